@@ -7,6 +7,9 @@
 
 p4sfu::Controller::Controller(const Config& c)
     : _config{c},
+      _logSink{c.asyncLog || !c.logFile.empty()
+          ? std::make_unique<AsyncLogSink>(AsyncLogSink::Config{.file = c.logFile})
+          : nullptr},
       _io{},
       _ssl{c.certFile, c.keyFile},
       _clients{_io, c.clientSidePort, _ssl.ssl},
@@ -28,7 +31,8 @@ p4sfu::Controller::Controller(const Config& c)
                    << "data-plane-addr=" << c.dataPlaneIPv4 << ":" << c.dataPlanePort << ", "
                    << "limit-net=" << c.limitNetwork << "/" << (int) c.limitMask << ", "
                    << "cert-file=" << c.certFile << ", "
-                   << "key-file=" << c.keyFile
+                   << "key-file=" << c.keyFile << ", "
+                   << "async-log=" << (_logSink != nullptr)
                    << std::endl;
 
     // set up handlers for client-side connections:
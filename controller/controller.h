@@ -5,6 +5,7 @@
 #include <nlohmann/json.hpp>
 #include <boost/asio.hpp>
 
+#include "../lib/async_log_sink.h"
 #include "../lib/controller_api.h"
 #include "../lib/controller_client_connection.h"
 #include "../lib/controller_client_interface.h"
@@ -40,6 +41,8 @@ namespace p4sfu {
             std::string   limitNetwork;
             std::uint8_t  limitMask;
             bool          verbose;
+            bool          asyncLog;
+            std::string   logFile; // implies asyncLog
         };
 
         Controller() = delete;
@@ -72,6 +75,9 @@ namespace p4sfu {
 
         Config _config;
 
+        //! declared first: created before and destroyed after everything that logs
+        std::unique_ptr<AsyncLogSink> _logSink;
+
         asio::io_context _io;
 
         struct _ssl {
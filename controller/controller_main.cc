@@ -27,6 +27,9 @@ cxxopts::Options setOptions() {
         ("k,key-file", "key file", cxxopts::value<std::string>(), "FILE")
         ("l,limit-net", "limit subnet for data plane", cxxopts::value<std::string>(), "IP/MASK")
         ("v,verbose", "log debug messages")
+        ("async-log", "write log messages from a background thread")
+        ("log-file", "write log messages to this file (implies --async-log)",
+         cxxopts::value<std::string>(), "FILE")
         ("h,help", "print this help message");
 
     return opts;
@@ -45,7 +48,9 @@ p4sfu::Controller::Config parseOptions(cxxopts::Options opts, int argc, char** a
         .keyFile        = "key.pem",
         .limitNetwork   = "0.0.0.0",
         .limitMask      = 0,
-        .verbose        = false
+        .verbose        = false,
+        .asyncLog       = false,
+        .logFile        = ""
     };
 
     auto parsed = opts.parse(argc, argv);
@@ -79,6 +84,12 @@ p4sfu::Controller::Config parseOptions(cxxopts::Options opts, int argc, char** a
     if (parsed.count("v"))
         config.verbose = true;
 
+    if (parsed.count("async-log"))
+        config.asyncLog = true;
+
+    if (parsed.count("log-file"))
+        config.logFile = parsed["log-file"].as<std::string>();
+
     if (parsed.count("h"))
         printHelp(opts);
 
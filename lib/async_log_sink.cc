@@ -0,0 +1,215 @@
+
+#include "async_log_sink.h"
+
+#include <bit>
+#include <ctime>
+#include <stdexcept>
+
+namespace {
+
+    //! records written per batch before the writer flushes
+    const std::size_t BATCH_SIZE = 256;
+
+    const char* label(Log::level l) {
+
+        switch (l) {
+            case Log::level::ERROR: return "ERROR";
+            case Log::level::WARN:  return "WARN";
+            case Log::level::INFO:  return "INFO";
+            case Log::level::DEBUG: return "DEBUG";
+            case Log::level::TRACE: return "TRACE";
+            default:                return "-";
+        }
+    }
+}
+
+AsyncLogSink::AsyncLogSink(const Config& c)
+    : _config(c),
+      _ring(new Slot[std::bit_ceil(std::max<std::size_t>(c.capacity, 2))]),
+      _mask(std::bit_ceil(std::max<std::size_t>(c.capacity, 2)) - 1),
+      _out(stdout),
+      _err(stderr) {
+
+    for (std::size_t i = 0; i <= _mask; i++) {
+        _ring[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    if (!_config.file.empty()) {
+
+        _out = std::fopen(_config.file.c_str(), "a");
+
+        if (!_out) {
+            throw std::runtime_error("AsyncLogSink: AsyncLogSink() failed: cannot open "
+                + _config.file + ": " + std::to_string(errno));
+        }
+
+        _err = _out;
+    }
+
+    _thread = std::thread([this]() { _run(); });
+    Log::sink(this);
+}
+
+AsyncLogSink::~AsyncLogSink() {
+
+    Log::sink(nullptr);
+
+    _stop.store(true, std::memory_order_release);
+    _signal.store(1);
+    _signal.notify_one();
+    _thread.join();
+
+    if (_out != stdout) {
+        std::fclose(_out);
+    }
+}
+
+bool AsyncLogSink::push(Log::level l, std::string&& text) {
+
+    auto pos = _head.load(std::memory_order_relaxed);
+    Slot* slot;
+
+    for (;;) {
+
+        slot = &_ring[pos & _mask];
+        auto diff = static_cast<std::intptr_t>(slot->seq.load(std::memory_order_acquire))
+            - static_cast<std::intptr_t>(pos);
+
+        if (diff == 0) {
+            if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) { // full, the writer has not released this slot yet
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = l;
+    slot->ts = std::chrono::system_clock::now();
+    slot->text = std::move(text);
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    // orders the store of the record before the load of the signal, pairs with the fence in
+    // _run(): either the writer sees the record or this sees its wait announcement
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (_signal.load(std::memory_order_relaxed) == 0 && _signal.exchange(1) == 0) {
+        _signal.notify_one();
+    }
+
+    return true;
+}
+
+AsyncLogSink::Statistics AsyncLogSink::statistics() const {
+
+    return Statistics{
+        .records = _records.load(std::memory_order_relaxed),
+        .dropped = _dropped.load(std::memory_order_relaxed),
+        .batches = _batches.load(std::memory_order_relaxed)
+    };
+}
+
+void AsyncLogSink::_run() {
+
+    for (;;) {
+
+        if (_drain() > 0) {
+            continue;
+        }
+
+        if (_stop.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        // re-check after announcing the wait, a producer may have pushed in between
+        _signal.store(0);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (_ring[_tail & _mask].seq.load(std::memory_order_acquire) == _tail + 1) {
+            continue;
+        }
+
+        _signal.wait(0);
+    }
+}
+
+std::size_t AsyncLogSink::_drain() {
+
+    std::size_t n = 0;
+
+    for (; n < BATCH_SIZE; n++) {
+
+        auto& slot = _ring[_tail & _mask];
+
+        if (slot.seq.load(std::memory_order_acquire) != _tail + 1) {
+            break;
+        }
+
+        auto& buf = (slot.level == Log::level::ERROR && _err != _out ? _errBuf : _outBuf);
+
+        if (_config.timestamps) {
+            _appendTimestamp(buf, slot.ts);
+        }
+
+        buf.append(slot.text);
+        slot.text.clear();
+
+        slot.seq.store(_tail + _mask + 1, std::memory_order_release);
+        _tail++;
+    }
+
+    if (auto dropped = _dropped.load(std::memory_order_relaxed); dropped != _reportedDropped) {
+
+        auto& buf = (_err != _out ? _errBuf : _outBuf);
+
+        if (_config.timestamps) {
+            _appendTimestamp(buf, std::chrono::system_clock::now());
+        }
+
+        buf.append("[").append(label(Log::level::WARN)).append("]  AsyncLogSink: dropped ")
+            .append(std::to_string(dropped - _reportedDropped)).append(" records\n");
+        _reportedDropped = dropped;
+    }
+
+    if (!_outBuf.empty()) {
+        std::fwrite(_outBuf.data(), 1, _outBuf.size(), _out);
+        std::fflush(_out);
+        _outBuf.clear();
+    }
+
+    if (!_errBuf.empty()) {
+        std::fwrite(_errBuf.data(), 1, _errBuf.size(), _err);
+        std::fflush(_err);
+        _errBuf.clear();
+    }
+
+    if (n > 0) {
+        _records.fetch_add(n, std::memory_order_relaxed);
+        _batches.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return n;
+}
+
+void AsyncLogSink::_appendTimestamp(std::string& out, std::chrono::system_clock::time_point ts) {
+
+    using namespace std::chrono;
+
+    auto us = duration_cast<microseconds>(ts.time_since_epoch()).count();
+    std::time_t sec = us / 1000000;
+
+    // localtime_r() is only called once per second
+    if (sec != _lastSecond) {
+        std::tm tm{};
+        ::localtime_r(&sec, &tm);
+        std::strftime(_secondPrefix, sizeof(_secondPrefix), "%Y-%m-%d %H:%M:%S", &tm);
+        _lastSecond = sec;
+    }
+
+    char frac[16];
+    std::snprintf(frac, sizeof(frac), ".%06ld ", static_cast<long>(us % 1000000));
+    out.append(_secondPrefix).append(frac);
+}
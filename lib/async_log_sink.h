@@ -0,0 +1,84 @@
+
+#ifndef P4SFU_ASYNC_LOG_SINK_H
+#define P4SFU_ASYNC_LOG_SINK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "log.h"
+
+//! asynchronous sink for Log
+//! - producers move preformatted records into a bounded lock-free ring and never block, records
+//!   are dropped and counted if the ring is full
+//! - a background thread writes records in batches with timestamps to stdout/stderr or a file
+//! - the sink registers itself with Log while it exists, it must outlive all threads that log
+class AsyncLogSink {
+public:
+
+    struct Config {
+        //! number of records the ring holds, rounded up to a power of two
+        std::size_t capacity = 8192;
+        //! output file (appended), stdout/stderr if empty
+        std::string file;
+        bool timestamps = true;
+    };
+
+    struct Statistics {
+        std::uint64_t records = 0;
+        std::uint64_t dropped = 0;
+        std::uint64_t batches = 0;
+    };
+
+    explicit AsyncLogSink(const Config& c);
+    AsyncLogSink(const AsyncLogSink&) = delete;
+    AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+    ~AsyncLogSink();
+
+    //! appends a record without blocking, returns false if the record was dropped
+    bool push(Log::level l, std::string&& text);
+
+    [[nodiscard]] Statistics statistics() const;
+
+private:
+
+    struct Slot {
+        std::atomic<std::size_t> seq;
+        Log::level level;
+        std::chrono::system_clock::time_point ts;
+        std::string text;
+    };
+
+    void _run();
+    std::size_t _drain();
+    void _appendTimestamp(std::string& out, std::chrono::system_clock::time_point ts);
+
+    Config _config;
+    std::unique_ptr<Slot[]> _ring;
+    std::size_t _mask;
+
+    alignas(64) std::atomic<std::size_t> _head{0};
+    alignas(64) std::size_t _tail = 0;
+
+    std::atomic<unsigned> _signal{0};
+    std::atomic<bool> _stop{false};
+
+    std::atomic<std::uint64_t> _records{0};
+    std::atomic<std::uint64_t> _dropped{0};
+    std::atomic<std::uint64_t> _batches{0};
+    std::uint64_t _reportedDropped = 0;
+
+    std::FILE* _out;
+    std::FILE* _err;
+    std::string _outBuf;
+    std::string _errBuf;
+    std::time_t _lastSecond = -1;
+    char _secondPrefix[32] = {};
+
+    std::thread _thread;
+};
+
+#endif
@@ -1,7 +1,8 @@
 
 #include "av1.h"
-#include "util.h"
+#include "bitstream.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 av1::DependencyDescriptor::MandatoryFields::MandatoryFields(const unsigned char* buf)
@@ -23,14 +24,50 @@ unsigned av1::DependencyDescriptor::MandatoryFields::frameNumber() const {
     return (_buf[1] << 8) + _buf[2];
 }
 
-av1::DependencyDescriptor::DependencyDescriptor(const unsigned char* bytes, unsigned len)
+namespace {
+
+    //! FNV-1a over the length and the bits [from, to) in chunks of up to 32 bits, never 0
+    std::uint64_t hashBits(const Bitstream& bits, std::size_t from, std::size_t to) {
+
+        std::uint64_t h = (0xcbf29ce484222325ull ^ (to - from)) * 0x100000001b3ull;
+
+        for (auto i = from; i < to; i += 32) {
+            h ^= bits.extract(i, std::min<std::size_t>(32, to - i));
+            h *= 0x100000001b3ull;
+        }
+
+        return h ? h : 1;
+    }
+}
+
+const av1::DependencyDescriptor::frame_dependency_template*
+av1::DependencyDescriptor::template_dependency_structure::find(unsigned templateId) const {
+
+    auto index = (templateId + MAX_TEMPLATES - template_id_offset) % MAX_TEMPLATES;
+    return index < templates.size() ? &templates[index] : nullptr;
+}
+
+av1::DependencyDescriptor::DependencyDescriptor(const unsigned char* bytes, unsigned len,
+                                                const template_dependency_structure* structure)
     : _buf(bytes), _len(len), _mandatoryFields(bytes) {
 
     if (len < MandatoryFields_LEN)
         throw std::logic_error("av1::DependencyDescriptor: len must be at least 3");
 
+    Bitstream bits{bytes, len};
+    bits.skip(MandatoryFields_LEN * 8);
+
     if (len > MandatoryFields_LEN)
-        _parse_bytes();
+        _parse_extended_descriptor_fields(bits, structure);
+
+    if (_structure)
+        structure = &*_structure;
+
+    // without a structure, the fields that follow can't be delimited
+    if (structure) {
+        _dt_cnt = structure->dt_cnt;
+        _parse_frame_dependency_definition(bits, *structure);
+    }
 }
 
 const class av1::DependencyDescriptor::MandatoryFields& av1::DependencyDescriptor::mandatoryFields() const {
@@ -68,128 +105,102 @@ unsigned av1::DependencyDescriptor::dtCnt() const {
     return _dt_cnt;
 }
 
-const std::map<unsigned, struct av1::DependencyDescriptor::frame_dependency_template>&
-av1::DependencyDescriptor::templates() const {
+const av1::DependencyDescriptor::template_dependency_structure*
+av1::DependencyDescriptor::structure() const {
 
-    return _templates;
+    return _structure ? &*_structure : nullptr;
 }
 
-void av1::DependencyDescriptor::_parse_bytes() {
-
-    auto bits = _bit_vector_from_bytes(_buf, _len);
+std::uint64_t av1::DependencyDescriptor::structureHash() const {
 
-    unsigned total_consumed_bits = MandatoryFields_LEN * 8;
-
-    total_consumed_bits = _parse_extended_descriptor_fields(bits, total_consumed_bits);
-    // total_consumed_bits = _parse_frame_dependency_definition(bits, total_consumed_bits);
+    return _structure_hash;
 }
 
-unsigned av1::DependencyDescriptor::_parse_extended_descriptor_fields(
-        const std::vector<bool>& bits, unsigned total_consumed_bits) {
-
-    auto i = total_consumed_bits;
-
-    _template_dependency_structure_present_flag = bits[i++];
-    _active_decode_targets_present_flag = bits[i++];
-    _custom_dtis_flag = bits[i++];
-    _custom_fdiffs_flag = bits[i++];
-    _custom_chains_flag = bits[i++];
-
-    /*
-     std::cout << "template_dependency_structure_present_flag: "
-               <<  _template_dependency_structure_present_flag << std::endl;
-     std::cout << "active_decode_targets_present_flag: "
-               << _active_decode_targets_present_flag << std::endl;
-     std::cout << "custom_dtis_flag: " << _custom_dtis_flag << std::endl;
-     std::cout << "custom_fdiffs_flag: " << _custom_fdiffs_flag << std::endl;
-     std::cout << "custom_chains_flag: " << _custom_chains_flag << std::endl;
-    */
+std::span<const av1::DependencyDescriptor::frame_dependency_template>
+av1::DependencyDescriptor::templates() const {
 
-    if (_template_dependency_structure_present_flag) {
-        i = _parse_template_dependency_structure(bits, i);
-        _active_decode_targets_bitmask = (1 << _dt_cnt) - 1;
+    if (!_structure) {
+        return {};
     }
 
-    /*
-    if (_active_decode_targets_present_flag) {
-        _active_decode_targets_bitmask = util::extract_bits(bits, i, _dt_cnt);
-        i += _dt_cnt;
-    }
-    */
+    return {_structure->templates.begin(), _structure->templates.end()};
+}
+
+const av1::DependencyDescriptor::frame_dependency_template*
+av1::DependencyDescriptor::frame() const {
 
-    return i;
+    return _frame ? &*_frame : nullptr;
 }
 
-/*
-unsigned av1::DependencyDescriptor::_parse_frame_dependency_definition(
-        const std::vector<bool>& bits, unsigned total_consumed_bits) {
+std::optional<std::uint32_t> av1::DependencyDescriptor::activeDecodeTargets() const {
 
-    auto i = total_consumed_bits;
-    return i;
+    return _active_decode_targets_bitmask;
 }
-*/
 
-unsigned av1::DependencyDescriptor::_parse_template_dependency_structure(
-        const std::vector<bool>& bits, unsigned total_consumed_bits) {
+std::optional<std::pair<unsigned, unsigned>> av1::DependencyDescriptor::frameResolution() const {
 
-    auto i = total_consumed_bits;
+    return _frame_resolution;
+}
 
-    _template_id_offset = util::extractBits(bits, i, 6);
-    i += 6;
-    auto dt_cnt_minus_one = util::extractBits(bits, i, 5);
-    i += 5;
+void av1::DependencyDescriptor::_parse_extended_descriptor_fields(
+        Bitstream& bits, const template_dependency_structure* structure) {
 
-    // std::cout << "template_id_offset: " << _template_id_offset << std::endl;
-    // std::cout << "dt_cnt_minus_one: " << dt_cnt_minus_one << std::endl;
+    _template_dependency_structure_present_flag = bits.read(1);
+    _active_decode_targets_present_flag = bits.read(1);
+    _custom_dtis_flag = bits.read(1);
+    _custom_fdiffs_flag = bits.read(1);
+    _custom_chains_flag = bits.read(1);
 
-    _dt_cnt = dt_cnt_minus_one + 1;
+    if (_template_dependency_structure_present_flag) {
+        auto from = bits.position();
+        _parse_template_dependency_structure(bits);
+        _structure_hash = hashBits(bits, from, bits.position());
+        structure = &*_structure;
+        _active_decode_targets_bitmask = (std::uint32_t) ((1ull << structure->dt_cnt) - 1);
+    }
 
-    unsigned max_spatial_id = 0, chain_cnt = 0;
+    if (_active_decode_targets_present_flag && structure) {
+        _active_decode_targets_bitmask = bits.read(structure->dt_cnt);
+    }
+}
 
-    i = _parse_template_layers(bits, i, max_spatial_id);
-    i = _parse_template_dtis(bits, i);
+void av1::DependencyDescriptor::_parse_template_dependency_structure(Bitstream& bits) {
 
-    /*
-    i = _parse_template_fdiffs(bits, i);
+    auto& s = _structure.emplace();
 
-    i = _parse_template_chains(bits, i, chain_cnt);
+    s.template_id_offset = bits.read(6);
+    s.dt_cnt = bits.read(5) + 1;
 
-    i = _parse_decode_target_layers(bits, i);
+    _parse_template_layers(bits, s);
+    _parse_template_dtis(bits, s);
+    _parse_template_fdiffs(bits, s);
+    _parse_template_chains(bits, s);
+    _parse_decode_target_layers(s);
 
-    _resolutions_present_flag = util::extract_bits(bits, i, 1);
-    i += 1;
+    s.resolutions_present_flag = bits.read(1);
 
-    if (_resolutions_present_flag) {
-       i = _parse_render_resolutions(bits, i, max_spatial_id);
+    if (s.resolutions_present_flag) {
+        _parse_render_resolutions(bits, s);
     }
-    */
-
-    return i;
 }
 
-unsigned av1::DependencyDescriptor::_parse_template_layers(const std::vector<bool>& bits,
-                                                            unsigned i, unsigned& max_spatial_id) {
+void av1::DependencyDescriptor::_parse_template_layers(Bitstream& bits,
+                                                        template_dependency_structure& s) {
 
-    unsigned temporal_id = 0, spatial_id = 0, max_temporal_id = 0, next_layer_idc = 0;
+    unsigned temporal_id = 0, spatial_id = 0, next_layer_idc = 0;
 
     do {
-        _template_spatial_id.push_back(spatial_id);
-        _template_temporal_id.push_back(temporal_id);
-
-        _templates[_template_id_offset + _template_cnt] = {spatial_id, temporal_id};
+        frame_dependency_template tpl;
+        tpl.id = (s.template_id_offset + (unsigned) s.templates.size()) % MAX_TEMPLATES;
+        tpl.spatial_layer_id = spatial_id;
+        tpl.temporal_layer_id = temporal_id;
+        s.templates.push_back(tpl);
 
-        _template_cnt++;
-
-        next_layer_idc = util::extractBits(bits, i, 2);
-        i += 2;
+        next_layer_idc = bits.read(2);
 
         if (next_layer_idc == 1) {
             temporal_id++;
-
-            if (temporal_id > max_temporal_id) {
-                max_temporal_id = temporal_id;
-            }
-
+            s.max_temporal_id = std::max(s.max_temporal_id, temporal_id);
         } else if (next_layer_idc == 2) {
             temporal_id = 0;
             spatial_id++;
@@ -197,205 +208,262 @@ unsigned av1::DependencyDescriptor::_parse_template_layers(const std::vector<boo
 
     } while (next_layer_idc != 3);
 
-    max_spatial_id = spatial_id;
-
-    /*
-    std::cout << "_template_spatial_id: ";
-    for (auto j = 0; j < _template_spatial_id.size(); j++) {
-        std::cout << (j > 0 ? ", " : "") << j << " -> " << _template_spatial_id[j];
+    if (spatial_id >= MAX_SPATIAL_LAYERS) {
+        throw std::invalid_argument("av1::DependencyDescriptor: too many spatial layers");
     }
-    std::cout << std::endl;
 
-    std::cout << "_template_temporal_id: ";
-    for (auto j = 0; j < _template_temporal_id.size(); j++) {
-        std::cout << (j > 0 ? ", " : "") << j << " -> " << _template_temporal_id[j];
-    }
-    std::cout << std::endl;
+    s.max_spatial_id = spatial_id;
+}
 
-    std::cout << "max_spatial_id: " << max_spatial_id << std::endl;
-    std::cout << "max_temporal_id: " << max_temporal_id << std::endl;
-    */
+void av1::DependencyDescriptor::_parse_template_dtis(Bitstream& bits,
+                                                      template_dependency_structure& s) {
 
-    return i;
+    for (unsigned template_index = 0; template_index < s.templates.size(); template_index++) {
+        for (unsigned dt_index = 0; dt_index < s.dt_cnt; dt_index++) {
+            s.templates[template_index].dtis.push_back((dti) bits.read(2));
+        }
+    }
 }
 
-unsigned av1::DependencyDescriptor::_parse_template_dtis(const std::vector<bool>&bits, unsigned i) {
+void av1::DependencyDescriptor::_parse_template_fdiffs(Bitstream& bits,
+                                                        template_dependency_structure& s) {
 
-    for (auto template_index = 0; template_index < _template_cnt; template_index++) {
-        for (auto dt_index = 0; dt_index < _dt_cnt; dt_index++) {
-            auto dti = (enum dti) util::extractBits(bits, i, 2);
-            _templates[template_index + _template_id_offset].dtis.push_back(dti);
-            i += 2;
+    for (unsigned template_index = 0; template_index < s.templates.size(); template_index++) {
+        while (bits.read(1)) { // fdiff_follows_flag
+            s.templates[template_index].fdiffs.push_back((std::uint16_t) (bits.read(4) + 1));
         }
     }
-
-    return i;
 }
 
-/*
-unsigned av1::DependencyDescriptor::_parse_template_fdiffs(const std::vector<bool>& bits, unsigned i) {
+void av1::DependencyDescriptor::_parse_template_chains(Bitstream& bits,
+                                                        template_dependency_structure& s) {
+
+    s.chain_cnt = bits.readNonSymmetric(s.dt_cnt + 1);
+
+    if (s.chain_cnt == 0) {
+        return;
+    }
 
-    unsigned fdiff_cnt = 0;
+    for (unsigned dt_index = 0; dt_index < s.dt_cnt; dt_index++) {
+        s.decode_target_protected_by[dt_index] = (std::uint8_t) bits.readNonSymmetric(s.chain_cnt);
+    }
 
-    for (auto template_index = 0; template_index < _template_cnt; template_index++) {
+    for (unsigned template_index = 0; template_index < s.templates.size(); template_index++) {
+        for (unsigned chain_index = 0; chain_index < s.chain_cnt; chain_index++) {
+            s.templates[template_index].chain_fdiffs.push_back((std::uint8_t) bits.read(4));
+        }
+    }
+}
 
-        fdiff_cnt = 0;
-        unsigned fdiff_follows_flag = util::extractBits(bits, i, 1);
-        i += 1;
+void av1::DependencyDescriptor::_parse_decode_target_layers(template_dependency_structure& s) {
 
-        while (fdiff_follows_flag) {
+    for (unsigned dt_index = 0; dt_index < s.dt_cnt; dt_index++) {
 
-            unsigned fdiff_minus_one = util::extractBits(bits, i, 4);
-            i += 4;
-            _templates[template_index + _template_id_offset].fdiffs.push_back(fdiff_minus_one + 1);
-            fdiff_cnt++;
-            fdiff_follows_flag = util::extractBits(bits, i, 1);
-            i += 1;
+        unsigned spatial_id = 0, temporal_id = 0;
+
+        for (const auto& tpl: s.templates) {
+            if (tpl.dtis[dt_index] != dti::not_present_indication) {
+                spatial_id = std::max(spatial_id, tpl.spatial_layer_id);
+                temporal_id = std::max(temporal_id, tpl.temporal_layer_id);
+            }
         }
+
+        s.decode_target_spatial_id[dt_index] = (std::uint8_t) spatial_id;
+        s.decode_target_temporal_id[dt_index] = (std::uint8_t) temporal_id;
     }
+}
 
-    return i;
+void av1::DependencyDescriptor::_parse_render_resolutions(Bitstream& bits,
+                                                           template_dependency_structure& s) {
+
+    for (unsigned spatial_id = 0; spatial_id <= s.max_spatial_id; spatial_id++) {
+        s.max_render_width_minus_1[spatial_id] = (std::uint16_t) bits.read(16);
+        s.max_render_height_minus_1[spatial_id] = (std::uint16_t) bits.read(16);
+    }
 }
-*/
 
-unsigned av1::DependencyDescriptor::_parse_template_chains(const std::vector<bool>& bits,
-                                                            unsigned i, unsigned& chain_cnt) {
+void av1::DependencyDescriptor::_parse_frame_dependency_definition(
+        Bitstream& bits, const template_dependency_structure& s) {
 
-    auto ns_chain_cnt = util::extractNonSymmetric(bits, i, _dt_cnt + 1);
-    chain_cnt = ns_chain_cnt.first;
-    i += ns_chain_cnt.second;
+    const auto* tpl = s.find(_mandatoryFields.templateId());
 
-    // std::cout << "_dt_cnt: " << _dt_cnt << std::endl;
-    // std::cout << "chain_cnt: " << chain_cnt << std::endl;
+    if (!tpl) {
+        throw std::invalid_argument("av1::DependencyDescriptor: unknown template ID "
+                                    + std::to_string(_mandatoryFields.templateId()));
+    }
 
-    if (chain_cnt == 0) {
-        return i;
+    auto& frame = _frame.emplace(*tpl);
+
+    if (_custom_dtis_flag) {
+        frame.dtis.clear();
+
+        for (unsigned dt_index = 0; dt_index < s.dt_cnt; dt_index++) {
+            frame.dtis.push_back((dti) bits.read(2));
+        }
     }
 
-    // std::cout << "decode_target_protected_by:" << std::endl;
+    if (_custom_fdiffs_flag) {
+        frame.fdiffs.clear();
 
-    for (auto dt_index = 0; dt_index < _dt_cnt; dt_index++) {
-        auto ns_decode_target_protected_by = util::extractNonSymmetric(bits, i, chain_cnt);
-        i += ns_decode_target_protected_by.second;
-        // std::cout << "  " << dt_index << " -> " << ns_decode_target_protected_by.first << std::endl;
+        while (auto next_fdiff_size = bits.read(2)) {
+            frame.fdiffs.push_back((std::uint16_t) (bits.read(4 * next_fdiff_size) + 1));
+        }
     }
 
-    return i;
+    if (_custom_chains_flag) {
+        frame.chain_fdiffs.clear();
+
+        for (unsigned chain_index = 0; chain_index < s.chain_cnt; chain_index++) {
+            frame.chain_fdiffs.push_back((std::uint8_t) bits.read(8));
+        }
+    }
+
+    if (s.resolutions_present_flag) {
+        _frame_resolution = {s.max_render_width_minus_1[frame.spatial_layer_id] + 1u,
+                             s.max_render_height_minus_1[frame.spatial_layer_id] + 1u};
+    }
 }
 
-unsigned av1::DependencyDescriptor::_parse_decode_target_layers(const std::vector<bool>& bits, unsigned i) {
+av1::DropTable::DropTable(const DependencyDescriptor& dd)
+    : _decodeTargets(std::min<unsigned>(dd.dtCnt(), MAX_DECODE_TARGETS)) {
 
-    for (unsigned dt_index = 0; dt_index < _dt_cnt; dt_index++) {
+    if (!dd.template_dependency_structure_present_flag()) {
+        throw std::invalid_argument("av1::DropTable: no template dependency structure");
+    }
 
-        unsigned spatial_id = 0, temporal_id = 0;
+    for (const auto& tpl: dd.templates()) {
+        for (unsigned dt = 0; dt < _decodeTargets && dt < tpl.dtis.size(); dt++) {
+            if (tpl.dtis[dt] == DependencyDescriptor::dti::not_present_indication) {
+                _exclusion[dt] |= 1ull << tpl.id;
+            }
+        }
+    }
+}
 
-        for (unsigned template_index = 0; template_index < _template_cnt; template_index++) {
+bool av1::FrameChain::forward(unsigned frameNumber, const frame_dependency_template* frame,
+                              const template_dependency_structure* s,
+                              std::optional<unsigned> decodeTarget, bool dropped,
+                              bool keyframe) {
 
-            if (_template_dti[template_index][dt_index] != 0) {
+    auto f = _unwrap(frameNumber);
 
-                if (_template_spatial_id[template_index] > spatial_id) {
-                    spatial_id = _template_spatial_id[template_index];
-                }
+    if (_started && f <= _highest - (std::int64_t) WINDOW) {
 
-                if (_template_temporal_id[template_index] > temporal_id) {
-                    temporal_id = _template_temporal_id[template_index];
-                }
-            }
+        const std::uint8_t* diff = frame && s && s->dt_cnt > 0
+            ? _chainFdiff(*frame, *s, decodeTarget.value_or(s->dt_cnt - 1)) : nullptr;
+
+        if (!keyframe && !(diff && *diff == 0)) { // too late to be of use
+            return false;
         }
 
-        _decode_target_spatial_id.push_back(spatial_id);
-        _decode_target_temporal_id.push_back(temporal_id);
+        *this = FrameChain{}; // the stream started over
+        f = _unwrap(frameNumber);
     }
 
-    /*
-    std::cout << "_decode_target_spatial_id:" << std::endl;
-    for (auto i = 0; i < _decode_target_spatial_id.size(); i++)
-        std::cout << "  " << i << " -> " << _decode_target_spatial_id[i] << std::endl;
+    if (_started && f <= _highest && (_seen[_word(f)] & _bit(f))) {
+        return _forwarded(f); // decided on an earlier packet of the frame
+    }
 
-    std::cout << "_decode_target_temporal_id:" << std::endl;
-    for (auto i = 0; i < _decode_target_temporal_id.size(); i++)
-        std::cout << "  " << i << " -> " << _decode_target_temporal_id[i] << std::endl;
-    */
+    bool forward = !dropped;
 
-    return i;
+    if (forward && frame && s && s->dt_cnt > 0) {
+        forward = _decodable(f, *frame, *s, decodeTarget.value_or(s->dt_cnt - 1));
+    }
+
+    _record(f, forward);
+    return forward;
 }
 
-unsigned av1::DependencyDescriptor::_parse_render_resolutions(
-        const std::vector<bool>& bits, unsigned i, const unsigned& max_spatial_id) {
+bool av1::FrameChain::broken() const {
 
-    for (unsigned spatial_id = 0; spatial_id < max_spatial_id; spatial_id++) {
-        _max_render_width_minus_one.push_back(util::extractBits(bits, i, 16));
-        i += 16;
-        _max_render_height_minus_one.push_back(util::extractBits(bits, i, 16));
-        i += 16;
-    }
+    return _broken;
+}
 
-    /*
-    std::cout << "_max_render_width_minus_one:" << std::endl;
-    for (auto i = 0; i < _max_render_width_minus_one.size(); i++)
-        std::cout << "  " << i << " -> " << _max_render_width_minus_one[i] << std::endl;
+bool av1::FrameChain::_decodable(std::int64_t f, const frame_dependency_template& frame,
+                                 const template_dependency_structure& s, unsigned dt) {
 
-    std::cout << "_max_render_height_minus_one:" << std::endl;
-    for (auto i = 0; i < _max_render_height_minus_one.size(); i++)
-        std::cout << "  " << i << " -> " << _max_render_height_minus_one[i] << std::endl;
-    */
+    const auto* chainFdiff = _chainFdiff(frame, s, dt);
 
-    return i;
-}
+    if (!chainFdiff) { // no chain protects the decode target
+        return true;
+    }
 
-unsigned av1::DependencyDescriptor::_parse_frame_chains(const std::vector<bool>& bits, unsigned i,
-                                                         unsigned& chain_cnt) {
+    auto diff = *chainFdiff;
 
-    // std::cout << "frame_chain_diff:" << std::endl;
-    for (auto chain_index = 0; chain_index < chain_cnt; chain_index++) {
-        // std::cout << "  " << chain_index << " -> " << util::extract_bits(bits, i, 4)
-        //           << std::endl;
-        i += 4;
+    if (diff == 0) { // restarts the chain
+        _broken = false;
+        return true;
     }
 
-    return i;
-}
+    if (!_broken && _forwarded(f - diff)) {
+        return true;
+    }
+
+    // a switch point of the decode target is decodable if the frames it references were
+    // forwarded, regardless of the chain
+    _broken = dt >= frame.dtis.size()
+        || frame.dtis[dt] != DependencyDescriptor::dti::switch_indication
+        || !std::all_of(frame.fdiffs.begin(), frame.fdiffs.end(), [this, f](auto fdiff) {
+            return _forwarded(f - fdiff);
+        });
 
-unsigned av1::DependencyDescriptor::_parse_frame_dependency_definition(
-        const std::vector<bool>& bits, unsigned i) {
+    return !_broken;
+}
 
-    unsigned template_index = (mandatoryFields().templateId() + 64 - _template_id_offset) % 64;
+const std::uint8_t* av1::FrameChain::_chainFdiff(const frame_dependency_template& frame,
+                                                  const template_dependency_structure& s,
+                                                  unsigned dt) {
 
-    if (template_index > _template_cnt) {
-        throw std::logic_error("_parse_frame_dependency_definition: template_index < template_cnt");
+    if (dt >= s.dt_cnt || s.chain_cnt == 0) {
+        return nullptr;
     }
 
-    auto frame_spatial_id = _template_spatial_id[template_index];
-    auto frame_temporal_id = _template_temporal_id[template_index];
+    auto chain = s.decode_target_protected_by[dt];
 
-    if (_custom_dtis_flag) {
-        throw std::logic_error("_custom_dtis_flag: not supported");
+    if (chain >= frame.chain_fdiffs.size()) {
+        return nullptr;
     }
 
-    if (_custom_fdiffs_flag) {
-        throw std::logic_error("_custom_fdiffs_flag: not supported");
+    return &frame.chain_fdiffs[chain];
+}
+
+std::int64_t av1::FrameChain::_unwrap(unsigned frameNumber) const {
+
+    if (!_started) {
+        return frameNumber;
     }
 
-    if (_custom_chains_flag) {
-        throw std::logic_error("_custom_chains_flag: not supported");
+    return _highest + (std::int16_t) (std::uint16_t) (frameNumber - (std::uint16_t) _highest);
+}
+
+bool av1::FrameChain::_forwarded(std::int64_t f) const {
+
+    if (!_started || f < _first) {
+        return true;
     }
 
-    if (_resolutions_present_flag) {
-        auto frame_max_width =  _max_render_width_minus_one[frame_spatial_id] + 1;
-        auto frame_max_height = _max_render_height_minus_one[frame_spatial_id] + 1;
+    if (f > _highest || f <= _highest - (std::int64_t) WINDOW) {
+        return false;
     }
 
-    return i;
+    return _sent[_word(f)] & _bit(f);
 }
 
-std::vector<bool> av1::DependencyDescriptor::_bit_vector_from_bytes(
-        const unsigned char* buf, unsigned len) {
+void av1::FrameChain::_record(std::int64_t f, bool forwarded) {
 
-    std::vector<bool> bits(len * 8);
+    if (!_started) {
+        _first = _highest = f;
+        _started = true;
+    }
+
+    // frames that slide into the window haven't been seen yet
+    for (auto n = std::max(_highest + 1, f - (std::int64_t) WINDOW + 1); n <= f; n++) {
+        _seen[_word(n)] &= ~_bit(n);
+        _sent[_word(n)] &= ~_bit(n);
+    }
 
-    for (auto i = 0; i < len; i++)
-        for (auto j = 7; j >= 0; j--)
-            bits[(i + 1) * 8 - j - 1] = ((buf[i] >> j) & 1);
+    _highest = std::max(_highest, f);
 
-    return bits;
+    _seen[_word(f)] |= _bit(f);
+    _sent[_word(f)] = forwarded ? _sent[_word(f)] | _bit(f) : _sent[_word(f)] & ~_bit(f);
 }
@@ -2,84 +2,113 @@
 #ifndef P4SFU_AV1_H
 #define P4SFU_AV1_H
 
+#include <array>
 #include <cstdint>
 #include <iostream>
 #include <map>
-#include <vector>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
 
-namespace av1 {
-
-    namespace svc {
-
-        struct L1T2 {
-            enum class DecodeTarget : unsigned {
-                lo = 0,
-                hi = 1
-            } decodeTarget = DecodeTarget::hi;
-
-            [[nodiscard]] bool drop(const unsigned templateId) const {
-                return decodeTarget == DecodeTarget::hi ? false : templateId % 3 == 2;
-            }
-        };
+#include "bitstream.h"
 
-        struct L1T3 {
-
-            L1T3() = default;
+namespace av1 {
 
-            enum class DecodeTarget : unsigned {
-                lo  = 0,
-                mid = 1,
-                hi  = 2
-            } decodeTarget = DecodeTarget::hi;
+    //! vector of trivially copyable values with a fixed capacity, keeps parsed descriptors off
+    //! the heap
+    //! - elements beyond size() are left uninitialized, a vector of 64 templates costs nothing
+    //!   until they are parsed
+    template <typename T, std::size_t N>
+    class StaticVector {
 
-            static constexpr unsigned short MAX_IDENT = 2;
+    public:
+        static_assert(std::is_trivially_copyable_v<T> && N <= 0xff);
 
-            static DecodeTarget decodeTargetFromNumIdentifier(const unsigned int target) {
+        StaticVector() { }
 
-                switch (target) {
-                    case 0: return DecodeTarget::lo;
-                    case 1: return DecodeTarget::mid;
-                    case 2: return DecodeTarget::hi;
-                    default:
-                        throw std::logic_error(
-                            "svc::L1T3::decodeTargetFromNumIdentifier: invalid target: " +
-                            std::to_string(target));
-                }
+        void push_back(const T& v) {
+            if (_size == N) {
+                throw std::invalid_argument("av1::StaticVector: capacity exceeded");
             }
+            std::construct_at(_data.data() + _size++, v);
+        }
 
+        void clear() { _size = 0; }
 
-            [[nodiscard]] bool drop(const unsigned templateId) const {
-
-                switch (decodeTarget) {
-                    case DecodeTarget::hi:
-                        return false;
-                    case DecodeTarget::mid:
-                        return templateId % 5 == 3 || templateId % 5 == 4;
-                    case DecodeTarget::lo:
-                        return templateId % 5 == 2 || templateId % 5 == 3 || templateId % 5 == 4;
-                }
+        [[nodiscard]] std::size_t size() const { return _size; }
+        [[nodiscard]] bool empty() const { return _size == 0; }
+        [[nodiscard]] const T& operator[](std::size_t i) const { return _data[i]; }
+        [[nodiscard]] T& operator[](std::size_t i) { return _data[i]; }
+        [[nodiscard]] const T* begin() const { return _data.data(); }
+        [[nodiscard]] const T* end() const { return _data.data() + _size; }
 
-                return false;
-            }
+    private:
+        union {
+            std::array<T, N> _data;
         };
-
-    }
+        std::uint8_t _size = 0;
+    };
 
     class DependencyDescriptor {
 
     public:
-        enum class dti : unsigned {
+        //! limits of the template dependency structure: template IDs are 6 bits,
+        //! dt_cnt_minus_one is 5 bits, chain_cnt is at most DtCnt, spatial IDs are 2 bits
+        static constexpr unsigned MAX_TEMPLATES = 64;
+        static constexpr unsigned MAX_DECODE_TARGETS = 32;
+        static constexpr unsigned MAX_CHAINS = MAX_DECODE_TARGETS;
+        static constexpr unsigned MAX_SPATIAL_LAYERS = 4;
+        //! the spec doesn't limit the number of frame diffs, encoders reference a few frames
+        static constexpr unsigned MAX_FDIFFS = 16;
+
+        enum class dti : std::uint8_t {
             not_present_indication = 0,
             discardable_indication = 1,
             switch_indication      = 2,
             required_indication    = 3
         };
 
+        //! the layer and dependencies of a template, or of a frame after applying the custom
+        //! fields of its descriptor
         struct frame_dependency_template {
+            unsigned id                = 0;
             unsigned spatial_layer_id  = 0;
             unsigned temporal_layer_id = 0;
-            std::vector<dti> dtis = {};
-            //std::vector<unsigned> fdiffs = {};
+            StaticVector<dti, MAX_DECODE_TARGETS> dtis;
+            //! differences of the frame numbers of the referenced frames
+            StaticVector<std::uint16_t, MAX_FDIFFS> fdiffs;
+            //! per chain, difference of the frame number of the previous frame in the chain
+            StaticVector<std::uint8_t, MAX_CHAINS> chain_fdiffs;
+        };
+
+        //! sent with keyframes, applies to the descriptors of the following frames
+        struct template_dependency_structure {
+
+            //! user-provided, so that emplacing it doesn't zero all templates first
+            template_dependency_structure() { }
+
+            //! nullptr if the structure has no template of the ID
+            [[nodiscard]] const frame_dependency_template* find(unsigned templateId) const;
+
+            unsigned template_id_offset = 0;
+            unsigned dt_cnt             = 0;
+            unsigned chain_cnt          = 0;
+            unsigned max_spatial_id     = 0;
+            unsigned max_temporal_id    = 0;
+            //! in template index order, i.e., from template ID template_id_offset on
+            StaticVector<frame_dependency_template, MAX_TEMPLATES> templates;
+            //! per decode target
+            std::array<std::uint8_t, MAX_DECODE_TARGETS> decode_target_protected_by = {};
+            std::array<std::uint8_t, MAX_DECODE_TARGETS> decode_target_spatial_id = {};
+            std::array<std::uint8_t, MAX_DECODE_TARGETS> decode_target_temporal_id = {};
+            //! per spatial layer
+            bool resolutions_present_flag = false;
+            std::array<std::uint16_t, MAX_SPATIAL_LAYERS> max_render_width_minus_1 = {};
+            std::array<std::uint16_t, MAX_SPATIAL_LAYERS> max_render_height_minus_1 = {};
         };
 
         class MandatoryFields {
@@ -97,8 +126,11 @@ namespace av1 {
         };
 
         DependencyDescriptor() = default;
-        explicit DependencyDescriptor(const unsigned char* bytes, unsigned len);
-        //explicit DependencyDescriptor(const std::array<unsigned char, 32>& bytes);
+        //! structure: the latest template dependency structure of the stream, resolves the frame
+        //! dependencies of descriptors that don't carry their own
+        //! - throws std::invalid_argument if the descriptor is truncated or malformed
+        explicit DependencyDescriptor(const unsigned char* bytes, unsigned len,
+                                      const template_dependency_structure* structure = nullptr);
 
         [[nodiscard]] const MandatoryFields& mandatoryFields() const;
 
@@ -108,28 +140,42 @@ namespace av1 {
         [[nodiscard]] bool custom_fdiffs_flag() const;
         [[nodiscard]] bool custom_chains_flag() const;
 
+        //! decode targets of the structure in effect, 0 if there is none
         [[nodiscard]] unsigned dtCnt() const;
 
-        [[nodiscard]] const std::map<unsigned, struct frame_dependency_template>& templates() const;
+        //! the structure the descriptor carries, nullptr if it carries none
+        [[nodiscard]] const template_dependency_structure* structure() const;
 
-    private:
+        //! hash of the bits of the structure the descriptor carries, 0 if it carries none,
+        //! tells a repeated structure from a new one without comparing the parsed ones
+        [[nodiscard]] std::uint64_t structureHash() const;
+
+        //! templates of the structure the descriptor carries, empty if it carries none
+        [[nodiscard]] std::span<const frame_dependency_template> templates() const;
+
+        //! dependencies of the frame, nullptr if there is no structure in effect
+        [[nodiscard]] const frame_dependency_template* frame() const;
 
-        void _parse_bytes();
-        unsigned _parse_extended_descriptor_fields(const std::vector<bool>& bits, unsigned total_consumed_bits);
-        // unsigned _parse_frame_dependency_definition(const std::vector<bool>& bits, unsigned total_consumed_bits);
-        unsigned _parse_template_dependency_structure(const std::vector<bool>& bits, unsigned total_consumed_bits);
+        //! bit i: decode target i, set if the descriptor carries a structure or the mask
+        [[nodiscard]] std::optional<std::uint32_t> activeDecodeTargets() const;
 
-        unsigned _parse_template_layers(const std::vector<bool>& bits, unsigned i, unsigned& max_spatial_id);
-        unsigned _parse_template_dtis(const std::vector<bool>& bits, unsigned it);
-        //unsigned _parse_template_fdiffs(const std::vector<bool>& bits, unsigned i);
+        //! maximum render resolution of the frame's spatial layer, if the structure has one
+        [[nodiscard]] std::optional<std::pair<unsigned, unsigned>> frameResolution() const;
 
-        unsigned _parse_template_chains(const std::vector<bool>& bits, unsigned i, unsigned& chain_cnt);
-        unsigned _parse_decode_target_layers(const std::vector<bool>& bits, unsigned i);
-        unsigned _parse_render_resolutions(const std::vector<bool>& bits, unsigned i, const unsigned& max_spatial_id);
-        unsigned _parse_frame_chains(const std::vector<bool>& bits, unsigned i, unsigned& chain_cnt);
-        unsigned _parse_frame_dependency_definition(const std::vector<bool>& bits, unsigned i);
+    private:
+
+        void _parse_extended_descriptor_fields(Bitstream& bits,
+                                               const template_dependency_structure* structure);
+        void _parse_template_dependency_structure(Bitstream& bits);
+        void _parse_frame_dependency_definition(Bitstream& bits,
+                                                const template_dependency_structure& s);
 
-        [[nodiscard]] static std::vector<bool> _bit_vector_from_bytes(const unsigned char* buf, unsigned len);
+        static void _parse_template_layers(Bitstream& bits, template_dependency_structure& s);
+        static void _parse_template_dtis(Bitstream& bits, template_dependency_structure& s);
+        static void _parse_template_fdiffs(Bitstream& bits, template_dependency_structure& s);
+        static void _parse_template_chains(Bitstream& bits, template_dependency_structure& s);
+        static void _parse_decode_target_layers(template_dependency_structure& s);
+        static void _parse_render_resolutions(Bitstream& bits, template_dependency_structure& s);
 
         const unsigned char* _buf = nullptr;
         unsigned _len = 0;
@@ -143,27 +189,158 @@ namespace av1 {
         bool _custom_chains_flag = false;
 
         unsigned _dt_cnt = 0;
-        unsigned _template_cnt = 0;
-        unsigned _template_id_offset = 0;
-        std::uint32_t _active_decode_targets_bitmask = 0;
-        bool _resolutions_present_flag = false;
+        std::optional<std::uint32_t> _active_decode_targets_bitmask;
+        std::optional<std::pair<unsigned, unsigned>> _frame_resolution;
+
+        std::optional<template_dependency_structure> _structure;
+        std::uint64_t _structure_hash = 0;
+        std::optional<frame_dependency_template> _frame;
 
-        std::vector<unsigned> _template_spatial_id = {};
-        std::vector<unsigned> _template_temporal_id = {};
+        static const unsigned MandatoryFields_LEN = 3;
+    };
 
-        std::vector<std::vector<unsigned>> _template_dti = {};
+    //! per decode target, the template IDs of frames that aren't part of it, built from the DTIs
+    //! of a template dependency structure
+    //! - a frame is dropped for a decode target if its template's DTI for it is "not present"
+    //! - template IDs the structure doesn't define and decode targets beyond its dtCnt() are
+    //!   never dropped
+    class DropTable {
 
-        std::vector<unsigned> _decode_target_spatial_id = {};
-        std::vector<unsigned> _decode_target_temporal_id = {};
+    public:
+        static constexpr unsigned MAX_TEMPLATES = DependencyDescriptor::MAX_TEMPLATES;
+        static constexpr unsigned MAX_DECODE_TARGETS = DependencyDescriptor::MAX_DECODE_TARGETS;
+
+        constexpr DropTable() = default;
+        //! dd must carry a template dependency structure
+        explicit DropTable(const DependencyDescriptor& dd);
+        //! from precomputed exclusions, e.g., of a scalability mode known at compile time
+        constexpr DropTable(const std::array<std::uint64_t, MAX_DECODE_TARGETS>& exclusion,
+                            unsigned decodeTargets)
+            : _exclusion(exclusion), _decodeTargets(decodeTargets) { }
+
+        [[nodiscard]] constexpr bool drop(unsigned templateId, unsigned decodeTarget) const {
+            return (exclusion(decodeTarget) >> (templateId % MAX_TEMPLATES)) & 1u;
+        }
+
+        //! template IDs dropped for the decode target, bit t: template ID t
+        [[nodiscard]] constexpr std::uint64_t exclusion(unsigned decodeTarget) const {
+            return decodeTarget < _decodeTargets ? _exclusion[decodeTarget] : 0;
+        }
+
+        [[nodiscard]] constexpr unsigned decodeTargets() const {
+            return _decodeTargets;
+        }
 
-        std::vector<unsigned> _max_render_width_minus_one = {};
-        std::vector<unsigned> _max_render_height_minus_one = {};
+    private:
+        std::array<std::uint64_t, MAX_DECODE_TARGETS> _exclusion = {};
+        unsigned _decodeTargets = 0;
+    };
 
-        std::map<unsigned, struct frame_dependency_template> _templates;
+    //! decodability of the frames a receiver of a decode target gets, from the chain that
+    //! protects the decode target
+    //! - the chain is broken if the previous frame in the chain, as given by a frame's
+    //!   chain_fdiffs, wasn't forwarded, i.e., it was lost upstream or dropped
+    //! - while it is broken, frames are dropped until one restarts the chain (a chain_fdiff of
+    //!   0, e.g., a keyframe) or is a switch point of the decode target whose references were
+    //!   forwarded
+    //! - the first packet of a frame decides for all of its packets, losses within a frame are
+    //!   left to retransmissions
+    //! - frames before the first one seen are assumed forwarded, so a receiver that joins
+    //!   mid-stream isn't cut off
+    class FrameChain {
 
-        static const unsigned MandatoryFields_LEN = 3;
+    public:
+        using frame_dependency_template = DependencyDescriptor::frame_dependency_template;
+        using template_dependency_structure = DependencyDescriptor::template_dependency_structure;
+
+        //! frames remembered, chain_fdiffs reach back at most 255 frames
+        static constexpr unsigned WINDOW = 256;
+
+        //! returns true if the packet of frame frameNumber is to be forwarded
+        //! - frame, s: dependencies of the frame and the structure in effect, frames are
+        //!   forwarded if either is nullptr
+        //! - decodeTarget: of the receiver, none: all frames, i.e., the structure's highest
+        //! - dropped: the frame isn't forwarded anyway, e.g., since it isn't part of the decode
+        //!   target
+        //! - keyframe: the packet carries a template dependency structure
+        //! - a keyframe or a frame that restarts the chain more than WINDOW frames behind the
+        //!   highest, e.g., after the encoder restarted, starts the tracking over
+        bool forward(unsigned frameNumber, const frame_dependency_template* frame,
+                     const template_dependency_structure* s, std::optional<unsigned> decodeTarget,
+                     bool dropped = false, bool keyframe = false);
+
+        //! true from a frame whose chain is broken to the next frame that restarts it
+        [[nodiscard]] bool broken() const;
+
+    private:
+
+        [[nodiscard]] bool _decodable(std::int64_t f, const frame_dependency_template& frame,
+                                      const template_dependency_structure& s, unsigned dt);
+        [[nodiscard]] static const std::uint8_t* _chainFdiff(const frame_dependency_template& frame,
+                                                             const template_dependency_structure& s,
+                                                             unsigned dt);
+        [[nodiscard]] std::int64_t _unwrap(unsigned frameNumber) const;
+        [[nodiscard]] bool _forwarded(std::int64_t f) const;
+        void _record(std::int64_t f, bool forwarded);
+
+        //! word and bit of frame f in the bitmaps
+        static std::size_t _word(std::int64_t f) { return (std::uint64_t) f % WINDOW / 64; }
+        static std::uint64_t _bit(std::int64_t f) { return 1ull << ((std::uint64_t) f % 64); }
+
+        //! bit f % WINDOW: frame f, of the frames up to WINDOW before the highest
+        std::array<std::uint64_t, WINDOW / 64> _seen = {};
+        std::array<std::uint64_t, WINDOW / 64> _sent = {};
+        std::int64_t _first   = 0;
+        std::int64_t _highest = 0;
+        bool _started = false;
+        bool _broken  = false;
     };
 
+    namespace svc {
+
+        //! template dependency structure of a full SVC mode with S spatial and T temporal
+        //! layers, in the template order of libwebrtc's encoders: per spatial layer, templates
+        //! of T0, T0, then T1, then T2, T2
+        //! - decode target s * T + t holds the frames of spatial layers <= s and temporal layers
+        //!   <= t, so L1T3's decode targets are lo, mid, hi
+        //! - the drop table is computed at compile time, structures not known in advance are
+        //!   built from their DTIs at runtime instead
+        template <unsigned S, unsigned T>
+        struct FullSvc {
+
+            static_assert(S >= 1 && S <= 3 && T >= 2 && T <= 3, "unsupported scalability mode");
+
+            static constexpr unsigned TEMPLATES_PER_LAYER = T == 2 ? 3 : 5;
+            static constexpr unsigned TEMPLATES = S * TEMPLATES_PER_LAYER;
+            static constexpr unsigned DECODE_TARGETS = S * T;
+
+            //! drop table of the structure sent with the template ID offset
+            [[nodiscard]] static constexpr DropTable dropTable(unsigned templateIdOffset = 0) {
+
+                constexpr unsigned temporal[] = {0, 0, 1, 2, 2};
+                std::array<std::uint64_t, DropTable::MAX_DECODE_TARGETS> exclusion = {};
+
+                for (unsigned i = 0; i < TEMPLATES; i++) {
+
+                    auto s = i / TEMPLATES_PER_LAYER, t = temporal[i % TEMPLATES_PER_LAYER];
+                    auto bit = 1ull << ((templateIdOffset + i) % DropTable::MAX_TEMPLATES);
+
+                    for (unsigned dt = 0; dt < DECODE_TARGETS; dt++) {
+                        if (s > dt / T || t > dt % T) {
+                            exclusion[dt] |= bit;
+                        }
+                    }
+                }
+
+                return DropTable{exclusion, DECODE_TARGETS};
+            }
+        };
+
+        using L1T2Structure = FullSvc<1, 2>;
+        using L1T3Structure = FullSvc<1, 3>;
+        using L2T3Structure = FullSvc<2, 3>;
+    }
+
     static std::map<DependencyDescriptor::dti, std::string> dtiString = {
         {DependencyDescriptor::dti::not_present_indication, "not-present"},
         {DependencyDescriptor::dti::discardable_indication, "discardable"},
@@ -1,48 +1,51 @@
 
 #include "bitstream.h"
 
+#include <bit>
 #include <stdexcept>
 
 Bitstream::Bitstream(const unsigned char* buf, std::size_t len)
-        : _data(len * 8) {
-
-    for (auto byteIndex = 0; byteIndex < len; byteIndex++) {
-        for (auto bitIndex = 7; bitIndex >= 0; bitIndex--) {
-            _data[(byteIndex * 8 + (8 - bitIndex)) - 1] = (buf[byteIndex] >> bitIndex) & 1;
-        }
-    }
-}
+        : _buf(buf), _len(len) { }
 
 bool Bitstream::operator[](std::size_t idx) const {
 
-    if (idx >= _data.size()) {
+    if (idx >= bitCount()) {
         throw std::invalid_argument("Bitstream: operator[]: index out of range");
     }
 
-    return _data[idx];
+    return (_buf[idx / 8] >> (7 - idx % 8)) & 1;
 }
 
 unsigned Bitstream::bitCount() const {
-    return _data.size();
+    return _len * 8;
 }
 
-std::uint32_t Bitstream::extract(std::size_t idxFrom, std::size_t n /* = 1 */) {
+std::uint32_t Bitstream::readNonSymmetric(std::uint32_t n) {
 
-    std::uint32_t res = 0;
+    auto w = (std::size_t) std::bit_width(n);
+    auto m = (std::uint32_t) ((1ull << w) - n);
+    auto v = read(w - 1);
 
-    if (n > 0 && n <= 32 && _isValidIdx(idxFrom) && _isValidIdx(idxFrom + n - 1)) {
+    if (v < m) {
+        return v;
+    }
 
-        for (auto i = 0; i < n; i++) {
-            res |= ((std::uint32_t) _data[idxFrom + i]) << (n - i - 1);
-        }
+    return (v << 1) - m + read(1);
+}
 
-        return res;
+void Bitstream::skip(std::size_t n) {
 
-    } else {
-        throw std::invalid_argument("Bitstream: extract: index out of range");
+    if (n > remaining()) {
+        throw std::invalid_argument("Bitstream: skip: index out of range");
     }
+
+    _pos += n;
+}
+
+std::size_t Bitstream::position() const {
+    return _pos;
 }
 
-bool Bitstream::_isValidIdx(std::size_t idx) {
-    return idx < _data.size();
+std::size_t Bitstream::remaining() const {
+    return bitCount() - _pos;
 }
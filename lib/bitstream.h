@@ -2,9 +2,17 @@
 #ifndef P4SFU_BITSTREAM_H
 #define P4SFU_BITSTREAM_H
 
+#include <algorithm>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
-#include <vector>
+#include <cstring>
+#include <stdexcept>
 
+//! reads bit fields, most significant bit first, from a buffer it doesn't copy
+//! - fields are cut out of 64-bit big-endian words with a shift and a mask
+//! - extract() reads at any position, read() and readNonSymmetric() at a cursor
+//! - reading beyond the buffer throws std::invalid_argument
 class Bitstream {
 
 public:
@@ -12,11 +20,70 @@ public:
 
     [[nodiscard]] unsigned bitCount() const;
     [[nodiscard]] bool operator[](std::size_t idx) const;
-    [[nodiscard]] std::uint32_t extract(std::size_t idxFrom, std::size_t n = 1);
+    [[nodiscard]] std::uint32_t extract(std::size_t idxFrom, std::size_t n = 1) const;
+
+    //! reads n <= 32 bits at the cursor and advances it, f(n) of the AV1 spec
+    std::uint32_t read(std::size_t n = 1);
+    //! reads a value in [0, n) at the cursor and advances it, ns(n) of the AV1 spec
+    std::uint32_t readNonSymmetric(std::uint32_t n);
+    void skip(std::size_t n);
+
+    [[nodiscard]] std::size_t position() const;
+    [[nodiscard]] std::size_t remaining() const;
 
 private:
-    [[nodiscard]] bool _isValidIdx(std::size_t idx);
-    std::vector<bool> _data;
+    //! the 64 bits from byte on, zero-padded beyond the buffer
+    [[nodiscard]] std::uint64_t _word(std::size_t byte) const;
+
+    const unsigned char* _buf;
+    std::size_t _len;
+    std::size_t _pos = 0;
 };
 
+// the reads are inline, the parsers call them for every field
+
+inline std::uint32_t Bitstream::extract(std::size_t idxFrom, std::size_t n /* = 1 */) const {
+
+    if (n == 0 || n > 32 || idxFrom >= _len * 8 || n > _len * 8 - idxFrom) {
+        throw std::invalid_argument("Bitstream: extract: index out of range");
+    }
+
+    // at most 7 leading bits of the word precede the field, so it always fits
+    return (std::uint32_t) ((_word(idxFrom / 8) << (idxFrom % 8)) >> (64 - n));
+}
+
+inline std::uint32_t Bitstream::read(std::size_t n /* = 1 */) {
+
+    if (n == 0) {
+        return 0;
+    }
+
+    auto v = extract(_pos, n);
+    _pos += n;
+    return v;
+}
+
+inline std::uint64_t Bitstream::_word(std::size_t byte) const {
+
+    std::uint64_t w = 0;
+
+    if (_len < 8) {
+        for (std::size_t i = 0; i < 8; i++) {
+            w = w << 8 | (byte + i < _len ? _buf[byte + i] : 0);
+        }
+
+        return w;
+    }
+
+    // near the end, the last 8 bytes shifted into place
+    auto from = std::min(byte, _len - 8);
+    std::memcpy(&w, _buf + from, 8);
+
+    if constexpr (std::endian::native == std::endian::little) {
+        w = __builtin_bswap64(w);
+    }
+
+    return w << (8 * (byte - from));
+}
+
 #endif
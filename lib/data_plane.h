@@ -53,12 +53,19 @@ namespace p4sfu {
             _controlPlanePacketHandler = f;
         }
 
-        [[nodiscard]] const TotalPacketStatistics& totalStatistics() const {
+        [[nodiscard]] virtual const TotalPacketStatistics& totalStatistics() const {
             return _totalStatistics;
         }
 
+        //! per-match and per-receiver counters, empty if the data plane doesn't keep any
+        [[nodiscard]] virtual std::vector<StreamStatistics> streamStatistics() const {
+            return {};
+        }
+
         virtual void addStream(const Stream& s) = 0;
         virtual void removeStream(const Stream& s) = 0;
+        //! target: index of the receiver's decode target in the template dependency structure
+        //! of the sender's stream
         virtual void adjustDecodeTarget(const net::IPv4Port& from, const net::IPv4Port& to,
                                         SSRC ssrc, unsigned target) = 0;
 
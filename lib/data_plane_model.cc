@@ -1,6 +1,12 @@
 
 #include "data_plane_model.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <vector>
+
 #include "proto/stun.h"
 #include "proto/rtp.h"
 #include "proto/rtcp.h"
@@ -11,26 +17,135 @@ p4sfu::DataPlaneModel::DataPlaneModel(UDPInterface* udp)
     : DataPlane{},
       _udp{udp},
       _config{},
-      _rtpDropDist{1, _config.rtpDropRate} {
+      _rtpDropDist{1, _config.rtpDropRate},
+      _rtcpPuntFilter{_config.rtcpPuntFilter
+                          ? std::make_unique<RTCPPuntFilter>(*_config.rtcpPuntFilter) : nullptr} {
 
     _udp->onMessage([this](UDPInterface& c, asio::ip::udp::endpoint& from, const char* buf,
                            std::size_t len) {
 
         this->_onPacket(c, from, (const unsigned char*) buf, len);
     });
+
+    _udp->onBatch([this](UDPInterface& c, UDPInterface::Datagram* datagrams, std::size_t n) {
+        this->_onPacketBatch(c, datagrams, n);
+    });
+}
+
+p4sfu::DataPlaneModel::DataPlaneModel(UDPInterface* udp, const Config& c,
+                                      boost::asio::io_context* io)
+    : DataPlane{io},
+      _udp{udp},
+      _config{c},
+      _rtpDropDist{1, _config.rtpDropRate},
+      _rtcpPuntFilter{_config.rtcpPuntFilter
+                          ? std::make_unique<RTCPPuntFilter>(*_config.rtcpPuntFilter) : nullptr} {
+
+    _udp->onMessage([this](UDPInterface& c, asio::ip::udp::endpoint& from, const char* buf,
+                           std::size_t len) {
+
+        this->_onPacket(c, from, (const unsigned char*) buf, len);
+    });
+
+    _udp->onBatch([this](UDPInterface& c, UDPInterface::Datagram* datagrams, std::size_t n) {
+        this->_onPacketBatch(c, datagrams, n);
+    });
+
+    _setUpPacing();
+    _setUpTransportFeedback();
 }
 
 p4sfu::DataPlaneModel::DataPlaneModel(boost::asio::io_context* io, DataPlane::Config* c)
     : DataPlane{io},
-      _udp{new UDPServer{*io, reinterpret_cast<DataPlaneModel::Config*>(c)->port}},
+      _udp{_makeUDPInterface(*io, *reinterpret_cast<DataPlaneModel::Config*>(c))},
       _config{*reinterpret_cast<DataPlaneModel::Config*>(c)},
-      _rtpDropDist{1, _config.rtpDropRate} {
+      _rtpDropDist{1, _config.rtpDropRate},
+      _rtcpPuntFilter{_config.rtcpPuntFilter
+                          ? std::make_unique<RTCPPuntFilter>(*_config.rtcpPuntFilter) : nullptr} {
 
     _udp->onMessage([this](UDPInterface& c, asio::ip::udp::endpoint& from, const char* buf,
                            std::size_t len) {
 
         this->_onPacket(c, from, (const unsigned char*) buf, len);
     });
+
+    _udp->onBatch([this](UDPInterface& c, UDPInterface::Datagram* datagrams, std::size_t n) {
+        this->_onPacketBatch(c, datagrams, n);
+    });
+
+    _setUpPacing();
+    _setUpTransportFeedback();
+}
+
+p4sfu::DataPlaneModel::~DataPlaneModel() {
+
+    _alive.reset();
+
+    if (_pacingTimer) {
+        _pacingTimer->cancel();
+    }
+
+    if (_feedbackTimer) {
+        _feedbackTimer->cancel();
+    }
+}
+
+UDPInterface* p4sfu::DataPlaneModel::_makeUDPInterface(asio::io_context& io, const Config& c) {
+
+    if (c.ioUring) {
+        return new UringUDPServer{io, c.port};
+    } else if (c.ioBatchSize > 1) {
+        auto* udp = new BatchUDPServer{io, c.port, c.ioBatchSize, false, c.udpOffload};
+        if (c.pacing && c.pacing->txTime) {
+            udp->enableTxTime();
+        }
+        return udp;
+    } else {
+        return new UDPServer{io, c.port};
+    }
+}
+
+void p4sfu::DataPlaneModel::_setUpPacing() {
+
+    if (!_config.pacing) {
+        return;
+    }
+
+    auto pc = *_config.pacing;
+
+    if (pc.txTime && !_udp->txTime()) {
+        Log(Log::WARN) << "DataPlaneModel: _setUpPacing: UDP backend does not support "
+                       << "SO_TXTIME, pacing in the data plane" << std::endl;
+        pc.txTime = false;
+    }
+
+    if (!pc.txTime) {
+
+        if (!_io) {
+            throw std::invalid_argument("DataPlaneModel: pacing requires an io_context");
+        }
+
+        _pacingTimer = std::make_unique<asio::steady_timer>(*_io);
+    }
+
+    _pacer = std::make_unique<EgressPacer>(pc, [this](const net::IPv4Port& to, const char* hdr,
+        std::size_t hdrLen, const char* payload, std::size_t payloadLen,
+        EgressPacer::Clock::time_point departure) {
+
+        asio::ip::udp::endpoint ep{asio::ip::address_v4{to.ip().num()}, to.port()};
+
+        if (_pacer->config().txTime) {
+            _udp->sendToGatherAt(ep, hdr, hdrLen, payload, payloadLen, departure);
+        } else if (hdrLen == 0) {
+            _udp->sendTo(ep, payload, payloadLen);
+        } else {
+            _udp->sendToGather(ep, hdr, hdrLen, payload, payloadLen);
+        }
+    });
+
+    Log(Log::INFO) << "DataPlaneModel: _setUpPacing: pacing-factor=" << pc.pacingFactor
+                   << ", default-rate=" << pc.defaultRate << ", burst=" << pc.burst
+                   << ", tx-time=" << pc.txTime << std::endl;
 }
 
 void p4sfu::DataPlaneModel::sendPacket(const PktOut& pkt) {
@@ -39,6 +154,192 @@ void p4sfu::DataPlaneModel::sendPacket(const PktOut& pkt) {
     _udp->sendTo(to, (const char*) pkt.buf, pkt.len);
 }
 
+void p4sfu::DataPlaneModel::_sendRTP(const net::IPv4Port& to, const char* hdr,
+                                     std::size_t hdrLen, const char* payload,
+                                     std::size_t payloadLen) {
+
+    if (_pacer) {
+        _pacer->send(to, hdr, hdrLen, payload, payloadLen, EgressPacer::Clock::now());
+        _armPacingTimer();
+        return;
+    }
+
+    asio::ip::udp::endpoint ep{asio::ip::address_v4{to.ip().num()}, to.port()};
+
+    if (hdrLen == 0) {
+        _udp->sendTo(ep, payload, payloadLen);
+    } else {
+        _udp->sendToGather(ep, hdr, hdrLen, payload, payloadLen);
+    }
+}
+
+void p4sfu::DataPlaneModel::_armPacingTimer() {
+
+    if (!_pacingTimer || _pacingTimerArmed || _pacer->idle()) {
+        return;
+    }
+
+    _pacingTimerArmed = true;
+    _pacingTimer->expires_after(_pacer->config().tick);
+
+    _pacingTimer->async_wait([this, alive = std::weak_ptr{_alive}]
+                             (const system::error_code& ec) {
+
+        if (ec || alive.expired()) { // cancelled, the model may be gone
+            return;
+        }
+
+        _pacingTimerArmed = false;
+        _pacer->poll(EgressPacer::Clock::now());
+        _udp->flush();
+        _armPacingTimer();
+    });
+}
+
+void p4sfu::DataPlaneModel::_setUpTransportFeedback() {
+
+    if (_config.delayBasedEstimate && !_config.transportFeedback) {
+        throw std::invalid_argument("DataPlaneModel: delay-based estimates require transport-cc "
+                                    "feedback");
+    }
+
+    if (_config.transportFeedback) {
+        Log(Log::INFO) << "DataPlaneModel: _setUpTransportFeedback: rtp-ext="
+                       << _config.transportFeedback->rtpExt << ", interval="
+                       << std::chrono::duration_cast<std::chrono::milliseconds>(
+                              _config.transportFeedback->interval).count()
+                       << " ms, delay-based-estimate=" << _config.delayBasedEstimate.has_value()
+                       << std::endl;
+
+        if (_io) {
+            _feedbackTimer = std::make_unique<asio::steady_timer>(*_io);
+        }
+    }
+}
+
+const unsigned char* p4sfu::DataPlaneModel::_transportSeq(const rtp::hdr* rtp) const {
+
+    if (!_config.transportFeedback) {
+        return nullptr;
+    }
+
+    const auto* ext = rtp->extension_ptr(_config.transportFeedback->rtpExt);
+    return ext && rtp::ext_len(ext) == 2 ? ext : nullptr;
+}
+
+void p4sfu::DataPlaneModel::_recordArrival(const net::IPv4Port& from, SSRC ssrc,
+                                           std::uint16_t seq) {
+
+    auto now = TransportFeedback::Clock::now();
+    auto it = _transportFeedback.find(from);
+
+    if (it == _transportFeedback.end()) {
+        it = _transportFeedback.try_emplace(from, SenderFeedback{
+            .feedback = TransportFeedback{*_config.transportFeedback}
+        }).first;
+    }
+
+    auto& f = it->second;
+    f.feedback.record(seq, now);
+    f.ssrc = ssrc;
+
+    if (f.feedback.due(now)) {
+        _sendFeedback(from, f, now);
+    }
+
+    _armFeedbackTimer();
+}
+
+void p4sfu::DataPlaneModel::_sendFeedback(const net::IPv4Port& to, SenderFeedback& f,
+                                          TransportFeedback::Clock::time_point now) {
+
+    std::array<unsigned char, RetransmissionCache::MAX_PACKET_LEN> buf;
+
+    while (auto len = f.feedback.write(buf.data(), buf.size(), f.ssrc, now)) {
+        this->sendPacket(PktOut{to, buf.data(), len});
+        LOG(DEBUG) << "DataPlaneModel: _sendFeedback: sent transport-cc feedback to " << to
+                   << ", len=" << len << std::endl;
+    }
+}
+
+void p4sfu::DataPlaneModel::_armFeedbackTimer() {
+
+    if (!_feedbackTimer || _feedbackTimerArmed) {
+        return;
+    }
+
+    _feedbackTimerArmed = true;
+    _feedbackTimer->expires_after(_config.transportFeedback->interval);
+
+    _feedbackTimer->async_wait([this, alive = std::weak_ptr{_alive}]
+                               (const system::error_code& ec) {
+
+        if (ec || alive.expired()) { // cancelled, the model may be gone
+            return;
+        }
+
+        _feedbackTimerArmed = false;
+
+        auto now = TransportFeedback::Clock::now();
+        bool pending = false;
+
+        for (auto& [to, f]: _transportFeedback) {
+
+            if (f.feedback.due(now)) {
+                _sendFeedback(to, f, now);
+            }
+
+            pending = pending || f.feedback.pending();
+        }
+
+        _udp->flush();
+
+        if (pending) {
+            _armFeedbackTimer();
+        }
+    });
+}
+
+std::size_t p4sfu::DataPlaneModel::_copyHeader(const unsigned char* buf,
+                                               const unsigned char* twcc, unsigned char* hdr,
+                                               unsigned char*& stamp) const {
+
+    std::size_t len = sizeof(rtp::hdr);
+    stamp = nullptr;
+
+    // the extensions up to the transport-wide sequence number are copied as well
+    if (twcc && _config.delayBasedEstimate
+        && (std::size_t) (twcc + 3 - buf) <= MAX_EGRESS_HDR_LEN) {
+        len = twcc + 3 - buf;
+        stamp = hdr + (twcc + 1 - buf);
+    }
+
+    std::memcpy(hdr, buf, len);
+    return len;
+}
+
+void p4sfu::DataPlaneModel::_stamp(const net::IPv4Port& to, unsigned char* stamp,
+                                   std::size_t len) {
+
+    auto seq = _estimator(to).onSent(len, DelayBasedEstimator::Clock::now());
+    stamp[0] = (unsigned char) (seq >> 8);
+    stamp[1] = (unsigned char) seq;
+}
+
+p4sfu::DelayBasedEstimator& p4sfu::DataPlaneModel::_estimator(const net::IPv4Port& to) {
+
+    if (auto it = _estimators.find(to); it != _estimators.end()) {
+        return *it->second;
+    }
+
+    auto e = std::make_unique<DelayBasedEstimator>(*_config.delayBasedEstimate);
+    auto& ref = *e;
+
+    std::lock_guard lock{_estimatorsMutex};
+    _estimators.emplace(to, std::move(e));
+    return ref;
+}
+
 void p4sfu::DataPlaneModel::addStream(const Stream& s) {
 
     Log(Log::INFO) << "DataPlaneModel: addStream: src=" << s.src << ", dst=" << s.dst
@@ -48,106 +349,524 @@ void p4sfu::DataPlaneModel::addStream(const Stream& s) {
     // matches and action for RTP and RTCP SR/SDES packets
     SFUTable::Match mainMatch{s.src, s.ssrc}, rtxMatch{s.src, s.rtxSsrc};
 
-    _addMatch(mainMatch);
+    // when sharded, only matches keyed by addresses this instance owns are installed
+    bool ownsSrc = _owns(s.src), ownsDst = _owns(s.dst);
+
+    // all matches and actions of the stream are published as a single table version
+    _sfu.update([&](SFUTable& t) {
+
+        if (ownsSrc) {
+            _addMatch(t, mainMatch);
+
+            if (_config.nackCache) {
+                t[mainMatch].enableRetransmissionCache(*_config.nackCache);
+            }
+
+            if (_config.pliWindow || (_config.dropUndecodable && _config.undecodablePLI)) {
+                t[mainMatch].enableKeyframeRequests();
+            }
+
+            if (_config.dropUndecodable) {
+                t[mainMatch].enableFrameTracking();
+            }
+
+            if (s.rtxSsrc) {
+                _addMatch(t, rtxMatch);
+            }
+        }
+
+        if (s.dst == net::IPv4Port{0, 0}) { // send stream-only, just add match, no forwarding rule
+            return;
+        }
+
+        SFUTable::Action action{s.dst};
+        // action.dropLayers.dropT2();
+
+        // matches and action for RTCP packets going in reverse direction, only use single SSRC
+        // for now
+        SFUTable::Match retMatch{s.dst, s.rtcpSsrc}, retRtxMatch{s.dst, s.rtcpRtxSsrc};
+        SFUTable::Action retAction{s.src};
+
+        if (ownsDst) {
+            _addMatch(t, retMatch);
+
+            if (s.rtcpRtxSsrc && s.rtcpSsrc != 1) {
+                _addMatch(t, retRtxMatch);
+            } else if (s.rtcpRtxSsrc) {
+                // no action is added below, the sender's removal must still release the match
+                _addPeerMatch(t, retRtxMatch, s.src);
+            }
+        }
+
+        if (ownsSrc) {
+            _addAction(t, mainMatch, action);
+
+            if (s.rtxSsrc) {
+                _addAction(t, rtxMatch, action);
+            }
+        }
+
+        if (ownsDst) {
+            _addAction(t, retMatch, retAction);
+
+            // don't add second action when sender's SSRC (for RTCP) is 1
+            // would result in duplicate entries
+            if (s.rtcpRtxSsrc && s.rtcpSsrc != 1) {
+                _addAction(t, retRtxMatch, retAction);
+            }
+        }
+    });
+}
 
-    if (s.rtxSsrc) {
-        _addMatch(rtxMatch);
+void p4sfu::DataPlaneModel::removeStream(const Stream& s) {
+
+    Log(Log::INFO) << "DataPlaneModel: removeStream: src=" << s.src << ", dst=" << s.dst
+                   << ", ssrc=[" << s.ssrc << (s.rtxSsrc ? (","+std::to_string(s.rtxSsrc)) : "")
+                   << "]" << std::endl;
+
+    // reverses addStream(): matches shared with other streams stay until their last stream is gone
+    SFUTable::Match mainMatch{s.src, s.ssrc}, rtxMatch{s.src, s.rtxSsrc};
+    bool ownsSrc = _owns(s.src), ownsDst = _owns(s.dst);
+
+    _sfu.update([&](SFUTable& t) {
+
+        if (s.dst != net::IPv4Port{0, 0}) {
+
+            SFUTable::Match retMatch{s.dst, s.rtcpSsrc}, retRtxMatch{s.dst, s.rtcpRtxSsrc};
+
+            if (ownsSrc) {
+                _removeAction(t, mainMatch, s.dst);
+
+                if (s.rtxSsrc) {
+                    _removeAction(t, rtxMatch, s.dst);
+                }
+            }
+
+            if (ownsDst) {
+                _removeAction(t, retMatch, s.src);
+
+                if (s.rtcpRtxSsrc && s.rtcpSsrc != 1) {
+                    _removeAction(t, retRtxMatch, s.src);
+                }
+
+                _releaseMatch(t, retMatch);
+
+                if (s.rtcpRtxSsrc && s.rtcpSsrc != 1) {
+                    _releaseMatch(t, retRtxMatch);
+                } else if (s.rtcpRtxSsrc) {
+                    _releasePeerMatch(t, retRtxMatch, s.src);
+                }
+            }
+        }
+
+        if (ownsSrc) {
+            _releaseMatch(t, mainMatch);
+
+            if (s.rtxSsrc) {
+                _releaseMatch(t, rtxMatch);
+            }
+        }
+    });
+}
+
+void p4sfu::DataPlaneModel::removeParticipant(const net::IPv4Port& addr) {
+
+    Log(Log::INFO) << "DataPlaneModel: removeParticipant: addr=" << addr << std::endl;
+
+    _sfu.update([&](SFUTable& t) {
+
+        // actions forwarding to the participant, each reference was installed by one of its
+        // streams together with a reference to the match
+        if (auto it = _matchesTo.find(addr); it != _matchesTo.end()) {
+            for (auto matches = it->second; const auto& m: matches) {
+                auto refs = _actionRefs.find(m);
+                auto n = refs != _actionRefs.end() && refs->second.contains(addr)
+                       ? refs->second.at(addr) : 0u;
+
+                for (; n > 0; n--) {
+                    _removeAction(t, m, addr);
+                    _releaseMatch(t, m);
+                }
+            }
+        }
+
+        // matches its streams referenced without an action to it
+        std::vector<std::pair<SFUTable::Match, unsigned>> held;
+
+        for (const auto& [m, peers]: _peerMatchRefs) {
+            if (auto p = peers.find(addr); p != peers.end()) {
+                held.emplace_back(m, p->second);
+            }
+        }
+
+        for (const auto& [m, n]: held) {
+            for (auto i = n; i > 0; i--) {
+                _releasePeerMatch(t, m, addr);
+            }
+        }
+
+        // matches keyed by the participant's address, all streams they serve end with it
+        if (auto it = _matchesFrom.find(addr); it != _matchesFrom.end()) {
+            for (auto matches = it->second; const auto& m: matches) {
+                _eraseMatch(t, m);
+            }
+        }
+    });
+
+    // the pacer belongs to the packet-processing thread
+    if (_pacer && _io) {
+        asio::post(*_io, [this, addr, alive = std::weak_ptr{_alive}]() {
+            if (!alive.expired()) {
+                _pacer->removeReceiver(addr);
+            }
+        });
+    }
+
+    if (_rtcpPuntFilter) {
+        if (_io) {
+            asio::post(*_io, [this, addr, alive = std::weak_ptr{_alive}]() {
+                if (!alive.expired()) {
+                    _rtcpPuntFilter->removeReceiver(addr);
+                }
+            });
+        } else {
+            _rtcpPuntFilter->removeReceiver(addr);
+        }
+    }
+
+    // the structure cache belongs to the packet-processing thread as well
+    if (_io) {
+        asio::post(*_io, [this, addr, alive = std::weak_ptr{_alive}]() {
+            if (!alive.expired()) {
+                _av1Structures.erase(addr);
+            }
+        });
+    } else {
+        _av1Structures.erase(addr);
+    }
+
+    // transport-cc state belongs to the packet-processing thread as well
+    if (_config.transportFeedback) {
+
+        auto remove = [this, addr]() {
+            _transportFeedback.erase(addr);
+            std::lock_guard lock{_estimatorsMutex};
+            _estimators.erase(addr);
+        };
+
+        if (_io) {
+            asio::post(*_io, [remove, alive = std::weak_ptr{_alive}]() {
+                if (!alive.expired()) {
+                    remove();
+                }
+            });
+        } else {
+            remove();
+        }
+    }
+}
+
+p4sfu::RCU<p4sfu::SFUTable>::ReadGuard p4sfu::DataPlaneModel::sfuTable() const {
+
+    return _sfu.read();
+}
+
+void p4sfu::DataPlaneModel::adjustDecodeTarget(const net::IPv4Port& from, const net::IPv4Port& to,
+                                               SSRC ssrc, const unsigned target) {
+
+    if (target >= av1::DropTable::MAX_DECODE_TARGETS) {
+        Log(Log::ERROR) << "DataPlaneModel: adjustDecodeTarget: invalid target: "
+                        << target << std::endl;
+        return;
+    }
+
+    _sfu.update([&](SFUTable& t) {
+
+        // looked up in the version being modified, a concurrent removeStream() may have removed it
+        auto* entry = t.find(SFUTable::Match{from, ssrc});
+
+        if (!entry) {
+            Log(Log::ERROR) << "DataPlaneModel: adjustDecodeTarget: no match for " << from
+                            << ", ssrc=" << ssrc << std::endl;
+            return;
+        }
+
+        // the target indexes the decode targets of the stream's template dependency structure
+        if (target >= entry->decodeTargets()) {
+            Log(Log::ERROR) << "DataPlaneModel: adjustDecodeTarget: target not in the stream's "
+                            << "structure: from=" << from << ", ssrc=" << ssrc << ", target="
+                            << target << ", decodeTargets=" << entry->decodeTargets()
+                            << std::endl;
+            return;
+        }
+
+        for (auto& a: entry->actions()) {
+
+            if (a.to() == to) {
+
+                a.decodeTarget = target;
+                entry->updateTreatment(a);
+
+                Log(Log::INFO) << "DataPlaneModel: adjustDecodeTarget: decode target adjusted: "
+                               << "from=" << from << ", to=" << to << ", ssrc=" << ssrc
+                               << ", target=" << target << std::endl;
+
+                return;
+            }
+        }
+    });
+}
+
+p4sfu::TotalPacketStatistics p4sfu::DataPlaneModel::totalCounters() const {
+
+    return _counters.snapshot();
+}
+
+const p4sfu::TotalPacketStatistics& p4sfu::DataPlaneModel::totalStatistics() const {
+
+    _totalSnapshot = _counters.snapshot();
+    return _totalSnapshot;
+}
+
+std::vector<p4sfu::StreamStatistics> p4sfu::DataPlaneModel::streamStatistics() const {
+
+    std::vector<StreamStatistics> stats;
+    auto sfu = _sfu.read();
+
+    sfu->forEach([this, &stats](const SFUTable::Match& m, const SFUTable::Entry& e) {
+
+        auto& st = stats.emplace_back();
+        st.from  = m.ipPort();
+        st.ssrc  = m.ssrc();
+        st.pkts  = e.counters().pkts.get();
+        st.bytes = e.counters().bytes.get();
+
+        if (auto* cache = e.retransmissionCache()) {
+            st.nackCache = StreamStatistics::NACKCache{cache->hits.get(), cache->misses.get()};
+        }
+
+        if (auto* kr = e.keyframeRequests()) {
+            st.keyframeRequests = StreamStatistics::KeyframeRequests{
+                kr->forwarded.get(), kr->suppressed.get(), kr->keyframes.get()
+            };
+        }
+
+        for (const auto& a: e.actions()) {
+            st.receivers.push_back(StreamStatistics::Receiver{
+                .to            = a.to(),
+                .pkts          = a.state->pkts.get(),
+                .bytes         = a.state->bytes.get(),
+                .rewritten     = a.state->rewritten.get(),
+                .retransmitted = a.state->retransmitted.get()
+            });
+
+            if (auto p = _pacer ? _pacer->statistics(a.to()) : std::nullopt) {
+                st.receivers.back().pacing = StreamStatistics::Receiver::Pacing{
+                    .rate               = p->rate,
+                    .delayed            = p->delayed,
+                    .dropped            = p->dropped,
+                    .queueingDelayUs    = p->pkts ? p->queueingDelayUs / p->pkts : 0,
+                    .maxQueueingDelayUs = p->maxQueueingDelayUs
+                };
+            }
+
+            if (_config.delayBasedEstimate) {
+                std::lock_guard lock{_estimatorsMutex};
+
+                if (auto it = _estimators.find(a.to()); it != _estimators.end()) {
+                    st.receivers.back().delayBasedEstimate = it->second->estimate();
+                }
+            }
+        }
+
+        // packets are pruned per node, i.e., for all receivers with the same decode target
+        for (const auto& n: e.nodes()) {
+            for (auto r: n.replicas) {
+                st.receivers[r].svcDropped = n.state->pruned.get();
+                st.receivers[r].undecodableDropped = n.state->undecodable.get();
+            }
+        }
+    });
+
+    return stats;
+}
+
+void p4sfu::DataPlaneModel::setOwnership(std::function<bool (const net::IPv4Port&)>&& f) {
+
+    _ownership = std::move(f);
+}
+
+bool p4sfu::DataPlaneModel::_owns(const net::IPv4Port& addr) const {
+
+    return !_ownership || (*_ownership)(addr);
+}
+
+void p4sfu::DataPlaneModel::onForeignFeedback(Feedback&& f) {
+
+    _foreignFeedback = std::move(f);
+}
+
+void p4sfu::DataPlaneModel::forwardFeedback(const net::IPv4Port& from,
+                                            const net::IPv4Port& sender,
+                                            const unsigned char* buf, std::size_t len) {
+
+    LOG(DEBUG) << "DataPlaneModel: forwardFeedback: from=" << from << ", sender=" << sender
+               << std::endl;
+
+    _forwardFeedback(*_sfu.read(), from, sender, buf, len);
+}
+
+void p4sfu::DataPlaneModel::_addMatch(SFUTable& t, const SFUTable::Match& m) noexcept {
+
+    _matchRefs[m]++;
+
+    if (!t.hasMatch(m)) {
+        t.addMatch(m);
+        _matchesFrom[m.ipPort()].push_back(m);
+        Log(Log::INFO) << "DataPlaneModel: _addMatch: match added: addr=" << m.ipPort() << ", ssrc="
+                       << m.ssrc() << std::endl;
+    } else {
+        Log(Log::DEBUG) << "DataPlaneModel: _addMatch: match already exists: addr=" << m.ipPort()
+                        << ", ssrc=" << m.ssrc() << std::endl;
+    }
+}
+
+void p4sfu::DataPlaneModel::_addAction(SFUTable& t, const SFUTable::Match& match,
+                                       const SFUTable::Action& a) noexcept {
+
+    _actionRefs[match][a.to()]++;
+
+    if (auto& e = t[match]; !e.hasAction(a)) {
+        e.addAction(a);
+        _matchesTo[a.to()].push_back(match);
+        Log(Log::INFO) << "DataPlaneModel: _addAction: action added: "
+                       << "from=" << match.ipPort() << ", ssrc=" << match.ssrc() << ", "
+                       << "to=" << a.to() << std::endl;
+    } else {
+        Log(Log::DEBUG) << "DataPlaneModel: _addAction: action already exists: "
+                        << "from=" << match.ipPort() << ", ssrc=" << match.ssrc() << ", "
+                        << "to=" << a.to() << std::endl;
+    }
+}
+
+void p4sfu::DataPlaneModel::_removeAction(SFUTable& t, const SFUTable::Match& match,
+                                          const net::IPv4Port& to) noexcept {
+
+    SFUTable::Action a{to};
+    auto* e = t.find(match);
+    auto refs = _actionRefs.find(match);
+
+    if (!e || !e->hasAction(a) || refs == _actionRefs.end() || !refs->second.contains(to)) {
+        Log(Log::ERROR) << "DataPlaneModel: _removeAction: action does not exist: "
+                        << "from=" << match.ipPort() << ", ssrc=" << match.ssrc() << ", "
+                        << "to=" << to << std::endl;
+        return;
     }
 
-    if (s.dst == net::IPv4Port{0, 0}) { // send stream-only, just add match, no forwarding rule
+    if (--refs->second[to] > 0) {
+        Log(Log::DEBUG) << "DataPlaneModel: _removeAction: action still referenced: "
+                        << "from=" << match.ipPort() << ", ssrc=" << match.ssrc() << ", "
+                        << "to=" << to << std::endl;
         return;
     }
 
-    SFUTable::Action action{s.dst};
-    // action.dropLayers.dropT2();
+    refs->second.erase(to);
 
-    // matches and action for RTCP packets going in reverse direction, only use single SSRC for now
-    SFUTable::Match retMatch{s.dst, s.rtcpSsrc}, retRtxMatch{s.dst, s.rtcpRtxSsrc};
-    _addMatch(retMatch);
+    if (refs->second.empty()) {
+        _actionRefs.erase(refs);
+    }
 
-    SFUTable::Action retAction{s.src};
+    e->removeAction(a);
+    _unindex(_matchesTo, to, match);
 
-    if (s.rtcpRtxSsrc) {
-        _addMatch(retRtxMatch);
-    }
+    Log(Log::INFO) << "DataPlaneModel: _removeAction: action removed: "
+                   << "from=" << match.ipPort() << ", ssrc=" << match.ssrc() << ", "
+                   << "to=" << to << std::endl;
+}
 
-    _addAction(mainMatch, _sfu[mainMatch], action);
-    _addAction(retMatch, _sfu[retMatch], retAction);
+void p4sfu::DataPlaneModel::_releaseMatch(SFUTable& t, const SFUTable::Match& m) noexcept {
 
-    if (s.rtxSsrc) {
-        _addAction(rtxMatch, _sfu[rtxMatch], action);
+    auto r = _matchRefs.find(m);
+
+    if (r == _matchRefs.end()) {
+        Log(Log::ERROR) << "DataPlaneModel: _releaseMatch: match does not exist: addr="
+                        << m.ipPort() << ", ssrc=" << m.ssrc() << std::endl;
+        return;
     }
 
-    // don't add second action when sender's SSRC (for RTCP) is 1
-    // would result in duplicate entries
-    if (s.rtcpRtxSsrc && s.rtcpSsrc != 1) {
-        _addAction(retRtxMatch, _sfu[retRtxMatch], retAction);
+    if (--r->second == 0) {
+        _eraseMatch(t, m);
     }
 }
 
-void p4sfu::DataPlaneModel::removeStream(const Stream& s) {
+void p4sfu::DataPlaneModel::_addPeerMatch(SFUTable& t, const SFUTable::Match& m,
+                                          const net::IPv4Port& peer) noexcept {
 
-    throw std::domain_error("DataPlaneModel: removeStream: not implemented");
+    _peerMatchRefs[m][peer]++;
+    _addMatch(t, m);
 }
 
-void p4sfu::DataPlaneModel::adjustDecodeTarget(const net::IPv4Port& from, const net::IPv4Port& to,
-                                               SSRC ssrc, const unsigned target) {
+void p4sfu::DataPlaneModel::_releasePeerMatch(SFUTable& t, const SFUTable::Match& m,
+                                              const net::IPv4Port& peer) noexcept {
 
-    if (_sfu.hasMatch(SFUTable::Match{from, ssrc})) {
-        for (auto& entry = _sfu[SFUTable::Match{from, ssrc}]; auto& a: entry.actions()) {
+    auto refs = _peerMatchRefs.find(m);
 
-            if (a.to() == to) {
+    if (refs == _peerMatchRefs.end() || !refs->second.contains(peer)) {
+        Log(Log::ERROR) << "DataPlaneModel: _releasePeerMatch: match not referenced by peer: "
+                        << "addr=" << m.ipPort() << ", ssrc=" << m.ssrc() << ", "
+                        << "peer=" << peer << std::endl;
+        return;
+    }
 
-                if (!a.svcConfig) {
-                    a.svcConfig = av1::svc::L1T3{};
-                }
+    if (--refs->second[peer] == 0) {
+        refs->second.erase(peer);
 
-                if (target > av1::svc::L1T3::MAX_IDENT) {
-                    Log(Log::ERROR) << "DataPlaneModel: adjustDecodeTarget: invalid target: "
-                                    << target << std::endl;
-                    return;
-                }
+        if (refs->second.empty()) {
+            _peerMatchRefs.erase(refs);
+        }
+    }
 
-                a.svcConfig->decodeTarget = av1::svc::L1T3::decodeTargetFromNumIdentifier(target);
+    _releaseMatch(t, m);
+}
 
-                Log(Log::INFO) << "DataPlaneModel: adjustDecodeTarget: decode target adjusted: "
-                               << "from=" << from << ", to=" << to << ", ssrc=" << ssrc
-                               << ", target=" << target << std::endl;
+void p4sfu::DataPlaneModel::_eraseMatch(SFUTable& t, const SFUTable::Match& m) noexcept {
 
-                return;
-            }
-        }
+    _matchRefs.erase(m);
+    _actionRefs.erase(m);
+    _peerMatchRefs.erase(m);
 
-    } else {
-        Log(Log::ERROR) << "DataPlaneModel: adjustDecodeTarget: no match for " << from
-                        << ", ssrc=" << ssrc << std::endl;
+    auto* e = t.find(m);
+
+    if (!e) {
+        return;
+    }
+
+    for (const auto& a: e->actions()) {
+        _unindex(_matchesTo, a.to(), m);
     }
+
+    t.removeMatch(m);
+    _unindex(_matchesFrom, m.ipPort(), m);
+
+    Log(Log::INFO) << "DataPlaneModel: _eraseMatch: match removed: addr=" << m.ipPort()
+                   << ", ssrc=" << m.ssrc() << std::endl;
 }
 
-void p4sfu::DataPlaneModel::_addMatch(const SFUTable::Match& m) noexcept {
+void p4sfu::DataPlaneModel::_unindex(MatchIndex& index, const net::IPv4Port& addr,
+                                     const SFUTable::Match& m) {
 
-    if (!_sfu.hasMatch(m)) {
-        _sfu.addMatch(m);
-        Log(Log::INFO) << "DataPlaneModel: _addMatch: match added: addr=" << m.ipPort() << ", ssrc="
-                       << m.ssrc() << std::endl;
-    } else {
-        Log(Log::DEBUG) << "DataPlaneModel: _addMatch: match already exists: addr=" << m.ipPort()
-                        << ", ssrc=" << m.ssrc() << std::endl;
+    auto it = index.find(addr);
+
+    if (it == index.end()) {
+        return;
     }
-}
 
-void p4sfu::DataPlaneModel::_addAction(const SFUTable::Match& match, SFUTable::Entry& e,
-                                       const SFUTable::Action& a) noexcept {
+    std::erase_if(it->second, [&m](const SFUTable::Match& other) {
+        return SFUTable::Match::Equal{}(m, other);
+    });
 
-    if (!e.hasAction(a)) {
-        e.addAction(a);
-        Log(Log::INFO) << "DataPlaneModel: _addAction: action added: "
-                       << "from=" << match.ipPort() << ", ssrc=" << match.ssrc() << ", "
-                       << "to=" << a.to() << std::endl;
-    } else {
-        Log(Log::ERROR) << "DataPlaneModel: addStream: action already exists: "
-                        << "from=" << match.ipPort() << ", ssrc=" << match.ssrc() << ", "
-                        << "to=" << a.to() << std::endl;
+    if (it->second.empty()) {
+        index.erase(it);
     }
 }
 
@@ -156,14 +875,14 @@ void p4sfu::DataPlaneModel::_onPacket(UDPInterface& c, asio::ip::udp::endpoint&
 
     if (stun::bufferContainsSTUN(buf, len)) {
 
-        _totalStatistics.pkts++;
-        _totalStatistics.bytes += len;
+        _counters.pkts.add();
+        _counters.bytes.add(len);
         _handleSTUN(net::IPv4Port{from.address().to_v4().to_string(), from.port()}, buf, len);
 
     } else if (rtp::contains_rtp_or_rtcp(buf, len)) {
 
-        _totalStatistics.pkts++;
-        _totalStatistics.bytes += len;
+        _counters.pkts.add();
+        _counters.bytes.add(len);
 
         auto* rtp = (rtp::hdr*) buf;
 
@@ -175,10 +894,21 @@ void p4sfu::DataPlaneModel::_onPacket(UDPInterface& c, asio::ip::udp::endpoint&
     }
 }
 
+void p4sfu::DataPlaneModel::_onPacketBatch(UDPInterface& c, UDPInterface::Datagram* datagrams,
+    std::size_t n) {
+
+    for (std::size_t i = 0; i < n; i++) {
+        _onPacket(c, datagrams[i].from, (const unsigned char*) datagrams[i].buf, datagrams[i].len);
+    }
+
+    // all fan-out copies produced by this batch leave with a single sendmmsg():
+    c.flush();
+}
+
 void p4sfu::DataPlaneModel::_handleSTUN(const net::IPv4Port& from, const unsigned char* buf,
     std::size_t len) {
 
-    _totalStatistics.stunPkts++;
+    _counters.stunPkts.add();
 
     try {
         _controlPlanePacketHandler(*this, PktIn{PktIn::Reason::stun, from, buf, len});
@@ -190,116 +920,347 @@ void p4sfu::DataPlaneModel::_handleSTUN(const net::IPv4Port& from, const unsigne
 void p4sfu::DataPlaneModel::_handleRTP(const net::IPv4Port& from, const unsigned char* buf,
     std::size_t len) {
 
-    auto* rtp = (rtp::hdr*) buf;
+    const auto* rtp = (const rtp::hdr*) buf;
 
     if (_rtpDropDist(_rand)) {
-        Log(Log::INFO) << "DataPlaneModel: _handleRTP: randomly dropping packet: "
+        LOG(INFO) << "DataPlaneModel: _handleRTP: randomly dropping packet: "
             << "ssrc=" << ntohl(rtp->ssrc) << ", seq=" << ntohs(rtp->seq) << std::endl;
         return;
     }
 
-    _totalStatistics.rtpPkts++;
+    _counters.rtpPkts.add();
 
     auto* av1Ptr = rtp->extension_ptr(_config.av1RtpExt);
+    const unsigned char* av1Buf = nullptr;
+    unsigned av1Len = 0;
     std::optional<av1::DependencyDescriptor::MandatoryFields> av1;
+    std::optional<av1::DropTable> dropTable;
+    bool keyframe = false;
+
+    std::optional<av1::DependencyDescriptor> dd;
+
+    SFUTable::Match match{from, ntohl(rtp->ssrc)};
+    auto sfu = _sfu.read();
+    auto* entry = sfu->find(match);
 
     if (av1Ptr) {
 
-        av1 = av1::DependencyDescriptor{av1Ptr + 1, rtp::ext_len(av1Ptr)}.mandatoryFields();
+        // descriptors with a structure of several spatial layers need the two-byte header
+        auto profile = rtp->extension_profile();
+        av1Buf = av1Ptr + (profile == rtp::ext_profile::two_byte ? 2 : 1);
+        av1Len = rtp::ext_len(av1Ptr, profile);
+
+        // if frames are tracked, descriptors are resolved against the stream's latest structure
+        const auto* structure = entry ? entry->av1Structure() : nullptr;
+
+        try {
+            dd.emplace(av1Buf, av1Len, structure);
+        } catch (std::invalid_argument& e) {
+            LOG(WARN) << "DataPlaneModel: _handleRTP: malformed AV1 dependency descriptor: "
+                      << "ssrc=" << ntohl(rtp->ssrc) << ", " << e.what() << std::endl;
+
+            // e.g., a template of a structure whose keyframe was lost: the frame isn't tracked
+            if (structure) {
+                try {
+                    dd.emplace(av1Buf, av1Len);
+                } catch (std::invalid_argument&) { }
+            }
+        }
+    }
+
+    if (dd) {
+
+        av1 = dd->mandatoryFields();
+
+        // a keyframe starts with a descriptor carrying the template dependency structure
+        keyframe = av1->startOfFrame() && dd->template_dependency_structure_present_flag();
 
-        if (rtp::ext_len(av1Ptr) > 3) {
+        // the drop decisions follow the DTIs of the latest template dependency structure
+        if (dd->template_dependency_structure_present_flag()) {
+            dropTable.emplace(*dd);
+        }
+
+        if (av1->startOfFrame()) {
+            _counters.frames.add();
+        }
+
+        if (av1Len > 3) {
 
-            try {
-                _controlPlanePacketHandler(*this, PktIn{PktIn::Reason::av1, from, buf, len});
-            } catch (std::bad_function_call& e) {
-                throw std::logic_error("DataPlaneModel: no control-plane packet handler set");
+            // the switch agent keeps the structure and resolves later descriptors against it,
+            // only repeats of the structure are not punted, until the stream is installed, the
+            // agent may not know it and gets all of them
+            if (!dd->structure() || !entry || _av1StructureChanged(match, *dd)) {
+                try {
+                    _controlPlanePacketHandler(*this, PktIn{PktIn::Reason::av1, from, buf, len});
+                } catch (std::bad_function_call& e) {
+                    throw std::logic_error("DataPlaneModel: no control-plane packet handler set");
+                }
+            } else {
+                _counters.av1PuntsSuppressed.add();
             }
 
-            _totalStatistics.av1ExtendedDescriptors++;
+            _counters.av1ExtendedDescriptors.add();
         } else {
-            _totalStatistics.av1SimpleDescriptors++;
+            _counters.av1SimpleDescriptors.add();
         }
     }
 
-    SFUTable::Match match{from, ntohl(rtp->ssrc)};
+    if (entry) {
+        auto& actions = entry->actions();
+        auto origSeq = ntohs(rtp->seq);
 
-    if (_sfu.hasMatch(match)) {
-        auto& actions = _sfu[match].actions();
+        entry->counters().pkts.add();
+        entry->counters().bytes.add(len);
 
-        Log(Log::TRACE) << "DataPlaneModel: _handleRTP: packet match: from=" << from << ", ssrc="
-                        << ntohl(rtp->ssrc) << ", actions=" << actions.size() <<  std::endl;
+        auto* cache = entry->retransmissionCache();
 
-        for (auto& a: actions) {
+        if (cache) {
+            cache->insert(origSeq, buf, len, RetransmissionCache::Clock::now());
+        }
 
-            Log(Log::TRACE) << "  - action:" << std::endl;
+        if (dropTable) {
+            entry->updateExclusions(*dropTable);
+            entry->updateAV1Structure(*dd->structure());
+        }
 
-            if (av1) { // handling for video frames with av1 descriptor
+        // a keyframe answers the outstanding keyframe request
+        if (auto* kr = entry->keyframeRequests(); kr && keyframe) {
+            kr->requested.store(0, std::memory_order_relaxed);
+            kr->chainBroken.store(false, std::memory_order_relaxed);
+            kr->keyframes.add();
+        }
 
-                // determine if packet needs to be dropped
-                bool drop = a.svcConfig && a.svcConfig->drop(av1->templateId());
+        const auto* twcc = _transportSeq(rtp);
 
-                // compute new sequence number
-                auto seq = a.sequenceRewriter(av1->frameNumber(), ntohs(rtp->seq),
-                                              av1->startOfFrame(), av1->endOfFrame(), drop);
+        if (twcc) {
+            _recordArrival(from, ntohl(rtp->ssrc), (std::uint16_t) (twcc[1] << 8 | twcc[2]));
+        }
 
-                if (drop) {
-                    Log(Log::TRACE) << "    - drop packet" << std::endl;
-                    return; // drop the packet
+        // each receiver gets its own copy of the header, the rest of the packet is shared and
+        // sent without copying
+        alignas(rtp::hdr) std::array<unsigned char, MAX_EGRESS_HDR_LEN> hdrBuf;
+        unsigned char* stamp = nullptr;
+        auto hdrLen = _copyHeader(buf, twcc, hdrBuf.data(), stamp);
+        auto* hdr = reinterpret_cast<rtp::hdr*>(hdrBuf.data());
+
+        LOG(TRACE) << "DataPlaneModel: _handleRTP: packet match: from=" << from << ", ssrc="
+                   << ntohl(rtp->ssrc) << ", actions=" << actions.size() <<  std::endl;
+
+        if (!av1) {
+            for (auto& a: actions) {
+                if (stamp) {
+                    _stamp(a.to(), stamp, len);
+                    _sendRTP(a.to(), (const char*) hdr, hdrLen, (const char*) buf + hdrLen,
+                             len - hdrLen);
                 } else {
-                    rtp->seq = htons(*seq); // set new sequence number
-                    Log(Log::TRACE) << "    - rewrite seq " << ntohs(rtp->seq) << " -> " << *seq
-                                    << std::endl;
+                    _sendRTP(a.to(), nullptr, 0, (const char*) buf, len);
                 }
+                a.state->pkts.add();
+                a.state->bytes.add(len);
+                LOG(TRACE) << "  - sent to " << a.to() << std::endl;
             }
 
-            this->sendPacket(PktOut{a.to(), buf, len});
-            Log(Log::TRACE) << "    - sent to " << a.to() << std::endl;
+            return;
+        }
+
+        // if frames are tracked, those the receivers of a node can't decode are dropped
+        const auto* structure = entry->av1Structure();
+        bool broken = false;
+
+        // handling for video frames with av1 descriptor: replicate per node, i.e., per distinct
+        // decode target instead of per receiver
+        for (auto& node: entry->nodes()) {
+
+            LOG(TRACE) << "  - node: replicas=" << node.replicas.size() << std::endl;
+
+            // determine if packet needs to be dropped (L1 exclusion)
+            bool prune = entry->prunes(node, av1->templateId());
+            bool drop = prune;
+
+            if (structure) {
+                auto& chain = node.state->chain;
+                auto wasBroken = chain.broken();
+                drop = !chain.forward(av1->frameNumber(), dd->frame(), structure,
+                                      node.decodeTarget, prune, keyframe);
+                broken |= !wasBroken && chain.broken();
+            }
+
+            // compute new sequence number, once for all replicas of the node
+            auto seq = node.state->sequenceRewriter(av1->frameNumber(), origSeq,
+                                                    av1->startOfFrame(), av1->endOfFrame(), drop);
+
+            if (drop || !seq) {
+                LOG(TRACE) << "    - drop packet" << std::endl;
+                (drop && !prune ? node.state->undecodable : node.state->pruned).add();
+                continue; // prune the node
+            }
+
+            if (cache) {
+                node.state->sent.record(*seq, origSeq);
+            }
+
+            for (auto replica: node.replicas) { // per-replica egress processing
+
+                auto& a = actions[replica];
+                auto& st = *a.state;
+
+                // receiver moved from another node: continue its sequence numbers
+                if (st.node != node.state->id) {
+                    st.seqOffset = st.node ? st.lastSeq + 1 - *seq : 0;
+                    st.node = node.state->id;
+                    st.nodeSeq = *seq + st.seqOffset;
+                }
+
+                st.lastSeq = *seq + st.seqOffset;
+                hdr->seq = htons(st.lastSeq); // set new sequence number
+
+                if (st.lastSeq != origSeq) {
+                    st.rewritten.add();
+                }
+
+                LOG(TRACE) << "    - rewrite seq " << origSeq << " -> " << st.lastSeq
+                           << std::endl;
+
+                if (stamp) {
+                    _stamp(a.to(), stamp, len);
+                }
+
+                _sendRTP(a.to(), (const char*) hdr, hdrLen, (const char*) buf + hdrLen,
+                         len - hdrLen);
+
+                st.pkts.add();
+                st.bytes.add(len);
+
+                LOG(TRACE) << "    - sent to " << a.to() << std::endl;
+            }
+        }
+
+        if (broken && _config.undecodablePLI) {
+            _requestKeyframe(*entry, from, ntohl(rtp->ssrc));
         }
 
     } else {
-        Log(Log::WARN) << "DataPlaneModel: _handleRTP: no match for " << from << ", ssrc="
-                       << ntohl(rtp->ssrc) << std::endl;
+        LOG(WARN) << "DataPlaneModel: _handleRTP: no match for " << from << ", ssrc="
+                  << ntohl(rtp->ssrc) << std::endl;
     }
 }
 
 void p4sfu::DataPlaneModel::_handleRTCP(const net::IPv4Port& from, const unsigned char* buf,
                                    std::size_t len) {
 
-    _totalStatistics.rtcpPkts++;
+    _counters.rtcpPkts.add();
+
+    rtcp::compound packets{buf, len};
+
+    if (packets.truncated()) {
+        LOG(WARN) << "DataPlaneModel: _handleRTCP: truncated compound packet: from=" << from
+                  << ", len=" << len << std::endl;
+    }
+
+    // receiver reports and feedback are (also) passed to the switch agent
+    bool punt = false;
+    // an SR is forwarded with the rest of the compound packet, except for the feedback
+    // handled here
+    bool sr = false, feedback = false;
+
+    // dispatch each packet of the compound packet
+    for (auto it = packets.begin(); it != packets.end(); ++it) {
+
+        const auto& rtcp = *it;
+
+        LOG(DEBUG) << "DataPlaneModel: _handleRTCP: pt="
+                   << rtcp::pt_name(static_cast<rtcp::pt>(rtcp.pt)) << ", ssrc=" << std::dec
+                   << ntohl(rtcp.sender_ssrc) << std::endl;
+
+        if (!rtcp.complete()) {
+            LOG(WARN) << "DataPlaneModel: _handleRTCP: incomplete RTCP packet: from=" << from
+                      << ", pt=" << static_cast<unsigned>(rtcp.pt) << std::endl;
+
+            // NACKs are forwarded unchanged, the media sender decides what to make of them
+            if (static_cast<rtcp::pt>(rtcp.pt) == rtcp::pt::rtpfb && rtcp.fb_fmt() == 1) {
+                _handleRTPFB(from, buf + it.offset(), rtcp.byte_len());
+            }
+
+            continue;
+        }
+
+        switch (static_cast<rtcp::pt>(rtcp.pt)) {
+
+            case rtcp::pt::sr: // forwarded together with the rest of the compound packet
+                sr = it.offset() == 0;
+                break;
+
+            case rtcp::pt::rr: // exclusively handled by the switch agent
+                punt = true;
+                break;
+
+            case rtcp::pt::sdes: // forwarded with the SR of a sender
+                break;
+
+            case rtcp::pt::rtpfb: // NACK, transport-cc (stays in the data plane)
+                _handleRTPFB(from, buf + it.offset(), rtcp.byte_len());
+                punt = punt || rtcp.fb_fmt() != 15;
+                feedback = true;
+                break;
 
-    auto* rtcp = reinterpret_cast<const rtcp::hdr*>(buf);
+            case rtcp::pt::psfb: // PLI, FIR, REMB
+                _handlePSFB(from, buf + it.offset(), rtcp.byte_len());
+                punt = true;
+                feedback = true;
+                break;
 
-    Log(Log::DEBUG) << "DataPlaneModel: _handleRTCP: pt="
-                    << rtcp::pt_name(static_cast<rtcp::pt>(rtcp->pt)) << ", ssrc=" << std::dec
-                    << ntohl(rtcp->sender_ssrc) << std::endl;
+            default:
+                LOG(WARN) << "DataPlaneModel: _handleRTCP: unknown RTCP type "
+                          << static_cast<unsigned>(rtcp.pt) << std::endl;
+        }
+    }
+
+    if (sr && !feedback) {
+        _handleSR(from, buf, len);
+    } else if (sr) { // the feedback blocks were forwarded on their own
+
+        // the SR-only copy is never longer than the compound packet
+        std::array<unsigned char, MAX_RTCP_LEN> stackBuf;
+        std::vector<unsigned char> heapBuf;
+        unsigned char* forward = stackBuf.data();
+        std::size_t forwardLen = 0;
+
+        if (len > MAX_RTCP_LEN) {
+            LOG(DEBUG) << "DataPlaneModel: _handleRTCP: oversized compound packet with SR: from="
+                       << from << ", len=" << len << std::endl;
+            heapBuf.resize(len);
+            forward = heapBuf.data();
+        }
 
-    // switch through outermost RTCP packet type
-    switch (static_cast<rtcp::pt>(rtcp->pt)) {
+        for (auto it = packets.begin(); it != packets.end(); ++it) {
 
-        case rtcp::pt::sr: // usually combined with SDES
-            _handleSR(from, buf, len);
-            break;
+            auto pt = static_cast<rtcp::pt>(it->pt);
 
-        case rtcp::pt::rr: // usually combined with PSFB (REMB)
-            _handleRR(from, buf, len);
-            break;
+            if (pt != rtcp::pt::rtpfb && pt != rtcp::pt::psfb) {
+                std::memcpy(forward + forwardLen, buf + it.offset(), it->byte_len());
+                forwardLen += it->byte_len();
+            }
+        }
 
-        case rtcp::pt::rtpfb: // for NACK; usually combined with PSFB (REMB)
-            _handleRTPFB(from, buf, len);
-            break;
+        _handleSR(from, forward, forwardLen);
+    }
 
-        case rtcp::pt::psfb: // for PLI; usually combined with additional PSFB (REMB)
-            _handlePSFB(from, buf, len);
-            break;
+    // with the punt filter, only if a REMB or a fraction lost changed beyond its threshold
+    if (!punt) {
+        return;
+    }
 
-        case rtcp::pt::sdes:
-            Log(Log::WARN) << "DataPlaneModel: _handleRTCP: logic for outermost RTCP SDES "
-                           << "not implemented" << std::endl;
-            break;
+    if (_rtcpPuntFilter
+        && !_rtcpPuntFilter->admit(from, buf, len, RTCPPuntFilter::Clock::now())) {
+        LOG(DEBUG) << "  - unchanged, not punted" << std::endl;
+        _counters.rtcpPuntsSuppressed.add();
+        return;
+    }
 
-        default:
-            Log(Log::WARN) << "DataPlaneModel: _handleRTCP: unknown RTCP type "
-                           << static_cast<unsigned>(rtcp->pt) << std::endl;
+    try {
+        _controlPlanePacketHandler(*this, PktIn{PktIn::Reason::rtcp, from, buf, len});
+    } catch (std::bad_function_call& e) {
+        throw std::logic_error("DataPlaneModel: no control-plane packet handler set");
     }
 }
 
@@ -325,23 +1286,29 @@ void p4sfu::DataPlaneModel::_handleSR(const net::IPv4Port& from, const unsigned
     */
 
     SFUTable::Match match{from, ntohl(rtcp->sender_ssrc)};
+    auto sfu = _sfu.read();
+
+    if (auto* entry = sfu->find(match)) {
 
-    if (_sfu.hasMatch(match)) {
+        auto& actions = entry->actions();
 
-        auto& actions = _sfu[match].actions();
+        entry->counters().pkts.add();
+        entry->counters().bytes.add(len);
 
-        Log(Log::DEBUG) << "DataPlaneModel: _handleRTCP: sr packet match: from=" << from
-                        << ", ssrc=" << ntohl(rtcp->sender_ssrc) << ", actions="
-                        << actions.size() << std::endl;
+        LOG(DEBUG) << "DataPlaneModel: _handleRTCP: sr packet match: from=" << from
+                   << ", ssrc=" << ntohl(rtcp->sender_ssrc) << ", actions="
+                   << actions.size() << std::endl;
 
         for (auto& a: actions) { // send SRs to all receivers
             this->sendPacket(PktOut{a.to(), buf, len});
-            Log(Log::DEBUG) << "  - sent to " << a.to() << std::endl;
+            a.state->pkts.add();
+            a.state->bytes.add(len);
+            LOG(DEBUG) << "  - sent to " << a.to() << std::endl;
         }
 
     } else {
-        Log(Log::WARN) << "DataPlaneModel: _handleRTCP: no match for sr: from=" << from << ", ssrc="
-                       << ntohl(rtcp->sender_ssrc) << std::endl;
+        LOG(WARN) << "DataPlaneModel: _handleRTCP: no match for sr: from=" << from << ", ssrc="
+                  << ntohl(rtcp->sender_ssrc) << std::endl;
     }
 
     /*
@@ -356,107 +1323,309 @@ void p4sfu::DataPlaneModel::_handleSR(const net::IPv4Port& from, const unsigned
     */
 }
 
-void p4sfu::DataPlaneModel::_handleRR(const net::IPv4Port& from, const unsigned char* buf,
-                                      std::size_t len) {
+void p4sfu::DataPlaneModel::_handleRTPFB(const net::IPv4Port& from, const unsigned char* buf,
+                                         std::size_t len) {
 
-    // RRs are passed to the switch agent and exclusively handled there
-    // - a future optimization might inspect bandwidth estimates and only forward to control plane
-    //   if the REMB value changed (at all or beyond threshold)
+    auto* rtcp = (rtcp::hdr*) buf;
 
-    auto* rtcp = reinterpret_cast<const rtcp::hdr*>(buf);
+    LOG(DEBUG) << "DataPlaneModel: _handleRTPFB: from=" << from << ", ssrc="
+               << ntohl(rtcp->sender_ssrc) << std::endl;
 
-    Log(Log::DEBUG) << "DataPlaneModel: _handleRTCP: rr packet match: from=" << from
-                    << ", ssrc=" << ntohl(rtcp->sender_ssrc) << std::endl;
+    if (rtcp->fb_fmt() == 1) { // NACK
 
-    /*
-    std::cout << "RTCP RR" << std::endl;
+        if (rtcp->complete()) {
+            LOG(DEBUG) << "  - NACK: ssrc=" << ntohl(rtcp->data.nack.ssrc)
+                       << ", seq=" << ntohs(rtcp->data.nack.pid)
+                       << ", blp=" << ntohs(rtcp->data.nack.blp) << std::endl;
+        }
 
-    for (auto i = 0; i < rtcp->recep_rep_count(); i++) {
-        std::cout << "  - " << ntohl(rtcp->data.rr[i].ssrc) << ": frac_lost="
-                  << (double) rtcp->data.rr[i].frac_lost() / 255 << ", jitter="
-                  << ntohl(rtcp->data.rr[i].jitter) << std::endl;
-    }
+        // send to media sender:
 
-    if (rtcp->byte_len() < len) {
-        auto* rtcp2 = (rtcp::hdr*) (buf + rtcp->byte_len());
+        auto sfu = _sfu.read();
+
+        if (auto* entry = sfu->find(SFUTable::Match{from, ntohl(rtcp->sender_ssrc)})) {
 
-        if (rtcp2->pt == 206 && rtcp2->fb_fmt() == 15) {
-            std::cout << "RTCP REMB" << std::endl;
+            entry->counters().pkts.add();
+            entry->counters().bytes.add(len);
+
+            LOG(DEBUG) << "DataPlaneModel: _handleRTPFB: packet match: from=" << from
+                       << ", ssrc=" << ntohl(rtcp->sender_ssrc) << ", actions="
+                       << entry->actions().size() <<  std::endl;
+
+            for (auto& action: entry->actions()) {
+
+                // the sender's streams and their caches are in the table of the instance
+                // owning the sender
+                if (!_owns(action.to()) && _foreignFeedback) {
+                    (*_foreignFeedback)(from, action.to(), buf, len);
+                    action.state->pkts.add();
+                    action.state->bytes.add(len);
+                    LOG(DEBUG) << "  - handed to the owner of " << action.to() << std::endl;
+                    continue;
+                }
 
-            for (int i = 0; i < rtcp2->data.remb.num_ssrcs(); i++) {
-                std::cout << "  - " << std::dec << ntohl(rtcp2->data.remb.ssrcs[i])  << ": "
-                          << "bit_rate=" << rtcp2->data.remb.bit_rate() << std::endl;
+                if (auto n = _forwardFeedback(*sfu, from, action.to(), buf, len)) {
+                    action.state->pkts.add();
+                    action.state->bytes.add(n);
+                }
             }
+
+        } else {
+            LOG(WARN) << "DataPlaneModel: _handleRTPFB: no match for NACK: from=" << from
+                      << ", ssrc=" << ntohl(rtcp->sender_ssrc) << std::endl;
         }
-    }
-    */
 
-    /*
-    Log(Log::DEBUG) << "  - rr: rc=" << rtcp->recep_rep_count()
-                    << ", ssrc=" << std::dec << ntohl(rtcp->msg.rr.ssrc)
-                    << ", frac_lost=" << std::dec << ntohl(rtcp->msg.rr.frac_lost())
-                    << ", cum_lost=" << std::dec << ntohl(rtcp->msg.rr.cum_lost())
-                    << ", ext_highest_seq_num=" << std::dec
-                    << ntohl(rtcp->msg.rr.ext_highest_seq_num)
-                    << ", jitter=" << std::dec << ntohl(rtcp->msg.rr.jitter)
-                    << ", lsr=" << std::dec << ntohl(rtcp->msg.rr.lsr)
-                    << ", dlsr=" << std::dec << ntohl(rtcp->msg.rr.dlsr)
-    */
+    } else if (rtcp->fb_fmt() == 15) { // transport-cc feedback on the packets sent to from
 
-    try {
-        _controlPlanePacketHandler(*this, PktIn{PktIn::Reason::rtcp, from, buf, len});
-    } catch (std::bad_function_call& e) {
-        throw std::logic_error("DataPlaneModel: no control-plane packet handler set");
+        if (!_config.delayBasedEstimate) {
+            LOG(DEBUG) << "  - transport-cc feedback ignored" << std::endl;
+            return;
+        }
+
+        auto it = _estimators.find(from);
+
+        if (it == _estimators.end()) {
+            LOG(DEBUG) << "  - transport-cc feedback from unknown receiver" << std::endl;
+        } else if (!it->second->onFeedback(buf, len, DelayBasedEstimator::Clock::now())) {
+            LOG(WARN) << "DataPlaneModel: _handleRTPFB: malformed transport-cc feedback: from="
+                      << from << std::endl;
+        } else {
+            LOG(DEBUG) << "  - transport-cc feedback: estimate=" << it->second->estimate()
+                       << std::endl;
+        }
+
+    } else {
+        LOG(WARN) << "DataPlaneModel: _handleRTPFB: logic to handle RTPFB other than NACK "
+                  << "and transport-cc not implemented" << std::endl;
     }
 }
 
-void p4sfu::DataPlaneModel::_handleRTPFB(const net::IPv4Port& from, const unsigned char* buf,
-                                         std::size_t len) {
+std::size_t p4sfu::DataPlaneModel::_forwardFeedback(const SFUTable& sfu,
+                                                    const net::IPv4Port& from,
+                                                    const net::IPv4Port& sender,
+                                                    const unsigned char* buf, std::size_t len) {
 
-    auto* rtcp = (rtcp::hdr*) buf;
+    auto* rtcp = (const rtcp::hdr*) buf;
+    const unsigned char* upstream = buf;
+    std::size_t upstreamLen = len;
+    std::array<unsigned char, RetransmissionCache::MAX_PACKET_LEN> nack;
 
-    Log(Log::DEBUG) << "DataPlaneModel: _handleRTPFB: from=" << from << ", ssrc="
-                    << ntohl(rtcp->sender_ssrc) << std::endl;
+    if (static_cast<rtcp::pt>(rtcp->pt) == rtcp::pt::psfb) { // PLI, FIR
 
-    if (rtcp->fb_fmt() == 1) { // NACK
+        auto mediaSsrc = ntohl(rtcp->fb_fmt() == 1 ? rtcp->data.pli.ssrc : rtcp->data.fir.ssrc);
 
-        Log(Log::DEBUG) << "  - NACK: ssrc=" << ntohl(rtcp->data.nack.ssrc)
-                        << ", seq=" << ntohs(rtcp->data.nack.pid)
-                        << ", blp=" << ntohs(rtcp->data.nack.blp) << std::endl;
+        // coalesce the keyframe requests of all receivers of the sender's stream
+        auto* media = sfu.find(SFUTable::Match{sender, mediaSsrc});
 
-        // send to media sender:
+        if (media && !_admitPLI(*media, std::chrono::steady_clock::now())) {
+            LOG(DEBUG) << "  - suppressed keyframe request to " << sender << std::endl;
+            return 0;
+        }
 
-        if (_sfu.hasMatch(SFUTable::Match{from, ntohl(rtcp->sender_ssrc)})) {
+    } else if (_config.nackCache && rtcp->complete() && len <= nack.size()) { // NACK
 
-            auto& entry = _sfu[SFUTable::Match{from, ntohl(rtcp->sender_ssrc)}];
+        // incomplete NACKs (without an FCI) and those too large to be rewritten are forwarded
+        // unchanged
+        auto* media = sfu.find(SFUTable::Match{sender, ntohl(rtcp->data.nack.ssrc)});
 
-            Log(Log::DEBUG) << "DataPlaneModel: _handleRTPFB: packet match: from=" << from
-                            << ", ssrc=" << ntohl(rtcp->sender_ssrc) << ", actions="
-                            << entry.actions().size() <<  std::endl;
+        if (!media) { // the stream is another sender's
+            return 0;
+        }
+
+        // answer what the retransmission cache holds, only the rest goes to the sender
+        upstreamLen = _serveNACK(*media, from, buf, len, nack.data());
+        upstream = nack.data();
+
+        if (upstreamLen == 0) {
+            LOG(DEBUG) << "  - all packets retransmitted from cache" << std::endl;
+            return 0;
+        }
+    }
+
+    this->sendPacket(PktOut{sender, upstream, upstreamLen});
+    LOG(DEBUG) << "  - sent to " << sender << std::endl;
+    return upstreamLen;
+}
+
+std::size_t p4sfu::DataPlaneModel::_serveNACK(const SFUTable::Entry& media,
+                                              const net::IPv4Port& from,
+                                              const unsigned char* buf, std::size_t len,
+                                              unsigned char* out) {
 
-            for (auto& action: entry.actions()) {
-                this->sendPacket(PktOut{action.to(), buf, len});
-                Log(Log::DEBUG) << "  - action:" << std::endl;
-                Log(Log::DEBUG) << "    - sent to " << action.to() << std::endl;
+    // common header and media SSRC are followed by FCIs of 4 bytes: PID and BLP
+    const std::size_t fciOffset = 12;
+
+    auto* rtcp = (const rtcp::hdr*) buf;
+    auto end = std::min<std::size_t>(len, rtcp->byte_len());
+    auto now = RetransmissionCache::Clock::now();
+
+    std::memcpy(out, buf, fciOffset);
+    auto outLen = fciOffset;
+
+    for (auto off = fciOffset; off + 4 <= end; off += 4) {
+
+        std::uint16_t pid, blp;
+        std::memcpy(&pid, buf + off, 2);
+        std::memcpy(&blp, buf + off + 2, 2);
+        pid = ntohs(pid);
+
+        // bit i: packet pid + i is lost
+        std::uint32_t lost = 1u | ((std::uint32_t) ntohs(blp) << 1);
+
+        for (unsigned i = 0; i < 17; i++) {
+            if ((lost >> i) & 1u
+                && _retransmit(media, from, (std::uint16_t) (pid + i), now)) {
+                lost &= ~(1u << i);
             }
+        }
 
-        } else {
-            Log(Log::WARN) << "DataPlaneModel: _handleRTPFB: no match for NACK: from=" << from
-                           << ", ssrc=" << ntohl(rtcp->sender_ssrc) << std::endl;
+        if (lost) { // re-encode the remaining packets relative to the first of them
+            auto first = (unsigned) std::countr_zero(lost);
+            pid = htons((std::uint16_t) (pid + first));
+            blp = htons((std::uint16_t) (lost >> (first + 1)));
+            std::memcpy(out + outLen, &pid, 2);
+            std::memcpy(out + outLen + 2, &blp, 2);
+            outLen += 4;
         }
+    }
 
-        // send copy to switch agent:
+    if (outLen == fciOffset) {
+        return 0;
+    }
 
-        try {
-            _controlPlanePacketHandler(*this, PktIn{PktIn::Reason::rtcp, from, buf, len});
-        } catch (std::bad_function_call& e) {
-            throw std::logic_error("DataPlaneModel: no control-plane packet handler set");
+    ((rtcp::hdr*) out)->len = htons((std::uint16_t) (outLen / 4 - 1));
+    return outLen;
+}
+
+bool p4sfu::DataPlaneModel::_retransmit(const SFUTable::Entry& media, const net::IPv4Port& to,
+                                        std::uint16_t seq,
+                                        RetransmissionCache::Clock::time_point now) {
+
+    auto* cache = media.retransmissionCache();
+    auto& actions = media.actions();
+    auto a = std::find_if(actions.begin(), actions.end(), [&to](const auto& a) {
+        return a.to() == to;
+    });
+
+    if (!cache || a == actions.end()) {
+        return false;
+    }
+
+    auto& st = *a->state;
+    std::optional<std::uint16_t> origSeq = seq;
+
+    // rewritten sequence numbers: map back through the history of the receiver's node, as
+    // far as the receiver got them from that node
+    if (st.node) {
+        origSeq = std::nullopt;
+
+        if ((std::uint16_t) (seq - st.nodeSeq) <= (std::uint16_t) (st.lastSeq - st.nodeSeq)) {
+            for (auto& n: media.nodes()) {
+                if (n.state->id == st.node) {
+                    origSeq = n.state->sent.original((std::uint16_t) (seq - st.seqOffset));
+                }
+            }
         }
+    }
 
-    } else {
-        Log(Log::WARN) << "DataPlaneModel: _handleRTPFB: logic to handle RTPFB other than NACK "
-                       << "not implemented" << std::endl;
+    auto pkt = origSeq ? cache->find(*origSeq, now) : std::nullopt;
+
+    if (!pkt) {
+        cache->misses.add();
+        return false;
+    }
+
+    // resent on the media SSRC with the sequence number the receiver knows it by
+    alignas(rtp::hdr) std::array<unsigned char, MAX_EGRESS_HDR_LEN> hdrBuf;
+    unsigned char* stamp = nullptr;
+    auto hdrLen = _copyHeader(pkt->buf, _transportSeq((const rtp::hdr*) pkt->buf),
+                              hdrBuf.data(), stamp);
+    reinterpret_cast<rtp::hdr*>(hdrBuf.data())->seq = htons(seq);
+
+    if (stamp) {
+        _stamp(to, stamp, pkt->len);
+    }
+
+    _sendRTP(to, (const char*) hdrBuf.data(), hdrLen, (const char*) pkt->buf + hdrLen,
+             pkt->len - hdrLen);
+
+    cache->hits.add();
+    st.retransmitted.add();
+
+    LOG(DEBUG) << "  - retransmitted seq " << seq << " to " << to << std::endl;
+    return true;
+}
+
+bool p4sfu::DataPlaneModel::_av1StructureChanged(const SFUTable::Match& match,
+                                                  const av1::DependencyDescriptor& dd) {
+
+    AV1StructureKey key{dd.structure()->template_id_offset, dd.structureHash()};
+    auto [it, inserted] = _av1Structures[match.ipPort()].try_emplace(match.ssrc(), key);
+
+    if (inserted) {
+        return true;
+    }
+
+    if (it->second == key) {
+        return false;
+    }
+
+    it->second = key;
+    return true;
+}
+
+bool p4sfu::DataPlaneModel::_admitPLI(const SFUTable::Entry& entry,
+                                      std::chrono::steady_clock::time_point now) {
+
+    auto* kr = entry.keyframeRequests();
+
+    if (!kr || !_config.pliWindow) {
+        return true;
+    }
+
+    auto t = now.time_since_epoch().count();
+    auto requested = kr->requested.load(std::memory_order_relaxed);
+    auto window = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        *_config.pliWindow).count();
+
+    if (requested != 0 && t - requested < window) {
+        kr->suppressed.add();
+        return false;
+    }
+
+    kr->requested.store(t, std::memory_order_relaxed);
+    kr->forwarded.add();
+    return true;
+}
+
+void p4sfu::DataPlaneModel::_requestKeyframe(const SFUTable::Entry& entry,
+                                             const net::IPv4Port& from, SSRC ssrc) {
+
+    // without coalescing, the chains of further nodes break on the same loss, a keyframe is
+    // still requested once until it arrives
+    auto* kr = entry.keyframeRequests();
+    bool requested = _config.pliWindow
+        ? !_admitPLI(entry, std::chrono::steady_clock::now())
+        : kr && kr->chainBroken.exchange(true, std::memory_order_relaxed);
+
+    if (requested) {
+        LOG(DEBUG) << "DataPlaneModel: _requestKeyframe: keyframe already requested: from="
+                   << from << ", ssrc=" << ssrc << std::endl;
+        return;
     }
+
+    const std::uint32_t pli[3] = {
+        // version 2, FMT 1, PSFB, length in 32-bit words minus one
+        htonl((0x80u | 1) << 24 | static_cast<std::uint32_t>(rtcp::pt::psfb) << 16 | 2),
+        // the data plane has no SSRC of its own, like the default of transport-cc feedback
+        htonl(1),
+        htonl(ssrc)
+    };
+
+    this->sendPacket(PktOut{from, (const unsigned char*) pli, sizeof(pli)});
+
+    LOG(INFO) << "DataPlaneModel: _requestKeyframe: chain broken, sent PLI to " << from
+              << ", ssrc=" << ssrc << std::endl;
 }
 
 void  p4sfu::DataPlaneModel::_handlePSFB(const net::IPv4Port& from, const unsigned char* buf,
@@ -464,43 +1633,62 @@ void  p4sfu::DataPlaneModel::_handlePSFB(const net::IPv4Port& from, const unsign
 
     auto* rtcp = (rtcp::hdr*) buf;
 
-    Log(Log::DEBUG) << "DataPlaneModel: _handlePSFB: from=" << from << ", ssrc="
-                    << ntohl(rtcp->sender_ssrc) << std::endl;
+    LOG(DEBUG) << "DataPlaneModel: _handlePSFB: from=" << from << ", ssrc="
+               << ntohl(rtcp->sender_ssrc) << std::endl;
+
+    if (rtcp->is_remb()) { // the receiver's estimate sets its pacing rate
+
+        LOG(DEBUG) << "  - REMB: bit_rate=" << rtcp->data.remb.bit_rate() << std::endl;
+
+        if (_pacer) {
+            _pacer->setBandwidthEstimate(from, rtcp->data.remb.bit_rate());
+        }
+
+    } else if (rtcp->fb_fmt() == 1 || rtcp->fb_fmt() == 4) { // PLI, FIR
 
-    if (rtcp->fb_fmt() == 1) { // PLI
-        Log(Log::DEBUG) << "  - PLI: ssrc=" << ntohl(rtcp->data.pli.ssrc) << std::endl;
+        auto mediaSsrc = ntohl(rtcp->fb_fmt() == 1 ? rtcp->data.pli.ssrc : rtcp->data.fir.ssrc);
+
+        LOG(DEBUG) << "  - " << (rtcp->fb_fmt() == 1 ? "PLI" : "FIR") << ": ssrc=" << mediaSsrc
+                   << std::endl;
 
         // send to media sender:
 
-        if (_sfu.hasMatch(SFUTable::Match{from, ntohl(rtcp->sender_ssrc)})) {
+        auto sfu = _sfu.read();
 
-            auto& entry = _sfu[SFUTable::Match{from, ntohl(rtcp->sender_ssrc)}];
+        if (auto* entry = sfu->find(SFUTable::Match{from, ntohl(rtcp->sender_ssrc)})) {
 
-            Log(Log::DEBUG) << "DataPlaneModel: _handlePSFB: packet match: from=" << from
-                            << ", ssrc=" << ntohl(rtcp->sender_ssrc) << ", actions="
-                            << entry.actions().size() <<  std::endl;
+            entry->counters().pkts.add();
+            entry->counters().bytes.add(len);
 
-            for (auto& action: entry.actions()) {
-                this->sendPacket(PktOut{action.to(), buf, len});
-                Log(Log::DEBUG) << "  - action:" << std::endl;
-                Log(Log::DEBUG) << "    - sent to " << action.to() << std::endl;
-            }
+            LOG(DEBUG) << "DataPlaneModel: _handlePSFB: packet match: from=" << from
+                       << ", ssrc=" << ntohl(rtcp->sender_ssrc) << ", actions="
+                       << entry->actions().size() <<  std::endl;
 
-        } else {
-            Log(Log::WARN) << "DataPlaneModel: _handlePSFB: no match for PLI: from=" << from
-                           << ", ssrc=" << ntohl(rtcp->sender_ssrc) << std::endl;
-        }
+            for (auto& action: entry->actions()) {
 
-        // send copy to switch agent:
+                // the sender's streams and their keyframe requests are in the table of the
+                // instance owning the sender
+                if (!_owns(action.to()) && _foreignFeedback) {
+                    (*_foreignFeedback)(from, action.to(), buf, len);
+                    action.state->pkts.add();
+                    action.state->bytes.add(len);
+                    LOG(DEBUG) << "  - handed to the owner of " << action.to() << std::endl;
+                    continue;
+                }
 
-        try {
-            _controlPlanePacketHandler(*this, PktIn{PktIn::Reason::rtcp, from, buf, len});
-        } catch (std::bad_function_call& e) {
-            throw std::logic_error("DataPlaneModel: no control-plane packet handler set");
+                if (auto n = _forwardFeedback(*sfu, from, action.to(), buf, len)) {
+                    action.state->pkts.add();
+                    action.state->bytes.add(n);
+                }
+            }
+
+        } else {
+            LOG(WARN) << "DataPlaneModel: _handlePSFB: no match for keyframe request: from="
+                      << from << ", ssrc=" << ntohl(rtcp->sender_ssrc) << std::endl;
         }
 
     } else {
-        Log(Log::WARN) << "DataPlaneModel: _handlePSFB: logic to handle PSFB other than PLI "
-                       << "not implemented" << std::endl;
+        LOG(WARN) << "DataPlaneModel: _handlePSFB: logic to handle PSFB other than PLI, FIR "
+                  << "and REMB not implemented" << std::endl;
     }
 }
@@ -2,10 +2,19 @@
 #define P4SFU_DATA_PLANE_MODEL_H
 
 #include <boost/asio.hpp>
+#include <mutex>
 #include <random>
+#include <unordered_map>
 #include "data_plane.h"
+#include "delay_based_estimator.h"
+#include "egress_pacer.h"
+#include "net/batch_udp_server.h"
 #include "net/udp_server.h"
+#include "net/uring_udp_server.h"
+#include "rcu.h"
+#include "rtcp_punt_filter.h"
 #include "sfu_table.h"
+#include "transport_feedback.h"
 #include "av1.h"
 #include "proto/rtp.h"
 
@@ -22,6 +31,38 @@ namespace p4sfu {
             //! UDP port the SFU data plane uses for RTP traffic
             unsigned short port;
             double rtpDropRate = 0;
+            //! number of datagrams drained/sent per syscall (recvmmsg/sendmmsg), 0 disables batching
+            unsigned ioBatchSize = 0;
+            //! use the io_uring backend (UringUDPServer) instead of asio sockets
+            bool ioUring = false;
+            //! enable UDP GRO/GSO in the batched backend (requires ioBatchSize > 1)
+            bool udpOffload = false;
+            //! paces forwarded RTP per receiver at a multiple of its REMB, disabled if unset
+            //! - pacing.txTime requires the batched backend, without it packets are held in the
+            //!   data plane
+            std::optional<EgressPacer::Config> pacing = std::nullopt;
+            //! caches forwarded RTP per send stream and answers NACKs locally, disabled if unset
+            std::optional<RetransmissionCache::Config> nackCache = std::nullopt;
+            //! forwards one PLI per send stream and suppresses further ones until the next
+            //! keyframe, or for at most this long, disabled if unset
+            std::optional<std::chrono::milliseconds> pliWindow = std::nullopt;
+            //! punts receiver reports to the switch agent only on meaningful changes, disabled
+            //! if unset (all are punted)
+            std::optional<RTCPPuntFilter::Config> rtcpPuntFilter = std::nullopt;
+            //! records the transport-wide sequence numbers of senders and sends them
+            //! transport-cc feedback, disabled if unset
+            //! - with an io_context, feedback is also sent to senders that went quiet
+            std::optional<TransportFeedback::Config> transportFeedback = std::nullopt;
+            //! stamps the packets to each receiver with its own transport-wide sequence numbers
+            //! and estimates its bandwidth from its transport-cc feedback, disabled if unset
+            //! - requires transportFeedback for the extension identifier
+            std::optional<DelayBasedEstimator::Config> delayBasedEstimate = std::nullopt;
+            //! drops the AV1 frames the receivers of a decode target can't decode since the
+            //! chain protecting it is broken, until the next keyframe or switch point
+            bool dropUndecodable = false;
+            //! with dropUndecodable, requests a keyframe from the sender when a chain breaks,
+            //! once until the next keyframe, with pliWindow also once per window
+            bool undecodablePLI = false;
         };
 
         struct RTPPktModifications {
@@ -30,40 +71,246 @@ namespace p4sfu {
         };
 
         explicit DataPlaneModel(UDPInterface* udp);
+        //! @param io drives the pacer's release timer, required if pacing is configured without
+        //!           txTime
+        explicit DataPlaneModel(UDPInterface* udp, const Config& c,
+                                boost::asio::io_context* io = nullptr);
+        ~DataPlaneModel() override;
         explicit DataPlaneModel(boost::asio::io_context* io, DataPlane::Config* c);
 
         // from abstract DataPlane:
         void sendPacket(const PktOut& pkt) override;
+        //! addStream(), removeStream() and adjustDecodeTarget() publish a new SFU table version
+        //! and may be called from another thread than the one processing packets
         void addStream(const Stream& s) override;
         void removeStream(const Stream& s) override;
         void adjustDecodeTarget(const net::IPv4Port& from, const net::IPv4Port& to, SSRC ssrc,
                                 unsigned target) override;
+        //! copies the total counters into the statistics returned by reference
+        [[nodiscard]] const TotalPacketStatistics& totalStatistics() const override;
+        //! reads the counters of the current SFU table version, may be called from any thread
+        [[nodiscard]] std::vector<StreamStatistics> streamStatistics() const override;
+
+        //! copies the total counters, may be called from any thread
+        [[nodiscard]] TotalPacketStatistics totalCounters() const;
+
+        //! restricts the matches this instance installs to those keyed by addresses for which f
+        //! returns true (used when the SFU table is partitioned across several instances)
+        void setOwnership(std::function<bool (const net::IPv4Port&)>&& f);
+
+        //! receiver feedback about the streams of a sender, see onForeignFeedback()
+        using Feedback = std::function<void (const net::IPv4Port& from,
+                                             const net::IPv4Port& sender,
+                                             const unsigned char* buf, std::size_t len)>;
+
+        //! hands the NACKs and keyframe requests of receivers for senders this instance doesn't
+        //! own to f, which passes them to forwardFeedback() of the owner holding the senders'
+        //! streams
+        void onForeignFeedback(Feedback&& f);
+
+        //! forwards a NACK or keyframe request of receiver from to sender, answers the NACK from
+        //! the retransmission cache of the sender's stream and coalesces the keyframe request
+        //! with those of the stream's other receivers, called from the thread processing packets
+        void forwardFeedback(const net::IPv4Port& from, const net::IPv4Port& sender,
+                             const unsigned char* buf, std::size_t len);
+
+        //! removes all matches keyed by addr and all actions forwarding to addr, i.e., every
+        //! stream a participant sends or receives on that address
+        void removeParticipant(const net::IPv4Port& addr);
+
+        //! pins the current SFU table version
+        [[nodiscard]] RCU<SFUTable>::ReadGuard sfuTable() const;
 
     private:
 
-        //! adds a match in the sfu table, if it doesn't already exist
-        void _addMatch(const SFUTable::Match& m) noexcept;
+        //! creates the UDP backend selected by the configuration
+        static UDPInterface* _makeUDPInterface(asio::io_context& io, const Config& c);
+
+        //! creates the egress pacer if pacing is configured
+        void _setUpPacing();
+
+        //! sends forwarded RTP gathered from hdr and payload, through the pacer if enabled
+        void _sendRTP(const net::IPv4Port& to, const char* hdr, std::size_t hdrLen,
+                      const char* payload, std::size_t payloadLen);
+
+        //! arms the timer releasing paced packets while packets are waiting
+        void _armPacingTimer();
+
+        //! checks the transport-cc configuration
+        void _setUpTransportFeedback();
+
+        //! maximum length of the header copy of a forwarded packet
+        static constexpr std::size_t MAX_EGRESS_HDR_LEN = 256;
+
+        //! maximum length of a compound RTCP packet forwarded without its feedback from a stack
+        //! buffer, as long as the receive buffers of the UDP backends, longer ones are copied to
+        //! the heap
+        static constexpr std::size_t MAX_RTCP_LEN = 2048;
+
+        //! returns the transport-wide sequence number extension of a packet, nullptr if it has
+        //! none or transport-cc feedback is disabled
+        [[nodiscard]] const unsigned char* _transportSeq(const rtp::hdr* rtp) const;
+
+        //! records the arrival of transport-wide sequence number seq from a sender and sends it
+        //! feedback (about its stream ssrc) when due
+        void _recordArrival(const net::IPv4Port& from, SSRC ssrc, std::uint16_t seq);
+
+        struct SenderFeedback {
+            TransportFeedback feedback;
+            //! media SSRC of the latest packet, the feedback is sent about
+            SSRC ssrc = 0;
+        };
+
+        //! sends a sender all feedback recorded so far
+        void _sendFeedback(const net::IPv4Port& to, SenderFeedback& f,
+                           TransportFeedback::Clock::time_point now);
+
+        //! arms the timer sending the feedback that is due to senders that went quiet
+        void _armFeedbackTimer();
+
+        //! copies the header each receiver of packet buf gets its own copy of to hdr, returns
+        //! its length
+        //! - with delay-based estimates, the copy extends to the transport-wide sequence number
+        //!   twcc, stamp is set to its copy, otherwise to nullptr
+        std::size_t _copyHeader(const unsigned char* buf, const unsigned char* twcc,
+                                unsigned char* hdr, unsigned char*& stamp) const;
 
-        //! adds an action associated with an entry in the sfu table if it doesn't already exist
-        void _addAction(const SFUTable::Match& match, SFUTable::Entry& e,
+        //! writes the next transport-wide sequence number of receiver to to stamp, for a packet
+        //! of len bytes
+        void _stamp(const net::IPv4Port& to, unsigned char* stamp, std::size_t len);
+
+        //! returns the delay-based estimator of a receiver, creates it on first use
+        DelayBasedEstimator& _estimator(const net::IPv4Port& to);
+
+        //! forwards feedback of receiver from to sender, whose streams are in sfu, returns the
+        //! number of bytes sent, 0 if nothing was left to forward
+        std::size_t _forwardFeedback(const SFUTable& sfu, const net::IPv4Port& from,
+                                     const net::IPv4Port& sender, const unsigned char* buf,
+                                     std::size_t len);
+
+        //! answers the NACK of receiver from with packets cached for the stream of media and
+        //! writes the NACK of the remaining packets to out (len bytes), returns its length, 0 if
+        //! all were served
+        std::size_t _serveNACK(const SFUTable::Entry& media, const net::IPv4Port& from,
+                               const unsigned char* buf, std::size_t len, unsigned char* out);
+
+        //! resends packet seq (in the receiver's numbering) of the stream of media from its
+        //! cache, returns false if it isn't cached
+        bool _retransmit(const SFUTable::Entry& media, const net::IPv4Port& to,
+                         std::uint16_t seq, RetransmissionCache::Clock::time_point now);
+
+        //! returns true if a PLI for the stream of entry is to be forwarded, false if a
+        //! keyframe was requested within the PLI window and not received yet
+        bool _admitPLI(const SFUTable::Entry& entry, std::chrono::steady_clock::time_point now);
+
+        //! sends a PLI for stream ssrc to the sender from, unless one is outstanding
+        void _requestKeyframe(const SFUTable::Entry& entry, const net::IPv4Port& from,
+                              SSRC ssrc);
+
+        //! returns true if the template dependency structure dd carries isn't the one the
+        //! stream of match sent last, and remembers it
+        bool _av1StructureChanged(const SFUTable::Match& match,
+                                  const av1::DependencyDescriptor& dd);
+
+        [[nodiscard]] bool _owns(const net::IPv4Port& addr) const;
+
+        using MatchIndex = std::unordered_map<net::IPv4Port, std::vector<SFUTable::Match>>;
+
+        //! adds a match in the sfu table, if it doesn't already exist, and references it
+        void _addMatch(SFUTable& t, const SFUTable::Match& m) noexcept;
+
+        //! adds an action associated with an entry in the sfu table if it doesn't already exist,
+        //! and references it
+        void _addAction(SFUTable& t, const SFUTable::Match& match,
                         const SFUTable::Action& a) noexcept;
 
+        //! drops a reference to the action forwarding to addr, removes it with the last one
+        void _removeAction(SFUTable& t, const SFUTable::Match& match,
+                           const net::IPv4Port& to) noexcept;
+
+        //! drops a reference to a match, removes it with the last one
+        void _releaseMatch(SFUTable& t, const SFUTable::Match& m) noexcept;
+
+        //! references a match on behalf of a peer without an action forwarding to it
+        void _addPeerMatch(SFUTable& t, const SFUTable::Match& m,
+                           const net::IPv4Port& peer) noexcept;
+
+        //! drops a reference taken by _addPeerMatch()
+        void _releasePeerMatch(SFUTable& t, const SFUTable::Match& m,
+                               const net::IPv4Port& peer) noexcept;
+
+        //! removes a match and its actions regardless of references
+        void _eraseMatch(SFUTable& t, const SFUTable::Match& m) noexcept;
+
+        static void _unindex(MatchIndex& index, const net::IPv4Port& addr,
+                             const SFUTable::Match& m);
+
         void _onPacket(UDPInterface& c, asio::ip::udp::endpoint& from, const unsigned char* buf,
                        std::size_t len);
 
+        //! handles all datagrams drained in a single wakeup and flushes the resulting packets
+        void _onPacketBatch(UDPInterface& c, UDPInterface::Datagram* datagrams, std::size_t n);
+
         void _handleSTUN(const net::IPv4Port& from, const unsigned char* buf, std::size_t len);
         void _handleRTP(const net::IPv4Port& from, const unsigned char* buf, std::size_t len);
+        //! dispatches each packet of a compound RTCP packet
         void _handleRTCP(const net::IPv4Port& fromm, const unsigned char* buf, std::size_t len);
+        //! forwards a sender's compound packet, starting with its SR, to the stream's receivers
         void _handleSR(const net::IPv4Port& from, const unsigned char* buf, std::size_t len);
-        void _handleRR(const net::IPv4Port& from, const unsigned char* buf, std::size_t len);
+        //! handle a single packet of a compound packet
         void _handleRTPFB(const net::IPv4Port& from, const unsigned char* buf, std::size_t len);
         void _handlePSFB(const net::IPv4Port& from, const unsigned char* buf, std::size_t len);
 
         UDPInterface* _udp = nullptr;
-        SFUTable _sfu;
+        //! written by the packet-processing thread, read by totalCounters() from any thread
+        TotalPacketCounters _counters;
+        mutable TotalPacketStatistics _totalSnapshot;
+        //! packet handlers read immutable table versions, control calls publish modified copies
+        RCU<SFUTable> _sfu;
+        //! writer-side bookkeeping, only accessed within _sfu.update():
+        //! - number of addStream() calls that installed a match
+        std::unordered_map<SFUTable::Match, unsigned, SFUTable::Match::Hash,
+                           SFUTable::Match::Equal> _matchRefs;
+        //! - number of addStream() calls that installed an action, per match and receiver
+        std::unordered_map<SFUTable::Match, std::unordered_map<net::IPv4Port, unsigned>,
+                           SFUTable::Match::Hash, SFUTable::Match::Equal> _actionRefs;
+        //! - match references held for a peer without an action, per match and peer
+        std::unordered_map<SFUTable::Match, std::unordered_map<net::IPv4Port, unsigned>,
+                           SFUTable::Match::Hash, SFUTable::Match::Equal> _peerMatchRefs;
+        //! - reverse indexes: matches keyed by an address, matches with an action to an address
+        MatchIndex _matchesFrom;
+        MatchIndex _matchesTo;
         DataPlaneModel::Config _config;
         std::mt19937 _rand = std::mt19937(std::random_device()());
         std::binomial_distribution<> _rtpDropDist;
+        std::optional<std::function<bool (const net::IPv4Port&)>> _ownership = std::nullopt;
+        std::optional<Feedback> _foreignFeedback = std::nullopt;
+        std::unique_ptr<EgressPacer> _pacer;
+        std::unique_ptr<asio::steady_timer> _pacingTimer;
+        //! belongs to the packet-processing thread like the pacer
+        std::unique_ptr<RTCPPuntFilter> _rtcpPuntFilter;
+        //! transport-cc feedback to each sender, belongs to the packet-processing thread
+        std::unordered_map<net::IPv4Port, SenderFeedback> _transportFeedback;
+        std::unique_ptr<asio::steady_timer> _feedbackTimer;
+        bool _feedbackTimerArmed = false;
+        //! delay-based estimates of each receiver, belong to the packet-processing thread
+        std::unordered_map<net::IPv4Port, std::unique_ptr<DelayBasedEstimator>> _estimators;
+        //! identifies a template dependency structure without keeping it
+        struct AV1StructureKey {
+            unsigned templateIdOffset = 0;
+            std::uint64_t hash        = 0;
+            bool operator==(const AV1StructureKey&) const = default;
+        };
+        //! latest structure per sender and SSRC, descriptors are only punted to the switch agent
+        //! when it changes, belongs to the packet-processing thread
+        std::unordered_map<net::IPv4Port, std::unordered_map<SSRC, AV1StructureKey>>
+            _av1Structures;
+        //! guards insertions and removals in _estimators against streamStatistics()
+        mutable std::mutex _estimatorsMutex;
+        bool _pacingTimerArmed = false;
+        //! expires with the model, handlers posted to or waiting on _io check it before touching
+        //! the model since cancel() doesn't withdraw completions that are already queued
+        std::shared_ptr<bool> _alive = std::make_shared<bool>(true);
     };
 }
 
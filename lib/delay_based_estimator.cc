@@ -0,0 +1,243 @@
+
+#include "delay_based_estimator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+#include "transport_feedback.h"
+
+namespace {
+
+    //! the trendline slope is scaled by the number of groups (up to a limit) and a gain
+    const std::size_t TRENDLINE_MAX_GROUPS = 60;
+    const double TRENDLINE_GAIN = 4.0;
+
+    //! the acknowledged rate is measured over arrival intervals of this length
+    const auto ACK_INTERVAL = std::chrono::milliseconds(250);
+
+    //! delay variations beyond this (e.g., a wrapped reference time) restart the trendline
+    const auto MAX_DELAY_VARIATION = std::chrono::seconds(1);
+
+    double ms(std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+}
+
+p4sfu::DelayBasedEstimator::DelayBasedEstimator(const Config& c, Clock::time_point now)
+    : _config(c),
+      _rate((double) c.initialRate),
+      _updated(now),
+      _estimate(c.initialRate) {
+
+    if (_config.history == 0 || _config.history > 65536) {
+        throw std::invalid_argument("DelayBasedEstimator: history must be in [1, 65536]");
+    }
+
+    if (_config.window < 2) {
+        throw std::invalid_argument("DelayBasedEstimator: window must be >= 2");
+    }
+
+    if (_config.minRate > _config.maxRate) {
+        throw std::invalid_argument("DelayBasedEstimator: minRate must be <= maxRate");
+    }
+
+    auto capacity = std::bit_ceil(_config.history);
+    _mask = capacity - 1;
+    _history.resize(capacity);
+}
+
+std::uint16_t p4sfu::DelayBasedEstimator::onSent(std::size_t len, Clock::time_point now) {
+
+    auto seq = _nextSeq++;
+    _history[seq & _mask] = Sent{now, len, seq, true};
+    return seq;
+}
+
+bool p4sfu::DelayBasedEstimator::onFeedback(const unsigned char* buf, std::size_t len,
+                                            Clock::time_point now) {
+
+    bool acknowledged = false;
+
+    bool valid = TransportFeedback::parse(buf, len, [this, &acknowledged](std::uint16_t seq,
+        std::optional<Clock::duration> arrival) {
+        auto& p = _history[seq & _mask];
+
+        if (!arrival || !p.valid || p.seq != seq) { // lost, or sent too long ago
+            return;
+        }
+
+        p.valid = false; // count repeated reports once
+        acknowledged = true;
+
+        _onAcknowledged(p.len, *arrival);
+        _onPacket(p, *arrival);
+    });
+
+    if (!valid) {
+        return false;
+    }
+
+    if (acknowledged) {
+        _update(now);
+    }
+
+    return true;
+}
+
+unsigned long p4sfu::DelayBasedEstimator::estimate() const {
+
+    return _estimate.load(std::memory_order_relaxed);
+}
+
+p4sfu::DelayBasedEstimator::Usage p4sfu::DelayBasedEstimator::usage() const {
+
+    return _usage;
+}
+
+unsigned long p4sfu::DelayBasedEstimator::acknowledgedRate() const {
+
+    return (unsigned long) _ackedRate;
+}
+
+void p4sfu::DelayBasedEstimator::_onPacket(const Sent& p, Clock::duration arrival) {
+
+    if (!_group) {
+        _group = Group{p.time, p.time, arrival};
+        return;
+    }
+
+    if (p.time < _group->firstSent) { // reordered, belongs to a closed group
+        return;
+    }
+
+    if (p.time - _group->firstSent <= _config.burst) {
+        _group->lastSent = std::max(_group->lastSent, p.time);
+        _group->lastArrival = std::max(_group->lastArrival, arrival);
+        return;
+    }
+
+    if (_prevGroup) {
+        _onGroup(*_prevGroup, *_group);
+    }
+
+    _prevGroup = _group;
+    _group = Group{p.time, p.time, arrival};
+}
+
+void p4sfu::DelayBasedEstimator::_onGroup(const Group& prev, const Group& g) {
+
+    auto variation = (g.lastArrival - prev.lastArrival) - (g.lastSent - prev.lastSent);
+
+    if (variation > MAX_DELAY_VARIATION || variation < -MAX_DELAY_VARIATION) {
+        _samples.clear();
+        _accumulated = 0;
+        _smoothed = 0;
+        _firstArrival = std::nullopt;
+        return;
+    }
+
+    _accumulated += ms(variation);
+    _smoothed = _config.smoothing * _smoothed + (1 - _config.smoothing) * _accumulated;
+
+    if (!_firstArrival) {
+        _firstArrival = g.lastArrival;
+    }
+
+    _samples.emplace_back(ms(g.lastArrival - *_firstArrival), _smoothed);
+    _groups++;
+
+    if (_samples.size() > _config.window) {
+        _samples.pop_front();
+    }
+
+    if (_samples.size() < _config.window) {
+        return;
+    }
+
+    // least-squares slope of the smoothed delay over the arrival time
+    double meanX = 0, meanY = 0;
+
+    for (const auto& [x, y]: _samples) {
+        meanX += x;
+        meanY += y;
+    }
+
+    meanX /= (double) _samples.size();
+    meanY /= (double) _samples.size();
+
+    double num = 0, den = 0;
+
+    for (const auto& [x, y]: _samples) {
+        num += (x - meanX) * (y - meanY);
+        den += (x - meanX) * (x - meanX);
+    }
+
+    auto slope = den > 0 ? num / den : 0;
+    auto trend = slope * (double) std::min(_groups, TRENDLINE_MAX_GROUPS) * TRENDLINE_GAIN;
+
+    if (trend > _config.threshold) {
+        // overuse only if the delay keeps growing for more than a single group
+        if (++_overusing > 1 && slope >= _prevSlope) {
+            _usage = Usage::overusing;
+        }
+    } else if (trend < -_config.threshold) {
+        _overusing = 0;
+        _usage = Usage::underusing;
+    } else {
+        _overusing = 0;
+        _usage = Usage::normal;
+    }
+
+    _prevSlope = slope;
+}
+
+void p4sfu::DelayBasedEstimator::_onAcknowledged(std::size_t len, Clock::duration arrival) {
+
+    if (!_ackedSince || arrival < *_ackedSince || arrival - *_ackedSince > 4 * ACK_INTERVAL) {
+        _ackedSince = arrival;
+        _ackedBytes = 0;
+        return;
+    }
+
+    _ackedBytes += len;
+
+    auto span = arrival - *_ackedSince;
+
+    if (span < ACK_INTERVAL) {
+        return;
+    }
+
+    auto rate = (double) _ackedBytes * 8 / std::chrono::duration<double>(span).count();
+    _ackedRate = _ackedRate > 0 ? (_ackedRate + rate) / 2 : rate;
+    _ackedSince = arrival;
+    _ackedBytes = 0;
+}
+
+void p4sfu::DelayBasedEstimator::_update(Clock::time_point now) {
+
+    auto elapsed = std::min(std::chrono::duration<double>(now - _updated).count(), 1.0);
+    _updated = now;
+
+    switch (_usage) {
+
+        case Usage::overusing:
+            _rate = std::min(_rate, _config.beta * (_ackedRate > 0 ? _ackedRate : _rate));
+            break;
+
+        case Usage::normal:
+            _rate *= std::pow(1 + _config.increase, std::max(elapsed, 0.0));
+
+            if (_ackedRate > 0) {
+                _rate = std::min(_rate, _config.headroom * _ackedRate);
+            }
+            break;
+
+        case Usage::underusing: // queues are draining, hold the rate
+            break;
+    }
+
+    _rate = std::clamp(_rate, (double) _config.minRate, (double) _config.maxRate);
+    _estimate.store((unsigned long) _rate, std::memory_order_relaxed);
+}
@@ -0,0 +1,129 @@
+
+#ifndef P4SFU_DELAY_BASED_ESTIMATOR_H
+#define P4SFU_DELAY_BASED_ESTIMATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+namespace p4sfu {
+
+    //! delay-based bandwidth estimate of the path to a receiver from its transport-cc feedback
+    //! - the sender stamps each packet to the receiver with a transport-wide sequence number
+    //!   from onSent(), the receiver reports their arrival times
+    //! - packets sent within a burst form a group; the difference of the arrival and the send
+    //!   spacing of consecutive groups accumulates to the queueing delay, the slope of a
+    //!   trendline fitted over it detects queue build-up before packets are lost
+    //! - on overuse, the estimate drops to a fraction of the acknowledged rate, otherwise it
+    //!   grows multiplicatively up to a multiple of the acknowledged rate
+    //! - not thread-safe except estimate()
+    class DelayBasedEstimator {
+    public:
+
+        using Clock = std::chrono::steady_clock;
+
+        enum class Usage { normal, overusing, underusing };
+
+        struct Config {
+            //! estimate until the first feedback, bits per second
+            unsigned long initialRate = 1'000'000;
+            //! bounds of the estimate, bits per second
+            unsigned long minRate = 100'000;
+            unsigned long maxRate = 20'000'000;
+            //! packets sent within this time of the first packet of a group belong to the group
+            Clock::duration burst = std::chrono::milliseconds(5);
+            //! number of groups the trendline is fitted over
+            std::size_t window = 20;
+            //! smoothing factor of the accumulated queueing delay
+            double smoothing = 0.9;
+            //! the path is overused if the scaled trendline slope exceeds this, in ms
+            double threshold = 12.5;
+            //! estimate after overuse as fraction of the acknowledged rate
+            double beta = 0.85;
+            //! multiplicative increase per second while the path isn't overused
+            double increase = 0.08;
+            //! the estimate grows to at most this multiple of the acknowledged rate, leaves
+            //! room to move an application-limited receiver to a higher decode target
+            double headroom = 2.5;
+            //! packets remembered for matching feedback, rounded up to a power of two
+            std::size_t history = 4096;
+        };
+
+        explicit DelayBasedEstimator(const Config& c, Clock::time_point now = Clock::now());
+
+        DelayBasedEstimator(const DelayBasedEstimator&) = delete;
+        DelayBasedEstimator& operator=(const DelayBasedEstimator&) = delete;
+
+        //! returns the transport-wide sequence number of a packet of len bytes sent at now
+        std::uint16_t onSent(std::size_t len, Clock::time_point now);
+
+        //! updates the estimate from a transport-cc feedback packet of the receiver, returns
+        //! false if it is malformed
+        bool onFeedback(const unsigned char* buf, std::size_t len, Clock::time_point now);
+
+        //! current estimate in bits per second, may be called from any thread
+        [[nodiscard]] unsigned long estimate() const;
+
+        [[nodiscard]] Usage usage() const;
+
+        //! rate of the packets the receiver acknowledged in bits per second, 0 until known
+        [[nodiscard]] unsigned long acknowledgedRate() const;
+
+    private:
+
+        struct Sent {
+            Clock::time_point time;
+            std::size_t len   = 0;
+            std::uint16_t seq = 0;
+            bool valid        = false;
+        };
+
+        struct Group {
+            Clock::time_point firstSent;
+            Clock::time_point lastSent;
+            Clock::duration lastArrival;
+        };
+
+        //! adds a received packet to the current group, closes the group at a new burst
+        void _onPacket(const Sent& p, Clock::duration arrival);
+        //! adds a delay sample of two consecutive groups to the trendline
+        void _onGroup(const Group& prev, const Group& g);
+        //! counts acknowledged bytes towards the acknowledged rate
+        void _onAcknowledged(std::size_t len, Clock::duration arrival);
+        //! adjusts the rate to the usage
+        void _update(Clock::time_point now);
+
+        Config _config;
+        std::vector<Sent> _history;
+        std::size_t _mask;
+        std::uint16_t _nextSeq = 0;
+
+        std::optional<Group> _group;
+        std::optional<Group> _prevGroup;
+        //! accumulated and smoothed queueing delay in ms
+        double _accumulated = 0;
+        double _smoothed = 0;
+        //! (arrival time, smoothed delay) of the last groups in ms
+        std::deque<std::pair<double, double>> _samples;
+        std::optional<Clock::duration> _firstArrival;
+        std::size_t _groups = 0;
+        double _prevSlope = 0;
+        //! consecutive groups above the threshold
+        unsigned _overusing = 0;
+        Usage _usage = Usage::normal;
+
+        //! acknowledged bytes since an arrival time
+        std::size_t _ackedBytes = 0;
+        std::optional<Clock::duration> _ackedSince;
+        double _ackedRate = 0;
+
+        double _rate;
+        Clock::time_point _updated;
+        std::atomic<unsigned long> _estimate;
+    };
+}
+
+#endif
@@ -0,0 +1,248 @@
+
+#include "egress_pacer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "log.h"
+
+namespace {
+
+    //! size of the buffers holding queued packets
+    const std::size_t PACKET_BUFFER_SIZE = 2048;
+}
+
+p4sfu::EgressPacer::EgressPacer(const Config& c, Send&& send, Clock::time_point now)
+    : _config(c),
+      _send(std::move(send)),
+      _epoch(now),
+      _wheel(0),
+      _pool(PACKET_BUFFER_SIZE) {
+
+    if (_config.tick <= Clock::duration::zero()) {
+        throw std::invalid_argument("EgressPacer: tick must be > 0");
+    }
+
+    if (_config.burst == 0) {
+        throw std::invalid_argument("EgressPacer: burst must be > 0");
+    }
+}
+
+void p4sfu::EgressPacer::send(const net::IPv4Port& to, const char* hdr, std::size_t hdrLen,
+                              const char* payload, std::size_t payloadLen, Clock::time_point now) {
+
+    auto& r = _receiver(to, now);
+    auto len = hdrLen + payloadLen;
+
+    if (r.rate == 0 && r.queue.empty()) { // no rate known for the receiver
+        _send(to, hdr, hdrLen, payload, payloadLen, now);
+        r.pkts.add();
+        return;
+    }
+
+    _refill(r, now);
+
+    // a packet waits until the bucket covers it and all packets queued before it
+    auto wait = _wait(r, r.queuedBytes + _cost(len));
+
+    if (wait > _config.maxQueueingDelay) {
+        LOG(DEBUG) << "EgressPacer: send: queue full, dropping packet to " << to << std::endl;
+        r.dropped.add();
+        return;
+    }
+
+    if (_config.txTime) { // the kernel holds the packet, the bucket may go into debt
+        r.tokens -= (double) len;
+        _send(to, hdr, hdrLen, payload, payloadLen, now + wait);
+        _recordDelay(r, wait);
+        return;
+    }
+
+    if (r.queue.empty() && wait == Clock::duration::zero()) {
+        r.tokens -= (double) len;
+        _send(to, hdr, hdrLen, payload, payloadLen, now);
+        _recordDelay(r, wait);
+        return;
+    }
+
+    if (len > _pool.bufferSize()) {
+        Log(Log::ERROR) << "EgressPacer: send: packet too large: len=" << len << std::endl;
+        r.dropped.add();
+        return;
+    }
+
+    auto buf = _pool.get();
+    std::memcpy(buf.data(), hdr, hdrLen);
+    std::memcpy(buf.data() + hdrLen, payload, payloadLen);
+
+    r.queue.push_back(Packet{std::move(buf), len, now});
+    r.queuedBytes += len;
+
+    if (!r.scheduled) {
+        _schedule(to, r, now);
+    }
+}
+
+void p4sfu::EgressPacer::poll(Clock::time_point now) {
+
+    _wheel.advance(_tick(now), [this, now](net::IPv4Port&& to) {
+        _release(to, now);
+    });
+}
+
+void p4sfu::EgressPacer::setBandwidthEstimate(const net::IPv4Port& to,
+                                              unsigned long bitsPerSecond, Clock::time_point now) {
+
+    auto& r = _receiver(to, now);
+
+    _refill(r, now); // tokens up to now accrue at the old rate
+    _setRate(r, _config.pacingFactor * (double) bitsPerSecond / 8);
+
+    LOG(DEBUG) << "EgressPacer: setBandwidthEstimate: to=" << to << ", estimate="
+               << bitsPerSecond << ", rate=" << (unsigned long) (r.rate * 8) << std::endl;
+}
+
+void p4sfu::EgressPacer::removeReceiver(const net::IPv4Port& to) {
+
+    // scheduled wheel entries of the receiver find no receiver and are ignored
+    std::lock_guard lock{_receiversMutex};
+    _receivers.erase(to);
+}
+
+bool p4sfu::EgressPacer::idle() const {
+
+    return _wheel.empty();
+}
+
+const p4sfu::EgressPacer::Config& p4sfu::EgressPacer::config() const {
+
+    return _config;
+}
+
+std::optional<p4sfu::EgressPacer::Statistics>
+p4sfu::EgressPacer::statistics(const net::IPv4Port& to) const {
+
+    std::lock_guard lock{_receiversMutex};
+    auto it = _receivers.find(to);
+
+    if (it == _receivers.end()) {
+        return std::nullopt;
+    }
+
+    const auto& r = *it->second;
+
+    return Statistics{
+        .rate               = r.publishedRate.load(std::memory_order_relaxed),
+        .pkts               = r.pkts.get(),
+        .delayed            = r.delayed.get(),
+        .dropped            = r.dropped.get(),
+        .queueingDelayUs    = r.queueingDelayUs.get(),
+        .maxQueueingDelayUs = r.maxQueueingDelayUs.get()
+    };
+}
+
+p4sfu::EgressPacer::Receiver& p4sfu::EgressPacer::_receiver(const net::IPv4Port& to,
+                                                            Clock::time_point now) {
+
+    if (auto it = _receivers.find(to); it != _receivers.end()) {
+        return *it->second;
+    }
+
+    auto r = std::make_unique<Receiver>();
+    _setRate(*r, (double) _config.defaultRate / 8);
+    r->tokens = (double) _config.burst;
+    r->refilled = now;
+
+    std::lock_guard lock{_receiversMutex};
+    return *_receivers.emplace(to, std::move(r)).first->second;
+}
+
+void p4sfu::EgressPacer::_refill(Receiver& r, Clock::time_point now) const {
+
+    if (now <= r.refilled) {
+        return;
+    }
+
+    std::chrono::duration<double> elapsed = now - r.refilled;
+    r.tokens = std::min((double) _config.burst, r.tokens + elapsed.count() * r.rate);
+    r.refilled = now;
+}
+
+p4sfu::EgressPacer::Clock::duration p4sfu::EgressPacer::_wait(const Receiver& r,
+                                                              std::size_t bytes) const {
+
+    if (r.tokens >= (double) bytes || r.rate == 0) {
+        return Clock::duration::zero();
+    }
+
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(((double) bytes - r.tokens) / r.rate));
+}
+
+std::size_t p4sfu::EgressPacer::_cost(std::size_t len) const {
+
+    // packets larger than the bucket leave when it is full
+    return std::min(len, _config.burst);
+}
+
+void p4sfu::EgressPacer::_schedule(const net::IPv4Port& to, Receiver& r, Clock::time_point now) {
+
+    auto release = now + _wait(r, _cost(r.queue.front().len));
+    _wheel.schedule(to, _tick(release + _config.tick - Clock::duration{1})); // round up
+    r.scheduled = true;
+}
+
+void p4sfu::EgressPacer::_release(const net::IPv4Port& to, Clock::time_point now) {
+
+    auto it = _receivers.find(to);
+
+    if (it == _receivers.end()) { // removed while scheduled
+        return;
+    }
+
+    auto& r = *it->second;
+    r.scheduled = false;
+    _refill(r, now);
+
+    while (!r.queue.empty() && _wait(r, _cost(r.queue.front().len)) == Clock::duration::zero()) {
+
+        auto& p = r.queue.front();
+        r.tokens -= (double) p.len;
+        r.queuedBytes -= p.len;
+
+        _send(to, nullptr, 0, p.buf.data(), p.len, now);
+        _recordDelay(r, now - p.enqueued);
+        r.queue.pop_front();
+    }
+
+    if (!r.queue.empty()) {
+        _schedule(to, r, now);
+    }
+}
+
+void p4sfu::EgressPacer::_recordDelay(Receiver& r, Clock::duration d) {
+
+    auto us = (unsigned long) std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+
+    r.pkts.add();
+
+    if (d > Clock::duration::zero()) {
+        r.delayed.add();
+        r.queueingDelayUs.add(us);
+    }
+
+    if (us > r.maxQueueingDelayUs.get()) { // single writer, the difference can't be stale
+        r.maxQueueingDelayUs.add(us - r.maxQueueingDelayUs.get());
+    }
+}
+
+void p4sfu::EgressPacer::_setRate(Receiver& r, double bytesPerSecond) {
+
+    r.rate = bytesPerSecond;
+    r.publishedRate.store((unsigned long) (bytesPerSecond * 8), std::memory_order_relaxed);
+}
+
+std::uint64_t p4sfu::EgressPacer::_tick(Clock::time_point t) const {
+
+    return t <= _epoch ? 0 : (std::uint64_t) ((t - _epoch) / _config.tick);
+}
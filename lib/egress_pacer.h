@@ -0,0 +1,144 @@
+
+#ifndef P4SFU_EGRESS_PACER_H
+#define P4SFU_EGRESS_PACER_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "net/net.h"
+#include "net/packet_buffer_pool.h"
+#include "switch_statistics.h"
+#include "timing_wheel.h"
+
+namespace p4sfu {
+
+    //! per-receiver token-bucket pacer for egress media
+    //! - each destination has a token bucket filled at a multiple of its bandwidth estimate
+    //!   (REMB); packets that conform leave immediately, others wait in the destination's queue
+    //! - waiting destinations are scheduled on a hierarchical timing wheel for the time their
+    //!   bucket covers the head of the queue, poll() releases them
+    //! - with txTime, packets are not held: they are handed to the backend immediately with the
+    //!   departure time the bucket allows, for kernel-assisted pacing (SO_TXTIME)
+    //! - not thread-safe except statistics(): a pacer is used from the thread sending packets
+    class EgressPacer {
+    public:
+
+        using Clock = std::chrono::steady_clock;
+
+        struct Config {
+            //! pacing rate as multiple of the receiver's bandwidth estimate, leaves headroom for
+            //! encoder overshoot and keyframes
+            double pacingFactor = 2.5;
+            //! pacing rate in bits per second until a receiver's first estimate, 0: unpaced
+            unsigned long defaultRate = 0;
+            //! bucket depth in bytes, i.e., data that may leave back-to-back
+            std::size_t burst = 8 * 1200;
+            //! packets that would wait longer are dropped
+            Clock::duration maxQueueingDelay = std::chrono::milliseconds(250);
+            //! resolution of the timing wheel
+            Clock::duration tick = std::chrono::microseconds(250);
+            //! don't hold packets, pass their departure time to the backend (SO_TXTIME)
+            bool txTime = false;
+        };
+
+        //! snapshot of a receiver's pacing counters
+        struct Statistics {
+            //! current pacing rate in bits per second, 0 if unpaced
+            unsigned long rate               = 0;
+            //! packets sent, packets that had to wait and packets dropped
+            unsigned long pkts               = 0;
+            unsigned long delayed            = 0;
+            unsigned long dropped            = 0;
+            //! sum and maximum of the queueing delays
+            unsigned long queueingDelayUs    = 0;
+            unsigned long maxQueueingDelayUs = 0;
+        };
+
+        //! transmits a packet, called with hdrLen = 0 for packets that were queued
+        using Send = std::function<void (const net::IPv4Port& to, const char* hdr,
+                                         std::size_t hdrLen, const char* payload,
+                                         std::size_t payloadLen, Clock::time_point departure)>;
+
+        EgressPacer(const Config& c, Send&& send, Clock::time_point now = Clock::now());
+
+        EgressPacer(const EgressPacer&) = delete;
+        EgressPacer& operator=(const EgressPacer&) = delete;
+
+        //! sends or queues a packet gathered from hdr and payload, both are copied if queued
+        void send(const net::IPv4Port& to, const char* hdr, std::size_t hdrLen,
+                  const char* payload, std::size_t payloadLen, Clock::time_point now);
+
+        //! releases the packets of all receivers whose bucket has refilled by now
+        void poll(Clock::time_point now);
+
+        //! sets the pacing rate of a receiver from its bandwidth estimate in bits per second
+        void setBandwidthEstimate(const net::IPv4Port& to, unsigned long bitsPerSecond,
+                                  Clock::time_point now = Clock::now());
+
+        //! drops the queue and state of a receiver
+        void removeReceiver(const net::IPv4Port& to);
+
+        //! returns true if no packets are waiting
+        [[nodiscard]] bool idle() const;
+
+        [[nodiscard]] const Config& config() const;
+
+        //! reads a receiver's counters, may be called from any thread
+        [[nodiscard]] std::optional<Statistics> statistics(const net::IPv4Port& to) const;
+
+    private:
+
+        struct Packet {
+            PacketBufferPool::Ref buf;
+            std::size_t len;
+            Clock::time_point enqueued;
+        };
+
+        struct Receiver {
+            //! bytes per second, 0 if unpaced
+            double rate = 0;
+            //! rate in bits per second as read by statistics()
+            std::atomic<unsigned long> publishedRate = 0;
+            double tokens = 0;
+            Clock::time_point refilled;
+            std::deque<Packet> queue;
+            std::size_t queuedBytes = 0;
+            bool scheduled = false;
+
+            Counter pkts;
+            Counter delayed;
+            Counter dropped;
+            Counter queueingDelayUs;
+            Counter maxQueueingDelayUs;
+        };
+
+        Receiver& _receiver(const net::IPv4Port& to, Clock::time_point now);
+        void _refill(Receiver& r, Clock::time_point now) const;
+        //! time until the bucket holds bytes
+        [[nodiscard]] Clock::duration _wait(const Receiver& r, std::size_t bytes) const;
+        //! tokens a packet must wait for
+        [[nodiscard]] std::size_t _cost(std::size_t len) const;
+        void _schedule(const net::IPv4Port& to, Receiver& r, Clock::time_point now);
+        void _release(const net::IPv4Port& to, Clock::time_point now);
+        static void _recordDelay(Receiver& r, Clock::duration d);
+        static void _setRate(Receiver& r, double bytesPerSecond);
+        [[nodiscard]] std::uint64_t _tick(Clock::time_point t) const;
+
+        Config _config;
+        Send _send;
+        Clock::time_point _epoch;
+        TimingWheel<net::IPv4Port> _wheel;
+        PacketBufferPool _pool;
+        std::unordered_map<net::IPv4Port, std::unique_ptr<Receiver>> _receivers;
+        //! guards insertions and removals in _receivers against statistics()
+        mutable std::mutex _receiversMutex;
+    };
+}
+
+#endif
@@ -1,8 +1,16 @@
 
 #include "log.h"
 
+#include "async_log_sink.h"
+
 Log::Log(Log::level l)
-    : _level(l), _nullStream("/dev/null", std::ios::out) {
+    : _level(l) {
+
+    // a statement logging from within another one on the same thread is written synchronously
+    if (l <= config.level && !_recording && _sink.load(std::memory_order_acquire)) {
+        _record = &_recordStream;
+        _recording = true;
+    }
 
     if (config.printLabel) {
 
@@ -29,7 +37,38 @@ Log::Log(Log::level l)
     }
 }
 
+Log::~Log() {
+
+    if (!_record) {
+        return;
+    }
+
+    auto text = std::move(*_record).str();
+    _record->str({});
+    // the buffer is reused, manipulators of a record must not carry over to the next one
+    _record->flags(std::ios_base::dec | std::ios_base::skipws);
+    _record->precision(6);
+    _record->fill(' ');
+    _record->width(0);
+    _recording = false;
+
+    if (auto* s = _sink.load(std::memory_order_acquire)) {
+        s->push(_level, std::move(text));
+    } else { // the sink was removed while the record was formatted
+        (_level == Log::level::ERROR ? std::cerr : std::cout) << text;
+    }
+}
+
+void Log::sink(AsyncLogSink* s) {
+
+    _sink.store(s, std::memory_order_release);
+}
+
 struct Log::config Log::config = {};
+std::atomic<AsyncLogSink*> Log::_sink{nullptr};
+thread_local std::ostringstream Log::_recordStream;
+thread_local bool Log::_recording = false;
+thread_local std::ostream Log::_nullStream{nullptr};
 Log::level Log::TRACE = Log::level::TRACE;
 Log::level Log::DEBUG = Log::level::DEBUG;
 Log::level Log::INFO  = Log::level::INFO;
@@ -1,9 +1,25 @@
-
 #ifndef LOG_H
 #define LOG_H
 
+#include <atomic>
 #include <iostream>
-#include <fstream>
+#include <sstream>
+
+//! most verbose level compiled into LOG() statements (0 = ERROR ... 4 = TRACE), statements
+//! above it are removed by the compiler
+#ifndef LOG_COMPILED_LEVEL
+#define LOG_COMPILED_LEVEL 3
+#endif
+
+//! hot-path logging: LOG(DEBUG) << ...
+//! - statements above LOG_COMPILED_LEVEL compile to nothing
+//! - arguments are only evaluated if the level is enabled at runtime
+#define LOG(l)                                             \
+    if constexpr (!Log::compiledIn(Log::level::l)) { }     \
+    else if (!Log::enabled(Log::level::l)) { }             \
+    else Log(Log::level::l)
+
+class AsyncLogSink;
 
 class Log {
 
@@ -26,17 +42,34 @@ public:
 
     Log() = delete;
     explicit Log(Log::level l);
+    Log(const Log&) = delete;
+    Log& operator=(const Log&) = delete;
+    ~Log();
 
     template<typename T>
     std::ostream& operator<<(const T& msg) {
 
         if(_level <= config.level) {
+            if (_record) {
+                return *_record << msg;
+            }
             return (_level == Log::level::ERROR ? std::cerr : std::cout) << msg;
         }
 
         return _nullStream;
     }
 
+    static constexpr bool compiledIn(Log::level l) {
+        return static_cast<int>(l) <= LOG_COMPILED_LEVEL;
+    }
+
+    static bool enabled(Log::level l) {
+        return l <= config.level;
+    }
+
+    //! routes records to an asynchronous sink instead of std::cout/std::cerr (nullptr: none)
+    static void sink(AsyncLogSink* s);
+
     static level DEBUG;
     static level INFO;
     static level WARN;
@@ -45,7 +78,16 @@ public:
 
 private:
     Log::level _level;
-    std::fstream _nullStream;
+    //! record buffer if this statement goes to the sink
+    std::ostringstream* _record = nullptr;
+
+    static std::atomic<AsyncLogSink*> _sink;
+    //! per-thread record buffer, reused across statements
+    static thread_local std::ostringstream _recordStream;
+    static thread_local bool _recording;
+
+    //! stream without buffer in failed state, discards output without formatting it
+    static thread_local std::ostream _nullStream;
 };
 
 #endif
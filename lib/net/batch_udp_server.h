@@ -0,0 +1,525 @@
+
+#ifndef P4SFU_BATCH_UDP_SERVER_H
+#define P4SFU_BATCH_UDP_SERVER_H
+
+#include <boost/asio.hpp>
+#include <linux/net_tstamp.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <ctime>
+#include <cstring>
+#include <vector>
+
+#include "udp_server.h"
+
+using namespace boost;
+
+//! UDP server that drains up to batchSize datagrams per wakeup using recvmmsg() and transmits all
+//! datagrams queued during a batch with a single sendmmsg()
+//! - with UDP offload enabled, the socket receives coalesced super-datagrams (UDP_GRO) that are
+//!   split into their segments before they are handed to the handlers, and consecutive datagrams
+//!   of a batch to the same receiver are sent as one super-datagram (UDP_SEGMENT, GSO)
+//! - with enableTxTime(), datagrams sent by sendToGatherAt() carry their departure time
+//!   (SCM_TXTIME) and are never coalesced with others
+class BatchUDPServer : public UDPInterface {
+
+public:
+
+    struct Statistics {
+        unsigned long rxBatches = 0;
+        unsigned long rxPkts    = 0;
+        unsigned long rxGroPkts = 0;
+        unsigned long txBatches = 0;
+        unsigned long txPkts    = 0;
+        unsigned long txGsoPkts = 0;
+        unsigned long txDropped = 0;
+    };
+
+    //! @param udpOffload enables UDP_GRO and UDP_SEGMENT if the kernel supports them
+    BatchUDPServer(asio::io_context& io, unsigned short port, std::size_t batchSize = 32,
+                   bool reusePort = false, bool udpOffload = false)
+        : _socket(_bind(io, port, reusePort)),
+          _batchSize(batchSize),
+          _gro(udpOffload && _enable(UDP_GRO, 1)),
+          _gso(udpOffload && _enable(UDP_SEGMENT, 0)),
+          _rxBufLen(_gro ? _GRO_BUF_LEN : _BUF_LEN),
+          _txSlots(_gso ? batchSize * _GSO_TX_FACTOR : batchSize),
+          _rxBufs(batchSize * _rxBufLen),
+          _rxAddrs(batchSize),
+          _rxIov(batchSize),
+          _rxMsgs(batchSize),
+          _rxCtrl(batchSize * CMSG_SPACE(sizeof(int))),
+          _txBufs(_txSlots * _BUF_LEN),
+          _txAddrs(_txSlots),
+          _txIov(2 * _txSlots),
+          _txIovLen(_txSlots),
+          _txMsgs(_txSlots),
+          _txMsgSegments(_txSlots) {
+
+        if (batchSize == 0) {
+            throw std::invalid_argument("BatchUDPServer: batchSize must be > 0");
+        }
+
+        _socket.non_blocking(true);
+
+        for (std::size_t i = 0; i < _batchSize; i++) {
+            _rxIov[i].iov_base = _rxBufs.data() + i * _rxBufLen;
+            _rxIov[i].iov_len = _rxBufLen;
+        }
+
+        for (std::size_t i = 0; i < _txSlots; i++) {
+            _txIov[2 * i].iov_base = _txBufs.data() + i * _BUF_LEN;
+        }
+
+        if (_gso) {
+            _txCtrl.resize(_txSlots * _TX_CTRL_LEN);
+            _txAssigned.resize(_txSlots);
+            _gsoIov.resize(2 * _txSlots);
+        }
+
+        _read();
+    }
+
+    //! copies the datagram into the transmit batch; the batch is sent when it is full, when the
+    //! current receive batch has been handled, or immediately when called outside a batch
+    void sendTo(const asio::ip::udp::endpoint& to, const char* buf, std::size_t len) override {
+
+        if (len > _BUF_LEN) {
+            throw std::invalid_argument("BatchUDPServer: sendTo(): datagram too large");
+        }
+
+        auto i = _queue(to);
+        std::memcpy(_txBufs.data() + i * _BUF_LEN, buf, len);
+        _txIov[2 * i].iov_len = len;
+        _txIovLen[i] = 1;
+        _setTxTime(i, 0);
+
+        if (!_inBatch) {
+            flush();
+        }
+    }
+
+    //! copies the header into the transmit batch, the payload is referenced by a second iovec
+    //! and not copied (it stays valid until the batch is flushed)
+    void sendToGather(const asio::ip::udp::endpoint& to, const char* hdr, std::size_t hdrLen,
+                      const char* payload, std::size_t payloadLen) override {
+
+        if (hdrLen > _BUF_LEN) {
+            throw std::invalid_argument("BatchUDPServer: sendToGather(): header too large");
+        }
+
+        auto i = _queue(to);
+        std::memcpy(_txBufs.data() + i * _BUF_LEN, hdr, hdrLen);
+        _txIov[2 * i].iov_len = hdrLen;
+        _txIov[2 * i + 1].iov_base = const_cast<char*>(payload);
+        _txIov[2 * i + 1].iov_len = payloadLen;
+        _txIovLen[i] = 2;
+        _setTxTime(i, 0);
+
+        if (!_inBatch) {
+            flush();
+        }
+    }
+
+    //! queues like sendToGather(), the datagram leaves the qdisc not before departure if
+    //! enableTxTime() succeeded
+    void sendToGatherAt(const asio::ip::udp::endpoint& to, const char* hdr, std::size_t hdrLen,
+                        const char* payload, std::size_t payloadLen,
+                        std::chrono::steady_clock::time_point departure) override {
+
+        if (!_txTime) {
+            return sendToGather(to, hdr, hdrLen, payload, payloadLen);
+        }
+
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            departure.time_since_epoch()).count();
+
+        auto inBatch = std::exchange(_inBatch, true); // flush after the departure time is set
+        sendToGather(to, hdr, hdrLen, payload, payloadLen);
+        _inBatch = inBatch;
+        _setTxTime(_txCount - 1, ns > 0 ? (std::uint64_t) ns : 1);
+
+        if (!_inBatch) {
+            flush();
+        }
+    }
+
+    //! sets SO_TXTIME on the socket, returns false if the kernel does not support it
+    //! @note departure times are only enforced with a time-based qdisc (e.g., fq or etf)
+    bool enableTxTime() {
+
+        sock_txtime config{CLOCK_MONOTONIC, 0};
+
+        if (::setsockopt(_socket.native_handle(), SOL_SOCKET, SO_TXTIME, &config,
+                         sizeof(config)) != 0) {
+            return false;
+        }
+
+        _txTime = true;
+        _txTimes.assign(_txSlots, 0);
+        _txCtrl.resize(_txSlots * _TX_CTRL_LEN);
+        return true;
+    }
+
+    [[nodiscard]] bool txTime() const override {
+        return _txTime;
+    }
+
+    void flush() override {
+
+        if (_txCount == 0) {
+            return;
+        }
+
+        std::size_t n = _gso ? _buildSegmentedMessages() : _buildMessages();
+        std::size_t sent = 0;
+
+        while (sent < n) {
+
+            int res = ::sendmmsg(_socket.native_handle(), _txMsgs.data() + sent, n - sent, 0);
+
+            if (res < 0) {
+
+                if (errno == EINTR) {
+                    continue;
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                    // socket buffer is full: drop the remainder as a congested link would
+                    for (std::size_t i = sent; i < n; i++) {
+                        _stats.txDropped += _txMsgSegments[i];
+                    }
+                    break;
+                }
+
+                _txCount = 0;
+                throw std::runtime_error("BatchUDPServer: flush() failed: " + std::to_string(errno));
+            }
+
+            for (std::size_t i = sent; i < sent + res; i++) {
+                _stats.txPkts += _txMsgSegments[i];
+                _stats.txGsoPkts += (_txMsgSegments[i] > 1);
+            }
+
+            sent += res;
+            _stats.txBatches++;
+        }
+
+        _txCount = 0;
+    }
+
+    [[nodiscard]] const Statistics& statistics() const {
+        return _stats;
+    }
+
+    [[nodiscard]] asio::ip::udp::socket& socket() {
+        return _socket;
+    }
+
+    //! returns true if received super-datagrams are coalesced by the kernel (UDP_GRO)
+    [[nodiscard]] bool gro() const {
+        return _gro;
+    }
+
+    //! returns true if datagrams to the same receiver are sent as super-datagrams (UDP_SEGMENT)
+    [[nodiscard]] bool gso() const {
+        return _gso;
+    }
+
+private:
+
+    //! sets a UDP-level socket option, returns false if the kernel does not support it
+    bool _enable(int option, int value) {
+        return ::setsockopt(_socket.native_handle(), SOL_UDP, option, &value, sizeof(value)) == 0;
+    }
+
+    //! reserves the next transmit slot (flushing a full batch) and returns its index
+    std::size_t _queue(const asio::ip::udp::endpoint& to) {
+
+        // the socket and the transmit slots are IPv4 only
+        if (!to.address().is_v4()) {
+            throw std::invalid_argument("BatchUDPServer: _queue(): not an IPv4 endpoint");
+        }
+
+        if (_txCount == _txSlots) {
+            flush();
+        }
+
+        std::memcpy(&_txAddrs[_txCount], to.data(), sizeof(sockaddr_in));
+        return _txCount++;
+    }
+
+    [[nodiscard]] std::size_t _txLen(std::size_t i) const {
+        return _txIov[2 * i].iov_len + (_txIovLen[i] == 2 ? _txIov[2 * i + 1].iov_len : 0);
+    }
+
+    [[nodiscard]] bool _sameReceiver(std::size_t i, std::size_t j) const {
+        return _txAddrs[i].sin_addr.s_addr == _txAddrs[j].sin_addr.s_addr
+            && _txAddrs[i].sin_port == _txAddrs[j].sin_port;
+    }
+
+    //! one message per queued datagram
+    std::size_t _buildMessages() {
+
+        for (std::size_t i = 0; i < _txCount; i++) {
+            std::memset(&_txMsgs[i], 0, sizeof(mmsghdr));
+            _txMsgs[i].msg_hdr.msg_name = &_txAddrs[i];
+            _txMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            _txMsgs[i].msg_hdr.msg_iov = &_txIov[2 * i];
+            _txMsgs[i].msg_hdr.msg_iovlen = _txIovLen[i];
+            _txMsgSegments[i] = 1;
+            _attachTxTime(i, i);
+        }
+
+        return _txCount;
+    }
+
+    //! groups the queued datagrams by receiver into GSO messages: the datagrams to a receiver
+    //! keep their order, all segments of a message but the last must have the same size
+    std::size_t _buildSegmentedMessages() {
+
+        std::fill(_txAssigned.begin(), _txAssigned.begin() + _txCount, false);
+        std::size_t msgs = 0, iovs = 0;
+
+        for (std::size_t i = 0; i < _txCount; i++) {
+
+            if (_txAssigned[i]) {
+                continue;
+            }
+
+            auto segSize = _txLen(i);
+            auto firstIov = iovs;
+            std::size_t segs = 0, bytes = 0;
+
+            for (std::size_t j = i; j < _txCount && segs < _GSO_MAX_SEGMENTS; j++) {
+
+                if (_txAssigned[j] || !_sameReceiver(i, j)) {
+                    continue;
+                }
+
+                // datagrams with a departure time are sent on their own
+                if (j > i && (_hasTxTime(i) || _hasTxTime(j))) {
+                    break;
+                }
+
+                auto len = _txLen(j);
+
+                if (len > segSize || bytes + len > _GSO_MAX_BYTES) {
+                    break;
+                }
+
+                for (std::size_t k = 0; k < _txIovLen[j]; k++) {
+                    _gsoIov[iovs++] = _txIov[2 * j + k];
+                }
+
+                _txAssigned[j] = true;
+                segs++;
+                bytes += len;
+
+                if (len < segSize) { // a shorter segment ends the message
+                    break;
+                }
+            }
+
+            auto& m = _txMsgs[msgs];
+            std::memset(&m, 0, sizeof(mmsghdr));
+            m.msg_hdr.msg_name = &_txAddrs[i];
+            m.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            m.msg_hdr.msg_iov = &_gsoIov[firstIov];
+            m.msg_hdr.msg_iovlen = iovs - firstIov;
+
+            if (segs > 1) {
+                auto* ctrl = _txCtrl.data() + msgs * _TX_CTRL_LEN;
+                m.msg_hdr.msg_control = ctrl;
+                m.msg_hdr.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+
+                auto* cm = CMSG_FIRSTHDR(&m.msg_hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+                auto gsoSize = static_cast<std::uint16_t>(segSize);
+                std::memcpy(CMSG_DATA(cm), &gsoSize, sizeof(gsoSize));
+            } else {
+                _attachTxTime(i, msgs);
+            }
+
+            _txMsgSegments[msgs++] = segs;
+        }
+
+        return msgs;
+    }
+
+    void _setTxTime(std::size_t slot, std::uint64_t ns) {
+        if (_txTime) {
+            _txTimes[slot] = ns;
+        }
+    }
+
+    [[nodiscard]] bool _hasTxTime(std::size_t slot) const {
+        return _txTime && _txTimes[slot] != 0;
+    }
+
+    //! adds the departure time of a queued datagram to message m
+    void _attachTxTime(std::size_t slot, std::size_t m) {
+
+        if (!_hasTxTime(slot)) {
+            return;
+        }
+
+        auto& msg = _txMsgs[m].msg_hdr;
+        msg.msg_control = _txCtrl.data() + m * _TX_CTRL_LEN;
+        msg.msg_controllen = CMSG_SPACE(sizeof(std::uint64_t));
+
+        auto* cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_TXTIME;
+        cm->cmsg_len = CMSG_LEN(sizeof(std::uint64_t));
+        std::memcpy(CMSG_DATA(cm), &_txTimes[slot], sizeof(std::uint64_t));
+    }
+
+    void _read() {
+
+        _socket.async_wait(asio::ip::udp::socket::wait_read, [this](system::error_code ec) {
+
+            if (ec) {
+                if (ec != asio::error::operation_aborted) {
+                    throw std::runtime_error("BatchUDPServer: _read() failed: "
+                        + std::to_string(ec.value()));
+                }
+                return;
+            }
+
+            _drain();
+            _read();
+        });
+    }
+
+    void _drain() {
+
+        for (std::size_t i = 0; i < _batchSize; i++) {
+            std::memset(&_rxMsgs[i], 0, sizeof(mmsghdr));
+            _rxMsgs[i].msg_hdr.msg_name = &_rxAddrs[i];
+            _rxMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            _rxMsgs[i].msg_hdr.msg_iov = &_rxIov[i];
+            _rxMsgs[i].msg_hdr.msg_iovlen = 1;
+
+            if (_gro) {
+                _rxMsgs[i].msg_hdr.msg_control = _rxCtrl.data() + i * CMSG_SPACE(sizeof(int));
+                _rxMsgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(int));
+            }
+        }
+
+        int n = ::recvmmsg(_socket.native_handle(), _rxMsgs.data(), _batchSize, MSG_DONTWAIT,
+                           nullptr);
+
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return;
+            }
+            throw std::runtime_error("BatchUDPServer: _drain() failed: " + std::to_string(errno));
+        }
+
+        _stats.rxBatches++;
+        _rxDatagrams.clear();
+
+        for (int i = 0; i < n; i++) {
+
+            asio::ip::udp::endpoint from;
+            std::memcpy(from.data(), &_rxAddrs[i], sizeof(sockaddr_in));
+            from.resize(sizeof(sockaddr_in));
+
+            const char* buf = _rxBufs.data() + i * _rxBufLen;
+            std::size_t len = _rxMsgs[i].msg_len;
+            std::size_t segSize = _gro ? _groSegmentSize(_rxMsgs[i].msg_hdr) : 0;
+
+            if (segSize == 0 || segSize >= len) {
+                _rxDatagrams.push_back(Datagram{from, buf, len});
+                continue;
+            }
+
+            _stats.rxGroPkts++;
+
+            for (std::size_t off = 0; off < len; off += segSize) {
+                _rxDatagrams.push_back(Datagram{from, buf + off, std::min(segSize, len - off)});
+            }
+        }
+
+        _stats.rxPkts += _rxDatagrams.size();
+        _inBatch = true;
+
+        try {
+            if (_onBatch) {
+                (*_onBatch)(*this, _rxDatagrams.data(), _rxDatagrams.size());
+            } else if (_onMessage) {
+                for (auto& d: _rxDatagrams) {
+                    (*_onMessage)(*this, d.from, d.buf, d.len);
+                }
+            }
+        } catch (...) {
+            _inBatch = false;
+            throw;
+        }
+
+        _inBatch = false;
+        flush();
+    }
+
+    //! returns the segment size of a coalesced datagram, 0 if it was not coalesced
+    static std::size_t _groSegmentSize(msghdr& h) {
+
+        for (auto* cm = CMSG_FIRSTHDR(&h); cm; cm = CMSG_NXTHDR(&h, cm)) {
+            if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                int size;
+                std::memcpy(&size, CMSG_DATA(cm), sizeof(size));
+                return size;
+            }
+        }
+
+        return 0;
+    }
+
+    static const std::size_t _BUF_LEN = 2048;
+    //! receive buffer size with GRO: a coalesced super-datagram has up to 64 KiB
+    static const std::size_t _GRO_BUF_LEN = 65536;
+    //! transmit slots per receive batch with GSO, so that the fan-out of a whole batch can be
+    //! coalesced per receiver
+    static const std::size_t _GSO_TX_FACTOR = 8;
+    //! limits of a single GSO send (UDP_MAX_SEGMENTS of older kernels, max. UDP payload)
+    static const std::size_t _GSO_MAX_SEGMENTS = 64;
+    static const std::size_t _GSO_MAX_BYTES = 65507;
+    //! control buffer per transmitted message, holds either UDP_SEGMENT or SCM_TXTIME
+    static constexpr std::size_t _TX_CTRL_LEN = CMSG_SPACE(sizeof(std::uint64_t));
+
+    asio::ip::udp::socket _socket;
+    std::size_t _batchSize;
+    bool _gro;
+    bool _gso;
+    std::size_t _rxBufLen;
+    std::size_t _txSlots;
+
+    std::vector<char> _rxBufs;
+    std::vector<sockaddr_in> _rxAddrs;
+    std::vector<iovec> _rxIov;
+    std::vector<mmsghdr> _rxMsgs;
+    std::vector<char> _rxCtrl;
+    std::vector<Datagram> _rxDatagrams;
+
+    std::vector<char> _txBufs;
+    std::vector<sockaddr_in> _txAddrs;
+    std::vector<iovec> _txIov; // two per datagram: copied header/datagram, referenced payload
+    std::vector<std::size_t> _txIovLen;
+    std::vector<mmsghdr> _txMsgs;
+    std::vector<std::size_t> _txMsgSegments;
+    std::vector<char> _txCtrl;
+    std::vector<bool> _txAssigned;
+    std::vector<iovec> _gsoIov;
+    std::size_t _txCount = 0;
+    bool _txTime = false;
+    //! departure time per transmit slot in ns of CLOCK_MONOTONIC, 0: none
+    std::vector<std::uint64_t> _txTimes;
+
+    bool _inBatch = false;
+    Statistics _stats;
+};
+
+#endif
@@ -86,6 +86,23 @@ namespace net {
                 src_addr        = 0;
                 dst_addr        = 0;
             }
+
+            //! computes hdr_checksum over the header (without options)
+            void compute_checksum() {
+                hdr_checksum = 0;
+                std::uint32_t sum = 0;
+                const auto* words = reinterpret_cast<const std::uint16_t*>(this);
+
+                for (unsigned i = 0; i < HDR_LEN / 2; i++) {
+                    sum += words[i];
+                }
+
+                while (sum >> 16) {
+                    sum = (sum & 0xffff) + (sum >> 16);
+                }
+
+                hdr_checksum = (std::uint16_t) ~sum;
+            }
         };
     }
 
@@ -0,0 +1,168 @@
+
+#ifndef P4SFU_PACKET_BUFFER_POOL_H
+#define P4SFU_PACKET_BUFFER_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! pool of fixed-size, reference-counted packet buffers carved out of slabs
+//! - a buffer returns to the pool's free list when its last reference is dropped, slabs are never
+//!   returned to the system while the pool exists
+//! - buffers may outlive the pool (e.g., in handlers of pending sends), the slabs are then
+//!   released with the last reference
+//! - not thread-safe: a pool and its buffers are used from a single thread
+class PacketBufferPool {
+
+    struct Slabs;
+
+    struct Buffer {
+        Slabs* slabs = nullptr;
+        Buffer* next = nullptr;
+        char* data = nullptr;
+        unsigned refs = 0;
+    };
+
+    struct Slabs {
+        std::size_t bufferSize;
+        std::size_t buffersPerSlab;
+        std::vector<std::unique_ptr<Buffer[]>> buffers = {};
+        std::vector<std::unique_ptr<char[]>> data = {};
+        Buffer* free = nullptr;
+        std::size_t inUse = 0;
+        bool closed = false;
+    };
+
+public:
+
+    //! reference to a pool buffer, copies share the buffer
+    class Ref {
+    public:
+
+        Ref() = default;
+
+        Ref(const Ref& other) : _buf(other._buf) {
+            if (_buf) {
+                _buf->refs++;
+            }
+        }
+
+        Ref(Ref&& other) noexcept : _buf(std::exchange(other._buf, nullptr)) { }
+
+        Ref& operator=(Ref other) noexcept {
+            std::swap(_buf, other._buf);
+            return *this;
+        }
+
+        ~Ref() {
+            if (_buf && --_buf->refs == 0) {
+                _release(_buf);
+            }
+        }
+
+        [[nodiscard]] char* data() const {
+            return _buf->data;
+        }
+
+        [[nodiscard]] std::size_t capacity() const {
+            return _buf->slabs->bufferSize;
+        }
+
+        //! returns true if p points into this buffer
+        [[nodiscard]] bool contains(const char* p) const {
+            return _buf && p >= _buf->data && p < _buf->data + _buf->slabs->bufferSize;
+        }
+
+        [[nodiscard]] unsigned useCount() const {
+            return _buf ? _buf->refs : 0;
+        }
+
+        explicit operator bool() const {
+            return _buf != nullptr;
+        }
+
+    private:
+
+        friend class PacketBufferPool;
+
+        explicit Ref(Buffer* b) : _buf(b) {
+            _buf->refs = 1;
+        }
+
+        static void _release(Buffer* b) {
+
+            auto* s = b->slabs;
+            b->next = s->free;
+            s->free = b;
+            s->inUse--;
+
+            if (s->closed && s->inUse == 0) {
+                delete s;
+            }
+        }
+
+        Buffer* _buf = nullptr;
+    };
+
+    struct Statistics {
+        std::size_t slabs  = 0;
+        std::size_t inUse  = 0;
+    };
+
+    explicit PacketBufferPool(std::size_t bufferSize, std::size_t buffersPerSlab = 64)
+        : _slabs(new Slabs{bufferSize, buffersPerSlab}) { }
+
+    PacketBufferPool(const PacketBufferPool&) = delete;
+    PacketBufferPool& operator=(const PacketBufferPool&) = delete;
+
+    ~PacketBufferPool() {
+
+        if (_slabs->inUse == 0) {
+            delete _slabs;
+        } else { // deleted by the last Ref
+            _slabs->closed = true;
+        }
+    }
+
+    //! returns an unused buffer, allocates a new slab if none is left
+    [[nodiscard]] Ref get() {
+
+        if (!_slabs->free) {
+            _grow();
+        }
+
+        auto* b = _slabs->free;
+        _slabs->free = b->next;
+        _slabs->inUse++;
+        return Ref{b};
+    }
+
+    [[nodiscard]] std::size_t bufferSize() const {
+        return _slabs->bufferSize;
+    }
+
+    [[nodiscard]] Statistics statistics() const {
+        return Statistics{_slabs->data.size(), _slabs->inUse};
+    }
+
+private:
+
+    void _grow() {
+
+        auto n = _slabs->buffersPerSlab;
+        auto& buffers = _slabs->buffers.emplace_back(new Buffer[n]);
+        auto& data = _slabs->data.emplace_back(new char[n * _slabs->bufferSize]);
+
+        for (std::size_t i = 0; i < n; i++) {
+            buffers[i].slabs = _slabs;
+            buffers[i].data = data.get() + i * _slabs->bufferSize;
+            buffers[i].next = _slabs->free;
+            _slabs->free = &buffers[i];
+        }
+    }
+
+    Slabs* _slabs;
+};
+
+#endif
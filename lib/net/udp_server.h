@@ -3,28 +3,104 @@
 #define P4SFU_UDP_SERVER_H
 
 #include <boost/asio.hpp>
+#include <array>
+#include <chrono>
+#include <cstring>
 #include <optional>
 #include <functional>
 #include <iostream>
 
+#include "packet_buffer_pool.h"
+
 using namespace boost;
 
 class UDPInterface {
 public:
 
+    //! a single received datagram, as handed to batch handlers
+    struct Datagram {
+        asio::ip::udp::endpoint from;
+        const char* buf = nullptr;
+        std::size_t len = 0;
+    };
+
     typedef std::function<void(UDPInterface&, asio::ip::udp::endpoint&, const char*, std::size_t)>
         OnMessageHandler;
 
+    typedef std::function<void(UDPInterface&, Datagram*, std::size_t)> OnBatchHandler;
+
     virtual void sendTo(const asio::ip::udp::endpoint& to, const char* buf, std::size_t len) = 0;
 
+    //! sends a datagram gathered from a header and a payload (scatter-gather), used to send a
+    //! received payload to several receivers with individually rewritten headers
+    //! - the header is copied, the payload must stay valid until the current receive handler
+    //!   returns or flush() is called
+    //! - the default implementation copies both into a contiguous buffer and calls sendTo()
+    virtual void sendToGather(const asio::ip::udp::endpoint& to, const char* hdr,
+                              std::size_t hdrLen, const char* payload, std::size_t payloadLen) {
+
+        char buf[_GATHER_BUF_LEN];
+
+        if (hdrLen + payloadLen > _GATHER_BUF_LEN) {
+            throw std::invalid_argument("UDPInterface: sendToGather(): datagram too large");
+        }
+
+        std::memcpy(buf, hdr, hdrLen);
+        std::memcpy(buf + hdrLen, payload, payloadLen);
+        sendTo(to, buf, hdrLen + payloadLen);
+    }
+
+    //! like sendToGather(), but the kernel holds the datagram until departure (SO_TXTIME on
+    //! CLOCK_MONOTONIC, which std::chrono::steady_clock uses on Linux)
+    //! - the default implementation ignores departure and sends immediately, see txTime()
+    virtual void sendToGatherAt(const asio::ip::udp::endpoint& to, const char* hdr,
+                                std::size_t hdrLen, const char* payload, std::size_t payloadLen,
+                                std::chrono::steady_clock::time_point /* departure */) {
+
+        sendToGather(to, hdr, hdrLen, payload, payloadLen);
+    }
+
+    //! returns true if sendToGatherAt() honors departure times
+    [[nodiscard]] virtual bool txTime() const {
+        return false;
+    }
+
+    //! transmits datagrams queued by sendTo(); no-op for implementations that send immediately
+    virtual void flush() { }
+
     void onMessage(OnMessageHandler&& f) {
         _onMessage = std::move(f);
     }
 
+    //! registers a handler for all datagrams drained in a single wakeup
+    //! @note implementations without batching ignore this handler and only call onMessage
+    void onBatch(OnBatchHandler&& f) {
+        _onBatch = std::move(f);
+    }
+
     virtual ~UDPInterface() = default;
 
 protected:
+
+    //! opens a UDP socket bound to the given port on all IPv4 addresses
+    //! @param reusePort sets SO_REUSEPORT so that multiple sockets can share the port
+    static asio::ip::udp::socket _bind(asio::io_context& io, unsigned short port, bool reusePort) {
+
+        asio::ip::udp::socket socket{io};
+        socket.open(asio::ip::udp::v4());
+
+        if (reusePort) {
+            socket.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>{true});
+        }
+
+        socket.bind(asio::ip::udp::endpoint(asio::ip::udp::v4(), port));
+        return socket;
+    }
+
+    static const std::size_t _GATHER_BUF_LEN = 2048;
+
     std::optional<OnMessageHandler> _onMessage = std::nullopt;
+    std::optional<OnBatchHandler> _onBatch = std::nullopt;
 };
 
 namespace test {
@@ -53,20 +129,30 @@ namespace test {
     };
 }
 
+//! UDP server on top of an asio socket
+//! - datagrams are received into pooled, reference-counted buffers; sends keep a reference to the
+//!   buffer they were sent from until they complete, so asynchronous sends never see a receive
+//!   buffer that has been reused
+//! - gathered sends (sendToGather) are transmitted with sendmsg() iovecs: the header is copied
+//!   into a small pooled buffer, a payload from the current receive buffer is not copied
 class UDPServer : public UDPInterface {
 
 public:
 
-    UDPServer(asio::io_context& io, unsigned short port)
-        : _socket(io, asio::ip::udp::endpoint(asio::ip::udp::v4(), port)) {
+    UDPServer(asio::io_context& io, unsigned short port, bool reusePort = false)
+        : _socket(_bind(io, port, reusePort)) {
 
         _read();
     }
 
-    virtual void sendTo(const asio::ip::udp::endpoint& to, const char* buf, std::size_t len) override {
+    //! sends a datagram, buf is copied unless it is the current receive buffer
+    void sendTo(const asio::ip::udp::endpoint& to, const char* buf, std::size_t len) override {
+
+        auto ref = _retain(buf, len);
 
-        _socket.async_send_to(asio::buffer(buf, len), to,
-            [](system::error_code ec, std::size_t len) {
+        // a queued send reads the buffer only when the socket becomes writable
+        _socket.async_send_to(asio::buffer(ref.contains(buf) ? buf : ref.data(), len), to,
+            [ref](system::error_code ec, std::size_t) {
 
             if (ec) {
                 throw std::runtime_error("UDPServer: sendTo() failed: " + std::to_string(ec.value()));
@@ -74,17 +160,67 @@ public:
         });
     }
 
+    void sendToGather(const asio::ip::udp::endpoint& to, const char* hdr, std::size_t hdrLen,
+                      const char* payload, std::size_t payloadLen) override {
+
+        if (hdrLen > _HDR_BUF_LEN) {
+            return UDPInterface::sendToGather(to, hdr, hdrLen, payload, payloadLen);
+        }
+
+        auto hdrRef = _hdrPool.get();
+        std::memcpy(hdrRef.data(), hdr, hdrLen);
+        auto payloadRef = _retain(payload, payloadLen);
+
+        std::array<asio::const_buffer, 2> bufs = {
+            asio::buffer(hdrRef.data(), hdrLen),
+            asio::buffer(payloadRef.contains(payload) ? payload : payloadRef.data(), payloadLen)
+        };
+
+        _socket.async_send_to(bufs, to,
+            [hdrRef, payloadRef](system::error_code ec, std::size_t) {
+
+            if (ec) {
+                throw std::runtime_error("UDPServer: sendToGather() failed: "
+                    + std::to_string(ec.value()));
+            }
+        });
+    }
+
+    [[nodiscard]] asio::ip::udp::socket& socket() {
+        return _socket;
+    }
+
 private:
 
+    //! returns a reference that keeps buf alive: the receive buffer if buf points into it,
+    //! otherwise a pooled copy
+    PacketBufferPool::Ref _retain(const char* buf, std::size_t len) {
+
+        if (_rxBuf.contains(buf)) {
+            return _rxBuf;
+        }
+
+        if (len > _pool.bufferSize()) {
+            throw std::invalid_argument("UDPServer: datagram too large");
+        }
+
+        auto ref = _pool.get();
+        std::memcpy(ref.data(), buf, len);
+        return ref;
+    }
+
     void _read() {
 
-        _socket.async_receive_from(asio::buffer(_rxBuf, _RX_BUF_LEN), _senderEndpoint,
+        // the previous buffer stays alive as long as sends from it are pending
+        _rxBuf = _pool.get();
+
+        _socket.async_receive_from(asio::buffer(_rxBuf.data(), _RX_BUF_LEN), _senderEndpoint,
             [this](system::error_code ec, std::size_t len) {
 
             if (!ec && len > 0) {
 
                 if (_onMessage) {
-                    (*_onMessage)(*this, _senderEndpoint, _rxBuf, len);
+                    (*_onMessage)(*this, _senderEndpoint, _rxBuf.data(), len);
                 }
 
                 _read();
@@ -99,9 +235,12 @@ private:
     }
 
     static const std::size_t _RX_BUF_LEN = 2048;
+    static const std::size_t _HDR_BUF_LEN = 64;
+    PacketBufferPool _pool{_RX_BUF_LEN};
+    PacketBufferPool _hdrPool{_HDR_BUF_LEN};
     asio::ip::udp::socket _socket;
     asio::ip::udp::endpoint _senderEndpoint;
-    char _rxBuf[_RX_BUF_LEN] = {};
+    PacketBufferPool::Ref _rxBuf;
 };
 
 #endif
@@ -0,0 +1,620 @@
+
+#ifndef P4SFU_URING_UDP_SERVER_H
+#define P4SFU_URING_UDP_SERVER_H
+
+#include <boost/asio.hpp>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "udp_server.h"
+
+using namespace boost;
+
+//! UDP server built on io_uring:
+//! - a single multishot recvmsg keeps receiving into a provided buffer ring without re-arming
+//! - datagrams are sent with SEND from per-slot transmit buffers, or with SEND_ZC from the same
+//!   buffers registered as fixed buffers if zero copy is enabled
+//!   (SEND_ZC only pays off for large datagrams on NICs that support it: on loopback and for
+//!   RTP-sized datagrams it falls back to copying and adds a notification completion per send)
+//! - completions are signalled through an eventfd that is polled by the asio io_context, all
+//!   completions available on a wakeup are handled as one batch (see UDPInterface::onBatch)
+//! - queued sends are submitted with a single io_uring_enter() per batch
+class UringUDPServer : public UDPInterface {
+
+public:
+
+    struct Statistics {
+        unsigned long rxWakeups = 0;
+        unsigned long rxPkts    = 0;
+        unsigned long rxRearms  = 0;
+        unsigned long rxNoBufs  = 0;
+        unsigned long txSubmits = 0;
+        unsigned long txPkts    = 0;
+        unsigned long txErrors  = 0;
+    };
+
+    //! @param ringDepth number of submission queue entries, receive buffers and transmit buffers;
+    //!                  must be a power of two
+    //! @param zeroCopy sends with SEND_ZC instead of SEND
+    UringUDPServer(asio::io_context& io, unsigned short port, unsigned ringDepth = 256,
+                   bool reusePort = false, bool zeroCopy = false)
+        : _socket(_bind(io, port, reusePort)),
+          _eventFd(io),
+          _depth(ringDepth),
+          _zeroCopy(zeroCopy),
+          _rxBufs(ringDepth * _BUF_LEN),
+          _txBufs(ringDepth * _BUF_LEN),
+          _txAddrs(ringDepth) {
+
+        if (ringDepth == 0 || (ringDepth & (ringDepth - 1)) != 0 || ringDepth > 32768) {
+            throw std::invalid_argument("UringUDPServer: ringDepth must be a power of two");
+        }
+
+        for (unsigned i = 0; i < _depth; i++) {
+            _txFree.push_back(_depth - 1 - i);
+        }
+
+        try {
+            _setupRing();
+            _setupBuffers();
+            _setupEventFd();
+        } catch (...) {
+            _teardown();
+            throw;
+        }
+
+        _rxDatagrams.reserve(_depth);
+        _armRecv();
+        flush();
+        _wait();
+    }
+
+    UringUDPServer(const UringUDPServer&) = delete;
+    UringUDPServer& operator=(const UringUDPServer&) = delete;
+
+    ~UringUDPServer() {
+        _teardown();
+    }
+
+    //! copies the datagram into a transmit buffer and queues a send; queued sends are submitted
+    //! when the current batch has been handled, or immediately outside a batch
+    void sendTo(const asio::ip::udp::endpoint& to, const char* buf, std::size_t len) override {
+
+        _send(to, nullptr, 0, buf, len);
+    }
+
+    //! header and payload are copied into one transmit buffer, SEND_ZC takes a single fixed
+    //! buffer
+    void sendToGather(const asio::ip::udp::endpoint& to, const char* hdr, std::size_t hdrLen,
+                      const char* payload, std::size_t payloadLen) override {
+
+        _send(to, hdr, hdrLen, payload, payloadLen);
+    }
+
+    //! submits all queued operations with a single io_uring_enter()
+    void flush() override {
+
+        while (_toSubmit > 0) {
+
+            int res = _enter(_toSubmit, 0, 0);
+
+            if (res < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                    _reap(); // completion queue is backed up, make room and retry
+                    continue;
+                }
+                throw std::runtime_error("UringUDPServer: flush() failed: " + std::to_string(errno));
+            }
+
+            _toSubmit -= res;
+            _stats.txSubmits++;
+        }
+    }
+
+    [[nodiscard]] const Statistics& statistics() const {
+        return _stats;
+    }
+
+    [[nodiscard]] asio::ip::udp::socket& socket() {
+        return _socket;
+    }
+
+private:
+
+    void _send(const asio::ip::udp::endpoint& to, const char* hdr, std::size_t hdrLen,
+               const char* payload, std::size_t payloadLen) {
+
+        auto len = hdrLen + payloadLen;
+
+        if (len > _BUF_LEN) {
+            throw std::invalid_argument("UringUDPServer: sendTo(): datagram too large");
+        }
+
+        if (_txFree.empty()) {
+            _waitForTxBuffer();
+        }
+
+        unsigned slot = _txFree.back();
+        _txFree.pop_back();
+
+        if (hdrLen > 0) {
+            std::memcpy(_txBufs.data() + slot * _BUF_LEN, hdr, hdrLen);
+        }
+
+        std::memcpy(_txBufs.data() + slot * _BUF_LEN + hdrLen, payload, payloadLen);
+        std::memcpy(&_txAddrs[slot], to.data(), sizeof(sockaddr_in));
+
+        auto* sqe = _sqe();
+        sqe->fd = _socket.native_handle();
+        sqe->addr = (std::uint64_t) (_txBufs.data() + slot * _BUF_LEN);
+        sqe->len = len;
+
+        if (_zeroCopy) {
+            sqe->opcode = IORING_OP_SEND_ZC;
+            sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+            sqe->buf_index = slot;
+        } else {
+            sqe->opcode = IORING_OP_SEND;
+        }
+
+        sqe->addr2 = (std::uint64_t) &_txAddrs[slot];
+        sqe->addr_len = sizeof(sockaddr_in);
+        sqe->user_data = _TX_TAG | slot;
+
+        if (!_inBatch) {
+            flush();
+        }
+    }
+
+    struct Completion {
+        std::uint64_t userData;
+        std::int32_t res;
+        std::uint32_t flags;
+    };
+
+    static int _enter(unsigned toSubmit, unsigned minComplete, unsigned flags, int fd) {
+        return (int) ::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+    }
+
+    int _enter(unsigned toSubmit, unsigned minComplete, unsigned flags) const {
+        return _enter(toSubmit, minComplete, flags, _ringFd);
+    }
+
+    template <typename T>
+    static T* _at(void* base, std::uint32_t off) {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + off);
+    }
+
+    void _setupRing() {
+
+        io_uring_params p = {};
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = _depth * 4; // multishot receives and send notifications share the CQ
+
+        _ringFd = (int) ::syscall(__NR_io_uring_setup, _depth, &p);
+
+        if (_ringFd < 0) {
+            throw std::runtime_error("UringUDPServer: io_uring_setup() failed: "
+                + std::to_string(errno));
+        }
+
+        if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+            throw std::runtime_error("UringUDPServer: kernel io_uring features missing");
+        }
+
+        _ringLen = std::max(p.sq_off.array + p.sq_entries * sizeof(std::uint32_t),
+                            p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe));
+
+        _ring = ::mmap(nullptr, _ringLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       _ringFd, IORING_OFF_SQ_RING);
+
+        if (_ring == MAP_FAILED) {
+            _ring = nullptr;
+            throw std::runtime_error("UringUDPServer: mmap() of rings failed: "
+                + std::to_string(errno));
+        }
+
+        _sqesLen = p.sq_entries * sizeof(io_uring_sqe);
+        _sqes = (io_uring_sqe*) ::mmap(nullptr, _sqesLen, PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES);
+
+        if (_sqes == MAP_FAILED) {
+            _sqes = nullptr;
+            throw std::runtime_error("UringUDPServer: mmap() of sqes failed: "
+                + std::to_string(errno));
+        }
+
+        _sqHead = _at<std::uint32_t>(_ring, p.sq_off.head);
+        _sqTail = _at<std::uint32_t>(_ring, p.sq_off.tail);
+        _sqMask = *_at<std::uint32_t>(_ring, p.sq_off.ring_mask);
+        _sqEntries = p.sq_entries;
+        _sqArray = _at<std::uint32_t>(_ring, p.sq_off.array);
+        _cqHead = _at<std::uint32_t>(_ring, p.cq_off.head);
+        _cqTail = _at<std::uint32_t>(_ring, p.cq_off.tail);
+        _cqMask = *_at<std::uint32_t>(_ring, p.cq_off.ring_mask);
+        _cqes = _at<io_uring_cqe>(_ring, p.cq_off.cqes);
+    }
+
+    void _setupBuffers() {
+
+        // provided buffer ring for the multishot receive:
+        _bufRingLen = _depth * sizeof(io_uring_buf);
+        _bufRing = (io_uring_buf_ring*) ::mmap(nullptr, _bufRingLen, PROT_READ | PROT_WRITE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (_bufRing == MAP_FAILED) {
+            _bufRing = nullptr;
+            throw std::runtime_error("UringUDPServer: mmap() of buffer ring failed: "
+                + std::to_string(errno));
+        }
+
+        io_uring_buf_reg reg = {};
+        reg.ring_addr = (std::uint64_t) _bufRing;
+        reg.ring_entries = _depth;
+        reg.bgid = _BUF_GROUP;
+
+        if (::syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            throw std::runtime_error("UringUDPServer: registering buffer ring failed: "
+                + std::to_string(errno));
+        }
+
+        for (unsigned i = 0; i < _depth; i++) {
+            _provideBuffer(i, i);
+        }
+
+        _publishBuffers(_depth);
+
+        if (!_zeroCopy) {
+            return;
+        }
+
+        // registered buffers for transmission, one per slot:
+        std::vector<iovec> iov(_depth);
+
+        for (unsigned i = 0; i < _depth; i++) {
+            iov[i].iov_base = _txBufs.data() + i * _BUF_LEN;
+            iov[i].iov_len = _BUF_LEN;
+        }
+
+        if (::syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_BUFFERS, iov.data(),
+                      _depth) < 0) {
+            throw std::runtime_error("UringUDPServer: registering buffers failed: "
+                + std::to_string(errno));
+        }
+    }
+
+    void _setupEventFd() {
+
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (fd < 0) {
+            throw std::runtime_error("UringUDPServer: eventfd() failed: " + std::to_string(errno));
+        }
+
+        _eventFd.assign(fd);
+
+        if (::syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_EVENTFD, &fd, 1) < 0) {
+            throw std::runtime_error("UringUDPServer: registering eventfd failed: "
+                + std::to_string(errno));
+        }
+    }
+
+    void _teardown() {
+
+        if (_ring && _sqes) {
+
+            // wait for the kernel to release transmit buffers still in flight
+            try {
+                flush();
+
+                for (int i = 0; i < 100 && _txFree.size() < _depth; i++) {
+                    _enter(0, 1, IORING_ENTER_GETEVENTS);
+                    _reap();
+                }
+            } catch (std::exception&) { }
+        }
+
+        system::error_code ec;
+        _eventFd.close(ec);
+
+        if (_sqes) {
+            ::munmap(_sqes, _sqesLen);
+            _sqes = nullptr;
+        }
+
+        if (_ring) {
+            ::munmap(_ring, _ringLen);
+            _ring = nullptr;
+        }
+
+        if (_ringFd >= 0) {
+            ::close(_ringFd);
+            _ringFd = -1;
+        }
+
+        if (_bufRing) {
+            ::munmap(_bufRing, _bufRingLen);
+            _bufRing = nullptr;
+        }
+    }
+
+    //! returns the next free submission queue entry, submitting queued entries if the SQ is full
+    io_uring_sqe* _sqe() {
+
+        auto tail = *_sqTail;
+
+        if (tail - std::atomic_ref<std::uint32_t>(*_sqHead).load(std::memory_order_acquire)
+            >= _sqEntries) {
+
+            flush();
+        }
+
+        auto idx = tail & _sqMask;
+        auto* sqe = &_sqes[idx];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        _sqArray[idx] = idx;
+
+        std::atomic_ref<std::uint32_t>(*_sqTail).store(tail + 1, std::memory_order_release);
+        _toSubmit++;
+
+        return sqe;
+    }
+
+    void _armRecv() {
+
+        std::memset(&_rxMsg, 0, sizeof(_rxMsg));
+        _rxMsg.msg_namelen = sizeof(sockaddr_in);
+
+        auto* sqe = _sqe();
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = _socket.native_handle();
+        sqe->addr = (std::uint64_t) &_rxMsg;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = _BUF_GROUP;
+        sqe->user_data = _RX_TAG;
+    }
+
+    void _provideBuffer(std::uint16_t bid, unsigned offset) {
+
+        // entries are addressed directly: in C++ the flexible array member of io_uring_buf_ring
+        // is not at offset 0 (its empty wrapper struct has a size of 1)
+        auto& b = reinterpret_cast<io_uring_buf*>(_bufRing)[(_bufRingTail + offset) & (_depth - 1)];
+        b.addr = (std::uint64_t) (_rxBufs.data() + bid * _BUF_LEN);
+        b.len = _BUF_LEN;
+        b.bid = bid;
+    }
+
+    void _publishBuffers(unsigned n) {
+
+        _bufRingTail += n;
+        std::atomic_ref<std::uint16_t>(_bufRing->tail).store(_bufRingTail,
+                                                              std::memory_order_release);
+    }
+
+    //! moves all available completions off the CQ: send completions release their transmit
+    //! buffer, receive completions are queued for delivery
+    void _reap() {
+
+        auto head = *_cqHead;
+        auto tail = std::atomic_ref<std::uint32_t>(*_cqTail).load(std::memory_order_acquire);
+
+        for (; head != tail; head++) {
+
+            const auto& cqe = _cqes[head & _cqMask];
+
+            if (cqe.user_data & _TX_TAG) {
+                _onTxCompletion(cqe);
+            } else {
+                _rxCompletions.push_back(Completion{cqe.user_data, cqe.res, cqe.flags});
+            }
+        }
+
+        std::atomic_ref<std::uint32_t>(*_cqHead).store(head, std::memory_order_release);
+    }
+
+    void _onTxCompletion(const io_uring_cqe& cqe) {
+
+        auto slot = (unsigned) (cqe.user_data & ~_TX_TAG);
+
+        if (cqe.flags & IORING_CQE_F_NOTIF) { // buffer no longer referenced by the kernel
+            _txFree.push_back(slot);
+            return;
+        }
+
+        if (cqe.res < 0) {
+            _stats.txErrors++;
+        } else {
+            _stats.txPkts++;
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE)) { // no notification will follow
+            _txFree.push_back(slot);
+        }
+    }
+
+    void _waitForTxBuffer() {
+
+        flush();
+
+        while (_txFree.empty()) {
+
+            int res = _enter(0, 1, IORING_ENTER_GETEVENTS);
+
+            if (res < 0 && errno != EINTR) {
+                throw std::runtime_error("UringUDPServer: waiting for completions failed: "
+                    + std::to_string(errno));
+            }
+
+            _reap();
+        }
+    }
+
+    void _wait() {
+
+        _eventFd.async_wait(asio::posix::stream_descriptor::wait_read,
+            [this](system::error_code ec) {
+
+            if (ec) {
+                if (ec != asio::error::operation_aborted) {
+                    throw std::runtime_error("UringUDPServer: _wait() failed: "
+                        + std::to_string(ec.value()));
+                }
+                return;
+            }
+
+            std::uint64_t count;
+            [[maybe_unused]] auto n = ::read(_eventFd.native_handle(), &count, sizeof(count));
+
+            _stats.rxWakeups++;
+            _reap();
+
+            while (!_rxCompletions.empty()) {
+                _deliver();
+                _reap(); // pick up completions posted while handling the batch
+            }
+
+            flush();
+            _wait();
+        });
+    }
+
+    void _deliver() {
+
+        std::swap(_rxCompletions, _delivering);
+        _rxDatagrams.clear();
+
+        unsigned recycled = 0;
+        bool rearm = false;
+
+        for (const auto& c: _delivering) {
+
+            if (!(c.flags & IORING_CQE_F_MORE)) {
+                rearm = true;
+            }
+
+            if (c.res < 0) {
+                if (c.res == -ENOBUFS) {
+                    _stats.rxNoBufs++; // all buffers were in use, rearmed below
+                } else if (c.res != -ECANCELED) {
+                    throw std::runtime_error("UringUDPServer: receive failed: "
+                        + std::to_string(-c.res));
+                }
+                continue;
+            }
+
+            if (!(c.flags & IORING_CQE_F_BUFFER)) {
+                continue;
+            }
+
+            auto bid = (std::uint16_t) (c.flags >> IORING_CQE_BUFFER_SHIFT);
+            auto* buf = _rxBufs.data() + bid * _BUF_LEN;
+            auto* out = reinterpret_cast<io_uring_recvmsg_out*>(buf);
+
+            // payload follows the header, the (fixed size) name and the (empty) control data
+            std::size_t off = sizeof(io_uring_recvmsg_out) + _rxMsg.msg_namelen
+                + _rxMsg.msg_controllen;
+
+            if (!(out->flags & MSG_TRUNC) && out->namelen <= sizeof(sockaddr_in)
+                && off + out->payloadlen <= _BUF_LEN) {
+
+                auto& d = _rxDatagrams.emplace_back();
+                std::memcpy(d.from.data(), buf + sizeof(io_uring_recvmsg_out), sizeof(sockaddr_in));
+                d.from.resize(sizeof(sockaddr_in));
+                d.buf = buf + off;
+                d.len = out->payloadlen;
+            }
+
+            _provideBuffer(bid, recycled++);
+        }
+
+        _stats.rxPkts += _rxDatagrams.size();
+
+        if (!_rxDatagrams.empty()) {
+
+            _inBatch = true;
+
+            try {
+                if (_onBatch) {
+                    (*_onBatch)(*this, _rxDatagrams.data(), _rxDatagrams.size());
+                } else if (_onMessage) {
+                    for (auto& d: _rxDatagrams) {
+                        (*_onMessage)(*this, d.from, d.buf, d.len);
+                    }
+                }
+            } catch (...) {
+                _inBatch = false;
+                _publishBuffers(recycled);
+                _delivering.clear();
+                throw;
+            }
+
+            _inBatch = false;
+        }
+
+        // buffers are handed back only after the handler is done with them
+        _publishBuffers(recycled);
+        _delivering.clear();
+
+        if (rearm) {
+            _stats.rxRearms++;
+            _armRecv();
+        }
+
+        flush();
+    }
+
+    static const std::size_t _BUF_LEN = 2048;
+    static const std::uint16_t _BUF_GROUP = 0;
+    static const std::uint64_t _RX_TAG = 1;
+    static const std::uint64_t _TX_TAG = 1ull << 63;
+
+    asio::ip::udp::socket _socket;
+    asio::posix::stream_descriptor _eventFd;
+    unsigned _depth;
+    bool _zeroCopy;
+
+    int _ringFd = -1;
+    void* _ring = nullptr;
+    std::size_t _ringLen = 0;
+    io_uring_sqe* _sqes = nullptr;
+    std::size_t _sqesLen = 0;
+    std::uint32_t* _sqHead = nullptr;
+    std::uint32_t* _sqTail = nullptr;
+    std::uint32_t* _sqArray = nullptr;
+    std::uint32_t _sqMask = 0;
+    std::uint32_t _sqEntries = 0;
+    std::uint32_t* _cqHead = nullptr;
+    std::uint32_t* _cqTail = nullptr;
+    std::uint32_t _cqMask = 0;
+    io_uring_cqe* _cqes = nullptr;
+    unsigned _toSubmit = 0;
+
+    io_uring_buf_ring* _bufRing = nullptr;
+    std::size_t _bufRingLen = 0;
+    std::uint16_t _bufRingTail = 0;
+
+    msghdr _rxMsg = {};
+    std::vector<char> _rxBufs;
+    std::vector<Completion> _rxCompletions;
+    std::vector<Completion> _delivering;
+    std::vector<Datagram> _rxDatagrams;
+
+    std::vector<char> _txBufs;
+    std::vector<sockaddr_in> _txAddrs;
+    std::vector<unsigned> _txFree;
+
+    bool _inBatch = false;
+    Statistics _stats;
+};
+
+#endif
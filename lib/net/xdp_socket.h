@@ -0,0 +1,554 @@
+
+#ifndef P4SFU_XDP_SOCKET_H
+#define P4SFU_XDP_SOCKET_H
+
+#include <boost/asio.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "net.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+using namespace boost;
+
+//! AF_XDP socket bound to a single queue of a network interface
+//! - frames live in a UMEM area shared with the kernel, the first half of its frames is used for
+//!   reception (fill/RX rings), the second half for transmission (TX/completion rings)
+//! - an XDP program redirects IPv4/UDP datagrams for the given destination port to the socket,
+//!   all other traffic (ARP, ICMP, ...) is passed to the kernel
+//! - readiness is signalled through the asio io_context, all frames available on a wakeup are
+//!   handed to the frame handler as one batch
+class XDPSocket {
+
+public:
+
+    //! a received frame, valid until the frame handler returns
+    struct Frame {
+        unsigned char* buf;
+        std::size_t len;
+    };
+
+    struct Statistics {
+        unsigned long rxBatches = 0;
+        unsigned long rxFrames  = 0;
+        unsigned long txFrames  = 0;
+        unsigned long txKicks   = 0;
+        unsigned long txNoFrame = 0;
+    };
+
+    typedef std::function<void (XDPSocket&, Frame*, std::size_t)> OnFramesHandler;
+
+    static const std::size_t FRAME_SIZE = 2048;
+
+    //! @param numFrames number of UMEM frames, must be a power of two
+    XDPSocket(asio::io_context& io, const std::string& iface, unsigned queueId,
+              std::uint16_t udpPort, unsigned numFrames = 4096)
+        : _stream(io),
+          _iface(iface),
+          _queueId(queueId),
+          _numFrames(numFrames),
+          _ringSize(numFrames / 2) {
+
+        if (numFrames < 4 || (numFrames & (numFrames - 1)) != 0) {
+            throw std::invalid_argument("XDPSocket: numFrames must be a power of two");
+        }
+
+        _ifindex = if_nametoindex(iface.c_str());
+
+        if (_ifindex == 0) {
+            throw std::runtime_error("XDPSocket: unknown interface: " + iface);
+        }
+
+        try {
+            _setupSocket();
+            _loadProgram(udpPort);
+        } catch (...) {
+            _teardown();
+            throw;
+        }
+
+        _rxFrames.resize(_ringSize);
+        _rxAddrs.reserve(_ringSize);
+        _read();
+    }
+
+    XDPSocket(const XDPSocket&) = delete;
+    XDPSocket& operator=(const XDPSocket&) = delete;
+
+    ~XDPSocket() {
+        _teardown();
+    }
+
+    void onFrames(OnFramesHandler&& f) {
+        _onFrames = std::move(f);
+    }
+
+    //! returns a free UMEM frame for transmission, or nullptr if all are in flight
+    [[nodiscard]] unsigned char* txFrame() {
+
+        if (_txFree.empty()) {
+            _reclaim();
+        }
+
+        if (_txFree.empty()) {
+            flush();
+            _reclaim();
+        }
+
+        if (_txFree.empty()) {
+            _stats.txNoFrame++;
+            return nullptr;
+        }
+
+        auto addr = _txFree.back();
+        _txFree.pop_back();
+
+        return _umem + addr;
+    }
+
+    //! queues a frame previously obtained with txFrame(); the frame is sent when the current
+    //! batch has been handled, or immediately outside a batch
+    void send(unsigned char* frame, std::size_t len) {
+
+        auto prod = *_tx.producer;
+        auto& desc = reinterpret_cast<xdp_desc*>(_tx.descs)[prod & _tx.mask];
+        desc.addr = frame - _umem;
+        desc.len = len;
+        desc.options = 0;
+
+        std::atomic_ref<std::uint32_t>(*_tx.producer).store(prod + 1, std::memory_order_release);
+        _txPending++;
+        _stats.txFrames++;
+
+        if (!_inBatch || _txPending == _ringSize) {
+            flush();
+        }
+    }
+
+    //! asks the kernel to transmit all queued frames
+    void flush() {
+
+        if (_txPending == 0) {
+            return;
+        }
+
+        _txPending = 0;
+        _stats.txKicks++;
+
+        if (::sendto(_fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0) < 0
+            && errno != EAGAIN && errno != EBUSY && errno != ENOBUFS && errno != ENETDOWN) {
+
+            throw std::runtime_error("XDPSocket: flush() failed: " + std::to_string(errno));
+        }
+    }
+
+    [[nodiscard]] net::eth::addr mac() const {
+
+        net::eth::addr a;
+        ifreq ifr = {};
+        std::strncpy(ifr.ifr_name, _iface.c_str(), IFNAMSIZ - 1);
+
+        int s = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+        if (s >= 0 && ::ioctl(s, SIOCGIFHWADDR, &ifr) == 0) {
+            std::memcpy(a.bytes, ifr.ifr_hwaddr.sa_data, net::eth::ADDR_LEN);
+        }
+
+        if (s >= 0) {
+            ::close(s);
+        }
+
+        return a;
+    }
+
+    [[nodiscard]] int fd() const {
+        return _fd;
+    }
+
+    //! true if the driver runs the socket in zero-copy mode
+    [[nodiscard]] bool zeroCopy() const {
+        return _zeroCopy;
+    }
+
+    [[nodiscard]] const Statistics& statistics() const {
+        return _stats;
+    }
+
+private:
+
+    //! producer/consumer ring shared with the kernel
+    struct Ring {
+        void* map = nullptr;
+        std::size_t mapLen = 0;
+        std::uint32_t* producer = nullptr;
+        std::uint32_t* consumer = nullptr;
+        void* descs = nullptr;
+        std::uint32_t mask = 0;
+    };
+
+    static int _bpf(int cmd, bpf_attr& attr) {
+        return (int) ::syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+    }
+
+    void _mapRing(Ring& r, const xdp_ring_offset& off, std::size_t descSize, off_t pgoff) {
+
+        r.mapLen = off.desc + _ringSize * descSize;
+        r.map = ::mmap(nullptr, r.mapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                       pgoff);
+
+        if (r.map == MAP_FAILED) {
+            r.map = nullptr;
+            throw std::runtime_error("XDPSocket: mmap() of ring failed: " + std::to_string(errno));
+        }
+
+        r.producer = (std::uint32_t*) ((char*) r.map + off.producer);
+        r.consumer = (std::uint32_t*) ((char*) r.map + off.consumer);
+        r.descs = (char*) r.map + off.desc;
+        r.mask = _ringSize - 1;
+    }
+
+    void _setsockopt(int opt, const void* val, socklen_t len, const char* what) const {
+
+        if (::setsockopt(_fd, SOL_XDP, opt, val, len) < 0) {
+            throw std::runtime_error(std::string("XDPSocket: ") + what + " failed: "
+                + std::to_string(errno));
+        }
+    }
+
+    void _setupSocket() {
+
+        _fd = ::socket(AF_XDP, SOCK_RAW, 0);
+
+        if (_fd < 0) {
+            throw std::runtime_error("XDPSocket: socket() failed: " + std::to_string(errno));
+        }
+
+        _umemLen = _numFrames * FRAME_SIZE;
+        _umem = (unsigned char*) ::mmap(nullptr, _umemLen, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+
+        if (_umem == MAP_FAILED) {
+            _umem = nullptr;
+            throw std::runtime_error("XDPSocket: mmap() of umem failed: " + std::to_string(errno));
+        }
+
+        xdp_umem_reg reg = {};
+        reg.addr = (std::uint64_t) _umem;
+        reg.len = _umemLen;
+        reg.chunk_size = FRAME_SIZE;
+        reg.headroom = 0;
+        _setsockopt(XDP_UMEM_REG, &reg, sizeof(reg), "registering umem");
+
+        _setsockopt(XDP_UMEM_FILL_RING, &_ringSize, sizeof(_ringSize), "sizing fill ring");
+        _setsockopt(XDP_UMEM_COMPLETION_RING, &_ringSize, sizeof(_ringSize),
+                    "sizing completion ring");
+        _setsockopt(XDP_RX_RING, &_ringSize, sizeof(_ringSize), "sizing rx ring");
+        _setsockopt(XDP_TX_RING, &_ringSize, sizeof(_ringSize), "sizing tx ring");
+
+        xdp_mmap_offsets off = {};
+        socklen_t optlen = sizeof(off);
+
+        if (::getsockopt(_fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) {
+            throw std::runtime_error("XDPSocket: getsockopt() failed: " + std::to_string(errno));
+        }
+
+        _mapRing(_fill, off.fr, sizeof(std::uint64_t), XDP_UMEM_PGOFF_FILL_RING);
+        _mapRing(_comp, off.cr, sizeof(std::uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING);
+        _mapRing(_rx, off.rx, sizeof(xdp_desc), XDP_PGOFF_RX_RING);
+        _mapRing(_tx, off.tx, sizeof(xdp_desc), XDP_PGOFF_TX_RING);
+
+        // hand the receive half of the umem to the kernel:
+        for (std::uint32_t i = 0; i < _ringSize; i++) {
+            reinterpret_cast<std::uint64_t*>(_fill.descs)[i] = i * FRAME_SIZE;
+        }
+
+        std::atomic_ref<std::uint32_t>(*_fill.producer).store(_ringSize,
+                                                              std::memory_order_release);
+
+        for (std::uint32_t i = _numFrames - 1; i >= _ringSize; i--) {
+            _txFree.push_back(i * FRAME_SIZE);
+        }
+
+        // zero-copy if the driver supports it, copy mode otherwise (e.g., veth)
+        sockaddr_xdp sxdp = {};
+        sxdp.sxdp_family = AF_XDP;
+        sxdp.sxdp_ifindex = _ifindex;
+        sxdp.sxdp_queue_id = _queueId;
+        sxdp.sxdp_flags = XDP_ZEROCOPY;
+
+        if (::bind(_fd, (sockaddr*) &sxdp, sizeof(sxdp)) < 0) {
+
+            sxdp.sxdp_flags = XDP_COPY;
+
+            if (::bind(_fd, (sockaddr*) &sxdp, sizeof(sxdp)) < 0) {
+                throw std::runtime_error("XDPSocket: bind() failed: " + std::to_string(errno));
+            }
+        }
+
+        _zeroCopy = (sxdp.sxdp_flags == XDP_ZEROCOPY);
+        _stream.assign(::dup(_fd));
+    }
+
+    void _loadProgram(std::uint16_t udpPort) {
+
+        // map from RX queue index to AF_XDP socket:
+        bpf_attr attr = {};
+        attr.map_type = BPF_MAP_TYPE_XSKMAP;
+        attr.key_size = sizeof(std::uint32_t);
+        attr.value_size = sizeof(std::uint32_t);
+        attr.max_entries = _queueId + 1;
+
+        _mapFd = _bpf(BPF_MAP_CREATE, attr);
+
+        if (_mapFd < 0) {
+            throw std::runtime_error("XDPSocket: creating xskmap failed: " + std::to_string(errno));
+        }
+
+        std::uint32_t key = _queueId, value = _fd;
+        attr = {};
+        attr.map_fd = _mapFd;
+        attr.key = (std::uint64_t) &key;
+        attr.value = (std::uint64_t) &value;
+
+        if (_bpf(BPF_MAP_UPDATE_ELEM, attr) < 0) {
+            throw std::runtime_error("XDPSocket: updating xskmap failed: " + std::to_string(errno));
+        }
+
+        // redirect IPv4 (without options) / UDP to udpPort, pass everything else:
+        const std::int16_t PASS = 20;
+        const std::int32_t XDP_PASS_ACTION = 2;
+
+        bpf_insn prog[] = {
+            _insn(BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0),             //  0: r6 = ctx
+            _insn(BPF_LDX | BPF_W | BPF_MEM, 2, 1, 0, 0),               //  1: r2 = data
+            _insn(BPF_LDX | BPF_W | BPF_MEM, 3, 1, 4, 0),               //  2: r3 = data_end
+            _insn(BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0),             //  3: r4 = data
+            _insn(BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, 42),            //  4: r4 += eth+ip+udp
+            _insn(BPF_JMP | BPF_JGT | BPF_X, 4, 3, PASS - 6, 0),        //  5: too short
+            _insn(BPF_LDX | BPF_H | BPF_MEM, 5, 2, 12, 0),              //  6: ether type
+            _insn(BPF_JMP | BPF_JNE | BPF_K, 5, 0, PASS - 8, htons(0x0800)),
+            _insn(BPF_LDX | BPF_B | BPF_MEM, 5, 2, 14, 0),              //  8: version, ihl
+            _insn(BPF_JMP | BPF_JNE | BPF_K, 5, 0, PASS - 10, 0x45),
+            _insn(BPF_LDX | BPF_B | BPF_MEM, 5, 2, 23, 0),              // 10: protocol
+            _insn(BPF_JMP | BPF_JNE | BPF_K, 5, 0, PASS - 12, 17),
+            _insn(BPF_LDX | BPF_H | BPF_MEM, 5, 2, 36, 0),              // 12: udp dst port
+            _insn(BPF_JMP | BPF_JNE | BPF_K, 5, 0, PASS - 14, htons(udpPort)),
+            _insn(BPF_LDX | BPF_W | BPF_MEM, 2, 6, 16, 0),              // 14: rx_queue_index
+            _insn(BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, _mapFd),
+            _insn(0, 0, 0, 0, 0),
+            _insn(BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS_ACTION), // 17: action on miss
+            _insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+            _insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+            _insn(BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS_ACTION), // 20: pass
+            _insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+        };
+
+        static_assert(sizeof(prog) / sizeof(prog[0]) == 22);
+
+        char license[] = "GPL";
+        std::vector<char> log(4096);
+
+        attr = {};
+        attr.prog_type = BPF_PROG_TYPE_XDP;
+        attr.insns = (std::uint64_t) prog;
+        attr.insn_cnt = sizeof(prog) / sizeof(prog[0]);
+        attr.license = (std::uint64_t) license;
+        attr.log_buf = (std::uint64_t) log.data();
+        attr.log_size = log.size();
+        attr.log_level = 1;
+
+        _progFd = _bpf(BPF_PROG_LOAD, attr);
+
+        if (_progFd < 0) {
+            throw std::runtime_error("XDPSocket: loading xdp program failed: "
+                + std::to_string(errno) + ": " + log.data());
+        }
+
+        // attached through a link, so it is detached when the link is closed
+        attr = {};
+        attr.link_create.prog_fd = _progFd;
+        attr.link_create.target_ifindex = _ifindex;
+        attr.link_create.attach_type = BPF_XDP;
+
+        _linkFd = _bpf(BPF_LINK_CREATE, attr);
+
+        if (_linkFd < 0) {
+            throw std::runtime_error("XDPSocket: attaching xdp program failed: "
+                + std::to_string(errno));
+        }
+    }
+
+    static bpf_insn _insn(std::uint8_t code, std::uint8_t dst, std::uint8_t src, std::int16_t off,
+                          std::int32_t imm) {
+        bpf_insn i = {};
+        i.code = code;
+        i.dst_reg = dst;
+        i.src_reg = src;
+        i.off = off;
+        i.imm = imm;
+        return i;
+    }
+
+    void _teardown() {
+
+        system::error_code ec;
+        _stream.close(ec);
+
+        for (int* fd: {&_linkFd, &_progFd, &_mapFd}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+
+        for (Ring* r: {&_fill, &_comp, &_rx, &_tx}) {
+            if (r->map) {
+                ::munmap(r->map, r->mapLen);
+                r->map = nullptr;
+            }
+        }
+
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+
+        if (_umem) {
+            ::munmap(_umem, _umemLen);
+            _umem = nullptr;
+        }
+    }
+
+    //! moves transmitted frames from the completion ring back to the free list
+    void _reclaim() {
+
+        auto cons = *_comp.consumer;
+        auto prod = std::atomic_ref<std::uint32_t>(*_comp.producer).load(std::memory_order_acquire);
+
+        for (; cons != prod; cons++) {
+            _txFree.push_back(reinterpret_cast<std::uint64_t*>(_comp.descs)[cons & _comp.mask]);
+        }
+
+        std::atomic_ref<std::uint32_t>(*_comp.consumer).store(cons, std::memory_order_release);
+    }
+
+    void _read() {
+
+        _stream.async_wait(asio::posix::stream_descriptor::wait_read,
+            [this](system::error_code ec) {
+
+            if (ec) {
+                if (ec != asio::error::operation_aborted) {
+                    throw std::runtime_error("XDPSocket: _read() failed: "
+                        + std::to_string(ec.value()));
+                }
+                return;
+            }
+
+            _drain();
+            _read();
+        });
+    }
+
+    void _drain() {
+
+        auto cons = *_rx.consumer;
+        auto prod = std::atomic_ref<std::uint32_t>(*_rx.producer).load(std::memory_order_acquire);
+        std::size_t n = prod - cons;
+
+        if (n == 0) {
+            return;
+        }
+
+        auto& addrs = _rxAddrs;
+        addrs.resize(n);
+
+        for (std::size_t i = 0; i < n; i++) {
+            const auto& desc = reinterpret_cast<xdp_desc*>(_rx.descs)[(cons + i) & _rx.mask];
+            addrs[i] = desc.addr - (desc.addr % FRAME_SIZE);
+            _rxFrames[i] = Frame{_umem + desc.addr, desc.len};
+        }
+
+        std::atomic_ref<std::uint32_t>(*_rx.consumer).store(prod, std::memory_order_release);
+
+        _stats.rxBatches++;
+        _stats.rxFrames += n;
+        _inBatch = true;
+
+        try {
+            if (_onFrames) {
+                (*_onFrames)(*this, _rxFrames.data(), n);
+            }
+        } catch (...) {
+            _inBatch = false;
+            _refill(addrs);
+            throw;
+        }
+
+        _inBatch = false;
+        _refill(addrs);
+        flush();
+    }
+
+    //! returns received frames to the fill ring
+    void _refill(const std::vector<std::uint64_t>& addrs) {
+
+        auto prod = *_fill.producer;
+
+        for (std::size_t i = 0; i < addrs.size(); i++) {
+            reinterpret_cast<std::uint64_t*>(_fill.descs)[(prod + i) & _fill.mask] = addrs[i];
+        }
+
+        std::atomic_ref<std::uint32_t>(*_fill.producer).store(prod + addrs.size(),
+                                                              std::memory_order_release);
+    }
+
+    asio::posix::stream_descriptor _stream;
+    std::string _iface;
+    unsigned _ifindex = 0;
+    unsigned _queueId;
+    std::uint32_t _numFrames;
+    std::uint32_t _ringSize;
+
+    int _fd = -1;
+    int _mapFd = -1;
+    int _progFd = -1;
+    int _linkFd = -1;
+    bool _zeroCopy = false;
+
+    unsigned char* _umem = nullptr;
+    std::size_t _umemLen = 0;
+    Ring _fill, _comp, _rx, _tx;
+
+    std::vector<Frame> _rxFrames;
+    std::vector<std::uint64_t> _rxAddrs;
+    std::vector<std::uint64_t> _txFree;
+    std::size_t _txPending = 0;
+
+    bool _inBatch = false;
+    std::optional<OnFramesHandler> _onFrames = std::nullopt;
+    Statistics _stats;
+};
+
+#endif
@@ -3,7 +3,9 @@
 #define P4SFU_RTCP_H
 
 #include <arpa/inet.h>
+#include <cstring>
 #include <iomanip>
+#include <iterator>
 
 namespace rtcp {
 
@@ -111,12 +113,12 @@ namespace rtcp {
 
             //! returns the numerator (0-255) of the fraction of packets lost
             [[nodiscard]] unsigned frac_lost() const {
-                return (frac_lost_cum_lost >> 24) & 0xff;
+                return (ntohl(frac_lost_cum_lost) >> 24) & 0xff;
             }
 
             //! returns the total number of packets lost
             [[nodiscard]] unsigned cum_lost() const {
-                return frac_lost_cum_lost & 0x00ffffff;
+                return ntohl(frac_lost_cum_lost) & 0x00ffffff;
             }
         };
 
@@ -154,12 +156,43 @@ namespace rtcp {
             std::uint16_t blp = 0;
         };
 
+        //! transport-wide congestion control feedback, the fixed fields are followed by packet
+        //! status chunks and receive deltas
+        //! https://datatracker.ietf.org/doc/html/draft-holmer-rmcat-transport-wide-cc-extensions-01
+        struct twcc {
+            //! ssrc of a media stream of the transport
+            std::uint32_t ssrc          = 0;
+            //! transport-wide sequence number of the first reported packet
+            std::uint16_t base_seq      = 0;
+            //! number of reported packets
+            std::uint16_t status_count  = 0;
+            //! arrival time of the first received packet in multiples of 64 ms, 24-bit signed
+            std::uint8_t ref_time[3]    = {0};
+            //! feedback packet count
+            std::uint8_t fb_pkt_count   = 0;
+
+            [[nodiscard]] std::int32_t reference_time() const {
+                auto t = (std::int32_t) ((ref_time[0] << 16) | (ref_time[1] << 8) | ref_time[2]);
+                return t & 0x800000 ? t - 0x1000000 : t;
+            }
+        };
+
         //! picture loss indication
         struct pli {
             //! ssrc of stream with lost picture
             std::uint32_t ssrc = 0;
         };
 
+        //! full intra request, with a single FCI entry
+        struct fir { // https://datatracker.ietf.org/doc/html/rfc5104#section-4.3.1
+            //! always 0
+            std::uint32_t source_ssrc = 0;
+            //! ssrc of stream a keyframe is requested for
+            std::uint32_t ssrc        = 0;
+            //! command sequence number, followed by 3 reserved bytes
+            std::uint8_t seq          = 0;
+        };
+
         union {
             //! sender report
             struct sr   sr;
@@ -169,11 +202,172 @@ namespace rtcp {
             struct remb remb;
             //! negative acknowledgement
             struct nack nack;
+            //! transport-wide congestion control feedback
+            struct twcc twcc;
             //! picture loss indication
             struct pli pli;
+            //! full intra request
+            struct fir fir;
         } data;
+
+        //! returns true for a REMB, i.e., a PSFB with FMT 15 and the "REMB" identifier
+        [[nodiscard]] bool is_remb() const {
+            return static_cast<rtcp::pt>(pt) == rtcp::pt::psfb && fb_fmt() == 15
+                && byte_len() >= HDR_LEN + 12 && ntohl(data.remb.remb) == 0x52454d42;
+        }
+
+        //! returns true if the packet's length covers the fields its type, count and FMT
+        //! announce, only then may they be read
+        [[nodiscard]] bool complete() const {
+
+            auto n = byte_len();
+
+            switch (static_cast<rtcp::pt>(pt)) {
+                case rtcp::pt::sr:
+                    return n >= HDR_LEN + sizeof(struct sr) + recep_rep_count() * sizeof(struct rr);
+                case rtcp::pt::rr:
+                    return n >= HDR_LEN + recep_rep_count() * sizeof(struct rr);
+                case rtcp::pt::rtpfb:
+                    switch (fb_fmt()) {
+                        case 1:  return n >= HDR_LEN + sizeof(struct nack);
+                        case 15: return n >= HDR_LEN + sizeof(struct twcc);
+                        default: return true;
+                    }
+                case rtcp::pt::psfb:
+                    switch (fb_fmt()) {
+                        case 1:  return n >= HDR_LEN + sizeof(struct pli);
+                        case 4:  return n >= HDR_LEN + sizeof(struct fir);
+                        case 15:
+                            return !is_remb() || n >= HDR_LEN + 12 + 4 * data.remb.num_ssrcs();
+                        default: return true;
+                    }
+                default:
+                    return true;
+            }
+        }
     };
 
+    //! the packets of a compound RTCP packet, iterated without copying
+    //! - bounds-checked: iteration ends before a packet that is shorter than the common header or
+    //!   extends beyond the buffer, truncated() tells if that happened
+    //! - the fields behind the common header may only be read if hdr::complete()
+    class compound {
+    public:
+
+        class iterator {
+        public:
+
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = hdr;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const hdr*;
+            using reference         = const hdr&;
+
+            iterator() = default;
+
+            iterator(const unsigned char* buf, std::size_t len, std::size_t off)
+                : _buf(buf), _len(len), _off(off) {
+                _check();
+            }
+
+            reference operator*() const {
+                return *reinterpret_cast<const hdr*>(_buf + _off);
+            }
+
+            pointer operator->() const {
+                return reinterpret_cast<const hdr*>(_buf + _off);
+            }
+
+            iterator& operator++() {
+                _off += (*this)->byte_len();
+                _check();
+                return *this;
+            }
+
+            iterator operator++(int) {
+                auto it = *this;
+                ++(*this);
+                return it;
+            }
+
+            bool operator==(const iterator& other) const {
+                return _off == other._off;
+            }
+
+            //! offset of the packet in the compound packet
+            [[nodiscard]] std::size_t offset() const {
+                return _off;
+            }
+
+        private:
+
+            void _check() {
+                if (_off + HDR_LEN > _len || (*this)->byte_len() < HDR_LEN
+                    || _off + (*this)->byte_len() > _len) {
+                    _off = _len;
+                }
+            }
+
+            const unsigned char* _buf = nullptr;
+            std::size_t _len          = 0;
+            std::size_t _off          = 0;
+        };
+
+        compound(const unsigned char* buf, std::size_t len) : _buf(buf), _len(len) { }
+
+        [[nodiscard]] iterator begin() const {
+            return iterator{_buf, _len, 0};
+        }
+
+        [[nodiscard]] iterator end() const {
+            return iterator{_buf, _len, _len};
+        }
+
+        //! returns true if the packets don't cover the buffer exactly
+        [[nodiscard]] bool truncated() const {
+
+            std::size_t off = 0;
+
+            for (auto it = begin(); it != end(); ++it) {
+                off = it.offset() + it->byte_len();
+            }
+
+            return off != _len;
+        }
+
+    private:
+        const unsigned char* _buf;
+        std::size_t _len;
+    };
+
+    //! length of a REMB for a single SSRC
+    static const unsigned REMB_LEN = 24;
+
+    //! writes a REMB for a single media SSRC to buf, which must hold REMB_LEN bytes
+    static void write_remb(unsigned char* buf, std::uint32_t sender_ssrc, std::uint32_t ssrc,
+                           unsigned bit_rate) {
+
+        // 18-bit mantissa, 6-bit exponent
+        std::uint32_t exp = 0;
+
+        while ((bit_rate >> exp) > 0b11'1111'1111'1111'1111) {
+            exp++;
+        }
+
+        const std::uint32_t words[REMB_LEN / 4] = {
+            // version 2, FMT 15, PSFB, length in 32-bit words minus one
+            htonl((0x80u | 15) << 24 | static_cast<std::uint32_t>(pt::psfb) << 16
+                  | (REMB_LEN / 4 - 1)),
+            htonl(sender_ssrc),
+            0, // source SSRC, always 0
+            htonl(0x52454d42), // "REMB"
+            htonl(1u << 24 | exp << 18 | (bit_rate >> exp)),
+            htonl(ssrc)
+        };
+
+        std::memcpy(buf, words, REMB_LEN);
+    }
+
     static std::ostream &operator<<(std::ostream &os, const rtcp::hdr &rtcp) {
         os << "rtcp: v="        << std::dec << rtcp.version()
            << ",p="             << std::dec << rtcp.padding()
@@ -0,0 +1,153 @@
+
+#ifndef P4SFU_RCU_H
+#define P4SFU_RCU_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace p4sfu {
+
+    //! read-copy-update cell holding an immutable version of T
+    //! - readers never block: read() pins the current version for the lifetime of the returned
+    //!   guard at the cost of two atomic increments
+    //! - update() copies the current version, applies the modification to the copy and publishes
+    //!   it with a single pointer swap, concurrent updates are serialized
+    //! - replaced versions are reclaimed epoch-based: a version retired in epoch e is deleted
+    //!   once all readers that entered in epoch e or earlier have left, checked on each update()
+    //!   and on reclaim()
+    template <typename T>
+    class RCU {
+    public:
+
+        //! read-side critical section, pins a version until destroyed
+        class ReadGuard {
+        public:
+
+            ReadGuard(const ReadGuard&) = delete;
+            ReadGuard& operator=(const ReadGuard&) = delete;
+
+            ~ReadGuard() {
+                _readers.fetch_sub(1, std::memory_order_release);
+            }
+
+            [[nodiscard]] const T* get() const {
+                return _version;
+            }
+
+            const T* operator->() const {
+                return _version;
+            }
+
+            const T& operator*() const {
+                return *_version;
+            }
+
+        private:
+
+            friend class RCU;
+
+            ReadGuard(std::atomic<std::uint64_t>& readers, const T* version)
+                : _readers(readers), _version(version) { }
+
+            std::atomic<std::uint64_t>& _readers;
+            const T* _version;
+        };
+
+        explicit RCU(T initial = T{}) : _current(new T(std::move(initial))) { }
+
+        RCU(const RCU&) = delete;
+        RCU& operator=(const RCU&) = delete;
+
+        ~RCU() {
+            delete _current.load();
+            for (auto& r: _retired) {
+                delete r.version;
+            }
+        }
+
+        [[nodiscard]] ReadGuard read() const {
+
+            for (;;) {
+                auto e = _epoch.load();
+                auto& readers = _readers[e & 1u];
+                readers.fetch_add(1);
+
+                // the epoch may have advanced before the reader was counted, retry in the new one
+                if (_epoch.load() == e) {
+                    return ReadGuard{readers, _current.load()};
+                }
+
+                readers.fetch_sub(1);
+            }
+        }
+
+        //! publishes a modified copy of the current version, f is called as f(T&)
+        template <typename F>
+        void update(F&& f) {
+
+            std::lock_guard lock{_writeMutex};
+
+            auto next = std::make_unique<T>(*_current.load());
+            f(*next);
+
+            auto* old = _current.exchange(next.release());
+            _retired.push_back(Retired{old, _epoch.load()});
+            _reclaim();
+        }
+
+        //! deletes retired versions no reader can still see, advances the epoch if possible
+        void reclaim() {
+
+            std::lock_guard lock{_writeMutex};
+            _reclaim();
+        }
+
+        //! number of versions waiting for reclamation
+        [[nodiscard]] std::size_t retired() const {
+
+            std::lock_guard lock{_writeMutex};
+            return _retired.size();
+        }
+
+    private:
+
+        struct Retired {
+            const T* version;
+            std::uint64_t epoch;
+        };
+
+        void _reclaim() {
+
+            auto e = _epoch.load();
+
+            // readers of the previous epoch are still active, nothing can be reclaimed yet
+            if (_readers[(e + 1) & 1u].load() != 0) {
+                return;
+            }
+
+            // only readers of the current epoch remain, they entered after versions retired in
+            // earlier epochs were replaced
+            std::erase_if(_retired, [e](const Retired& r) {
+                if (r.epoch < e) {
+                    delete r.version;
+                    return true;
+                }
+                return false;
+            });
+
+            _epoch.store(e + 1);
+        }
+
+        std::atomic<const T*> _current;
+        std::atomic<std::uint64_t> _epoch = 0;
+        mutable std::atomic<std::uint64_t> _readers[2] = {0, 0};
+        mutable std::mutex _writeMutex;
+        std::vector<Retired> _retired;
+    };
+}
+
+#endif
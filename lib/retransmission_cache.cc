@@ -0,0 +1,76 @@
+
+#include "retransmission_cache.h"
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+p4sfu::RetransmissionCache::RetransmissionCache(const Config& c)
+    : _config(c) {
+
+    if (_config.packets == 0 || _config.packets > 65536) {
+        throw std::invalid_argument("RetransmissionCache: packets must be in [1, 65536]");
+    }
+
+    auto capacity = std::bit_ceil(_config.packets);
+    _mask = capacity - 1;
+    _slots.resize(capacity);
+    _data.resize(capacity * MAX_PACKET_LEN);
+}
+
+void p4sfu::RetransmissionCache::insert(std::uint16_t seq, const unsigned char* buf,
+                                        std::size_t len, Clock::time_point now) {
+
+    auto& s = _slots[seq & _mask];
+
+    if (len > MAX_PACKET_LEN) {
+        s.len = 0; // don't serve an older packet for this slot
+        return;
+    }
+
+    std::memcpy(_data.data() + (seq & _mask) * MAX_PACKET_LEN, buf, len);
+    s.stored = now;
+    s.seq = seq;
+    s.len = (std::uint16_t) len;
+}
+
+std::optional<p4sfu::RetransmissionCache::Packet>
+p4sfu::RetransmissionCache::find(std::uint16_t seq, Clock::time_point now) const {
+
+    const auto& s = _slots[seq & _mask];
+
+    if (s.len == 0 || s.seq != seq || now - s.stored > _config.maxAge) {
+        return std::nullopt;
+    }
+
+    return Packet{_data.data() + (seq & _mask) * MAX_PACKET_LEN, s.len};
+}
+
+std::size_t p4sfu::RetransmissionCache::capacity() const {
+
+    return _slots.size();
+}
+
+void p4sfu::SequenceHistory::record(std::uint16_t seq, std::uint16_t origSeq) {
+
+    if (!_items) {
+        _items = std::make_unique<std::array<Item, SIZE>>();
+    }
+
+    (*_items)[seq % SIZE] = Item{seq, origSeq, true};
+}
+
+std::optional<std::uint16_t> p4sfu::SequenceHistory::original(std::uint16_t seq) const {
+
+    if (!_items) {
+        return std::nullopt;
+    }
+
+    const auto& i = (*_items)[seq % SIZE];
+
+    if (!i.valid || i.seq != seq) {
+        return std::nullopt;
+    }
+
+    return i.origSeq;
+}
@@ -0,0 +1,93 @@
+
+#ifndef P4SFU_RETRANSMISSION_CACHE_H
+#define P4SFU_RETRANSMISSION_CACHE_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "switch_statistics.h"
+
+namespace p4sfu {
+
+    //! ring buffer of the recently forwarded RTP packets of a send stream, indexed by their
+    //! original sequence number, used to answer NACKs without a round trip to the sender
+    //! - a slot holds the latest packet whose sequence number maps to it (seq mod capacity)
+    //! - packets older than maxAge or larger than MAX_PACKET_LEN are not served
+    //! - single writer (the thread forwarding the stream), counters are readable from any thread
+    class RetransmissionCache {
+    public:
+
+        using Clock = std::chrono::steady_clock;
+
+        struct Config {
+            //! number of packets kept, rounded up to a power of two
+            std::size_t packets = 512;
+            //! packets older than this are not retransmitted
+            Clock::duration maxAge = std::chrono::milliseconds(1000);
+        };
+
+        struct Packet {
+            const unsigned char* buf;
+            std::size_t len;
+        };
+
+        static constexpr std::size_t MAX_PACKET_LEN = 1500;
+
+        explicit RetransmissionCache(const Config& c);
+
+        void insert(std::uint16_t seq, const unsigned char* buf, std::size_t len,
+                    Clock::time_point now);
+
+        //! returns the packet with sequence number seq if it is still cached
+        [[nodiscard]] std::optional<Packet> find(std::uint16_t seq, Clock::time_point now) const;
+
+        [[nodiscard]] std::size_t capacity() const;
+
+        //! NACKed packets served from the cache and NACKed packets not found
+        Counter hits;
+        Counter misses;
+
+    private:
+
+        struct Slot {
+            Clock::time_point stored;
+            std::uint16_t seq = 0;
+            //! 0 marks an empty slot
+            std::uint16_t len = 0;
+        };
+
+        Config _config;
+        std::size_t _mask;
+        std::vector<Slot> _slots;
+        std::vector<unsigned char> _data;
+    };
+
+    //! maps the rewritten sequence numbers of recently sent packets back to the original ones,
+    //! so that NACKs of receivers with rewritten sequence numbers can be served from the cache
+    class SequenceHistory {
+    public:
+
+        static constexpr std::size_t SIZE = 1024;
+
+        //! allocates the history on first use
+        void record(std::uint16_t seq, std::uint16_t origSeq);
+
+        [[nodiscard]] std::optional<std::uint16_t> original(std::uint16_t seq) const;
+
+    private:
+
+        struct Item {
+            std::uint16_t seq = 0;
+            std::uint16_t origSeq = 0;
+            bool valid = false;
+        };
+
+        std::unique_ptr<std::array<Item, SIZE>> _items;
+    };
+}
+
+#endif
@@ -0,0 +1,112 @@
+
+#include "rtcp_punt_filter.h"
+
+#include <cstdlib>
+#include <optional>
+#include <stdexcept>
+
+#include "proto/rtcp.h"
+
+p4sfu::RTCPPuntFilter::RTCPPuntFilter(const Config& c)
+    : _config(c) {
+
+    if (_config.rembRelative < 0) {
+        throw std::invalid_argument("RTCPPuntFilter: rembRelative must be >= 0");
+    }
+}
+
+bool p4sfu::RTCPPuntFilter::admit(const net::IPv4Port& from, const unsigned char* buf,
+                                  std::size_t len, Clock::time_point now) {
+
+    auto it = _receivers.find(from);
+    bool punt = it == _receivers.end() || now - it->second.punted >= _config.maxStaleness;
+
+    std::optional<unsigned long> bitRate;
+    const rtcp::hdr* rr = nullptr;
+
+    rtcp::compound packets{buf, len};
+
+    if (packets.truncated()) {
+        return true; // malformed, let the agent deal with it
+    }
+
+    for (const auto& rtcp: packets) {
+
+        if (!rtcp.complete()) {
+            return true;
+        }
+
+        switch (static_cast<rtcp::pt>(rtcp.pt)) {
+
+            case rtcp::pt::rr:
+                rr = &rtcp;
+                break;
+
+            case rtcp::pt::sdes:
+                break;
+
+            case rtcp::pt::rtpfb:
+                if (rtcp.fb_fmt() == 15) { // transport-cc, stays in the data plane
+                    break;
+                }
+                return true;
+
+            case rtcp::pt::psfb:
+                if (rtcp.is_remb()) {
+                    bitRate = rtcp.data.remb.bit_rate();
+                    break;
+                }
+                return true;
+
+            default:
+                return true;
+        }
+    }
+
+    if (!punt && bitRate) {
+        punt = _changed(it->second.bitRate, *bitRate);
+    }
+
+    for (unsigned i = 0; rr && !punt && i < rr->recep_rep_count(); i++) {
+
+        auto lost = it->second.fractionLost.find(ntohl(rr->data.rr[i].ssrc));
+
+        punt = lost == it->second.fractionLost.end()
+            || (unsigned) std::abs((int) rr->data.rr[i].frac_lost() - (int) lost->second)
+               > _config.fractionLost;
+    }
+
+    if (!punt) {
+        return false;
+    }
+
+    // the agent sees the values from here on
+    auto& r = _receivers[from];
+    r.punted = now;
+
+    if (bitRate) {
+        r.bitRate = *bitRate;
+    }
+
+    for (unsigned i = 0; rr && i < rr->recep_rep_count(); i++) {
+        r.fractionLost[ntohl(rr->data.rr[i].ssrc)] = rr->data.rr[i].frac_lost();
+    }
+
+    return true;
+}
+
+void p4sfu::RTCPPuntFilter::removeReceiver(const net::IPv4Port& from) {
+
+    _receivers.erase(from);
+}
+
+const p4sfu::RTCPPuntFilter::Config& p4sfu::RTCPPuntFilter::config() const {
+
+    return _config;
+}
+
+bool p4sfu::RTCPPuntFilter::_changed(unsigned long last, unsigned long current) const {
+
+    auto delta = (double) (current > last ? current - last : last - current);
+    return delta > _config.rembRelative * (double) last && delta > (double) _config.rembAbsolute;
+}
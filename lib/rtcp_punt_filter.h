@@ -0,0 +1,65 @@
+
+#ifndef P4SFU_RTCP_PUNT_FILTER_H
+#define P4SFU_RTCP_PUNT_FILTER_H
+
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+
+#include "net/net.h"
+#include "p4sfu.h"
+
+namespace p4sfu {
+
+    //! decides which receiver reports (RR, REMB) are passed to the switch agent
+    //! - keeps the last punted REMB bit rate and fraction lost per reported SSRC of each receiver
+    //! - a report is punted if it changes a value beyond the thresholds, or if the receiver's last
+    //!   punt is older than maxStaleness; other reports are suppressed
+    //! - a bit rate change must exceed both the relative and the absolute threshold
+    //! - not thread-safe: a filter is used from the thread processing the receiver's packets
+    class RTCPPuntFilter {
+    public:
+
+        using Clock = std::chrono::steady_clock;
+
+        struct Config {
+            //! REMB bit rate change relative to the last punted bit rate
+            double rembRelative = 0.1;
+            //! REMB bit rate change in bits per second
+            unsigned long rembAbsolute = 50000;
+            //! change of a report block's fraction lost, in 1/256
+            unsigned fractionLost = 5;
+            //! reports are punted at least this often per receiver
+            Clock::duration maxStaleness = std::chrono::seconds(1);
+        };
+
+        explicit RTCPPuntFilter(const Config& c);
+
+        //! returns true if the compound RTCP packet from a receiver is to be punted
+        //! - packets with parts other than RR, SDES, REMB and transport-cc are always punted
+        [[nodiscard]] bool admit(const net::IPv4Port& from, const unsigned char* buf,
+                                 std::size_t len, Clock::time_point now);
+
+        //! drops the state of a receiver
+        void removeReceiver(const net::IPv4Port& from);
+
+        [[nodiscard]] const Config& config() const;
+
+    private:
+
+        struct Receiver {
+            Clock::time_point punted;
+            //! 0 until the first REMB
+            unsigned long bitRate = 0;
+            //! fraction lost per reported SSRC
+            std::unordered_map<SSRC, std::uint8_t> fractionLost;
+        };
+
+        [[nodiscard]] bool _changed(unsigned long last, unsigned long current) const;
+
+        Config _config;
+        std::unordered_map<net::IPv4Port, Receiver> _receivers;
+    };
+}
+
+#endif
@@ -2,24 +2,22 @@
 #include "sfu_table.h"
 
 p4sfu::SFUTable::Match::Match(const net::IPv4Port& ipPort, p4sfu::SSRC ssrc)
-    : _ipPort(ipPort), _ssrc(ssrc) { }
+    : _addr((std::uint64_t) ipPort.ip().num() << 16u | ipPort.port()), _ssrc(ssrc) { }
 
 std::size_t p4sfu::SFUTable::Match::Hash::operator()(const Match &m) const noexcept {
 
-    std::size_t h = 0;
-    h ^= std::hash<net::IPv4Port>{}(m._ipPort) + 0x9e3779b9 + (h << 6) + (h >> 2);
-    h ^= m._ssrc + 0x9e3779b9 + (h << 6) + (h >> 2);
-    return h;
+    return SFUTable::_hash(m._addr, m._ssrc);
 }
 
 bool p4sfu::SFUTable::Match::Equal::operator()(const Match &a, const Match &b) const noexcept {
 
-    return a._ipPort == b._ipPort && a._ssrc == b._ssrc;
+    return a._addr == b._addr && a._ssrc == b._ssrc;
 }
 
 net::IPv4Port p4sfu::SFUTable::Match::ipPort() const {
 
-    return _ipPort;
+    return net::IPv4Port{net::IPv4{(std::uint32_t) (_addr >> 16u)},
+                         (unsigned short) (_addr & 0xffffu)};
 }
 
 std::uint32_t p4sfu::SFUTable::Match::ssrc() const {
@@ -28,7 +26,7 @@ std::uint32_t p4sfu::SFUTable::Match::ssrc() const {
 }
 
 p4sfu::SFUTable::Action::Action(const net::IPv4Port& to)
-    : _to(to) { }
+    : state(std::make_shared<State>()), _to(to) { }
 
 net::IPv4Port p4sfu::SFUTable::Action::to() const {
 
@@ -40,11 +38,21 @@ bool p4sfu::SFUTable::Action::operator==(const p4sfu::SFUTable::Action& other) c
     return _to == other._to;
 }
 
-std::list<p4sfu::SFUTable::Action>& p4sfu::SFUTable::Entry::actions() {
+std::vector<p4sfu::SFUTable::Action>& p4sfu::SFUTable::Entry::actions() {
+
+    return _actions;
+}
+
+const std::vector<p4sfu::SFUTable::Action>& p4sfu::SFUTable::Entry::actions() const {
 
     return _actions;
 }
 
+const std::vector<p4sfu::SFUTable::Entry::Node>& p4sfu::SFUTable::Entry::nodes() const {
+
+    return _nodes;
+}
+
 void p4sfu::SFUTable::Entry::addAction(const Action& action) {
 
     if (hasAction(action)) {
@@ -52,19 +60,185 @@ void p4sfu::SFUTable::Entry::addAction(const Action& action) {
     }
 
     _actions.push_back(action);
+    _attach(_actions.size() - 1);
+}
+
+void p4sfu::SFUTable::Entry::removeAction(const Action& action) {
+
+    auto it = std::find(_actions.begin(), _actions.end(), action);
+
+    if (it == _actions.end()) {
+        throw std::invalid_argument("SFUTable::Entry: removeAction: Action does not exist");
+    }
+
+    auto replica = (std::uint32_t) (it - _actions.begin());
+    auto last = (std::uint32_t) (_actions.size() - 1);
+
+    _detach(replica);
+
+    if (replica != last) { // the last replica takes the removed one's RID
+        _detach(last);
+        _actions[replica] = std::move(_actions[last]);
+        _actions.pop_back();
+        _attach(replica);
+    } else {
+        _actions.pop_back();
+    }
+}
+
+void p4sfu::SFUTable::Entry::updateTreatment(const Action& action) {
+
+    auto it = std::find(_actions.begin(), _actions.end(), action);
+
+    if (it == _actions.end()) {
+        throw std::invalid_argument("SFUTable::Entry: updateTreatment: Action does not exist");
+    }
+
+    auto replica = (std::uint32_t) (it - _actions.begin());
+    _detach(replica);
+    _attach(replica);
 }
 
 bool p4sfu::SFUTable::Entry::hasAction(const Action& action) const {
     return std::find(_actions.begin(), _actions.end(), action) != _actions.end();
 }
 
+const av1::DependencyDescriptor::template_dependency_structure*
+p4sfu::SFUTable::Entry::av1Structure() const {
+
+    return _av1Structure && *_av1Structure ? &**_av1Structure : nullptr;
+}
+
+void p4sfu::SFUTable::Entry::updateAV1Structure(
+    const av1::DependencyDescriptor::template_dependency_structure& s) const {
+
+    if (_av1Structure) {
+        *_av1Structure = s;
+    }
+}
+
+void p4sfu::SFUTable::Entry::enableFrameTracking() {
+
+    if (!_av1Structure) {
+        _av1Structure = std::make_shared<
+            std::optional<av1::DependencyDescriptor::template_dependency_structure>>();
+    }
+}
+
+void p4sfu::SFUTable::Entry::updateExclusions(const av1::DropTable& t) const {
+
+    for (unsigned dt = 0; dt < av1::DropTable::MAX_DECODE_TARGETS; dt++) {
+        _exclusions->templates[dt].store(t.exclusion(dt), std::memory_order_relaxed);
+    }
+
+    _exclusions->decodeTargets.store(t.decodeTargets(), std::memory_order_relaxed);
+}
+
+bool p4sfu::SFUTable::Entry::prunes(const Node& node, unsigned templateId) const {
+
+    auto x = _exclusions->templates[node.exclusion].load(std::memory_order_relaxed);
+    return (x >> (templateId % av1::DropTable::MAX_TEMPLATES)) & 1u;
+}
+
+unsigned p4sfu::SFUTable::Entry::decodeTargets() const {
+
+    if (!_exclusions) {
+        return av1::svc::L1T3Structure::DECODE_TARGETS;
+    }
+
+    return _exclusions->decodeTargets.load(std::memory_order_relaxed);
+}
+
+void p4sfu::SFUTable::Entry::_attach(std::uint32_t replica) {
+
+    if (!_exclusions) { // an entry not created by SFUTable::addMatch()
+        _exclusions = _makeExclusions();
+    }
+
+    auto dt = _actions[replica].decodeTarget;
+
+    auto node = std::find_if(_nodes.begin(), _nodes.end(), [dt](const Node& n) {
+        return n.decodeTarget == dt;
+    });
+
+    if (node == _nodes.end()) {
+        auto x = dt && *dt < av1::DropTable::MAX_DECODE_TARGETS
+            ? *dt : av1::DropTable::MAX_DECODE_TARGETS;
+        node = _nodes.insert(_nodes.end(),
+                             Node{dt, x, std::make_shared<NodeState>(_nextNodeId++), {}});
+    }
+
+    node->replicas.push_back(replica);
+}
+
+std::shared_ptr<p4sfu::SFUTable::Entry::Exclusions> p4sfu::SFUTable::Entry::_makeExclusions() {
+
+    constexpr auto initial = av1::svc::L1T3Structure::dropTable();
+
+    auto x = std::make_shared<Exclusions>();
+
+    for (unsigned dt = 0; dt < av1::DropTable::MAX_DECODE_TARGETS; dt++) {
+        x->templates[dt].store(initial.exclusion(dt), std::memory_order_relaxed);
+    }
+
+    x->decodeTargets.store(initial.decodeTargets(), std::memory_order_relaxed);
+    return x;
+}
+
+void p4sfu::SFUTable::Entry::_detach(std::uint32_t replica) {
+
+    for (auto node = _nodes.begin(); node != _nodes.end(); node++) {
+
+        if (auto r = std::find(node->replicas.begin(), node->replicas.end(), replica);
+            r != node->replicas.end()) {
+
+            node->replicas.erase(r);
+
+            if (node->replicas.empty()) {
+                _nodes.erase(node);
+            }
+
+            return;
+        }
+    }
+}
+
+p4sfu::SFUTable::Entry::Counters& p4sfu::SFUTable::Entry::counters() const {
+
+    return *_counters;
+}
+
+p4sfu::RetransmissionCache* p4sfu::SFUTable::Entry::retransmissionCache() const {
+
+    return _retransmissionCache.get();
+}
+
+void p4sfu::SFUTable::Entry::enableRetransmissionCache(const RetransmissionCache::Config& c) {
+
+    if (!_retransmissionCache) {
+        _retransmissionCache = std::make_shared<RetransmissionCache>(c);
+    }
+}
+
+p4sfu::SFUTable::Entry::KeyframeRequests* p4sfu::SFUTable::Entry::keyframeRequests() const {
+
+    return _keyframeRequests.get();
+}
+
+void p4sfu::SFUTable::Entry::enableKeyframeRequests() {
+
+    if (!_keyframeRequests) {
+        _keyframeRequests = std::make_shared<KeyframeRequests>();
+    }
+}
+
 unsigned long p4sfu::SFUTable::size() const {
-    return _table.size();
+    return _size;
 }
 
 bool p4sfu::SFUTable::hasMatch(const Match& m) const {
 
-    return _table.find(m) != _table.end();
+    return _find(m) != NPOS;
 }
 
 p4sfu::SFUTable::Entry& p4sfu::SFUTable::addMatch(const Match& m) {
@@ -73,29 +247,142 @@ p4sfu::SFUTable::Entry& p4sfu::SFUTable::addMatch(const Match& m) {
         throw std::invalid_argument("SFUTable: addMatch: Match already exists");
     }
 
-    auto insertResult = _table.insert(std::make_pair(m, Entry{}));
+    // keep the load factor at or below 1/2, linear probing degrades quickly above
+    if (2 * (_size + 1) > _slots.size()) {
+        _rehash(std::max(MIN_CAPACITY, 2 * _slots.size()));
+    }
 
-    if (!insertResult.second) {
-        throw std::runtime_error("SFUTable: addMatch: failed adding match");
+    auto mask = _slots.size() - 1;
+    auto i = _hash(m.addr(), m.ssrc()) & mask;
+
+    while (_slots[i].used) {
+        i = (i + 1) & mask;
     }
 
-    return insertResult.first->second;
+    _slots[i] = Slot{m.addr(), m.ssrc(), 1};
+    _entries[i] = Entry{};
+    _entries[i]._counters = std::make_shared<Entry::Counters>();
+    _entries[i]._exclusions = Entry::_makeExclusions();
+    _size++;
+
+    return _entries[i];
+}
+
+void p4sfu::SFUTable::removeMatch(const Match& m) {
+
+    auto i = _find(m);
+
+    if (i == NPOS) {
+        throw std::invalid_argument("SFUTable: removeMatch: match does not exist");
+    }
+
+    auto mask = _slots.size() - 1;
+
+    // shift following slots of the probe sequence back into the hole, unless that would move
+    // them in front of their home slot
+    for (auto j = (i + 1) & mask; _slots[j].used; j = (j + 1) & mask) {
+
+        auto home = _hash(_slots[j].addr, _slots[j].ssrc) & mask;
+
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            _slots[i] = _slots[j];
+            _entries[i] = std::move(_entries[j]);
+            i = j;
+        }
+    }
+
+    _slots[i] = Slot{};
+    _entries[i] = Entry{};
+    _size--;
+
+    if (_slots.size() > MIN_CAPACITY && 8 * _size < _slots.size()) {
+        _rehash(_slots.size() / 2);
+    }
 }
 
 p4sfu::SFUTable::Entry& p4sfu::SFUTable::getEntry(const Match& m) {
 
-    if (!hasMatch(m)) {
+    auto* e = find(m);
+
+    if (!e) {
         throw std::invalid_argument("SFUTable: getMatch: match does not exist");
     }
 
-    return _table.find(m)->second;
+    return *e;
 }
 
 p4sfu::SFUTable::Entry& p4sfu::SFUTable::operator[](const Match& m) {
 
-    if (!hasMatch(m)) {
-        throw std::invalid_argument("SFUTable: getMatch: match does not exist");
+    return getEntry(m);
+}
+
+p4sfu::SFUTable::Entry* p4sfu::SFUTable::find(const Match& m) {
+
+    auto i = _find(m);
+    return i != NPOS ? &_entries[i] : nullptr;
+}
+
+const p4sfu::SFUTable::Entry* p4sfu::SFUTable::find(const Match& m) const {
+
+    auto i = _find(m);
+    return i != NPOS ? &_entries[i] : nullptr;
+}
+
+std::uint64_t p4sfu::SFUTable::_hash(std::uint64_t addr, std::uint32_t ssrc) noexcept {
+
+    auto h = addr * 0x9e3779b97f4a7c15ull ^ ssrc;
+    h ^= h >> 33u;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33u;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33u;
+    return h;
+}
+
+std::size_t p4sfu::SFUTable::_find(const Match& m) const noexcept {
+
+    if (_size == 0) {
+        return NPOS;
+    }
+
+    auto mask = _slots.size() - 1;
+
+    for (auto i = _hash(m.addr(), m.ssrc()) & mask;; i = (i + 1) & mask) {
+
+        const auto& s = _slots[i];
+
+        if (!s.used) {
+            return NPOS;
+        }
+
+        if (s.addr == m.addr() && s.ssrc == m.ssrc()) {
+            return i;
+        }
+    }
+}
+
+void p4sfu::SFUTable::_rehash(std::size_t capacity) {
+
+    std::vector<Slot> slots(capacity);
+    std::vector<Entry> entries(capacity);
+    auto mask = capacity - 1;
+
+    for (std::size_t j = 0; j < _slots.size(); j++) {
+
+        if (!_slots[j].used) {
+            continue;
+        }
+
+        auto i = _hash(_slots[j].addr, _slots[j].ssrc) & mask;
+
+        while (slots[i].used) {
+            i = (i + 1) & mask;
+        }
+
+        slots[i] = _slots[j];
+        entries[i] = std::move(_entries[j]);
     }
 
-    return _table.find(m)->second;
+    _slots = std::move(slots);
+    _entries = std::move(entries);
 }
@@ -2,17 +2,31 @@
 #ifndef P4SFU_SFU_TABLE_H
 #define P4SFU_SFU_TABLE_H
 
-#include <list>
-#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
 
 #include "net/net.h"
 #include "av1.h"
 #include "p4sfu.h"
 #include "sequence_rewriter.h"
 #include "drop_layer_set.h"
+#include "retransmission_cache.h"
+#include "switch_statistics.h"
 
 namespace p4sfu {
 
+    //! SFU forwarding table: (source address, SSRC) -> list of receivers
+    //! - flat open-addressing hash table with linear probing, the probed key array holds only the
+    //!   packed keys so that a lookup typically touches a single cache line
+    //! - entries live in a parallel array, their actions in one contiguous array per entry
+    //! - references to entries and actions are invalidated by addMatch() and removeMatch()
+    //! - removal uses backward-shift deletion (no tombstones), the table shrinks when it falls
+    //!   below 1/8 occupancy
     class SFUTable {
 
     public:
@@ -33,34 +47,175 @@ namespace p4sfu {
             [[nodiscard]] net::IPv4Port ipPort() const;
             [[nodiscard]] p4sfu::SSRC ssrc() const;
 
+            //! IPv4 address and port packed into 48 bits
+            [[nodiscard]] std::uint64_t addr() const {
+                return _addr;
+            }
+
         private:
-            net::IPv4Port _ipPort   = {};
+            std::uint64_t _addr = 0;
             p4sfu::SSRC _ssrc = 0;
         };
 
-        class Action {
+        //! one action per cache line, so that fan-out walks consecutive lines
+        //! - the state is mutated per packet by the data plane, copies of an action (and thus
+        //!   copies of the table) share it so that it survives table versions
+        class alignas(64) Action {
 
         public:
+
+            //! per-replica egress state
+            struct State {
+                Counter pkts;
+                Counter bytes;
+                Counter rewritten;
+                //! NACKed packets served from the stream's retransmission cache
+                Counter retransmitted;
+                //! the receiver's sequence numbers are its node's plus seqOffset, the offset is
+                //! recomputed when the receiver is served by another node than the last packet
+                std::uint64_t node      = 0;
+                std::uint16_t seqOffset = 0;
+                std::uint16_t lastSeq   = 0;
+                //! first sequence number the receiver got from its current node
+                std::uint16_t nodeSeq   = 0;
+            };
+
             explicit Action(const net::IPv4Port& to);
             [[nodiscard]] net::IPv4Port to() const;
             bool operator==(const Action& other) const;
-            std::optional<av1::svc::L1T3> svcConfig = std::nullopt;
-            SequenceRewriter sequenceRewriter;
+            //! index of the receiver's decode target in the stream's template dependency
+            //! structure, none: all frames
+            std::optional<unsigned> decodeTarget = std::nullopt;
+            std::shared_ptr<State> state;
 
         private:
             net::IPv4Port _to = {};
         };
 
+        //! an entry is the match's replication group, modeled on the Tofino PRE
+        //! - the entry is the multicast group, each action a replica (its index is the RID)
+        //! - replicas with the same treatment share a level-1 node: its exclusion set holds the
+        //!   AV1 template IDs pruned for the node's decode target, as given by the DTIs of the
+        //!   stream's latest template dependency structure, and its sequence rewriter is shared
+        //!   since all of its replicas see the same packet sequence
+        //! - per packet, pruning and sequence rewriting run once per node, only the header copy
+        //!   and transmission run per replica
+        //! - nodes are maintained incrementally by addAction(), removeAction() and
+        //!   updateTreatment()
         class Entry {
 
         public:
+
+            //! packets received on the match, shared by copies of the entry like Action::State
+            struct Counters {
+                Counter pkts;
+                Counter bytes;
+            };
+
+            //! keyframe requests (PLIs) for the stream, coalesced into one per keyframe
+            struct KeyframeRequests {
+                //! when the outstanding request was forwarded (steady clock ticks), 0: none
+                std::atomic<std::chrono::steady_clock::rep> requested = 0;
+                //! a keyframe was requested since a chain broke, without coalescing (pliWindow)
+                std::atomic<bool> chainBroken = false;
+                Counter forwarded;
+                Counter suppressed;
+                Counter keyframes;
+            };
+
+            //! egress state of a node, shared by copies of the entry like Action::State
+            struct NodeState {
+                explicit NodeState(std::uint64_t id) : id(id) { }
+                const std::uint64_t id;
+                SequenceRewriter sequenceRewriter;
+                Counter pruned;
+                //! decodability of the frames the node forwards, if the entry tracks AV1 frames
+                av1::FrameChain chain;
+                //! packets of frames dropped since the node's chain was broken
+                Counter undecodable;
+                //! original sequence numbers of the node's packets, if the stream is cached
+                SequenceHistory sent;
+            };
+
+            //! AV1 template IDs pruned per decode target (bit t: template ID t), shared by copies
+            //! of the entry like Action::State, the last one is never set
+            struct Exclusions {
+                std::array<std::atomic<std::uint64_t>, av1::DropTable::MAX_DECODE_TARGETS + 1>
+                    templates = {};
+                //! decode targets of the structure the exclusions were built from
+                std::atomic<unsigned> decodeTargets = 0;
+            };
+
+            struct Node {
+                //! decode target of the replicas, none: no pruning
+                std::optional<unsigned> decodeTarget;
+                //! index of the node's L1 exclusion in Exclusions, so that the per-packet test is
+                //! a single shift-and-test
+                std::uint32_t exclusion = av1::DropTable::MAX_DECODE_TARGETS;
+                std::shared_ptr<NodeState> state;
+                //! indices into actions()
+                std::vector<std::uint32_t> replicas;
+            };
+
             Entry() = default;
-            [[nodiscard]] std::list<Action>& actions();
+            [[nodiscard]] std::vector<Action>& actions();
+            [[nodiscard]] const std::vector<Action>& actions() const;
+            [[nodiscard]] const std::vector<Node>& nodes() const;
+            //! adds a replica, the order of actions() is kept
             void addAction(const Action& action);
+            //! removes a replica, the last action takes its place in actions()
+            void removeAction(const Action& action);
+            //! moves the replica to the node matching its decodeTarget, call after changing it
+            void updateTreatment(const Action& action);
             [[nodiscard]] bool hasAction(const Action& action) const;
+            [[nodiscard]] Counters& counters() const;
+            //! returns the entry's retransmission cache, nullptr if not enabled
+            [[nodiscard]] RetransmissionCache* retransmissionCache() const;
+            //! creates the retransmission cache if the entry has none, copies share it
+            void enableRetransmissionCache(const RetransmissionCache::Config& c);
+            //! returns the entry's keyframe request state, nullptr if PLIs aren't coalesced
+            [[nodiscard]] KeyframeRequests* keyframeRequests() const;
+            //! creates the keyframe request state if the entry has none, copies share it
+            void enableKeyframeRequests();
+
+            //! returns the latest template dependency structure of the stream, nullptr if AV1
+            //! frames aren't tracked or none was received yet
+            [[nodiscard]] const av1::DependencyDescriptor::template_dependency_structure*
+                av1Structure() const;
+            //! keeps a new template dependency structure of the stream, if AV1 frames are tracked
+            void updateAV1Structure(
+                const av1::DependencyDescriptor::template_dependency_structure& s) const;
+            //! keeps the stream's template dependency structure from now on, so that the
+            //! dependencies of every frame are known, copies share it
+            void enableFrameTracking();
+
+            //! replaces the pruned template IDs with those of a new template dependency
+            //! structure of the stream, until the first one, L1T3's are assumed
+            void updateExclusions(const av1::DropTable& t) const;
+            //! true if packets with the AV1 template ID are pruned for the node
+            [[nodiscard]] bool prunes(const Node& node, unsigned templateId) const;
+            //! decode targets of the stream's latest template dependency structure, L1T3's until
+            //! the first one
+            [[nodiscard]] unsigned decodeTargets() const;
 
         private:
-            std::list<Action> _actions;
+            friend class SFUTable;
+
+            void _attach(std::uint32_t replica);
+            static std::shared_ptr<Exclusions> _makeExclusions();
+            void _detach(std::uint32_t replica);
+
+            std::vector<Action> _actions;
+            std::vector<Node> _nodes;
+            std::uint64_t _nextNodeId = 1;
+            //! allocated by SFUTable::addMatch(), unused slots don't carry them
+            std::shared_ptr<Counters> _counters;
+            std::shared_ptr<Exclusions> _exclusions;
+            std::shared_ptr<RetransmissionCache> _retransmissionCache;
+            std::shared_ptr<KeyframeRequests> _keyframeRequests;
+            //! only accessed by the packet-processing thread
+            std::shared_ptr<std::optional<av1::DependencyDescriptor::template_dependency_structure>>
+                _av1Structure;
         };
 
         SFUTable() = default;
@@ -70,11 +225,46 @@ namespace p4sfu {
         [[nodiscard]] unsigned long size() const;
         [[nodiscard]] bool hasMatch(const Match& m) const;
         Entry& addMatch(const Match& m);
+        void removeMatch(const Match& m);
         [[nodiscard]] Entry& getEntry(const Match& m);
         [[nodiscard]] Entry& operator[](const Match& m);
+        //! returns the entry for m or nullptr, single lookup for the packet path
+        [[nodiscard]] Entry* find(const Match& m);
+        [[nodiscard]] const Entry* find(const Match& m) const;
+
+        //! calls f(const Match&, const Entry&) for all entries
+        template <typename F>
+        void forEach(F&& f) const {
+            for (std::size_t i = 0; i < _slots.size(); i++) {
+                if (_slots[i].used) {
+                    f(Match{net::IPv4Port{(std::uint32_t) (_slots[i].addr >> 16u),
+                                          (std::uint16_t) (_slots[i].addr & 0xffffu)},
+                            _slots[i].ssrc}, _entries[i]);
+                }
+            }
+        }
 
     private:
-        std::unordered_map<Match, Entry, Match::Hash, Match::Equal> _table;
+
+        //! packed key of a slot, used == 0 marks an empty slot
+        struct Slot {
+            std::uint64_t addr = 0;
+            std::uint32_t ssrc = 0;
+            std::uint32_t used = 0;
+        };
+
+        static constexpr std::size_t NPOS = ~std::size_t{0};
+        static constexpr std::size_t MIN_CAPACITY = 16;
+
+        //! 64-bit mix (murmur3 finalizer) of address, port and SSRC
+        static std::uint64_t _hash(std::uint64_t addr, std::uint32_t ssrc) noexcept;
+
+        [[nodiscard]] std::size_t _find(const Match& m) const noexcept;
+        void _rehash(std::size_t capacity);
+
+        std::vector<Slot> _slots;
+        std::vector<Entry> _entries;
+        std::size_t _size = 0;
     };
 }
 
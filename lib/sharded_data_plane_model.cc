@@ -0,0 +1,267 @@
+
+#include "sharded_data_plane_model.h"
+
+#include <linux/filter.h>
+#include <sys/socket.h>
+
+#include "log.h"
+
+namespace {
+
+    //! multiplier of the hash shared by shardOf() and the steering program
+    const std::uint32_t SHARD_HASH_MUL = 0x9e3779b1;
+}
+
+p4sfu::ShardedDataPlaneModel::Shard::Shard()
+    : work{io.get_executor()} { }
+
+p4sfu::ShardedDataPlaneModel::ShardedDataPlaneModel(boost::asio::io_context* io,
+                                                    DataPlane::Config* c)
+    : DataPlane{io},
+      _config{*reinterpret_cast<ShardedDataPlaneModel::Config*>(c)},
+      _port{_config.port} {
+
+    if (_config.shards == 0) {
+        throw std::invalid_argument("ShardedDataPlaneModel: shards must be > 0");
+    }
+
+    // a receiver's transport-wide sequence numbers would be counted in every shard forwarding
+    // to it, and its feedback arrives at a single shard
+    if (_config.delayBasedEstimate) {
+        Log(Log::WARN) << "ShardedDataPlaneModel: delay-based estimates are not supported with "
+                       << "shards, disabled" << std::endl;
+        _config.delayBasedEstimate = std::nullopt;
+    }
+
+    for (unsigned i = 0; i < _config.shards; i++) {
+
+        auto shard = std::make_unique<Shard>();
+        int fd;
+
+        auto adopt = [&](auto* udp) {
+            fd = udp->socket().native_handle();
+            _port = udp->socket().local_endpoint().port();
+            shard->udp.reset(udp);
+        };
+
+        if (_config.ioUring) {
+            adopt(new UringUDPServer{shard->io, _port, 256, true});
+        } else if (_config.ioBatchSize > 1) {
+            auto* udp = new BatchUDPServer{shard->io, _port, _config.ioBatchSize, true,
+                                           _config.udpOffload};
+            if (_config.pacing && _config.pacing->txTime) {
+                udp->enableTxTime();
+            }
+            adopt(udp);
+        } else {
+            adopt(new UDPServer{shard->io, _port, true});
+        }
+
+        // the program is stored with the reuseport group, sockets bound later inherit it
+        if (i == 0) {
+            _attachSteeringProgram(fd);
+        }
+
+        shard->model = std::make_unique<DataPlaneModel>(shard->udp.get(), _config, &shard->io);
+
+        shard->model->setOwnership([i, n = _config.shards](const net::IPv4Port& addr) {
+            return shardOf(addr, n) == i;
+        });
+
+        shard->model->onPacketToController([this](DataPlane&, PktIn pkt) {
+            _onShardPacketToController(pkt);
+        });
+
+        shard->model->onForeignFeedback([this](const net::IPv4Port& from,
+                                               const net::IPv4Port& sender,
+                                               const unsigned char* buf, std::size_t len) {
+            _onShardForeignFeedback(from, sender, buf, len);
+        });
+
+        _shards.push_back(std::move(shard));
+    }
+
+    for (unsigned i = 0; i < _shards.size(); i++) {
+
+        _shards[i]->thread = std::thread([i, s = _shards[i].get()]() {
+            for (;;) { // keep the shard alive if a single handler throws
+                try {
+                    s->io.run();
+                    return;
+                } catch (std::exception& e) {
+                    Log(Log::ERROR) << "ShardedDataPlaneModel: shard " << i << ": " << e.what()
+                                    << std::endl;
+                }
+            }
+        });
+    }
+
+    Log(Log::INFO) << "ShardedDataPlaneModel: started " << _shards.size() << " shards on port "
+                   << _port << std::endl;
+}
+
+p4sfu::ShardedDataPlaneModel::~ShardedDataPlaneModel() {
+
+    for (auto& s: _shards) {
+        s->work.reset();
+        s->io.stop();
+    }
+
+    for (auto& s: _shards) {
+        if (s->thread.joinable()) {
+            s->thread.join();
+        }
+    }
+}
+
+void p4sfu::ShardedDataPlaneModel::sendPacket(const PktOut& pkt) {
+
+    auto buf = std::make_shared<std::vector<unsigned char>>(pkt.buf, pkt.buf + pkt.len);
+    auto& shard = _shardOf(pkt.to);
+
+    asio::post(shard.io, [&shard, to = pkt.to, buf]() {
+        shard.model->sendPacket(PktOut{to, buf->data(), buf->size()});
+    });
+}
+
+void p4sfu::ShardedDataPlaneModel::addStream(const Stream& s) {
+
+    // forward matches live in the sender's shard, reverse RTCP matches in the receiver's shard
+    // - the shards' tables are RCU-protected, updates are published from this thread without
+    //   waiting for the shard to process queued packets
+    auto& src = _shardOf(s.src);
+    src.model->addStream(s);
+
+    if (auto& dst = _shardOf(s.dst); &dst != &src && s.dst != net::IPv4Port{0, 0}) {
+        dst.model->addStream(s);
+    }
+}
+
+void p4sfu::ShardedDataPlaneModel::removeStream(const Stream& s) {
+
+    auto& src = _shardOf(s.src);
+    src.model->removeStream(s);
+
+    if (auto& dst = _shardOf(s.dst); &dst != &src && s.dst != net::IPv4Port{0, 0}) {
+        dst.model->removeStream(s);
+    }
+}
+
+void p4sfu::ShardedDataPlaneModel::removeParticipant(const net::IPv4Port& addr) {
+
+    // matches keyed by addr live in its shard, actions forwarding to addr in any shard
+    for (auto& s: _shards) {
+        s->model->removeParticipant(addr);
+    }
+}
+
+void p4sfu::ShardedDataPlaneModel::adjustDecodeTarget(const net::IPv4Port& from,
+                                                      const net::IPv4Port& to, SSRC ssrc,
+                                                      unsigned target) {
+
+    _shardOf(from).model->adjustDecodeTarget(from, to, ssrc, target);
+}
+
+const p4sfu::TotalPacketStatistics& p4sfu::ShardedDataPlaneModel::totalStatistics() const {
+
+    TotalPacketStatistics sum;
+
+    for (const auto& s: _shards) {
+        const auto st = s->model->totalCounters();
+        sum.pkts                   += st.pkts;
+        sum.bytes                  += st.bytes;
+        sum.stunPkts               += st.stunPkts;
+        sum.rtcpPkts               += st.rtcpPkts;
+        sum.rtpPkts                += st.rtpPkts;
+        sum.frames                 += st.frames;
+        sum.av1SimpleDescriptors   += st.av1SimpleDescriptors;
+        sum.av1ExtendedDescriptors += st.av1ExtendedDescriptors;
+        sum.rtcpPuntsSuppressed    += st.rtcpPuntsSuppressed;
+        sum.av1PuntsSuppressed     += st.av1PuntsSuppressed;
+    }
+
+    _aggregatedStatistics = sum;
+    return _aggregatedStatistics;
+}
+
+std::vector<p4sfu::StreamStatistics> p4sfu::ShardedDataPlaneModel::streamStatistics() const {
+
+    std::vector<StreamStatistics> stats;
+
+    for (const auto& s: _shards) {
+        auto shardStats = s->model->streamStatistics();
+        stats.insert(stats.end(), std::make_move_iterator(shardStats.begin()),
+                     std::make_move_iterator(shardStats.end()));
+    }
+
+    return stats;
+}
+
+unsigned short p4sfu::ShardedDataPlaneModel::port() const {
+
+    return _port;
+}
+
+unsigned p4sfu::ShardedDataPlaneModel::shardOf(const net::IPv4Port& addr, unsigned shards) {
+
+    std::uint32_t h = (addr.ip().num() ^ addr.port()) * SHARD_HASH_MUL;
+    return (h >> 16) % shards;
+}
+
+void p4sfu::ShardedDataPlaneModel::_attachSteeringProgram(int fd) const {
+
+    // computes shardOf(source address) on the IPv4/UDP headers of the incoming datagram
+    sock_filter code[] = {
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, (__u32) SKF_NET_OFF),        // x = ipv4 header length
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, (__u32) SKF_NET_OFF),         // a = udp source port
+        BPF_STMT(BPF_ST, 0),                                             // m[0] = a
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (__u32) (SKF_NET_OFF + 12)),  // a = ipv4 source address
+        BPF_STMT(BPF_LDX | BPF_W | BPF_MEM, 0),                // x = m[0]
+        BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+        BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, SHARD_HASH_MUL),
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, _config.shards),
+        BPF_STMT(BPF_RET | BPF_A, 0)
+    };
+
+    sock_fprog prog{sizeof(code) / sizeof(code[0]), code};
+
+    if (::setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        throw std::runtime_error("ShardedDataPlaneModel: _attachSteeringProgram() failed: "
+            + std::to_string(errno));
+    }
+}
+
+void p4sfu::ShardedDataPlaneModel::_onShardPacketToController(const PktIn& pkt) {
+
+    // runs on a shard thread: the shard's buffer is reused, hand a copy to the agent's thread
+    auto buf = std::make_shared<std::vector<unsigned char>>(pkt.buf, pkt.buf + pkt.len);
+
+    asio::post(*_io, [this, reason = pkt.reason, from = pkt.from, buf]() {
+        try {
+            _controlPlanePacketHandler(*this, PktIn{reason, from, buf->data(), buf->size()});
+        } catch (std::bad_function_call& e) {
+            throw std::logic_error("ShardedDataPlaneModel: no control-plane packet handler set");
+        }
+    });
+}
+
+void p4sfu::ShardedDataPlaneModel::_onShardForeignFeedback(const net::IPv4Port& from,
+                                                           const net::IPv4Port& sender,
+                                                           const unsigned char* buf,
+                                                           std::size_t len) {
+
+    // runs on the receiver's shard thread, the sender's shard handles a copy
+    auto copy = std::make_shared<std::vector<unsigned char>>(buf, buf + len);
+    auto& shard = _shardOf(sender);
+
+    asio::post(shard.io, [&shard, from, sender, copy]() {
+        shard.model->forwardFeedback(from, sender, copy->data(), copy->size());
+    });
+}
+
+p4sfu::ShardedDataPlaneModel::Shard& p4sfu::ShardedDataPlaneModel::_shardOf(
+    const net::IPv4Port& addr) {
+
+    return *_shards[shardOf(addr, _config.shards)];
+}
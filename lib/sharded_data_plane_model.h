@@ -0,0 +1,92 @@
+
+#ifndef P4SFU_SHARDED_DATA_PLANE_MODEL_H
+#define P4SFU_SHARDED_DATA_PLANE_MODEL_H
+
+#include <boost/asio.hpp>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "data_plane_model.h"
+
+using namespace boost;
+
+namespace p4sfu {
+
+    //! runs several DataPlaneModel instances (shards) on worker threads, each with its own UDP
+    //! socket bound to the SFU port using SO_REUSEPORT
+    //! - a reuseport BPF program steers each datagram to the shard owning the sender's IPv4Port
+    //! - each shard only installs SFU-table matches keyed by addresses it owns
+    //! - control-plane calls update the owning shard's RCU-protected SFU table from the agent's
+    //!   thread, punted packets are posted back to the agent's io_context
+    //! - NACKs and keyframe requests arrive at the receiver's shard and are posted to the
+    //!   sender's shard, which holds the retransmission cache and keyframe requests of the stream
+    class ShardedDataPlaneModel : public DataPlane {
+    public:
+
+        struct Config : public DataPlaneModel::Config {
+            //! number of worker threads (one socket and SFU-table partition each)
+            unsigned shards = 1;
+        };
+
+        explicit ShardedDataPlaneModel(boost::asio::io_context* io, DataPlane::Config* c);
+        ShardedDataPlaneModel(const ShardedDataPlaneModel&) = delete;
+        ShardedDataPlaneModel& operator=(const ShardedDataPlaneModel&) = delete;
+        ~ShardedDataPlaneModel() override;
+
+        // from abstract DataPlane:
+        void sendPacket(const PktOut& pkt) override;
+        void addStream(const Stream& s) override;
+        void removeStream(const Stream& s) override;
+        void adjustDecodeTarget(const net::IPv4Port& from, const net::IPv4Port& to, SSRC ssrc,
+                                unsigned target) override;
+
+        //! removes a participant's matches and actions from all shards
+        void removeParticipant(const net::IPv4Port& addr);
+
+        //! sums up the statistics of all shards
+        //! @note counters are read while the shards are running and may be slightly behind
+        [[nodiscard]] const TotalPacketStatistics& totalStatistics() const override;
+
+        //! collects the per-stream counters of all shards, each match lives in exactly one shard
+        [[nodiscard]] std::vector<StreamStatistics> streamStatistics() const override;
+
+        //! UDP port all shards are bound to
+        [[nodiscard]] unsigned short port() const;
+
+        //! returns the index of the shard that owns matches keyed by addr
+        //! @note must produce the same result as the reuseport steering program
+        [[nodiscard]] static unsigned shardOf(const net::IPv4Port& addr, unsigned shards);
+
+    private:
+
+        struct Shard {
+            Shard();
+            asio::io_context io;
+            asio::executor_work_guard<asio::io_context::executor_type> work;
+            std::unique_ptr<UDPInterface> udp;
+            std::unique_ptr<DataPlaneModel> model;
+            std::thread thread;
+        };
+
+        //! attaches the classic BPF program that selects a socket from the reuseport group
+        void _attachSteeringProgram(int fd) const;
+
+        //! copies a packet punted by a shard and hands it to the agent on its io_context
+        void _onShardPacketToController(const PktIn& pkt);
+
+        //! copies a receiver's feedback and hands it to the shard owning the sender, whose
+        //! table holds the streams it is about
+        void _onShardForeignFeedback(const net::IPv4Port& from, const net::IPv4Port& sender,
+                                     const unsigned char* buf, std::size_t len);
+
+        [[nodiscard]] Shard& _shardOf(const net::IPv4Port& addr);
+
+        Config _config;
+        unsigned short _port = 0;
+        std::vector<std::unique_ptr<Shard>> _shards;
+        mutable TotalPacketStatistics _aggregatedStatistics;
+    };
+}
+
+#endif
@@ -3,7 +3,11 @@
 #define P4_SFU_SWITCH_AGENT_H
 
 #include <boost/asio.hpp>
+#include <map>
+#include <limits>
+#include <tuple>
 
+#include "async_log_sink.h"
 #include "av1.h"
 #include "data_plane_model.h"
 #include "log.h"
@@ -24,27 +28,50 @@ using namespace boost;
 
 namespace p4sfu {
 
+    //! switch agent configuration, shared by all data-plane types
+    struct SwitchAgentConfig {
+        enum class Type { model, tofino } type = Type::model;
+        unsigned      switchId                 = 0;
+        std::uint16_t sfuListenPort            = 0;
+        std::uint16_t apiListenPort            = 6790;
+        std::string   controllerIPv4;
+        std::uint16_t controllerPort           = 0;
+        std::string   dataPlaneIface; // Tofino and AF_XDP model only
+        std::string   dataPlaneIPv4;  // AF_XDP model only
+        std::string   iceUfrag;
+        std::string   icePwd;
+        unsigned      av1RtpExtId               = 0;
+        double        rtpDropRate               = 0;
+        unsigned      ioBatchSize               = 0; // model only
+        bool          ioUring                   = false; // model only
+        bool          udpOffload                = false; // model only
+        double        pacingFactor              = 0; // model only, 0: no pacing
+        bool          pacingTxTime              = false; // model only
+        unsigned      nackCache                 = 0; // model only, packets, 0: no cache
+        unsigned      pliWindow                 = 0; // model only, ms, 0: no PLI coalescing
+        unsigned      rembInterval              = 0; // ms, 0: no aggregate REMB to senders
+        unsigned      rtcpPuntStaleness         = 0; // model only, ms, 0: punt all RRs
+        unsigned      twccRtpExtId              = 0; // model only, 0: no transport-cc feedback
+        unsigned      delayEstimateInterval     = 0; // model only, ms, 0: no delay estimates
+        bool          dropUndecodable           = false; // model only
+        bool          undecodablePLI            = false; // model only
+        unsigned      shards                    = 1; // model only
+        bool          verbose                   = false;
+        bool          asyncLog                  = false;
+        std::string   logFile; // implies asyncLog
+    };
+
     template <typename DataPlaneType>
     class SwitchAgent {
     public:
 
-        struct Config {
-            enum class Type { model, tofino } type = Type::model;
-            unsigned      switchId                 = 0;
-            std::uint16_t sfuListenPort            = 0;
-            std::uint16_t apiListenPort            = 6790;
-            std::string   controllerIPv4;
-            std::uint16_t controllerPort           = 0;
-            std::string   dataPlaneIface; // Tofino only
-            std::string   iceUfrag;
-            std::string   icePwd;
-            unsigned      av1RtpExtId               = 0;
-            double        rtpDropRate               = 0;
-            bool          verbose                   = false;
-        };
+        typedef SwitchAgentConfig Config;
 
         SwitchAgent(const Config& c, DataPlane::Config& dpc)
             : _config(c),
+              _logSink(_config.asyncLog || !_config.logFile.empty()
+                  ? std::make_unique<AsyncLogSink>(AsyncLogSink::Config{.file = _config.logFile})
+                  : nullptr),
               _io(),
               _controllerClient(_io),
               _api(_io, _config.apiListenPort),
@@ -61,7 +88,8 @@ namespace p4sfu {
                 Log(Log::INFO) << "SwitchAgent: (): api-listen-port=" << c.apiListenPort
                                << ", controller=" << c.controllerIPv4 << ":" << c.controllerPort
                                << ", ice-ufrag=" << c.iceUfrag
-                               << ", ice-pwd=" << c.icePwd << std::endl;
+                               << ", ice-pwd=" << c.icePwd
+                               << ", remb-interval=" << c.rembInterval << std::endl;
 
             } else if(_config.type == Config::Type::model) {
 
@@ -72,7 +100,23 @@ namespace p4sfu {
                                << ", ice-ufrag=" << c.iceUfrag
                                << ", ice-pwd=" << c.icePwd
                                << ", av1-rtp-ext-id=" << c.av1RtpExtId
-                               << ", rtp-drop-rate=" << c.rtpDropRate << std::endl;
+                               << ", rtp-drop-rate=" << c.rtpDropRate
+                               << ", io-batch-size=" << c.ioBatchSize
+                               << ", io-uring=" << c.ioUring
+                               << ", udp-offload=" << c.udpOffload
+                               << ", pacing-factor=" << c.pacingFactor
+                               << ", pacing-tx-time=" << c.pacingTxTime
+                               << ", nack-cache=" << c.nackCache
+                               << ", pli-window=" << c.pliWindow
+                               << ", remb-interval=" << c.rembInterval
+                               << ", rtcp-punt-staleness=" << c.rtcpPuntStaleness
+                               << ", twcc-rtp-ext-id=" << c.twccRtpExtId
+                               << ", delay-estimate-interval=" << c.delayEstimateInterval
+                               << ", drop-undecodable=" << c.dropUndecodable
+                               << ", undecodable-pli=" << c.undecodablePLI
+                               << ", shards=" << c.shards
+                               << ", xdp-iface=" << c.dataPlaneIface
+                               << ", xdp-ipv4=" << c.dataPlaneIPv4 << std::endl;
             }
 
             // set up controller client callbacks:
@@ -131,6 +175,20 @@ namespace p4sfu {
                 this->_onTimer(t);
             });
 
+            if (_config.rembInterval > 0) {
+                _rembTimer = std::make_unique<Timer>(_io, _config.rembInterval);
+                _rembTimer->onTimer([this](Timer&) {
+                    this->_sendAggregateEstimates();
+                });
+            }
+
+            if (_config.delayEstimateInterval > 0) {
+                _delayEstimateTimer = std::make_unique<Timer>(_io, _config.delayEstimateInterval);
+                _delayEstimateTimer->onTimer([this](Timer&) {
+                    this->_applyDelayBasedEstimates();
+                });
+            }
+
             try {
                 // connect to controller:
                 _controllerClient.connect(c.controllerIPv4, c.controllerPort);
@@ -160,12 +218,18 @@ namespace p4sfu {
     private:
 
         Config _config;
+        //! declared first: created before and destroyed after everything that logs
+        std::unique_ptr<AsyncLogSink> _logSink;
         asio::io_context _io;
         SwitchControllerClient _controllerClient;
         SwitchAPI _api;
         std::shared_ptr<DataPlane> _dataPlane;
         STUNAgent _stunAgent;
         Timer _timer;
+        //! sends each sender one REMB aggregated from its receivers' estimates
+        std::unique_ptr<Timer> _rembTimer;
+        //! feeds the data plane's delay-based estimates into the decode-target decisions
+        std::unique_ptr<Timer> _delayEstimateTimer;
 
         SwitchAgentState _state;
 
@@ -174,12 +238,6 @@ namespace p4sfu {
         bool _adjustDecodeTarget(unsigned sessionId, SSRC ssrc, unsigned participantId,
                                  unsigned decodeTarget) {
 
-            if (decodeTarget > av1::svc::L1T3::MAX_IDENT) {
-                Log(Log::ERROR) << "SwitchAgent: _adjustDecodeTarget: invalid decode target: "
-                                << decodeTarget << std::endl;
-                return false;
-            }
-
             auto rs = _state.getReceiveStream(sessionId, ssrc, participantId);
 
             if (rs == _state.receiveStreams().end()) {
@@ -205,10 +263,17 @@ namespace p4sfu {
                 return false;
             }
 
+            if (decodeTarget >= ss->second.decodeTargets()) {
+                Log(Log::ERROR) << "SwitchAgent: _adjustDecodeTarget: invalid decode target: "
+                                << decodeTarget << ", decodeTargets="
+                                << ss->second.decodeTargets() << std::endl;
+                return false;
+            }
+
             _dataPlane->adjustDecodeTarget(ss->second.addr, rs->second.addr, ss->second.ssrc,
                                            decodeTarget);
 
-            rs->second.decodeTarget = av1::svc::L1T3::decodeTargetFromNumIdentifier(decodeTarget);
+            rs->second.decodeTarget = decodeTarget;
 
             return true;
         }
@@ -286,7 +351,8 @@ namespace p4sfu {
                 */
 
                 _state.addReceiveStream(m.sessionId, sendStream.sendingParticipant, m.participantId,
-                                        net::IPv4Port{m.ip, m.port}, m.mainSSRC, m.rtxSSRC);
+                                        net::IPv4Port{m.ip, m.port}, m.mainSSRC, m.rtxSSRC,
+                                        m.rtcpSSRC);
 
 
                 Log(Log::INFO) << "SwitchAgent: _onAddStream: add receive stream" << std::endl;
@@ -332,7 +398,7 @@ namespace p4sfu {
 
         void _onPacketFromDataPlane(DataPlane& dataPlane, DataPlane::PktIn& pkt) {
 
-            Log(Log::DEBUG) << "SwitchAgent: _onPacketFromDataPlane: len=" << pkt.len << std::endl;
+            LOG(DEBUG) << "SwitchAgent: _onPacketFromDataPlane: len=" << pkt.len << std::endl;
 
             switch (pkt.reason) {
                 case DataPlane::PktIn::Reason::stun: _handleSTUN(dataPlane, pkt); break;
@@ -345,45 +411,47 @@ namespace p4sfu {
 
         void _handleSTUN(DataPlane& dataPlane, DataPlane::PktIn& pkt) {
 
-            Log(Log::DEBUG) << "SwitchAgent: _handleSTUN: len=" << pkt.len << std::endl;
+            LOG(DEBUG) << "SwitchAgent: _handleSTUN: len=" << pkt.len << std::endl;
 
             if (stun::bufferContainsSTUNBindingRequest(pkt.buf, pkt.len)) {
                 _handleSTUNBindingRequest(dataPlane, pkt);
             } else {
-                Log(Log::ERROR) << "SwitchAgent: _handleSTUN: unknown STUN message, ignore."
-                                << std::endl;
+                LOG(ERROR) << "SwitchAgent: _handleSTUN: unknown STUN message, ignore."
+                           << std::endl;
             }
         }
 
         void _handleSTUNBindingRequest(DataPlane& dataPlane, DataPlane::PktIn& pkt) {
 
-            Log(Log::DEBUG) << "SwitchAgent: _handleSTUNBindingRequest: len=" << pkt.len
-                            << std::endl;
+            LOG(DEBUG) << "SwitchAgent: _handleSTUNBindingRequest: len=" << pkt.len
+                       << std::endl;
 
             auto stunResult = _stunAgent.validate(pkt.from, pkt.buf, pkt.len);
 
             if (stunResult.success) {
 
                 if (stunResult.initial) {
-                    Log(Log::INFO) << "SwitchAgent: initial STUN validation succeeded for "
-                                   << pkt.from << std::endl;
+                    LOG(INFO) << "SwitchAgent: initial STUN validation succeeded for "
+                              << pkt.from << std::endl;
                 } else {
-                    Log(Log::DEBUG) << "SwitchAgent: STUN validation succeeded" << std::endl;
+                    LOG(DEBUG) << "SwitchAgent: STUN validation succeeded" << std::endl;
                 }
 
                 _dataPlane->sendPacket(DataPlane::PktOut{
                     pkt.from, _stunAgent.msgBuf(), _stunAgent.msgLen()
                 });
 
-                Log(Log::DEBUG) << "SwitchAgent: sent STUN response to " << pkt.from << std::endl;
+                LOG(DEBUG) << "SwitchAgent: sent STUN response to " << pkt.from << std::endl;
 
             } else {
 
-                Log(Log::ERROR) << "SwitchAgent: STUN validation failed: from=" << pkt.from
-                                << ", error=" << stunResult.message << std::endl;
+                LOG(ERROR) << "SwitchAgent: STUN validation failed: from=" << pkt.from
+                           << ", error=" << stunResult.message << std::endl;
             }
         }
 
+        //! keeps the template dependency structure of a sender's stream, the data plane punts
+        //! descriptors without a structure and those that change it
         void _handleAV1(DataPlane& dataPlane, DataPlane::PktIn& pkt) {
 
             const auto* rtp = reinterpret_cast<const rtp::hdr*>(pkt.buf);
@@ -391,31 +459,59 @@ namespace p4sfu {
             av1::DependencyDescriptor av1;
 
             if (av1Ptr == nullptr) {
-                Log(Log::ERROR) << "SwitchAgent: _handleAV1: no AV1 extension found" << std::endl;
+                LOG(ERROR) << "SwitchAgent: _handleAV1: no AV1 extension found" << std::endl;
+                return;
             }
 
-            if (rtp->extension_profile() == rtp::ext_profile::one_byte) {
-                const auto* ext = reinterpret_cast<const rtp::one_byte_extension_hdr*>(av1Ptr);
-                av1 = av1::DependencyDescriptor{av1Ptr + 1, ext->len()};
-            } else if (rtp->extension_profile() == rtp::ext_profile::two_byte) {
-                const auto* ext = reinterpret_cast<const rtp::two_byte_extension_hdr*>(av1Ptr);
-                av1 = av1::DependencyDescriptor{av1Ptr + 2, ext->len()};
-            } else {
-                Log(Log::ERROR) << "SwitchAgent: _handleAV1: unknown extension profile" << std::endl;
+            auto sendStream = _state.getSendStream(pkt.from, ntohl(rtp->ssrc));
+            const av1::DependencyDescriptor::template_dependency_structure* structure = nullptr;
+
+            if (sendStream != _state.sendStreams().end() && sendStream->second.av1Structure) {
+                structure = &*sendStream->second.av1Structure;
+            }
+
+            try {
+                // the one-byte header holds the length minus one
+                if (rtp->extension_profile() == rtp::ext_profile::one_byte) {
+                    av1 = av1::DependencyDescriptor{
+                        av1Ptr + 1, rtp::ext_len(av1Ptr, rtp::ext_profile::one_byte), structure
+                    };
+                } else if (rtp->extension_profile() == rtp::ext_profile::two_byte) {
+                    av1 = av1::DependencyDescriptor{
+                        av1Ptr + 2, rtp::ext_len(av1Ptr, rtp::ext_profile::two_byte), structure
+                    };
+                } else {
+                    LOG(ERROR) << "SwitchAgent: _handleAV1: unknown extension profile" << std::endl;
+                    return;
+                }
+            } catch (std::invalid_argument& e) {
+                LOG(WARN) << "SwitchAgent: _handleAV1: malformed dependency descriptor: "
+                          << e.what() << std::endl;
                 return;
             }
 
-            Log(Log::INFO) << "SwitchAgent: _handleAV1: av1_dd: "
-                            << (av1.mandatoryFields().startOfFrame() ? "start, " : "")
-                            << (av1.mandatoryFields().endOfFrame() ? "end, " : "")
-                            << "tpl_id=" << av1.mandatoryFields().templateId()
-                            << ", frame_num=" << av1.mandatoryFields().frameNumber()
-                            << std::endl;
+            LOG(INFO) << "SwitchAgent: _handleAV1: av1_dd: "
+                      << (av1.mandatoryFields().startOfFrame() ? "start, " : "")
+                      << (av1.mandatoryFields().endOfFrame() ? "end, " : "")
+                      << "tpl_id=" << av1.mandatoryFields().templateId()
+                      << ", frame_num=" << av1.mandatoryFields().frameNumber()
+                      << std::endl;
+
+            if (!av1.structure()) {
+                return;
+            }
+
+            if (sendStream == _state.sendStreams().end()) {
+                LOG(WARN) << "SwitchAgent: _handleAV1: no send stream: from=" << pkt.from
+                          << ", ssrc=" << ntohl(rtp->ssrc) << std::endl;
+            } else {
+                sendStream->second.av1Structure = *av1.structure();
+            }
 
             std::stringstream ss;
 
-            for (const auto& [id, tpl]: av1.templates()) {
-                ss << " - id=" << id << ", spatial_layer_id=" << tpl.spatial_layer_id
+            for (const auto& tpl: av1.templates()) {
+                ss << " - id=" << tpl.id << ", spatial_layer_id=" << tpl.spatial_layer_id
                    << ", temporal_layer_id=" << tpl.temporal_layer_id << ", dtis=[ ";
                 for (const auto& dti: tpl.dtis) {
                     ss << av1::dtiString[dti] << " ";
@@ -423,19 +519,35 @@ namespace p4sfu {
                 ss << "]" << std::endl;
             }
 
-            Log(Log::DEBUG) << "SwitchAgent: _handleAV1: av1 ext. desc.: " << std::endl << ss.str();
+            LOG(DEBUG) << "SwitchAgent: _handleAV1: av1 ext. desc.: " << std::endl << ss.str();
         }
 
         void _handleRTCP(DataPlane& dataPlane, DataPlane::PktIn& pkt) {
 
-            for (auto bytesRem = pkt.len; bytesRem > 0;) {
+            rtcp::compound packets{pkt.buf, pkt.len};
+
+            if (packets.truncated()) {
+                LOG(WARN) << "SwitchAgent: _handleRTCP: truncated compound packet: from="
+                          << pkt.from << std::endl;
+            }
+
+            for (const auto& p: packets) {
 
-                const auto* rtcp = reinterpret_cast<const rtcp::hdr*>(pkt.buf + pkt.len - bytesRem);
+                const auto* rtcp = &p;
+
+                if (!rtcp->complete()) {
+                    LOG(WARN) << "SwitchAgent: _handleRTCP: incomplete packet: pt="
+                              << static_cast<unsigned>(rtcp->pt) << std::endl;
+                    continue;
+                }
 
                 switch (static_cast<rtcp::pt>(rtcp->pt)) {
                     case rtcp::pt::rr:
                         _processReceiverReport(pkt.from, rtcp);
                         break;
+                    case rtcp::pt::sr:
+                    case rtcp::pt::sdes:
+                        break;
                     case rtcp::pt::psfb:
 
                         switch (rtcp->fb_fmt()) {
@@ -446,8 +558,8 @@ namespace p4sfu {
                                 _processReceiverEstimatedBitrate(pkt.from, rtcp);
                                 break;
                             default:
-                                Log(Log::WARN) << "SwitchAgent: _handleRTCP: unsupported psfb type "
-                                               << rtcp->fb_fmt() << std::endl;
+                                LOG(WARN) << "SwitchAgent: _handleRTCP: unsupported psfb type "
+                                          << rtcp->fb_fmt() << std::endl;
                                 break;
                         }
 
@@ -458,95 +570,152 @@ namespace p4sfu {
                             case 1:
                                 _processNegativeAcknowledgement(pkt.from, rtcp);
                                 break;
+                            case 15: // transport-cc, consumed by the data plane
+                                break;
                             default:
-                                Log(Log::WARN) << "SwitchAgent: _handleRTCP: unsupported rtpfb "
-                                               << "type " << rtcp->fb_fmt() << std::endl;
+                                LOG(WARN) << "SwitchAgent: _handleRTCP: unsupported rtpfb "
+                                          << "type " << rtcp->fb_fmt() << std::endl;
                                 break;
                         }
                         break;
 
                     default:
-                        Log(Log::WARN) << "SwitchAgent: _handleRTCP: unsupported msg." << std::endl;
+                        LOG(WARN) << "SwitchAgent: _handleRTCP: unsupported msg." << std::endl;
                         break;
                 }
-
-                bytesRem -= rtcp->byte_len();
             }
         }
 
         void _processReceiverReport(const net::IPv4Port& from, const rtcp::hdr* rtcp) {
 
             for (unsigned i = 0; i < rtcp->recep_rep_count(); i++) {
-                Log(Log::DEBUG) << "SwitchAgent: _processReceiverReport: "
-                                << "from= " << from << ", "
-                                << "sender_ssrc=" << std::dec << ntohl(rtcp->sender_ssrc) << ", "
-                                << "ssrc=" << std::dec << ntohl(rtcp->data.rr[i].ssrc) << ", "
-                                << "frac_lost=" << rtcp->data.rr[i].frac_lost() << ", "
-                                << "jitter=" << ntohl(rtcp->data.rr[i].jitter) << std::endl;
+                LOG(DEBUG) << "SwitchAgent: _processReceiverReport: "
+                           << "from= " << from << ", "
+                           << "sender_ssrc=" << std::dec << ntohl(rtcp->sender_ssrc) << ", "
+                           << "ssrc=" << std::dec << ntohl(rtcp->data.rr[i].ssrc) << ", "
+                           << "frac_lost=" << rtcp->data.rr[i].frac_lost() << ", "
+                           << "jitter=" << ntohl(rtcp->data.rr[i].jitter) << std::endl;
             }
         }
 
-        static av1::svc::L1T3::DecodeTarget _decideDecodeTarget(
-            const SwitchAgentState::ReceiveStream& stream, const unsigned bitrate) {
-
-            /*
-            auto currentTarget = stream.decodeTarget;
-            auto& history = stream.bandwidthEstimates;
-            */
+        //! one decode target per Mbps, up to the highest of the stream's structure, i.e., L1T3's
+        //! lo up to 1 Mbps, mid up to 2 Mbps, hi above
+        static unsigned _decideDecodeTarget(const SwitchAgentState::ReceiveStream& stream,
+                                            unsigned decodeTargets, unsigned bitrate) {
 
-            if (bitrate / 1e3 > 2000) { // > 2 Mbps
-                return av1::svc::L1T3::DecodeTarget::hi;
-            } else if (bitrate / 1e3 > 1000) { // > 1 Mbps
-                return av1::svc::L1T3::DecodeTarget::mid;
-            } else { // < 1 Mbps
-                return av1::svc::L1T3::DecodeTarget::lo;
+            // the delay-based estimate drops as soon as queues build up, before the
+            // receiver's loss- and REMB-based reaction
+            if (stream.delayBasedEstimate > 0) {
+                bitrate = std::min(bitrate, stream.delayBasedEstimate);
             }
+
+            auto target = bitrate > 0 ? (bitrate - 1) / 1000000 : 0;
+            return std::min(target, decodeTargets - 1);
         }
 
         void _processReceiverEstimatedBitrate(const net::IPv4Port& from, const rtcp::hdr* rtcp) {
 
             for (auto i = 0; i < rtcp->data.remb.num_ssrcs(); i++) {
 
-                Log(Log::DEBUG) << "SwitchAgent: _processReceiverEstimatedBitrate: "
-                                << "from= " << from << ", "
-                                << "ssrc=" << std::dec << ntohl(rtcp->data.remb.ssrcs[i]) << ", "
-                                << "bit_rate=" << rtcp->data.remb.bit_rate() << std::endl;
+                LOG(DEBUG) << "SwitchAgent: _processReceiverEstimatedBitrate: "
+                           << "from= " << from << ", "
+                           << "ssrc=" << std::dec << ntohl(rtcp->data.remb.ssrcs[i]) << ", "
+                           << "bit_rate=" << rtcp->data.remb.bit_rate() << std::endl;
 
 
                 const auto rsIt = _state.getReceiveStream(from, ntohl(rtcp->data.remb.ssrcs[i]));
 
                 if (rsIt == _state.receiveStreams().end()) {
 
-                    Log(Log::ERROR) << "SwitchAgent: _processReceiverEstimatedBitrate: "
-                                    << "receive stream not found: ssrc=" << std::dec
-                                    << ntohl(rtcp->data.remb.ssrcs[i]) << std::endl;
+                    LOG(ERROR) << "SwitchAgent: _processReceiverEstimatedBitrate: "
+                               << "receive stream not found: ssrc=" << std::dec
+                               << ntohl(rtcp->data.remb.ssrcs[i]) << std::endl;
                     return;
                 }
 
                 auto& receiveStream = rsIt->second;
                 receiveStream.bandwidthEstimates.push_back(rtcp->data.remb.bit_rate());
 
-                auto newTarget = _decideDecodeTarget(receiveStream, rtcp->data.remb.bit_rate());
+                _updateDecodeTarget(receiveStream, rtcp->data.remb.bit_rate());
+            }
+        }
+
+        void _applyDelayBasedEstimates() {
 
-                if (newTarget != receiveStream.decodeTarget) {
-                    Log(Log::INFO) << "SwitchAgent: _processReceiverEstimatedBitrate: "
-                                   << "changing decode target: ssrc=" << std::dec
-                                   << ntohl(rtcp->data.remb.ssrcs[i]) << ", "
-                                   << "bit_rate=" << rtcp->data.remb.bit_rate() << ", "
-                                   << "new_target=" << static_cast<unsigned>(newTarget)
-                                   << std::endl;
+            for (const auto& st: _dataPlane->streamStatistics()) {
+                for (const auto& r: st.receivers) {
 
-                    // update state:
-                    receiveStream.decodeTarget = newTarget;
+                    const auto rsIt = _state.getReceiveStream(r.to, st.ssrc);
 
-                    // change decode target in data plane:
-                    _adjustDecodeTarget(receiveStream.sessionId, receiveStream.ssrc,
-                                        receiveStream.receivingParticipant,
-                                        static_cast<unsigned>(newTarget));
+                    if (rsIt == _state.receiveStreams().end()
+                        || rsIt->second.type != MediaType::video || rsIt->second.rtx) {
+                        continue;
+                    }
+
+                    auto& receiveStream = rsIt->second;
+
+                    // the receiver's estimator is gone, a stale estimate mustn't keep capping
+                    // its REMB
+                    if (!r.delayBasedEstimate) {
+
+                        if (receiveStream.delayBasedEstimate > 0) {
+                            receiveStream.delayBasedEstimate = 0;
+
+                            if (!receiveStream.bandwidthEstimates.empty()) {
+                                _updateDecodeTarget(receiveStream,
+                                                    receiveStream.bandwidthEstimates.back());
+                            }
+                        }
+
+                        continue;
+                    }
+
+                    receiveStream.delayBasedEstimate = (unsigned) std::min<unsigned long>(
+                        *r.delayBasedEstimate, std::numeric_limits<unsigned>::max());
+
+                    LOG(DEBUG) << "SwitchAgent: _applyDelayBasedEstimates: to=" << r.to
+                               << ", ssrc=" << st.ssrc << ", bit_rate="
+                               << receiveStream.delayBasedEstimate << std::endl;
+
+                    // without a REMB yet, the delay-based estimate alone decides
+                    _updateDecodeTarget(receiveStream,
+                                        receiveStream.bandwidthEstimates.empty()
+                                            ? receiveStream.delayBasedEstimate
+                                            : receiveStream.bandwidthEstimates.back());
                 }
             }
         }
 
+        void _updateDecodeTarget(SwitchAgentState::ReceiveStream& receiveStream,
+                                 unsigned bitrate) {
+
+            auto sendStream = _state.sendStreams().find(receiveStream.sendStreamId);
+
+            if (sendStream == _state.sendStreams().end()) {
+                return;
+            }
+
+            auto decodeTargets = sendStream->second.decodeTargets();
+            auto newTarget = _decideDecodeTarget(receiveStream, decodeTargets, bitrate);
+
+            // until one is chosen, the receiver gets all frames, i.e., the highest target
+            if (newTarget != receiveStream.decodeTarget.value_or(decodeTargets - 1)) {
+                Log(Log::INFO) << "SwitchAgent: _updateDecodeTarget: "
+                               << "changing decode target: ssrc=" << std::dec
+                               << receiveStream.ssrc << ", "
+                               << "bit_rate=" << bitrate << ", "
+                               << "delay_based_estimate=" << receiveStream.delayBasedEstimate
+                               << ", new_target=" << newTarget << std::endl;
+
+                // update state:
+                receiveStream.decodeTarget = newTarget;
+
+                // change decode target in data plane:
+                _adjustDecodeTarget(receiveStream.sessionId, receiveStream.ssrc,
+                                    receiveStream.receivingParticipant, newTarget);
+            }
+        }
+
         void _processPictureLossIndication(const net::IPv4Port& from, const rtcp::hdr* rtcp) {
 
             Log(Log::INFO) << "SwitchAgent: _processPictureLossIndication: "
@@ -576,6 +745,15 @@ namespace p4sfu {
             j["type"] = "streams";
             j["data"]["streams"] = json::json::array();
 
+            // data-plane counters keyed by sender address and SSRC
+            auto stats = _dataPlane->streamStatistics();
+            std::map<std::tuple<std::uint32_t, std::uint16_t, SSRC>, const StreamStatistics*>
+                statsByStream;
+
+            for (const auto& st: stats) {
+                statsByStream[{st.from.ip().num(), st.from.port(), st.ssrc}] = &st;
+            }
+
             for (const auto& [_, stream]: _state.sendStreams()) {
 
                 auto sendStreamJson = json::json::object({
@@ -589,6 +767,29 @@ namespace p4sfu {
                      { "rtx", stream.rtx }
                 });
 
+                auto st = statsByStream.find({stream.addr.ip().num(), stream.addr.port(),
+                                              stream.ssrc});
+
+                if (st != statsByStream.end()) {
+                    sendStreamJson["pkts"] = st->second->pkts;
+                    sendStreamJson["bytes"] = st->second->bytes;
+
+                    if (st->second->nackCache) {
+                        sendStreamJson["nack_cache"] = json::json::object({
+                            { "hits", st->second->nackCache->hits },
+                            { "misses", st->second->nackCache->misses }
+                        });
+                    }
+
+                    if (st->second->keyframeRequests) {
+                        sendStreamJson["pli"] = json::json::object({
+                            { "forwarded", st->second->keyframeRequests->forwarded },
+                            { "suppressed", st->second->keyframeRequests->suppressed },
+                            { "keyframes", st->second->keyframeRequests->keyframes }
+                        });
+                    }
+                }
+
                 for (auto receiveStreamId: stream.receiveStreamIds) {
 
                     const auto& receiveStreamIt = _state.receiveStreams().find(receiveStreamId);
@@ -604,7 +805,36 @@ namespace p4sfu {
 
                         if (stream.type == MediaType::video && !stream.rtx) {
                             receiveStreamJson["decode_target"]
-                                = (unsigned) receiveStream.decodeTarget;
+                                = receiveStream.decodeTarget.value_or(stream.decodeTargets() - 1);
+                        }
+
+                        if (st != statsByStream.end()) {
+                            for (const auto& r: st->second->receivers) {
+                                if (r.to == receiveStream.addr) {
+                                    receiveStreamJson["pkts"] = r.pkts;
+                                    receiveStreamJson["bytes"] = r.bytes;
+                                    receiveStreamJson["svc_dropped"] = r.svcDropped;
+                                    receiveStreamJson["undecodable_dropped"] = r.undecodableDropped;
+                                    receiveStreamJson["rewritten"] = r.rewritten;
+                                    receiveStreamJson["retransmitted"] = r.retransmitted;
+
+                                    if (r.delayBasedEstimate) {
+                                        receiveStreamJson["delay_based_estimate"]
+                                            = *r.delayBasedEstimate;
+                                    }
+
+                                    if (r.pacing) {
+                                        receiveStreamJson["pacing"] = json::json::object({
+                                            { "rate", r.pacing->rate },
+                                            { "delayed", r.pacing->delayed },
+                                            { "dropped", r.pacing->dropped },
+                                            { "queueing_delay_us", r.pacing->queueingDelayUs },
+                                            { "max_queueing_delay_us",
+                                              r.pacing->maxQueueingDelayUs }
+                                        });
+                                    }
+                                }
+                            }
                         }
 
                         sendStreamJson["receivers"].push_back(receiveStreamJson);
@@ -646,6 +876,31 @@ namespace p4sfu {
 
         #pragma mark etc:
 
+        void _sendAggregateEstimates() {
+
+            unsigned char buf[rtcp::REMB_LEN];
+
+            for (const auto& [id, sendStream]: _state.sendStreams()) {
+
+                if (sendStream.type != MediaType::video || sendStream.rtx) {
+                    continue;
+                }
+
+                auto estimate = _state.aggregateEstimate(id);
+
+                if (!estimate) {
+                    continue;
+                }
+
+                rtcp::write_remb(buf, estimate->rtcpSsrc, sendStream.ssrc, estimate->bitRate);
+                _dataPlane->sendPacket(DataPlane::PktOut{sendStream.addr, buf, sizeof(buf)});
+
+                LOG(DEBUG) << "SwitchAgent: _sendAggregateEstimates: to=" << sendStream.addr
+                           << ", ssrc=" << sendStream.ssrc << ", bit_rate=" << estimate->bitRate
+                           << std::endl;
+            }
+        }
+
         void _onTimer(Timer& t) {
 
             if (_dataPlane->totalStatistics().pkts > 0) {
@@ -655,11 +910,15 @@ namespace p4sfu {
                                << "rtpPkts=" << _dataPlane->totalStatistics().rtpPkts << ", "
                                << "rtcpPkts=" << _dataPlane->totalStatistics().rtcpPkts << ", "
                                << "stunPkts=" << _dataPlane->totalStatistics().stunPkts << ", "
-                               // << "frames=" << _dataPlane->totalStatistics().frames << ", "
+                               << "frames=" << _dataPlane->totalStatistics().frames << ", "
                                << "av1SimpleDescriptors="
                                << _dataPlane->totalStatistics().av1SimpleDescriptors << ", "
                                << "av1ExtendedDescriptors="
-                               << _dataPlane->totalStatistics().av1ExtendedDescriptors
+                               << _dataPlane->totalStatistics().av1ExtendedDescriptors << ", "
+                               << "rtcpPuntsSuppressed="
+                               << _dataPlane->totalStatistics().rtcpPuntsSuppressed << ", "
+                               << "av1PuntsSuppressed="
+                               << _dataPlane->totalStatistics().av1PuntsSuppressed
                                << std::endl;
             }
         }
@@ -4,6 +4,7 @@
 #include <vector>
 #include <unordered_map>
 #include <algorithm>
+#include <optional>
 
 #include "p4sfu.h"
 #include "net/net.h"
@@ -26,13 +27,39 @@ namespace p4sfu {
 
         struct SendStream : Stream {
             std::vector<unsigned> receiveStreamIds = {};
+            //! latest AV1 template dependency structure, resolves the frame dependencies of
+            //! descriptors that don't carry one
+            std::optional<av1::DependencyDescriptor::template_dependency_structure> av1Structure
+                = std::nullopt;
+
+            //! decode targets receivers can choose from, L1T3's until the first structure, like
+            //! the data plane
+            [[nodiscard]] unsigned decodeTargets() const {
+
+                if (!av1Structure) {
+                    return av1::svc::L1T3Structure::DECODE_TARGETS;
+                }
+
+                return std::min(av1Structure->dt_cnt, av1::DropTable::MAX_DECODE_TARGETS);
+            }
         };
 
         struct ReceiveStream : Stream {
             unsigned sendStreamId                     = 0;
             unsigned receivingParticipant             = 0;
-            av1::svc::L1T3::DecodeTarget decodeTarget = av1::svc::L1T3::DecodeTarget::hi;
+            //! index into the decode targets of the send stream's structure, none: all frames
+            std::optional<unsigned> decodeTarget      = std::nullopt;
             std::vector<unsigned> bandwidthEstimates  = {};
+            //! delay-based estimate of the data plane in bits per second, 0: none
+            unsigned delayBasedEstimate               = 0;
+            //! SSRC the receiver sends RTCP with
+            SSRC rtcpSsrc                             = 0;
+        };
+
+        struct BandwidthEstimate {
+            unsigned bitRate = 0;
+            //! RTCP SSRC of the receiver the estimate comes from
+            SSRC rtcpSsrc    = 0;
         };
 
 
@@ -93,7 +120,7 @@ namespace p4sfu {
 
         void addReceiveStream(unsigned sessionId, unsigned fromParticipantId,
                               unsigned toParticipantId, const net::IPv4Port& addr,
-                              SSRC mainSSRC, SSRC rtxSSRC = 0) {
+                              SSRC mainSSRC, SSRC rtxSSRC = 0, SSRC rtcpSSRC = 0) {
 
             auto mainSendStreamIt = getSendStream(sessionId, mainSSRC);
 
@@ -113,6 +140,7 @@ namespace p4sfu {
             r1.type                       = mainSendStreamIt->second.type;
             r1.sendStreamId               = mainSendStreamIt->first;
             r1.sendingParticipant         = mainSendStreamIt->second.sendingParticipant;
+            r1.rtcpSsrc                   = rtcpSSRC;
             _receiveStreams[mainStreamId] = r1;
 
             mainSendStreamIt->second.receiveStreamIds.push_back(mainStreamId);
@@ -157,6 +185,50 @@ namespace p4sfu {
             });
         }
 
+        [[nodiscard]] SendStreamIterator getSendStream(const net::IPv4Port& from, SSRC ssrc) {
+
+            return std::ranges::find_if(_sendStreams,
+            [&](const std::pair<unsigned, SendStream>& s) {
+                return std::tie(s.second.addr, s.second.ssrc) == std::tie(from, ssrc);
+            });
+        }
+
+        //! returns the bandwidth estimate for the sender of a send stream: the lowest latest
+        //! estimate of the receivers on the highest decode target any receiver gets, receivers on
+        //! lower decode targets get a thinned stream and don't constrain the encoder
+        [[nodiscard]] std::optional<BandwidthEstimate>
+        aggregateEstimate(unsigned sendStreamId) const {
+
+            auto sendStreamIt = _sendStreams.find(sendStreamId);
+
+            if (sendStreamIt == _sendStreams.end()) {
+                return std::nullopt;
+            }
+
+            std::optional<BandwidthEstimate> estimate;
+            unsigned top = 0;
+
+            for (auto id: sendStreamIt->second.receiveStreamIds) {
+
+                const auto& r = _receiveStreams.at(id);
+                // decode targets are ordered by the layers they hold, all frames is the highest
+                auto target = r.decodeTarget.value_or(av1::DropTable::MAX_DECODE_TARGETS);
+
+                if (r.bandwidthEstimates.empty() || target < top) {
+                    continue;
+                }
+
+                if (!estimate || target > top
+                    || r.bandwidthEstimates.back() < estimate->bitRate) {
+                    estimate = BandwidthEstimate{r.bandwidthEstimates.back(), r.rtcpSsrc};
+                }
+
+                top = target;
+            }
+
+            return estimate;
+        }
+
         [[nodiscard]] const std::unordered_map<unsigned, ReceiveStream>& receiveStreams() const {
 
             return _receiveStreams;
@@ -2,8 +2,14 @@
 #ifndef P4SFU_SWITCH_STATISTICS_H
 #define P4SFU_SWITCH_STATISTICS_H
 
+#include <atomic>
 #include <iostream>
+#include <optional>
 #include <unordered_map>
+#include <vector>
+
+#include "net/net.h"
+#include "p4sfu.h"
 
 namespace p4sfu {
 
@@ -16,6 +22,116 @@ namespace p4sfu {
         unsigned long frames                 = 0;
         unsigned long av1SimpleDescriptors   = 0;
         unsigned long av1ExtendedDescriptors = 0;
+        //! receiver reports not punted to the switch agent
+        unsigned long rtcpPuntsSuppressed    = 0;
+        //! extended AV1 descriptors not punted since they repeat the structure
+        unsigned long av1PuntsSuppressed     = 0;
+    };
+
+    //! packet counter with a single writing thread, readable from any thread
+    //! - increments are a relaxed load and store instead of an atomic read-modify-write, so the
+    //!   packet path pays no locked instruction
+    class Counter {
+    public:
+
+        Counter() = default;
+
+        Counter(const Counter& other) : _value(other.get()) { }
+
+        void add(unsigned long n = 1) {
+            _value.store(_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] unsigned long get() const {
+            return _value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<unsigned long> _value = 0;
+    };
+
+    //! counters behind TotalPacketStatistics, written by a single packet-processing thread
+    struct TotalPacketCounters {
+        Counter pkts;
+        Counter bytes;
+        Counter stunPkts;
+        Counter rtcpPkts;
+        Counter rtpPkts;
+        Counter frames;
+        Counter av1SimpleDescriptors;
+        Counter av1ExtendedDescriptors;
+        Counter rtcpPuntsSuppressed;
+        Counter av1PuntsSuppressed;
+
+        [[nodiscard]] TotalPacketStatistics snapshot() const {
+            return TotalPacketStatistics{
+                .pkts                   = pkts.get(),
+                .bytes                  = bytes.get(),
+                .stunPkts               = stunPkts.get(),
+                .rtcpPkts               = rtcpPkts.get(),
+                .rtpPkts                = rtpPkts.get(),
+                .frames                 = frames.get(),
+                .av1SimpleDescriptors   = av1SimpleDescriptors.get(),
+                .av1ExtendedDescriptors = av1ExtendedDescriptors.get(),
+                .rtcpPuntsSuppressed    = rtcpPuntsSuppressed.get(),
+                .av1PuntsSuppressed     = av1PuntsSuppressed.get()
+            };
+        }
+    };
+
+    //! snapshot of the counters of one SFU table match and its actions
+    struct StreamStatistics {
+
+        struct Receiver {
+            net::IPv4Port to;
+            //! packets and bytes sent to the receiver
+            unsigned long pkts       = 0;
+            unsigned long bytes      = 0;
+            //! packets not sent because of the receiver's SVC decode target
+            unsigned long svcDropped = 0;
+            //! packets not sent since the receiver couldn't decode their frames
+            unsigned long undecodableDropped = 0;
+            //! packets sent with a rewritten sequence number
+            unsigned long rewritten  = 0;
+            //! NACKed packets resent to the receiver from the retransmission cache
+            unsigned long retransmitted = 0;
+            //! egress pacing of the receiver's address, shared by all streams sent to it
+            struct Pacing {
+                //! pacing rate in bits per second
+                unsigned long rate               = 0;
+                //! packets that waited for the bucket and packets dropped from the queue
+                unsigned long delayed            = 0;
+                unsigned long dropped            = 0;
+                //! mean over all paced packets and maximum queueing delay
+                unsigned long queueingDelayUs    = 0;
+                unsigned long maxQueueingDelayUs = 0;
+            };
+            std::optional<Pacing> pacing = std::nullopt;
+            //! delay-based bandwidth estimate of the receiver's address from its transport-cc
+            //! feedback in bits per second, shared by all streams sent to it
+            std::optional<unsigned long> delayBasedEstimate = std::nullopt;
+        };
+
+        net::IPv4Port from;
+        SSRC ssrc = 0;
+        //! packets and bytes received on the match
+        unsigned long pkts = 0;
+        unsigned long bytes = 0;
+        //! NACKed packets found and not found in the match's retransmission cache
+        struct NACKCache {
+            unsigned long hits   = 0;
+            unsigned long misses = 0;
+        };
+        std::optional<NACKCache> nackCache = std::nullopt;
+        //! PLIs forwarded to the sender, PLIs suppressed while a keyframe was outstanding and
+        //! keyframes received on the match
+        struct KeyframeRequests {
+            unsigned long forwarded  = 0;
+            unsigned long suppressed = 0;
+            unsigned long keyframes  = 0;
+        };
+        std::optional<KeyframeRequests> keyframeRequests = std::nullopt;
+        std::vector<Receiver> receivers;
     };
 }
 
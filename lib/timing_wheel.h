@@ -0,0 +1,125 @@
+
+#ifndef P4SFU_TIMING_WHEEL_H
+#define P4SFU_TIMING_WHEEL_H
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace p4sfu {
+
+    //! hierarchical timing wheel with three levels of 256 slots
+    //! - time is counted in ticks, the tick duration is up to the user
+    //! - level 0 resolves single ticks over the next 256 ticks, level 1 and 2 cover 2^16 and 2^24
+    //!   ticks with coarser slots whose items are cascaded to the next lower level when the wheel
+    //!   reaches them; deadlines further out are clamped to the end of level 2
+    //! - schedule() and firing an item are O(1), advance() is O(elapsed ticks) while items are
+    //!   pending and O(1) when the wheel is empty
+    template <typename T>
+    class TimingWheel {
+    public:
+
+        explicit TimingWheel(std::uint64_t now = 0) : _now(now) { }
+
+        //! schedules item to fire at tick deadline, deadlines not after now fire on the next tick
+        void schedule(T item, std::uint64_t deadline) {
+
+            if (deadline <= _now) {
+                deadline = _now + 1;
+            } else if (deadline - _now >= _LEVEL_SPAN[_LEVELS - 1]) {
+                deadline = _now + _LEVEL_SPAN[_LEVELS - 1] - 1;
+            }
+
+            _insert(std::move(item), deadline);
+            _size++;
+        }
+
+        //! advances the wheel to tick now and calls f(T&&) for all items that became due, in
+        //! order of their deadlines
+        template <typename F>
+        void advance(std::uint64_t now, F&& f) {
+
+            while (_now < now) {
+
+                if (_size == 0) { // nothing to cascade or fire, skip the idle ticks
+                    _now = now;
+                    return;
+                }
+
+                _now++;
+
+                // refill the lower levels from the slot of the higher level the wheel just reached
+                for (unsigned l = _LEVELS - 1; l > 0; l--) {
+                    if ((_now & (_LEVEL_SPAN[l - 1] - 1)) == 0) {
+                        _cascade(l);
+                    }
+                }
+
+                auto& slot = _levels[0][_now & _SLOT_MASK];
+                auto due = std::move(slot);
+                slot.clear();
+                _size -= due.size();
+
+                for (auto& d: due) {
+                    f(std::move(d.second));
+                }
+            }
+        }
+
+        [[nodiscard]] std::uint64_t now() const {
+            return _now;
+        }
+
+        //! number of scheduled items
+        [[nodiscard]] std::size_t size() const {
+            return _size;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return _size == 0;
+        }
+
+    private:
+
+        static constexpr unsigned _LEVELS = 3;
+        static constexpr unsigned _SLOT_BITS = 8;
+        static constexpr std::uint64_t _SLOT_MASK = (1u << _SLOT_BITS) - 1;
+        //! number of ticks covered by each level
+        static constexpr std::uint64_t _LEVEL_SPAN[_LEVELS] = {
+            1ull << _SLOT_BITS, 1ull << (2 * _SLOT_BITS), 1ull << (3 * _SLOT_BITS)
+        };
+
+        using Slot = std::vector<std::pair<std::uint64_t, T>>;
+
+        void _insert(T&& item, std::uint64_t deadline) {
+
+            auto delta = deadline - _now;
+            unsigned l = 0;
+
+            while (l < _LEVELS - 1 && delta >= _LEVEL_SPAN[l]) {
+                l++;
+            }
+
+            auto slot = (deadline >> (l * _SLOT_BITS)) & _SLOT_MASK;
+            _levels[l][slot].emplace_back(deadline, std::move(item));
+        }
+
+        void _cascade(unsigned l) {
+
+            auto& slot = _levels[l][(_now >> (l * _SLOT_BITS)) & _SLOT_MASK];
+            auto items = std::move(slot);
+            slot.clear();
+
+            for (auto& i: items) {
+                _insert(std::move(i.second), i.first);
+            }
+        }
+
+        std::uint64_t _now;
+        std::size_t _size = 0;
+        std::array<std::array<Slot, 1u << _SLOT_BITS>, _LEVELS> _levels;
+    };
+}
+
+#endif
@@ -41,8 +41,8 @@ p4sfu::TofinoDataPlane::TofinoDataPlane(boost::asio::io_context* io, DataPlane::
 
 void p4sfu::TofinoDataPlane::sendPacket(const p4sfu::DataPlane::PktOut& pkt) {
 
-    Log(Log::DEBUG) << "TofinoDataPlane: sendPacket: received pkt-out: to=" << pkt.to
-                    << ", l7_bytes=" << util::hexString(pkt.buf, pkt.len, 4) << std::endl;
+    LOG(DEBUG) << "TofinoDataPlane: sendPacket: received pkt-out: to=" << pkt.to
+               << ", l7_bytes=" << util::hexString(pkt.buf, pkt.len, 4) << std::endl;
 
     unsigned char buf[1024] = {0};
     unsigned offset = 0;
@@ -72,8 +72,8 @@ void p4sfu::TofinoDataPlane::sendPacket(const p4sfu::DataPlane::PktOut& pkt) {
 
     _dataPlaneInterface.inject(buf, pkt.len + offset);
 
-    Log(Log::DEBUG) << "TofinoDataPlane: sendPacket: sent pkt-out: len=" << pkt.len + offset
-                    << ", bytes=" << util::hexString(buf, pkt.len + offset, 4) << std::endl;
+    LOG(DEBUG) << "TofinoDataPlane: sendPacket: sent pkt-out: len=" << pkt.len + offset
+               << ", bytes=" << util::hexString(buf, pkt.len + offset, 4) << std::endl;
 }
 
 void p4sfu::TofinoDataPlane::addStream(const p4sfu::DataPlane::Stream& s) {
@@ -201,9 +201,9 @@ void p4sfu::TofinoDataPlane::_onDataPlanePacket(FileDescriptor& fd) {
 
     if (_dataPlaneInterface.next(pkt)) {
 
-        Log(Log::DEBUG) << "TofinoDataPlane: _onDataPlanePacket: fd=" << fd.fd() << ", frame_len="
-                        << pkt.frame_len << ", bytes=" << util::hexString(pkt.buf, pkt.frame_len, 4)
-                        << std::endl;
+        LOG(DEBUG) << "TofinoDataPlane: _onDataPlanePacket: fd=" << fd.fd() << ", frame_len="
+                   << pkt.frame_len << ", bytes=" << util::hexString(pkt.buf, pkt.frame_len, 4)
+                   << std::endl;
 
         // for testing: set to 4 when sniffing from loopback
         unsigned offset = 0;
@@ -238,22 +238,22 @@ void p4sfu::TofinoDataPlane::_onDataPlanePacket(FileDescriptor& fd) {
                         _handleRTP(pktInFrom, payload, payloadLen);
                     }
                 } else {
-                    Log(Log::ERROR) << "TofinoDataPlane: _onDataPlanePacket: unknown payload"
-                                    << std::endl;
+                    LOG(ERROR) << "TofinoDataPlane: _onDataPlanePacket: unknown payload"
+                               << std::endl;
                 }
             }
         }
 
     } else {
-        Log(Log::ERROR) << "TofinoDataPlane: _onDataPlanePacket: failed pcap_interface::next"
-                        << std::endl;
+        LOG(ERROR) << "TofinoDataPlane: _onDataPlanePacket: failed pcap_interface::next"
+                   << std::endl;
     }
 }
 
 void p4sfu::TofinoDataPlane::_handleSTUN(const net::IPv4Port& from, const unsigned char* buf,
                                          std::size_t len) {
 
-    Log(Log::DEBUG) << "TofinoDataPlane: _handleSTUN: from=" << from << std::endl;
+    LOG(DEBUG) << "TofinoDataPlane: _handleSTUN: from=" << from << std::endl;
 
     try {
         _controlPlanePacketHandler(*this, PktIn{PktIn::Reason::stun, from, buf, len});
@@ -265,8 +265,8 @@ void p4sfu::TofinoDataPlane::_handleSTUN(const net::IPv4Port& from, const unsign
 void p4sfu::TofinoDataPlane::_handleRTP(const net::IPv4Port& from, const unsigned char* buf,
                                         std::size_t len) {
 
-    Log(Log::DEBUG) << "TofinoDataPlane: _handleRTP: from=" << from << std::endl;
-    Log(Log::DEBUG) << "TofinoDataPlane:   - not implemented" << std::endl;
+    LOG(DEBUG) << "TofinoDataPlane: _handleRTP: from=" << from << std::endl;
+    LOG(DEBUG) << "TofinoDataPlane:   - not implemented" << std::endl;
 
     /*
     try {
@@ -280,8 +280,8 @@ void p4sfu::TofinoDataPlane::_handleRTP(const net::IPv4Port& from, const unsigne
 void p4sfu::TofinoDataPlane::_handleRTCP(const net::IPv4Port& from, const unsigned char* buf,
                                          std::size_t len) {
 
-    Log(Log::DEBUG) << "TofinoDataPlane: _handleRTCP: from=" << from << std::endl;
-    Log(Log::DEBUG) << "TofinoDataPlane:   - not implemented" << std::endl;
+    LOG(DEBUG) << "TofinoDataPlane: _handleRTCP: from=" << from << std::endl;
+    LOG(DEBUG) << "TofinoDataPlane:   - not implemented" << std::endl;
 
     /*
     try {
@@ -0,0 +1,306 @@
+
+#include "transport_feedback.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "proto/rtcp.h"
+
+namespace {
+
+    //! the reference time counts multiples of 64 ms, i.e., of 256 receive delta units
+    const unsigned REFERENCE_SHIFT = 8;
+
+    std::uint16_t get16(const unsigned char* buf) {
+        return (std::uint16_t) (buf[0] << 8 | buf[1]);
+    }
+
+    void put16(unsigned char* buf, std::uint16_t v) {
+        buf[0] = (unsigned char) (v >> 8);
+        buf[1] = (unsigned char) v;
+    }
+}
+
+p4sfu::TransportFeedback::TransportFeedback(const Config& c)
+    : _config(c) {
+
+    if (_config.maxPackets == 0 || _config.maxPackets > 0xffff) {
+        throw std::invalid_argument("TransportFeedback: maxPackets must be in [1, 65535]");
+    }
+}
+
+void p4sfu::TransportFeedback::record(std::uint16_t seq, Clock::time_point arrival) {
+
+    if (!_started) {
+        _base = seq;
+        _started = true;
+        _lastFeedback = arrival;
+    }
+
+    // unwrap relative to the highest sequence number so far
+    auto highest = _base + (std::int64_t) _arrivals.size() - 1;
+    auto s = highest + (std::int16_t) (std::uint16_t) (seq - (std::uint16_t) highest);
+
+    if (s < _base) { // already reported
+        return;
+    }
+
+    auto i = (std::size_t) (s - _base);
+
+    // a jump far ahead, e.g., after the sender restarted: start over
+    if (i >= 4 * _config.maxPackets) {
+        _arrivals.clear();
+        _base = s;
+        i = 0;
+    }
+
+    if (i >= _arrivals.size()) {
+        _arrivals.resize(i + 1);
+    }
+
+    _arrivals[i] = arrival;
+}
+
+bool p4sfu::TransportFeedback::due(Clock::time_point now) const {
+
+    return !_arrivals.empty()
+        && (now - _lastFeedback >= _config.interval || _arrivals.size() >= _config.maxPackets);
+}
+
+bool p4sfu::TransportFeedback::pending() const {
+
+    return !_arrivals.empty();
+}
+
+std::size_t p4sfu::TransportFeedback::write(unsigned char* buf, std::size_t len, SSRC mediaSsrc,
+                                            Clock::time_point now) {
+
+    auto first = std::find_if(_arrivals.begin(), _arrivals.end(), [](Clock::time_point t) {
+        return t != Clock::time_point{};
+    });
+
+    if (first == _arrivals.end()) {
+        return 0;
+    }
+
+    // the first receive delta is relative to the reference time
+    auto reference = _ticks(*first) >> REFERENCE_SHIFT;
+    auto last = reference << REFERENCE_SHIFT;
+
+    _symbols.clear();
+    _deltas.clear();
+
+    std::size_t n = 0, deltaBytes = 0;
+
+    for (; n < _arrivals.size() && n < 0xffff; n++) {
+
+        auto symbol = notReceived;
+        std::int64_t delta = 0;
+
+        if (_arrivals[n] != Clock::time_point{}) {
+
+            delta = _ticks(_arrivals[n]) - last;
+
+            if (delta >= 0 && delta <= 0xff) {
+                symbol = smallDelta;
+            } else if (delta >= std::numeric_limits<std::int16_t>::min()
+                       && delta <= std::numeric_limits<std::int16_t>::max()) {
+                symbol = largeDelta;
+            } else {
+                break; // reported relative to a new reference time in the next packet
+            }
+        }
+
+        // at most one chunk per 7 packets, up to 3 bytes of padding
+        auto bytes = deltaBytes + symbol;
+
+        if (BASE_LEN + 2 * ((n + 7) / 7) + bytes + 3 > len) {
+            break;
+        }
+
+        _symbols.push_back(symbol);
+        deltaBytes = bytes;
+
+        if (symbol != notReceived) {
+            _deltas.push_back(delta);
+            last += delta;
+        }
+    }
+
+    if (n == 0 || _deltas.empty()) {
+        return 0;
+    }
+
+    auto off = BASE_LEN + _writeChunks(buf + BASE_LEN, n);
+
+    for (auto delta: _deltas) {
+        if (delta >= 0 && delta <= 0xff) {
+            buf[off++] = (unsigned char) delta;
+        } else {
+            put16(buf + off, (std::uint16_t) delta);
+            off += 2;
+        }
+    }
+
+    // padded to 32 bits, the last byte holds the number of padding bytes
+    auto padding = (4 - off % 4) % 4;
+
+    if (padding) {
+        std::memset(buf + off, 0, padding);
+        off += padding;
+        buf[off - 1] = (unsigned char) padding;
+    }
+
+    const std::uint32_t words[BASE_LEN / 4] = {
+        // version 2, padding, FMT 15, RTPFB, length in 32-bit words minus one
+        htonl((0x80u | (padding ? 0x20u : 0) | 15) << 24
+              | static_cast<std::uint32_t>(rtcp::pt::rtpfb) << 16 | (std::uint32_t) (off / 4 - 1)),
+        htonl(_config.ssrc),
+        htonl(mediaSsrc),
+        htonl((std::uint32_t) (std::uint16_t) _base << 16 | (std::uint32_t) n),
+        htonl((std::uint32_t) (reference & 0xffffff) << 8 | _feedbackCount++)
+    };
+
+    std::memcpy(buf, words, BASE_LEN);
+
+    _arrivals.erase(_arrivals.begin(), _arrivals.begin() + (std::ptrdiff_t) n);
+    _base += (std::int64_t) n;
+    _lastFeedback = now;
+
+    return off;
+}
+
+bool p4sfu::TransportFeedback::parse(const unsigned char* buf, std::size_t len,
+                                     const Report& report) {
+
+    const auto* rtcp = reinterpret_cast<const rtcp::hdr*>(buf);
+
+    if (len < BASE_LEN || static_cast<rtcp::pt>(rtcp->pt) != rtcp::pt::rtpfb
+        || rtcp->fb_fmt() != 15 || rtcp->byte_len() > len || !rtcp->complete()) {
+        return false;
+    }
+
+    len = rtcp->byte_len();
+
+    if (rtcp->padding()) {
+
+        if (buf[len - 1] == 0 || buf[len - 1] > len - BASE_LEN) {
+            return false;
+        }
+
+        len -= buf[len - 1];
+    }
+
+    auto base = ntohs(rtcp->data.twcc.base_seq);
+    auto count = ntohs(rtcp->data.twcc.status_count);
+
+    // packet status chunks
+    std::vector<std::uint8_t> symbols;
+    symbols.reserve(count);
+
+    auto off = BASE_LEN;
+
+    while (symbols.size() < count) {
+
+        if (off + 2 > len) {
+            return false;
+        }
+
+        auto chunk = get16(buf + off);
+        off += 2;
+
+        if (!(chunk & 0x8000)) { // run length
+            symbols.insert(symbols.end(),
+                           std::min<std::size_t>(chunk & 0x1fff, count - symbols.size()),
+                           (std::uint8_t) ((chunk >> 13) & 0x03));
+        } else if (!(chunk & 0x4000)) { // status vector of 14 1-bit symbols
+            for (int i = 13; i >= 0 && symbols.size() < count; i--) {
+                symbols.push_back((chunk >> i) & 0x01);
+            }
+        } else { // status vector of 7 2-bit symbols
+            for (int i = 12; i >= 0 && symbols.size() < count; i -= 2) {
+                symbols.push_back((chunk >> i) & 0x03);
+            }
+        }
+    }
+
+    // receive deltas
+    std::size_t deltaBytes = 0;
+
+    for (auto s: symbols) {
+        if (s == 3) { // reserved
+            return false;
+        }
+        deltaBytes += s;
+    }
+
+    if (off + deltaBytes > len) {
+        return false;
+    }
+
+    auto ticks = (std::int64_t) rtcp->data.twcc.reference_time() << REFERENCE_SHIFT;
+
+    for (std::size_t i = 0; i < count; i++) {
+
+        auto seq = (std::uint16_t) (base + i);
+
+        if (symbols[i] == notReceived) {
+            report(seq, std::nullopt);
+            continue;
+        }
+
+        if (symbols[i] == smallDelta) {
+            ticks += buf[off++];
+        } else {
+            ticks += (std::int16_t) get16(buf + off);
+            off += 2;
+        }
+
+        report(seq, ticks * TICK);
+    }
+
+    return true;
+}
+
+const p4sfu::TransportFeedback::Config& p4sfu::TransportFeedback::config() const {
+
+    return _config;
+}
+
+std::int64_t p4sfu::TransportFeedback::_ticks(Clock::time_point t) {
+
+    return t.time_since_epoch() / TICK;
+}
+
+std::size_t p4sfu::TransportFeedback::_writeChunks(unsigned char* buf, std::size_t n) const {
+
+    std::size_t off = 0;
+
+    for (std::size_t i = 0; i < n;) {
+
+        auto run = (std::size_t) 1;
+
+        while (i + run < n && run < 0x1fff && _symbols[i + run] == _symbols[i]) {
+            run++;
+        }
+
+        if (run >= 7) { // run length chunk
+            put16(buf + off, (std::uint16_t) (_symbols[i] << 13 | run));
+            i += run;
+        } else { // status vector chunk of 7 2-bit symbols, unused symbols are "not received"
+            std::uint16_t chunk = 0xc000;
+
+            for (unsigned k = 0; k < 7 && i < n; k++, i++) {
+                chunk |= (std::uint16_t) (_symbols[i] << (12 - 2 * k));
+            }
+
+            put16(buf + off, chunk);
+        }
+
+        off += 2;
+    }
+
+    return off;
+}
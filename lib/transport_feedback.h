@@ -0,0 +1,94 @@
+
+#ifndef P4SFU_TRANSPORT_FEEDBACK_H
+#define P4SFU_TRANSPORT_FEEDBACK_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "p4sfu.h"
+
+namespace p4sfu {
+
+    //! transport-wide congestion control (transport-cc) feedback of a single transport
+    //! https://datatracker.ietf.org/doc/html/draft-holmer-rmcat-transport-wide-cc-extensions-01
+    //! - records the arrival times of the transport-wide sequence numbers a sender stamps its
+    //!   packets with and writes them as RTPFB FMT 15 packets for the sender's congestion control
+    //! - each sequence number is reported once, packets arriving after their report are ignored
+    //! - parse() reads the feedback packets of a receiver
+    //! - not thread-safe
+    class TransportFeedback {
+    public:
+
+        using Clock = std::chrono::steady_clock;
+
+        struct Config {
+            //! RTP header extension identifier of the transport-wide sequence number
+            unsigned rtpExt = 0;
+            //! feedback is due this long after the last one
+            Clock::duration interval = std::chrono::milliseconds(100);
+            //! feedback is due once this many sequence numbers wait to be reported
+            std::size_t maxPackets = 200;
+            //! SSRC the feedback is sent with
+            SSRC ssrc = 1;
+        };
+
+        //! called for each packet of a feedback packet with its arrival time relative to the
+        //! receiver's reference, std::nullopt if it wasn't received
+        using Report = std::function<void (std::uint16_t seq,
+                                           std::optional<Clock::duration> arrival)>;
+
+        //! length of a feedback packet without status chunks and receive deltas
+        static constexpr std::size_t BASE_LEN = 20;
+        //! resolution of the receive deltas
+        static constexpr Clock::duration TICK = std::chrono::microseconds(250);
+
+        explicit TransportFeedback(const Config& c);
+
+        //! records the arrival of the packet with transport-wide sequence number seq
+        void record(std::uint16_t seq, Clock::time_point arrival);
+
+        //! returns true if feedback is to be written by now
+        [[nodiscard]] bool due(Clock::time_point now) const;
+
+        //! returns true if recorded packets wait to be reported
+        [[nodiscard]] bool pending() const;
+
+        //! writes a feedback packet about the media stream mediaSsrc's transport to buf and
+        //! removes the packets it reports, returns its length, 0 if there is nothing to report
+        //! - reports as many packets as fit into len bytes, call again for the rest
+        std::size_t write(unsigned char* buf, std::size_t len, SSRC mediaSsrc,
+                          Clock::time_point now);
+
+        //! reads a feedback packet and calls report for each packet in it, returns false if the
+        //! packet is malformed (then report isn't called)
+        static bool parse(const unsigned char* buf, std::size_t len, const Report& report);
+
+        [[nodiscard]] const Config& config() const;
+
+    private:
+
+        enum Symbol : std::uint8_t { notReceived = 0, smallDelta = 1, largeDelta = 2 };
+
+        //! arrival time in receive delta units
+        [[nodiscard]] static std::int64_t _ticks(Clock::time_point t);
+        //! appends the status chunks of _symbols[0, n) to buf, returns the bytes written
+        std::size_t _writeChunks(unsigned char* buf, std::size_t n) const;
+
+        Config _config;
+        //! unwrapped sequence number of the first unreported packet, i.e., of _arrivals[0]
+        std::int64_t _base = 0;
+        bool _started = false;
+        //! arrival times from _base on, Clock::time_point{} if not (yet) received
+        std::vector<Clock::time_point> _arrivals;
+        Clock::time_point _lastFeedback;
+        std::uint8_t _feedbackCount = 0;
+        //! scratch space of write()
+        std::vector<std::uint8_t> _symbols;
+        std::vector<std::int64_t> _deltas;
+    };
+}
+
+#endif
@@ -0,0 +1,214 @@
+
+#include "xdp_data_plane.h"
+
+#include "log.h"
+
+p4sfu::XDPDataPlane::XDPDataPlane(boost::asio::io_context* io, DataPlane::Config* c)
+    : DataPlane(io),
+      _config(*reinterpret_cast<XDPDataPlane::Config*>(c)),
+      _ipv4(_config.ipv4),
+      _socket(*_io, _config.dataPlaneIface, _config.queueId, _config.port),
+      _mac(_socket.mac()),
+      _frames(*this),
+      _model(&_frames, _config, _io) {
+
+    // the source address of transmitted frames, it isn't taken from the interface
+    if (_ipv4.num() == 0) {
+        throw std::invalid_argument("XDPDataPlane: invalid SFU address: " + _config.ipv4);
+    }
+
+    Log(Log::INFO) << "XDPDataPlane: XDPDataPlane: iface=" << _config.dataPlaneIface
+                   << ", queue=" << _config.queueId << ", ipv4=" << _ipv4 << ", port="
+                   << _config.port << ", mac=" << _mac.to_str() << ", zero-copy="
+                   << _socket.zeroCopy() << std::endl;
+
+    _socket.onFrames([this](auto&&... args) -> void {
+        _onFrames(std::forward<decltype(args)>(args)...);
+    });
+
+    _model.onPacketToController([this](DataPlane&, PktIn pkt) {
+        try {
+            _controlPlanePacketHandler(*this, pkt);
+        } catch (std::bad_function_call& e) {
+            throw std::logic_error("XDPDataPlane: no control-plane packet handler set");
+        }
+    });
+}
+
+void p4sfu::XDPDataPlane::sendPacket(const PktOut& pkt) {
+
+    _model.sendPacket(pkt);
+}
+
+void p4sfu::XDPDataPlane::addStream(const Stream& s) {
+
+    _model.addStream(s);
+}
+
+void p4sfu::XDPDataPlane::removeStream(const Stream& s) {
+
+    _model.removeStream(s);
+}
+
+void p4sfu::XDPDataPlane::adjustDecodeTarget(const net::IPv4Port& from, const net::IPv4Port& to,
+                                             SSRC ssrc, unsigned target) {
+
+    _model.adjustDecodeTarget(from, to, ssrc, target);
+}
+
+const p4sfu::TotalPacketStatistics& p4sfu::XDPDataPlane::totalStatistics() const {
+
+    return _model.totalStatistics();
+}
+
+std::vector<p4sfu::StreamStatistics> p4sfu::XDPDataPlane::streamStatistics() const {
+
+    return _model.streamStatistics();
+}
+
+const XDPSocket::Statistics& p4sfu::XDPDataPlane::socketStatistics() const {
+
+    return _socket.statistics();
+}
+
+void p4sfu::XDPDataPlane::_onFrames(XDPSocket&, XDPSocket::Frame* frames, std::size_t n) {
+
+    _datagrams.clear();
+
+    for (std::size_t i = 0; i < n; i++) {
+
+        const auto* buf = frames[i].buf;
+        auto len = frames[i].len;
+
+        if (len < net::eth::HDR_LEN + net::ipv4::HDR_LEN + net::udp::HDR_LEN) {
+            continue;
+        }
+
+        const auto* eth = (const net::eth::hdr*) buf;
+
+        if (static_cast<net::eth::type>(ntohs(eth->ether_type)) != net::eth::type::ipv4) {
+            continue;
+        }
+
+        const auto* ip = (const net::ipv4::hdr*) (buf + net::eth::HDR_LEN);
+
+        if ((net::ipv4::proto)(ip->next_proto_id) != net::ipv4::proto::udp
+            || net::eth::HDR_LEN + ip->ihl_bytes() + net::udp::HDR_LEN > len) {
+            continue;
+        }
+
+        const auto* udp = (const net::udp::hdr*) (buf + net::eth::HDR_LEN + ip->ihl_bytes());
+
+        if (ntohs(udp->dgram_len) < net::udp::HDR_LEN) {
+            continue;
+        }
+
+        auto hdrLen = net::eth::HDR_LEN + ip->ihl_bytes() + net::udp::HDR_LEN;
+        auto payloadLen = std::min<std::size_t>(ntohs(udp->dgram_len) - net::udp::HDR_LEN,
+                                                len - hdrLen);
+
+        // learn the neighbor's MAC address for packets sent back to it, the map is only written
+        // if it is new or changed
+        auto [neighbor, learned] = _neighbors.try_emplace(ntohl(ip->src_addr), eth->src_addr);
+
+        if (!learned && std::memcmp(neighbor->second.bytes, eth->src_addr.bytes,
+                                    net::eth::ADDR_LEN) != 0) {
+            neighbor->second = eth->src_addr;
+        }
+
+        auto& d = _datagrams.emplace_back();
+        d.from = asio::ip::udp::endpoint{asio::ip::address_v4{ntohl(ip->src_addr)},
+                                         ntohs(udp->src_port)};
+        d.buf = (const char*) (buf + hdrLen);
+        d.len = payloadLen;
+    }
+
+    if (!_datagrams.empty()) {
+        _frames.deliver(_datagrams.data(), _datagrams.size());
+    }
+}
+
+void p4sfu::XDPDataPlane::_transmit(const net::IPv4Port& to, const char* hdr,
+                                    std::size_t hdrLen, const char* payload,
+                                    std::size_t payloadLen) {
+
+    auto len = hdrLen + payloadLen;
+    auto frameHdrLen = net::eth::HDR_LEN + net::ipv4::HDR_LEN + net::udp::HDR_LEN;
+
+    if (len + frameHdrLen > XDPSocket::FRAME_SIZE) {
+        Log(Log::ERROR) << "XDPDataPlane: _transmit: packet too large: len=" << len << std::endl;
+        return;
+    }
+
+    auto* frame = _socket.txFrame();
+
+    if (!frame) {
+        Log(Log::WARN) << "XDPDataPlane: _transmit: no free frame, dropping packet to " << to
+                       << std::endl;
+        return;
+    }
+
+    auto* eth = (net::eth::hdr*) frame;
+    eth->init_default();
+    eth->src_addr = _mac;
+    eth->ether_type = htons(static_cast<std::uint16_t>(net::eth::type::ipv4));
+
+    if (auto n = _neighbors.find(to.ip().num()); n != _neighbors.end()) {
+        eth->dst_addr = n->second;
+    } else {
+        std::fill(eth->dst_addr.bytes, eth->dst_addr.bytes + net::eth::ADDR_LEN, 0xff);
+    }
+
+    auto* ip = (net::ipv4::hdr*) (frame + net::eth::HDR_LEN);
+    ip->init_default();
+    ip->total_length  = htons(len + net::ipv4::HDR_LEN + net::udp::HDR_LEN);
+    ip->next_proto_id = static_cast<std::uint8_t>(net::ipv4::proto::udp);
+    ip->src_addr      = htonl(_ipv4.num());
+    ip->dst_addr      = htonl(to.ip().num());
+    ip->compute_checksum();
+
+    auto* udp = (net::udp::hdr*) (frame + net::eth::HDR_LEN + net::ipv4::HDR_LEN);
+    udp->src_port     = htons(_config.port);
+    udp->dst_port     = htons(to.port());
+    udp->dgram_len    = htons(len + net::udp::HDR_LEN);
+    udp->dgram_cksum  = 0; // udp chksum is optional
+
+    if (hdrLen > 0) {
+        std::memcpy(frame + frameHdrLen, hdr, hdrLen);
+    }
+
+    std::memcpy(frame + frameHdrLen + hdrLen, payload, payloadLen);
+    _socket.send(frame, len + frameHdrLen);
+}
+
+void p4sfu::XDPDataPlane::FrameInterface::sendTo(const asio::ip::udp::endpoint& to,
+                                                 const char* buf, std::size_t len) {
+
+    _dp._transmit(net::IPv4Port{net::IPv4{to.address().to_v4().to_uint()}, to.port()},
+                  nullptr, 0, buf, len);
+}
+
+void p4sfu::XDPDataPlane::FrameInterface::sendToGather(const asio::ip::udp::endpoint& to,
+                                                       const char* hdr, std::size_t hdrLen,
+                                                       const char* payload,
+                                                       std::size_t payloadLen) {
+
+    _dp._transmit(net::IPv4Port{net::IPv4{to.address().to_v4().to_uint()}, to.port()},
+                  hdr, hdrLen, payload, payloadLen);
+}
+
+void p4sfu::XDPDataPlane::FrameInterface::flush() {
+
+    _dp._socket.flush();
+}
+
+void p4sfu::XDPDataPlane::FrameInterface::deliver(Datagram* datagrams, std::size_t n) {
+
+    if (_onBatch) {
+        (*_onBatch)(*this, datagrams, n);
+    } else if (_onMessage) {
+        for (std::size_t i = 0; i < n; i++) {
+            (*_onMessage)(*this, datagrams[i].from, datagrams[i].buf, datagrams[i].len);
+        }
+    }
+}
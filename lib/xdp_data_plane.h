@@ -0,0 +1,79 @@
+
+#ifndef P4SFU_XDP_DATA_PLANE_H
+#define P4SFU_XDP_DATA_PLANE_H
+
+#include <boost/asio.hpp>
+#include <unordered_map>
+
+#include "data_plane.h"
+#include "data_plane_model.h"
+#include "net/xdp_socket.h"
+
+namespace p4sfu {
+
+    //! software SFU data plane that receives and transmits raw frames over AF_XDP
+    //! - Ethernet/IPv4/UDP headers are parsed and built here, the UDP payloads are handled by a
+    //!   DataPlaneModel (SFU table, SVC drop, sequence rewriting) through a frame-backed
+    //!   UDPInterface
+    //! - STUN and RTCP are punted to the agent as in the model
+    //! - destination MAC addresses are learned from received frames, frames to unknown
+    //!   neighbors are broadcast
+    class XDPDataPlane : public DataPlane {
+    public:
+
+        //! the embedded model's configuration, its UDP backend options (ioBatchSize, ioUring,
+        //! udpOffload) don't apply since frames are received and sent over the AF_XDP socket
+        struct Config : public DataPlaneModel::Config {
+            //! IPv4 address of the SFU, used as source address of transmitted packets
+            std::string ipv4;
+            //! interface and queue the AF_XDP socket is bound to
+            std::string dataPlaneIface;
+            unsigned queueId = 0;
+        };
+
+        explicit XDPDataPlane(boost::asio::io_context* io, DataPlane::Config* c);
+
+        // from abstract DataPlane:
+        void sendPacket(const PktOut& pkt) override;
+        void addStream(const Stream& s) override;
+        void removeStream(const Stream& s) override;
+        void adjustDecodeTarget(const net::IPv4Port& from, const net::IPv4Port& to, SSRC ssrc,
+                                unsigned target) override;
+        [[nodiscard]] const TotalPacketStatistics& totalStatistics() const override;
+        [[nodiscard]] std::vector<StreamStatistics> streamStatistics() const override;
+
+        [[nodiscard]] const XDPSocket::Statistics& socketStatistics() const;
+
+    private:
+
+        //! UDPInterface on top of the AF_XDP socket, used by the embedded DataPlaneModel
+        class FrameInterface : public UDPInterface {
+        public:
+            explicit FrameInterface(XDPDataPlane& dp) : _dp(dp) { }
+            void sendTo(const asio::ip::udp::endpoint& to, const char* buf, std::size_t len) override;
+            void sendToGather(const asio::ip::udp::endpoint& to, const char* hdr,
+                              std::size_t hdrLen, const char* payload,
+                              std::size_t payloadLen) override;
+            void flush() override;
+            void deliver(Datagram* datagrams, std::size_t n);
+        private:
+            XDPDataPlane& _dp;
+        };
+
+        void _onFrames(XDPSocket& s, XDPSocket::Frame* frames, std::size_t n);
+        //! builds a frame around the UDP payload hdr + payload and sends it
+        void _transmit(const net::IPv4Port& to, const char* hdr, std::size_t hdrLen,
+                       const char* payload, std::size_t payloadLen);
+
+        Config _config;
+        net::IPv4 _ipv4;
+        XDPSocket _socket;
+        net::eth::addr _mac;
+        FrameInterface _frames;
+        DataPlaneModel _model;
+        std::unordered_map<std::uint32_t, net::eth::addr> _neighbors;
+        std::vector<UDPInterface::Datagram> _datagrams;
+    };
+}
+
+#endif
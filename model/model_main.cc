@@ -2,7 +2,9 @@
 #include <iostream>
 #include <cxxopts/cxxopts.h>
 
+#include "../lib/sharded_data_plane_model.h"
 #include "../lib/switch_agent.h"
+#include "../lib/xdp_data_plane.h"
 #include "../lib/util.h"
 
 void printHelp(cxxopts::Options& opts, int exitCode = 0) {
@@ -26,7 +28,38 @@ cxxopts::Options setOptions() {
         ("a,av1-rtp-ext", "RTP extension ID for AV1 dependency descriptor",
             cxxopts::value<unsigned>(), "ID")
         ("r,rtp-drop-rate", "RTP packet drop rate", cxxopts::value<double>(), "RATE")
+        ("b,io-batch-size", "datagrams per recvmmsg/sendmmsg (0: no batching)",
+            cxxopts::value<unsigned>(), "N")
+        ("io-uring", "use the io_uring UDP backend")
+        ("udp-offload", "enable UDP GRO/GSO (with --io-batch-size > 1)")
+        ("pacing-factor", "pace RTP per receiver at this multiple of its REMB (0: no pacing)",
+            cxxopts::value<double>(), "FACTOR")
+        ("pacing-tx-time", "pace with SO_TXTIME (with --io-batch-size > 1)")
+        ("nack-cache", "answer NACKs from the last N packets of each stream (0: forward NACKs)",
+            cxxopts::value<unsigned>(), "N")
+        ("pli-window", "forward one PLI per stream until its next keyframe or for at most MS "
+            "(0: forward all PLIs)", cxxopts::value<unsigned>(), "MS")
+        ("remb-interval", "send each sender one REMB aggregated from its receivers every MS "
+            "(0: no REMB)", cxxopts::value<unsigned>(), "MS")
+        ("rtcp-punt-staleness", "punt receiver reports to the agent only on meaningful changes "
+            "or after MS (0: punt all)", cxxopts::value<unsigned>(), "MS")
+        ("twcc-rtp-ext", "RTP extension ID for transport-wide sequence numbers, send transport-cc "
+            "feedback to senders (0: no feedback)", cxxopts::value<unsigned>(), "ID")
+        ("delay-estimate-interval", "decide decode targets on delay-based estimates of the "
+            "receivers every MS (with --twcc-rtp-ext, 0: REMB only)", cxxopts::value<unsigned>(),
+            "MS")
+        ("drop-undecodable", "drop AV1 frames a receiver can't decode since the chain of its "
+            "decode target broke, until the next keyframe or switch point")
+        ("undecodable-pli", "request a keyframe when a chain breaks (with --drop-undecodable)")
+        ("s,shards", "data-plane worker threads sharing the SFU port", cxxopts::value<unsigned>(),
+            "N")
+        ("xdp-iface", "receive and send frames over AF_XDP on this interface",
+            cxxopts::value<std::string>(), "IFACE")
+        ("xdp-ipv4", "SFU address used with AF_XDP", cxxopts::value<std::string>(), "IP")
         ("v,verbose", "log debug messages")
+        ("async-log", "write log messages from a background thread")
+        ("log-file", "write log messages to this file (implies --async-log)",
+            cxxopts::value<std::string>(), "FILE")
         ("h,help", "print this help message");
 
     return opts;
@@ -46,6 +79,15 @@ typename p4sfu::SwitchAgent<DataPlaneType>::Config parseOptions(cxxopts::Options
         .icePwd         = "UKZe/aYNEouGzQUhChnKGiIS",
         .av1RtpExtId    = 12,
         .rtpDropRate    = 0.0,
+        .ioBatchSize    = 0,
+        .ioUring        = false,
+        .udpOffload     = false,
+        .pacingFactor   = 0,
+        .pacingTxTime   = false,
+        .nackCache      = 0,
+        .pliWindow      = 0,
+        .rembInterval   = 0,
+        .shards         = 1,
         .verbose        = false
     };
 
@@ -84,10 +126,82 @@ typename p4sfu::SwitchAgent<DataPlaneType>::Config parseOptions(cxxopts::Options
         config.rtpDropRate = parsed["r"].as<double>();
     }
 
+    if (parsed.count("b")) {
+        config.ioBatchSize = parsed["b"].as<unsigned>();
+    }
+
+    if (parsed.count("io-uring")) {
+        config.ioUring = true;
+    }
+
+    if (parsed.count("udp-offload")) {
+        config.udpOffload = true;
+    }
+
+    if (parsed.count("pacing-factor")) {
+        config.pacingFactor = parsed["pacing-factor"].as<double>();
+    }
+
+    if (parsed.count("pacing-tx-time")) {
+        config.pacingTxTime = true;
+    }
+
+    if (parsed.count("nack-cache")) {
+        config.nackCache = parsed["nack-cache"].as<unsigned>();
+    }
+
+    if (parsed.count("pli-window")) {
+        config.pliWindow = parsed["pli-window"].as<unsigned>();
+    }
+
+    if (parsed.count("remb-interval")) {
+        config.rembInterval = parsed["remb-interval"].as<unsigned>();
+    }
+
+    if (parsed.count("rtcp-punt-staleness")) {
+        config.rtcpPuntStaleness = parsed["rtcp-punt-staleness"].as<unsigned>();
+    }
+
+    if (parsed.count("twcc-rtp-ext")) {
+        config.twccRtpExtId = parsed["twcc-rtp-ext"].as<unsigned>();
+    }
+
+    if (parsed.count("delay-estimate-interval")) {
+        config.delayEstimateInterval = parsed["delay-estimate-interval"].as<unsigned>();
+    }
+
+    if (parsed.count("drop-undecodable")) {
+        config.dropUndecodable = true;
+    }
+
+    if (parsed.count("undecodable-pli")) {
+        config.undecodablePLI = true;
+    }
+
+    if (parsed.count("s")) {
+        config.shards = parsed["s"].as<unsigned>();
+    }
+
+    if (parsed.count("xdp-iface")) {
+        config.dataPlaneIface = parsed["xdp-iface"].as<std::string>();
+    }
+
+    if (parsed.count("xdp-ipv4")) {
+        config.dataPlaneIPv4 = parsed["xdp-ipv4"].as<std::string>();
+    }
+
     if (parsed.count("v")) {
         config.verbose = true;
     }
 
+    if (parsed.count("async-log")) {
+        config.asyncLog = true;
+    }
+
+    if (parsed.count("log-file")) {
+        config.logFile = parsed["log-file"].as<std::string>();
+    }
+
     if (parsed.count("h")) {
         printHelp(opts);
     }
@@ -103,12 +217,76 @@ int main(int argc, char** argv) {
     p4sfu::DataPlaneModel::Config dataPlaneConfig{
         .av1RtpExt   = config.av1RtpExtId,
         .port        = config.sfuListenPort,
-        .rtpDropRate = config.rtpDropRate
+        .rtpDropRate = config.rtpDropRate,
+        .ioBatchSize = config.ioBatchSize,
+        .ioUring     = config.ioUring,
+        .udpOffload  = config.udpOffload
     };
 
+    dataPlaneConfig.dropUndecodable = config.dropUndecodable;
+    dataPlaneConfig.undecodablePLI  = config.undecodablePLI;
+
+    if (config.pacingFactor > 0) {
+        dataPlaneConfig.pacing = p4sfu::EgressPacer::Config{
+            .pacingFactor = config.pacingFactor,
+            .txTime       = config.pacingTxTime
+        };
+    }
+
+    if (config.nackCache > 0) {
+        dataPlaneConfig.nackCache = p4sfu::RetransmissionCache::Config{
+            .packets = config.nackCache
+        };
+    }
+
+    if (config.pliWindow > 0) {
+        dataPlaneConfig.pliWindow = std::chrono::milliseconds(config.pliWindow);
+    }
+
+    if (config.rtcpPuntStaleness > 0) {
+        dataPlaneConfig.rtcpPuntFilter = p4sfu::RTCPPuntFilter::Config{
+            .maxStaleness = std::chrono::milliseconds(config.rtcpPuntStaleness)
+        };
+    }
+
+    if (config.twccRtpExtId > 0) {
+        dataPlaneConfig.transportFeedback = p4sfu::TransportFeedback::Config{
+            .rtpExt = config.twccRtpExtId
+        };
+
+        if (config.delayEstimateInterval > 0) {
+            dataPlaneConfig.delayBasedEstimate = p4sfu::DelayBasedEstimator::Config{};
+        }
+    } else if (config.delayEstimateInterval > 0) {
+        std::cerr << "model: --delay-estimate-interval requires --twcc-rtp-ext" << std::endl;
+        return 1;
+    }
+
+    if (!config.dataPlaneIface.empty() && config.dataPlaneIPv4.empty()) {
+        std::cerr << "model: --xdp-iface requires --xdp-ipv4" << std::endl;
+        return 1;
+    }
+
     try {
-        p4sfu::SwitchAgent<p4sfu::DataPlaneModel> s(config, dataPlaneConfig);
-        return s();
+        if (!config.dataPlaneIface.empty()) {
+            p4sfu::XDPDataPlane::Config xdpConfig;
+            static_cast<p4sfu::DataPlaneModel::Config&>(xdpConfig) = dataPlaneConfig;
+            xdpConfig.ipv4           = config.dataPlaneIPv4;
+            xdpConfig.dataPlaneIface = config.dataPlaneIface;
+
+            p4sfu::SwitchAgent<p4sfu::XDPDataPlane> s(config, xdpConfig);
+            return s();
+        } else if (config.shards > 1) {
+            p4sfu::ShardedDataPlaneModel::Config shardedConfig;
+            static_cast<p4sfu::DataPlaneModel::Config&>(shardedConfig) = dataPlaneConfig;
+            shardedConfig.shards = config.shards;
+
+            p4sfu::SwitchAgent<p4sfu::ShardedDataPlaneModel> s(config, shardedConfig);
+            return s();
+        } else {
+            p4sfu::SwitchAgent<p4sfu::DataPlaneModel> s(config, dataPlaneConfig);
+            return s();
+        }
     } catch (std::exception& e) {
         std::cerr << "[ERROR] main: failed starting switch model: " << e.what() << std::endl;
         return -1;
@@ -0,0 +1,120 @@
+#include <catch.h>
+
+#include <async_log_sink.h>
+
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+namespace {
+
+    std::vector<std::string> readLines(const std::string& file) {
+
+        std::vector<std::string> lines;
+        std::ifstream in{file};
+
+        for (std::string l; std::getline(in, l);) {
+            lines.push_back(l);
+        }
+
+        return lines;
+    }
+}
+
+TEST_CASE("AsyncLogSink: writes records in order with timestamps", "[async_log_sink]") {
+
+    auto file = "/tmp/p4sfu_async_log_sink_test_" + std::to_string(::getpid()) + ".log";
+    std::remove(file.c_str());
+
+    auto prevConfig = Log::config;
+    Log::config = { .level = Log::INFO, .printLabel = true };
+
+    {
+        AsyncLogSink sink{AsyncLogSink::Config{.capacity = 1024, .file = file}};
+
+        for (int i = 0; i < 100; i++) {
+            Log(Log::INFO) << "record " << i << std::endl;
+        }
+
+        Log(Log::DEBUG) << "not enabled" << std::endl;
+        Log(Log::ERROR) << "error " << std::hex << 255 << std::endl;
+        Log(Log::INFO) << "after hex " << 255 << std::endl;
+        Log(Log::INFO) << std::setprecision(2) << std::setfill('0') << std::setw(5) << 1.234
+                       << std::endl;
+        Log(Log::INFO) << 1.234567 << " " << std::setw(3) << 7 << std::endl;
+    }
+
+    Log::config = prevConfig;
+
+    auto lines = readLines(file);
+    std::remove(file.c_str());
+
+    REQUIRE(lines.size() == 104);
+
+    for (int i = 0; i < 100; i++) {
+        // "YYYY-MM-DD HH:MM:SS.uuuuuu [INFO]  record i"
+        CHECK(lines[i].size() > 27);
+        CHECK(lines[i][10] == ' ');
+        CHECK(lines[i][19] == '.');
+        CHECK(lines[i].substr(27) == "[INFO]  record " + std::to_string(i));
+    }
+
+    CHECK(lines[100].substr(27) == "[ERROR] error ff");
+    CHECK(lines[101].substr(27) == "[INFO]  after hex 255");
+    CHECK(lines[102].substr(27) == "[INFO]  001.2");
+    CHECK(lines[103].substr(27) == "[INFO]  1.23457   7");
+}
+
+TEST_CASE("AsyncLogSink: drops records if the ring is full", "[async_log_sink]") {
+
+    auto file = "/tmp/p4sfu_async_log_sink_test_" + std::to_string(::getpid()) + ".log";
+    std::remove(file.c_str());
+
+    const unsigned threads = 4, records = 5000;
+    AsyncLogSink::Statistics st;
+
+    {
+        AsyncLogSink sink{AsyncLogSink::Config{.capacity = 4, .file = file, .timestamps = false}};
+        std::vector<std::thread> producers;
+
+        for (unsigned t = 0; t < threads; t++) {
+            producers.emplace_back([&sink]() {
+                for (unsigned i = 0; i < records; i++) {
+                    sink.push(Log::level::INFO, "record\n");
+                }
+            });
+        }
+
+        for (auto& p: producers) {
+            p.join();
+        }
+
+        // give the writer time to drain and report the drops
+        while (sink.statistics().records + sink.statistics().dropped < threads * records) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        st = sink.statistics();
+    }
+
+    auto lines = readLines(file);
+    std::remove(file.c_str());
+
+    CHECK(st.records + st.dropped == threads * records);
+    CHECK(st.batches > 0);
+
+    unsigned long written = 0, reported = 0;
+
+    for (auto& l: lines) {
+        if (l == "record") {
+            written++;
+        } else {
+            REQUIRE(l.starts_with("[WARN]  AsyncLogSink: dropped "));
+            reported += std::stoul(l.substr(30));
+        }
+    }
+
+    CHECK(written == st.records);
+    CHECK(reported == st.dropped);
+}
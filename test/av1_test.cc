@@ -43,14 +43,15 @@ TEST_CASE("av1", "[av1]") {
 
         CHECK(dd1.dtCnt() == 2);
 
+        REQUIRE(dd1.structure() != nullptr);
         CHECK(dd1.templates().size() == 3);
-        CHECK(dd1.templates().find(0) != dd1.templates().end());
-        CHECK(dd1.templates().find(1) != dd1.templates().end());
-        CHECK(dd1.templates().find(2) != dd1.templates().end());
+        CHECK(dd1.structure()->find(0) != nullptr);
+        CHECK(dd1.structure()->find(1) != nullptr);
+        CHECK(dd1.structure()->find(2) != nullptr);
 
-        const auto& dd1_tpl0 = dd1.templates().find(0)->second;
-        const auto& dd1_tpl1 = dd1.templates().find(1)->second;
-        const auto& dd1_tpl2 = dd1.templates().find(2)->second;
+        const auto& dd1_tpl0 = *dd1.structure()->find(0);
+        const auto& dd1_tpl1 = *dd1.structure()->find(1);
+        const auto& dd1_tpl2 = *dd1.structure()->find(2);
 
         CHECK(dd1_tpl0.spatial_layer_id == 0);
         CHECK(dd1_tpl0.temporal_layer_id == 0);
@@ -86,37 +87,38 @@ TEST_CASE("av1", "[av1]") {
 
         CHECK(dd2.dtCnt() == 2);
 
+        REQUIRE(dd2.structure() != nullptr);
         CHECK(dd2.templates().size() == 3);
-        CHECK(dd2.templates().find(6) != dd2.templates().end());
-        CHECK(dd2.templates().find(7) != dd2.templates().end());
-        CHECK(dd2.templates().find(8) != dd2.templates().end());
+        CHECK(dd2.structure()->find(6) != nullptr);
+        CHECK(dd2.structure()->find(7) != nullptr);
+        CHECK(dd2.structure()->find(8) != nullptr);
 
-        const auto& dd2_tpl6 = dd2.templates().find(6)->second;
-        const auto& dd2_tpl7 = dd2.templates().find(7)->second;
-        const auto& dd2_tpl8 = dd2.templates().find(8)->second;
+        const auto& dd2_tpl6 = *dd2.structure()->find(6);
+        const auto& dd2_tpl7 = *dd2.structure()->find(7);
+        const auto& dd2_tpl8 = *dd2.structure()->find(8);
 
         CHECK(dd2_tpl6.spatial_layer_id == 0);
         CHECK(dd2_tpl6.temporal_layer_id == 0);
         CHECK(dd2_tpl6.dtis.size() == 2);
         CHECK(dd2_tpl6.dtis[0] == av1::DependencyDescriptor::dti::switch_indication);
         CHECK(dd2_tpl6.dtis[1] == av1::DependencyDescriptor::dti::switch_indication);
-        // CHECK(dd2_tpl6.fdiffs.empty());
+        CHECK(dd2_tpl6.fdiffs.empty());
 
         CHECK(dd2_tpl7.spatial_layer_id == 0);
         CHECK(dd2_tpl7.temporal_layer_id == 0);
         CHECK(dd2_tpl7.dtis.size() == 2);
         CHECK(dd2_tpl7.dtis[0] == av1::DependencyDescriptor::dti::switch_indication);
         CHECK(dd2_tpl7.dtis[1] == av1::DependencyDescriptor::dti::switch_indication);
-        // CHECK(dd2_tpl7.fdiffs.size() == 1);
-        // CHECK(dd2_tpl7.fdiffs[0] == 2);
+        CHECK(dd2_tpl7.fdiffs.size() == 1);
+        CHECK(dd2_tpl7.fdiffs[0] == 2);
 
         CHECK(dd2_tpl8.spatial_layer_id == 0);
         CHECK(dd2_tpl8.temporal_layer_id == 1);
         CHECK(dd2_tpl8.dtis.size() == 2);
         CHECK(dd2_tpl8.dtis[0] == av1::DependencyDescriptor::dti::not_present_indication);
         CHECK(dd2_tpl8.dtis[1] == av1::DependencyDescriptor::dti::discardable_indication);
-        // CHECK(dd2_tpl8.fdiffs.size() == 1);
-        // CHECK(dd2_tpl8.fdiffs[0] == 1);
+        CHECK(dd2_tpl8.fdiffs.size() == 1);
+        CHECK(dd2_tpl8.fdiffs[0] == 1);
     }
 
     SECTION("mandatory fields") {
@@ -144,21 +146,22 @@ TEST_CASE("av1", "[av1]") {
 
         CHECK(dd4.dtCnt() == 4);
 
+        REQUIRE(dd4.structure() != nullptr);
         CHECK(dd4.templates().size() == 6);
 
-        CHECK(dd4.templates().find(0) != dd4.templates().end());
-        CHECK(dd4.templates().find(1) != dd4.templates().end());
-        CHECK(dd4.templates().find(2) != dd4.templates().end());
-        CHECK(dd4.templates().find(3) != dd4.templates().end());
-        CHECK(dd4.templates().find(4) != dd4.templates().end());
-        CHECK(dd4.templates().find(5) != dd4.templates().end());
+        CHECK(dd4.structure()->find(0) != nullptr);
+        CHECK(dd4.structure()->find(1) != nullptr);
+        CHECK(dd4.structure()->find(2) != nullptr);
+        CHECK(dd4.structure()->find(3) != nullptr);
+        CHECK(dd4.structure()->find(4) != nullptr);
+        CHECK(dd4.structure()->find(5) != nullptr);
 
-        const auto& dd4_tpl0 = dd4.templates().find(0)->second;
-        const auto& dd4_tpl1 = dd4.templates().find(1)->second;
-        const auto& dd4_tpl2 = dd4.templates().find(2)->second;
-        const auto& dd4_tpl3 = dd4.templates().find(3)->second;
-        const auto& dd4_tpl4 = dd4.templates().find(4)->second;
-        const auto& dd4_tpl5 = dd4.templates().find(5)->second;
+        const auto& dd4_tpl0 = *dd4.structure()->find(0);
+        const auto& dd4_tpl1 = *dd4.structure()->find(1);
+        const auto& dd4_tpl2 = *dd4.structure()->find(2);
+        const auto& dd4_tpl3 = *dd4.structure()->find(3);
+        const auto& dd4_tpl4 = *dd4.structure()->find(4);
+        const auto& dd4_tpl5 = *dd4.structure()->find(5);
 
         CHECK(dd4_tpl0.spatial_layer_id == 0);
         CHECK(dd4_tpl0.temporal_layer_id == 0);
@@ -208,82 +211,294 @@ TEST_CASE("av1", "[av1]") {
         CHECK(dd4_tpl5.dtis[2] == av1::DependencyDescriptor::dti::not_present_indication);
         CHECK(dd4_tpl5.dtis[3] == av1::DependencyDescriptor::dti::discardable_indication);
     }
-}
 
-TEST_CASE("av1::svc::L1T2::drop", "[av1]") {
+    SECTION("template chains and render resolutions") {
 
-    av1::svc::L1T2 svc;
+        av1::DependencyDescriptor dd4{dd4_bytes, 33};
+        const auto* s = dd4.structure();
+        REQUIRE(s != nullptr);
+
+        CHECK(s->max_spatial_id == 1);
+        CHECK(s->max_temporal_id == 1);
+        CHECK(s->chain_cnt == 2);
+        CHECK(s->decode_target_protected_by[1] == 0);
+        CHECK(s->decode_target_protected_by[2] == 1);
+        CHECK(s->decode_target_spatial_id[2] == 1);
+        CHECK(s->decode_target_temporal_id[2] == 0);
+
+        const auto& tpl5 = *s->find(5);
+        REQUIRE(tpl5.fdiffs.size() == 2);
+        CHECK(tpl5.fdiffs[0] == 2);
+        CHECK(tpl5.fdiffs[1] == 1);
+        REQUIRE(tpl5.chain_fdiffs.size() == 2);
+        CHECK(tpl5.chain_fdiffs[0] == 3);
+        CHECK(tpl5.chain_fdiffs[1] == 2);
+
+        CHECK(s->resolutions_present_flag);
+        CHECK(s->max_render_width_minus_1[1] + 1 == 320);
+        CHECK(s->max_render_height_minus_1[1] + 1 == 240);
+
+        // the keyframe uses template 0 of spatial layer 0
+        REQUIRE(dd4.frame() != nullptr);
+        CHECK(dd4.frame()->id == 0);
+        CHECK(dd4.frameResolution() == std::pair<unsigned, unsigned>{160, 120});
+        CHECK(dd4.activeDecodeTargets() == 0b1111);
+        CHECK(s->find(6) == nullptr);
+    }
 
-    CHECK_FALSE(svc.drop(0));
-    CHECK_FALSE(svc.drop(1));
-    CHECK_FALSE(svc.drop(2));
+    SECTION("frame dependencies resolved by the structure of an earlier descriptor") {
 
-    svc.decodeTarget = av1::svc::L1T2::DecodeTarget::lo;
-    CHECK_FALSE(svc.drop(0));
-    CHECK_FALSE(svc.drop(1));
-    CHECK(svc.drop(2));
-    CHECK_FALSE(svc.drop(3));
-    CHECK_FALSE(svc.drop(4));
-    CHECK(svc.drop(5));
-    CHECK_FALSE(svc.drop(6));
-    CHECK_FALSE(svc.drop(7));
-    CHECK(svc.drop(8));
+        av1::DependencyDescriptor dd2{dd2_bytes, 15};
 
-    svc.decodeTarget = av1::svc::L1T2::DecodeTarget::hi;
+        // mandatory fields only, template 8
+        av1::DependencyDescriptor dd3{dd3_bytes, 3, dd2.structure()};
+        CHECK(dd3.structure() == nullptr);
+        CHECK(dd3.templates().empty());
+        CHECK(dd3.dtCnt() == 2);
+        REQUIRE(dd3.frame() != nullptr);
+        CHECK(dd3.frame()->temporal_layer_id == 1);
+        CHECK(dd3.frame()->dtis[0] == av1::DependencyDescriptor::dti::not_present_indication);
+        CHECK(dd3.frame()->fdiffs.size() == 1);
+        CHECK(dd3.frameResolution() == std::pair<unsigned, unsigned>{640, 480});
+        CHECK_FALSE(dd3.activeDecodeTargets());
+
+        // without a structure, only the mandatory fields are known
+        av1::DependencyDescriptor unresolved{dd3_bytes, 3};
+        CHECK(unresolved.frame() == nullptr);
+        CHECK(unresolved.dtCnt() == 0);
+    }
 
-    CHECK_FALSE(svc.drop(9));
-    CHECK_FALSE(svc.drop(10));
-    CHECK_FALSE(svc.drop(12));
-}
+    SECTION("custom DTIs, frame diffs and chains") {
+
+        // template 8, active decode targets 0b01, DTIs switch and required, frame diffs 3 and
+        // 20 (4 and 8 bits), frame chain diff 5
+        const unsigned char custom[] = {0x08, 0x00, 0xb6, 0x7b, 0x69, 0x42, 0x60, 0x28};
+
+        av1::DependencyDescriptor dd2{dd2_bytes, 15};
+        av1::DependencyDescriptor dd{custom, sizeof(custom), dd2.structure()};
+
+        CHECK_FALSE(dd.template_dependency_structure_present_flag());
+        CHECK(dd.active_decode_targets_present_flag());
+        CHECK(dd.custom_dtis_flag());
+        CHECK(dd.custom_fdiffs_flag());
+        CHECK(dd.custom_chains_flag());
+        CHECK(dd.activeDecodeTargets() == 0b01);
+
+        const auto* frame = dd.frame();
+        REQUIRE(frame != nullptr);
+        CHECK(frame->id == 8);
+        CHECK(frame->temporal_layer_id == 1);
+        REQUIRE(frame->dtis.size() == 2);
+        CHECK(frame->dtis[0] == av1::DependencyDescriptor::dti::switch_indication);
+        CHECK(frame->dtis[1] == av1::DependencyDescriptor::dti::required_indication);
+        REQUIRE(frame->fdiffs.size() == 2);
+        CHECK(frame->fdiffs[0] == 3);
+        CHECK(frame->fdiffs[1] == 20);
+        REQUIRE(frame->chain_fdiffs.size() == 1);
+        CHECK(frame->chain_fdiffs[0] == 5);
+
+        // the template itself is unchanged
+        CHECK(dd2.structure()->find(8)->dtis[0]
+              == av1::DependencyDescriptor::dti::not_present_indication);
+    }
+
+    SECTION("structure hash") {
+
+        av1::DependencyDescriptor dd1{dd1_bytes, 15};
+        av1::DependencyDescriptor dd2{dd2_bytes, 15};
+        av1::DependencyDescriptor dd3{dd3_bytes, 3};
+
+        CHECK(dd1.structureHash() != 0);
+        CHECK(dd1.structureHash() != dd2.structureHash());
+        CHECK(dd3.structureHash() == 0);
+
+        // the same structure in the descriptor of another frame
+        std::array<unsigned char, 15> next{};
+        std::copy(std::begin(dd1_bytes), std::end(dd1_bytes), next.begin());
+        next[0] = 0x81;
+        next[2] = 0x07;
+        CHECK(av1::DependencyDescriptor{next.data(), 15}.structureHash() == dd1.structureHash());
+    }
+
+    SECTION("malformed descriptors") {
+
+        av1::DependencyDescriptor dd2{dd2_bytes, 15};
+
+        // truncated structure
+        CHECK_THROWS_AS(av1::DependencyDescriptor(dd4_bytes, 20), std::invalid_argument);
+
+        // template 2 isn't part of the structure of templates 6, 7, 8
+        const unsigned char unknown[] = {0x02, 0x00, 0xb6};
+        CHECK_THROWS_AS(av1::DependencyDescriptor(unknown, 3, dd2.structure()),
+                        std::invalid_argument);
+    }
+
+    SECTION("L1T2 drop table") {
 
-TEST_CASE("av1::svc::L1T3::drop", "[av1]") {
-
-    av1::svc::L1T3 svc;
-
-    CHECK_FALSE(svc.drop(0));
-    CHECK_FALSE(svc.drop(1));
-    CHECK_FALSE(svc.drop(2));
-    CHECK_FALSE(svc.drop(3));
-    CHECK_FALSE(svc.drop(4));
-    CHECK_FALSE(svc.drop(5));
-    CHECK_FALSE(svc.drop(6));
-    CHECK_FALSE(svc.drop(7));
-    CHECK_FALSE(svc.drop(8));
-    CHECK_FALSE(svc.drop(9));
-
-    svc.decodeTarget = av1::svc::L1T3::DecodeTarget::lo;
-    CHECK_FALSE(svc.drop(0));
-    CHECK_FALSE(svc.drop(1));
-    CHECK(svc.drop(2));
-    CHECK(svc.drop(3));
-    CHECK(svc.drop(4));
-    CHECK_FALSE(svc.drop(5));
-    CHECK_FALSE(svc.drop(6));
-    CHECK(svc.drop(7));
-    CHECK(svc.drop(8));
-    CHECK(svc.drop(9));
-
-    svc.decodeTarget = av1::svc::L1T3::DecodeTarget::mid;
-    CHECK_FALSE(svc.drop(0));
-    CHECK_FALSE(svc.drop(1));
-    CHECK_FALSE(svc.drop(2));
-    CHECK(svc.drop(3));
-    CHECK(svc.drop(4));
-    CHECK_FALSE(svc.drop(5));
-    CHECK_FALSE(svc.drop(6));
-    CHECK_FALSE(svc.drop(7));
-    CHECK(svc.drop(8));
-    CHECK(svc.drop(9));
-
-    svc.decodeTarget = av1::svc::L1T3::DecodeTarget::hi;
-    CHECK_FALSE(svc.drop(0));
-    CHECK_FALSE(svc.drop(1));
-    CHECK_FALSE(svc.drop(2));
-    CHECK_FALSE(svc.drop(3));
-    CHECK_FALSE(svc.drop(4));
-    CHECK_FALSE(svc.drop(5));
-    CHECK_FALSE(svc.drop(6));
-    CHECK_FALSE(svc.drop(7));
-    CHECK_FALSE(svc.drop(8));
-    CHECK_FALSE(svc.drop(9));
-}
\ No newline at end of file
+        av1::DropTable t{av1::DependencyDescriptor{dd2_bytes, 15}};
+        CHECK(t.decodeTargets() == 2);
+
+        // template 8 (T1) is not present in decode target 0
+        CHECK(t.exclusion(0) == 1ull << 8);
+        CHECK_FALSE(t.drop(6, 0));
+        CHECK_FALSE(t.drop(7, 0));
+        CHECK(t.drop(8, 0));
+        CHECK(t.exclusion(1) == 0);
+
+        // undefined templates and decode targets are kept
+        CHECK_FALSE(t.drop(2, 0));
+        CHECK(t.exclusion(2) == 0);
+    }
+
+    SECTION("L2T2 drop table") {
+
+        av1::DropTable t{av1::DependencyDescriptor{dd4_bytes, 33}};
+        CHECK(t.decodeTargets() == 4);
+
+        CHECK(t.exclusion(0) == 0b111100); // S0T0: templates 0, 1
+        CHECK(t.exclusion(1) == 0b111000); // S0T1: templates 0, 1, 2
+        CHECK(t.exclusion(2) == 0b100100); // S1T0: templates 0, 1, 3, 4
+        CHECK(t.exclusion(3) == 0);        // S1T1: all templates
+        CHECK(t.drop(5, 2));
+        CHECK_FALSE(t.drop(5, 3));
+    }
+
+    SECTION("drop tables of scalability modes known at compile time") {
+
+        using namespace av1::svc;
+
+        static_assert(L1T3Structure::dropTable().decodeTargets() == 3);
+        static_assert(L1T3Structure::dropTable().exclusion(0) == 0b11100);
+        static_assert(L1T3Structure::dropTable().exclusion(1) == 0b11000);
+        static_assert(L1T3Structure::dropTable().exclusion(2) == 0);
+        static_assert(L1T3Structure::dropTable(62).exclusion(0) == 0b111); // IDs wrap around
+        static_assert(L2T3Structure::dropTable().exclusion(2) == 0b1111100000); // S0T2
+        static_assert(L2T3Structure::dropTable().exclusion(3) == 0b1110011100); // S1T0
+
+        // as parsed from the descriptors
+        av1::DropTable l1t2{av1::DependencyDescriptor{dd2_bytes, 15}};
+        av1::DropTable l2t2{av1::DependencyDescriptor{dd4_bytes, 33}};
+
+        for (unsigned dt = 0; dt < 4; dt++) {
+            CHECK(L1T2Structure::dropTable(6).exclusion(dt) == l1t2.exclusion(dt));
+            CHECK(FullSvc<2, 2>::dropTable().exclusion(dt) == l2t2.exclusion(dt));
+        }
+    }
+
+    SECTION("no drop table without template dependency structure") {
+
+        av1::DependencyDescriptor dd3{dd3_bytes, 3};
+        CHECK_THROWS_AS(av1::DropTable{dd3}, std::invalid_argument);
+    }
+
+    SECTION("frames are dropped while the chain of the decode target is broken") {
+
+        // L1T3 keyframe, the single chain holds the T0 frames
+        const unsigned char key[] = {
+            0xc0, 0x00, 0x64, 0x80, 0x02, 0x14, 0xea, 0xa8,
+            0x60, 0x41, 0x4d, 0x14, 0x10, 0x20, 0x84, 0x26
+        };
+
+        av1::DependencyDescriptor dd{key, sizeof(key)};
+        const auto* s = dd.structure();
+        REQUIRE(s);
+        REQUIRE(s->chain_cnt == 1);
+
+        // templates of frames 100 (keyframe) to 112: T0, T2, T1, T2, T0, ...
+        auto tpl = [s](unsigned n) {
+            const unsigned pattern[] = {1, 3, 2, 4};
+            return s->find(n == 100 ? 0 : pattern[n % 4]);
+        };
+
+        av1::FrameChain hi, lo;
+
+        for (unsigned n = 100; n < 104; n++) {
+            CHECK(hi.forward(n, tpl(n), s, std::nullopt));
+            CHECK(hi.forward(n, tpl(n), s, std::nullopt)); // further packets of the frame
+        }
+
+        // losing T2 frame 105 doesn't break the chain
+        for (unsigned n = 104; n < 108; n++) {
+            if (n != 105) {
+                CHECK(hi.forward(n, tpl(n), s, std::nullopt));
+            }
+        }
+
+        CHECK_FALSE(hi.broken());
+
+        // losing T0 frame 108 does, until the next keyframe
+        for (unsigned n = 109; n < 113; n++) {
+            CHECK_FALSE(hi.forward(n, tpl(n), s, std::nullopt));
+            CHECK(hi.broken());
+        }
+
+        CHECK(hi.forward(113, s->find(0), s, std::nullopt));
+        CHECK_FALSE(hi.broken());
+        CHECK(hi.forward(114, s->find(3), s, 2)); // T2, references the keyframe
+
+        // frames dropped for the decode target aren't part of its chain
+        for (unsigned n = 100; n < 109; n++) {
+            auto t0 = tpl(n)->temporal_layer_id == 0;
+            CHECK(lo.forward(n, tpl(n), s, 0, !t0) == t0);
+        }
+
+        CHECK_FALSE(lo.broken());
+
+        // frames of unknown dependencies are forwarded, a receiver that joins mid-stream too
+        av1::FrameChain joined;
+        CHECK(joined.forward(201, tpl(201), s, std::nullopt)); // frame 200 wasn't seen
+        CHECK(joined.forward(202, nullptr, s, std::nullopt));
+        CHECK(joined.forward(203, tpl(203), s, std::nullopt));
+        CHECK_FALSE(joined.forward(205, tpl(205), s, std::nullopt)); // frame 204 was lost
+
+        // after the encoder restarted, frames far behind the highest are dropped until one
+        // restarts the chain or carries a structure
+        av1::FrameChain restarted, restructured;
+
+        for (unsigned n = 1000; n < 1004; n++) {
+            CHECK(restarted.forward(n, tpl(n), s, std::nullopt));
+            CHECK(restructured.forward(n, tpl(n), s, std::nullopt));
+        }
+
+        CHECK_FALSE(restarted.forward(501, tpl(501), s, std::nullopt));
+        CHECK(restarted.forward(500, s->find(0), s, std::nullopt));
+        CHECK(restarted.forward(501, tpl(501), s, std::nullopt));
+        CHECK_FALSE(restarted.broken());
+
+        CHECK(restructured.forward(500, nullptr, nullptr, std::nullopt, false, true));
+        CHECK(restructured.forward(501, tpl(501), s, std::nullopt));
+    }
+
+    SECTION("a switch point whose references were forwarded repairs a broken chain") {
+
+        av1::DependencyDescriptor::template_dependency_structure s;
+        s.dt_cnt = 1;
+        s.chain_cnt = 1;
+
+        using dti = av1::DependencyDescriptor::dti;
+
+        auto frame = [](dti d, unsigned fdiff, unsigned chainFdiff) {
+            av1::DependencyDescriptor::frame_dependency_template f;
+            f.dtis.push_back(d);
+            f.fdiffs.push_back((std::uint16_t) fdiff);
+            f.chain_fdiffs.push_back((std::uint8_t) chainFdiff);
+            return f;
+        };
+
+        auto key = frame(dti::switch_indication, 0, 0);
+        auto delta = frame(dti::required_indication, 1, 1);
+        auto switchToDropped = frame(dti::switch_indication, 1, 1);
+        auto switchToForwarded = frame(dti::switch_indication, 5, 1);
+
+        av1::FrameChain c;
+        CHECK(c.forward(0, &key, &s, 0));
+        CHECK(c.forward(1, &delta, &s, 0));
+        CHECK_FALSE(c.forward(3, &delta, &s, 0)); // frame 2 was lost
+        CHECK_FALSE(c.forward(4, &delta, &s, 0));
+        CHECK_FALSE(c.forward(5, &switchToDropped, &s, 0));
+        CHECK(c.broken());
+        CHECK(c.forward(6, &switchToForwarded, &s, 0)); // references frame 1
+        CHECK_FALSE(c.broken());
+        CHECK(c.forward(7, &delta, &s, 0));
+    }
+}
@@ -0,0 +1,231 @@
+#include <catch.h>
+
+#include <net/batch_udp_server.h>
+
+using namespace boost;
+
+TEST_CASE("BatchUDPServer: drains and sends datagrams in batches", "[batch_udp_server]") {
+
+    asio::io_context io;
+    BatchUDPServer server{io, 0, 8};
+    asio::ip::udp::endpoint serverEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     server.socket().local_endpoint().port()};
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+
+    std::vector<std::size_t> batchSizes;
+
+    server.onBatch([&batchSizes](UDPInterface& c, UDPInterface::Datagram* d, std::size_t n) {
+
+        batchSizes.push_back(n);
+
+        for (std::size_t i = 0; i < n; i++) { // echo every datagram twice
+            c.sendTo(d[i].from, d[i].buf, d[i].len);
+            c.sendTo(d[i].from, d[i].buf, d[i].len);
+        }
+    });
+
+    for (char i = 0; i < 5; i++) {
+        char buf[100] = {i};
+        client.send_to(asio::buffer(buf, sizeof(buf)), serverEp);
+    }
+
+    while (server.statistics().rxPkts < 5) {
+        io.run_one();
+    }
+
+    std::size_t received = 0;
+    std::array<char, 2048> rxBuf = {};
+    client.non_blocking(true);
+    system::error_code ec;
+
+    while (client.receive(asio::buffer(rxBuf), 0, ec) == 100) {
+        received++;
+    }
+
+    std::size_t total = 0;
+    for (auto n: batchSizes) {
+        total += n;
+    }
+
+    CHECK(total == 5);
+    CHECK(batchSizes.size() <= 5);
+    CHECK(received == 10);
+    CHECK(server.statistics().txPkts == 10);
+    CHECK(server.statistics().txBatches <= server.statistics().rxBatches * 2);
+}
+
+TEST_CASE("BatchUDPServer: sends immediately outside a batch", "[batch_udp_server]") {
+
+    asio::io_context io;
+    BatchUDPServer server{io, 0, 4};
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+    asio::ip::udp::endpoint clientEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     client.local_endpoint().port()};
+
+    char buf[10] = {1, 2, 3};
+    server.sendTo(clientEp, buf, sizeof(buf));
+
+    std::array<char, 2048> rxBuf = {};
+    CHECK(client.receive(asio::buffer(rxBuf)) == 10);
+    CHECK(rxBuf[2] == 3);
+    CHECK(server.statistics().txPkts == 1);
+}
+
+TEST_CASE("BatchUDPServer: rejects IPv6 endpoints", "[batch_udp_server]") {
+
+    asio::io_context io;
+    BatchUDPServer server{io, 0, 4};
+
+    asio::ip::udp::endpoint v6Ep{asio::ip::make_address_v6("::1"), 5000};
+
+    char buf[10] = {};
+    CHECK_THROWS_AS(server.sendTo(v6Ep, buf, sizeof(buf)), std::invalid_argument);
+    CHECK(server.statistics().txPkts == 0);
+}
+
+TEST_CASE("BatchUDPServer: sends gathered headers and payloads", "[batch_udp_server]") {
+
+    asio::io_context io;
+    BatchUDPServer server{io, 0, 4};
+    asio::ip::udp::endpoint serverEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     server.socket().local_endpoint().port()};
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+
+    server.onBatch([](UDPInterface& c, UDPInterface::Datagram* d, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            for (char j = 0; j < 3; j++) {
+                char hdr[2] = {j, j};
+                c.sendToGather(d[i].from, hdr, sizeof(hdr), d[i].buf + 2, d[i].len - 2);
+            }
+        }
+    });
+
+    char buf[50];
+    std::memset(buf, 7, sizeof(buf));
+    client.send_to(asio::buffer(buf, sizeof(buf)), serverEp);
+
+    while (server.statistics().rxPkts < 1) {
+        io.run_one();
+    }
+
+    for (char j = 0; j < 3; j++) {
+        std::array<char, 2048> rxBuf = {};
+        REQUIRE(client.receive(asio::buffer(rxBuf)) == 50);
+        CHECK(rxBuf[0] == j);
+        CHECK(rxBuf[1] == j);
+        CHECK(rxBuf[2] == 7);
+        CHECK(rxBuf[49] == 7);
+    }
+
+    CHECK(server.statistics().txPkts == 3);
+}
+
+TEST_CASE("BatchUDPServer: coalesces datagrams per receiver with UDP GSO/GRO",
+          "[batch_udp_server]") {
+
+    asio::io_context io;
+    BatchUDPServer sender{io, 0, 8, false, true};
+    BatchUDPServer receiver{io, 0, 8, false, true};
+
+    if (!sender.gso() || !receiver.gro()) {
+        WARN("UDP GSO/GRO not supported by the kernel");
+        return;
+    }
+
+    asio::ip::udp::endpoint senderEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     sender.socket().local_endpoint().port()};
+    asio::ip::udp::endpoint receiverEp{asio::ip::make_address_v4("127.0.0.1"),
+                                       receiver.socket().local_endpoint().port()};
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+    asio::ip::udp::endpoint clientEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     client.local_endpoint().port()};
+
+    // payloads are referenced until the batch is flushed
+    std::array<std::array<char, 96>, 6> payloads;
+
+    for (char i = 0; i < 6; i++) {
+        payloads[i].fill(i);
+    }
+
+    // a burst of equal-sized packets and a shorter last one to the receiver, interleaved with
+    // packets to another receiver (as produced by fan-out)
+    sender.onBatch([&](UDPInterface& c, UDPInterface::Datagram*, std::size_t) {
+        for (char i = 0; i < 6; i++) {
+            char hdr[4] = {i, 0, 0, 0};
+            c.sendToGather(receiverEp, hdr, sizeof(hdr), payloads[i].data(), i < 5 ? 96 : 46);
+            c.sendTo(clientEp, payloads[i].data(), 10);
+        }
+    });
+
+    std::vector<std::vector<char>> received;
+
+    receiver.onBatch([&received](UDPInterface&, UDPInterface::Datagram* d, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            received.emplace_back(d[i].buf, d[i].buf + d[i].len);
+        }
+    });
+
+    char trigger[1] = {};
+    client.send_to(asio::buffer(trigger), senderEp);
+
+    while (received.size() < 6) {
+        io.run_one();
+    }
+
+    CHECK(sender.statistics().txPkts == 12);
+    CHECK(sender.statistics().txGsoPkts == 2);
+    CHECK(receiver.statistics().rxPkts == 6);
+    CHECK(receiver.statistics().rxGroPkts == 1);
+
+    for (char i = 0; i < 6; i++) {
+        REQUIRE(received[i].size() == (i < 5 ? 100 : 50));
+        CHECK(received[i][0] == i);
+        CHECK(received[i][4] == i);
+        CHECK(received[i].back() == i);
+    }
+
+    std::array<char, 2048> rxBuf = {};
+    client.non_blocking(true);
+    system::error_code ec;
+    std::size_t toClient = 0;
+
+    while (client.receive(asio::buffer(rxBuf), 0, ec) > 0) {
+        toClient++;
+    }
+
+    CHECK(toClient == 6);
+}
+
+TEST_CASE("BatchUDPServer: sends datagrams with a departure time (SO_TXTIME)",
+          "[batch_udp_server]") {
+
+    asio::io_context io;
+    BatchUDPServer server{io, 0, 4, false, true};
+
+    if (!server.enableTxTime()) {
+        WARN("SO_TXTIME not supported by the kernel");
+        return;
+    }
+
+    CHECK(server.txTime());
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+    asio::ip::udp::endpoint clientEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     client.local_endpoint().port()};
+
+    // a departure time in the past, without time-based qdisc the datagram leaves immediately
+    char hdr[4] = {1, 2, 3, 4}, payload[6] = {5, 6, 7, 8, 9, 10};
+    server.sendToGatherAt(clientEp, hdr, sizeof(hdr), payload, sizeof(payload),
+                          std::chrono::steady_clock::now());
+    server.sendToGather(clientEp, hdr, sizeof(hdr), payload, sizeof(payload));
+
+    std::array<char, 2048> rxBuf = {};
+    CHECK(client.receive(asio::buffer(rxBuf)) == 10);
+    CHECK(rxBuf[9] == 10);
+    CHECK(client.receive(asio::buffer(rxBuf)) == 10);
+    CHECK(server.statistics().txPkts == 2);
+}
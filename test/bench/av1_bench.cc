@@ -0,0 +1,220 @@
+#include <catch.h>
+
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include "av1.h"
+#include "util.h"
+
+namespace {
+
+    // recorded from libwebrtc's encoder: keyframe descriptors with the template dependency
+    // structure of L1T2 and L2T2, and a descriptor with the mandatory fields only
+    const unsigned char L1T2_KEYFRAME[] = {
+        0x80, 0x00, 0x01, 0x80, 0x01, 0x1e, 0xa8, 0x51, 0x41, 0x01, 0x0c, 0x04, 0xfc, 0x03, 0xbc
+    };
+
+    const unsigned char L2T2_KEYFRAME[] = {
+        0xc0, 0x00, 0x01, 0x80, 0x03, 0x18, 0x7a, 0xaa, 0xf1, 0x30, 0xa0, 0xa0, 0x14, 0xd1, 0x41,
+        0x38, 0x23, 0x04, 0x60, 0x08, 0x64, 0x22, 0x22, 0x26, 0x50, 0x09, 0xf0, 0x07, 0x70, 0x13,
+        0xf0, 0x0e, 0xf0
+    };
+
+    const unsigned char MANDATORY[] = {0x02, 0x00, 0xd8};
+
+    //! the previous parser for comparison, as of the baseline: av1::DependencyDescriptor before
+    //! the word reader, reduced to the members its constructor reaches (it expands the descriptor
+    //! into a bit vector and parses the template layers and DTIs of a structure into a map)
+    class BitVectorDependencyDescriptor {
+
+    public:
+        enum class dti : unsigned {
+            not_present_indication = 0,
+            discardable_indication = 1,
+            switch_indication      = 2,
+            required_indication    = 3
+        };
+
+        struct frame_dependency_template {
+            unsigned spatial_layer_id  = 0;
+            unsigned temporal_layer_id = 0;
+            std::vector<dti> dtis = {};
+        };
+
+        BitVectorDependencyDescriptor(const unsigned char* bytes, unsigned len)
+            : _buf(bytes), _len(len) {
+
+            if (len < MandatoryFields_LEN)
+                throw std::logic_error("av1::DependencyDescriptor: len must be at least 3");
+
+            if (len > MandatoryFields_LEN)
+                _parse_bytes();
+        }
+
+        [[nodiscard]] const std::map<unsigned, struct frame_dependency_template>& templates() const {
+
+            return _templates;
+        }
+
+    private:
+
+        void _parse_bytes() {
+
+            auto bits = _bit_vector_from_bytes(_buf, _len);
+
+            unsigned total_consumed_bits = MandatoryFields_LEN * 8;
+
+            total_consumed_bits = _parse_extended_descriptor_fields(bits, total_consumed_bits);
+        }
+
+        unsigned _parse_extended_descriptor_fields(const std::vector<bool>& bits,
+                                                   unsigned total_consumed_bits) {
+
+            auto i = total_consumed_bits;
+
+            _template_dependency_structure_present_flag = bits[i++];
+            _active_decode_targets_present_flag = bits[i++];
+            _custom_dtis_flag = bits[i++];
+            _custom_fdiffs_flag = bits[i++];
+            _custom_chains_flag = bits[i++];
+
+            if (_template_dependency_structure_present_flag) {
+                i = _parse_template_dependency_structure(bits, i);
+                _active_decode_targets_bitmask = (1 << _dt_cnt) - 1;
+            }
+
+            return i;
+        }
+
+        unsigned _parse_template_dependency_structure(const std::vector<bool>& bits,
+                                                      unsigned total_consumed_bits) {
+
+            auto i = total_consumed_bits;
+
+            _template_id_offset = util::extractBits(bits, i, 6);
+            i += 6;
+            auto dt_cnt_minus_one = util::extractBits(bits, i, 5);
+            i += 5;
+
+            _dt_cnt = dt_cnt_minus_one + 1;
+
+            unsigned max_spatial_id = 0;
+
+            i = _parse_template_layers(bits, i, max_spatial_id);
+            i = _parse_template_dtis(bits, i);
+
+            return i;
+        }
+
+        unsigned _parse_template_layers(const std::vector<bool>& bits, unsigned i,
+                                        unsigned& max_spatial_id) {
+
+            unsigned temporal_id = 0, spatial_id = 0, max_temporal_id = 0, next_layer_idc = 0;
+
+            do {
+                _template_spatial_id.push_back(spatial_id);
+                _template_temporal_id.push_back(temporal_id);
+
+                _templates[_template_id_offset + _template_cnt] = {spatial_id, temporal_id};
+
+                _template_cnt++;
+
+                next_layer_idc = util::extractBits(bits, i, 2);
+                i += 2;
+
+                if (next_layer_idc == 1) {
+                    temporal_id++;
+
+                    if (temporal_id > max_temporal_id) {
+                        max_temporal_id = temporal_id;
+                    }
+
+                } else if (next_layer_idc == 2) {
+                    temporal_id = 0;
+                    spatial_id++;
+                }
+
+            } while (next_layer_idc != 3);
+
+            max_spatial_id = spatial_id;
+
+            return i;
+        }
+
+        unsigned _parse_template_dtis(const std::vector<bool>& bits, unsigned i) {
+
+            for (unsigned template_index = 0; template_index < _template_cnt; template_index++) {
+                for (unsigned dt_index = 0; dt_index < _dt_cnt; dt_index++) {
+                    auto dti = (enum dti) util::extractBits(bits, i, 2);
+                    _templates[template_index + _template_id_offset].dtis.push_back(dti);
+                    i += 2;
+                }
+            }
+
+            return i;
+        }
+
+        [[nodiscard]] static std::vector<bool> _bit_vector_from_bytes(const unsigned char* buf,
+                                                                      unsigned len) {
+
+            std::vector<bool> bits(len * 8);
+
+            for (unsigned i = 0; i < len; i++)
+                for (int j = 7; j >= 0; j--)
+                    bits[(i + 1) * 8 - j - 1] = ((buf[i] >> j) & 1);
+
+            return bits;
+        }
+
+        const unsigned char* _buf = nullptr;
+        unsigned _len = 0;
+
+        bool _template_dependency_structure_present_flag = false;
+        bool _active_decode_targets_present_flag = false;
+        bool _custom_dtis_flag = false;
+        bool _custom_fdiffs_flag = false;
+        bool _custom_chains_flag = false;
+
+        unsigned _dt_cnt = 0;
+        unsigned _template_cnt = 0;
+        unsigned _template_id_offset = 0;
+        std::uint32_t _active_decode_targets_bitmask = 0;
+
+        std::vector<unsigned> _template_spatial_id = {};
+        std::vector<unsigned> _template_temporal_id = {};
+
+        std::map<unsigned, struct frame_dependency_template> _templates;
+
+        static const unsigned MandatoryFields_LEN = 3;
+    };
+
+    void benchmark(const std::string& name, const unsigned char* buf, unsigned len) {
+
+        av1::DependencyDescriptor keyframe{L1T2_KEYFRAME, sizeof(L1T2_KEYFRAME)};
+
+        BENCHMARK("baseline bit vector parser: " + name) {
+            return BitVectorDependencyDescriptor{buf, len}.templates().size();
+        };
+
+        BENCHMARK("word reader, full descriptor: " + name) {
+            return av1::DependencyDescriptor{buf, len}.templates().size();
+        };
+
+        BENCHMARK("word reader, frame resolved by the latest structure: " + name) {
+            return av1::DependencyDescriptor{buf, len, keyframe.structure()}.frame() != nullptr;
+        };
+    }
+}
+
+TEST_CASE("AV1: parse L1T2 keyframe descriptor", "[av1]") {
+    benchmark("L1T2 keyframe, 15 bytes", L1T2_KEYFRAME, sizeof(L1T2_KEYFRAME));
+}
+
+TEST_CASE("AV1: parse L2T2 keyframe descriptor", "[av1]") {
+    benchmark("L2T2 keyframe, 33 bytes", L2T2_KEYFRAME, sizeof(L2T2_KEYFRAME));
+}
+
+TEST_CASE("AV1: parse mandatory fields", "[av1]") {
+    benchmark("mandatory fields, 3 bytes", MANDATORY, sizeof(MANDATORY));
+}
@@ -0,0 +1,54 @@
+#include <catch.h>
+
+#include "data_plane_model.h"
+#include "log.h"
+#include "../rtp_rtcp_packets.h"
+
+using namespace p4sfu;
+using namespace boost;
+
+TEST_CASE("Log: per-packet cost of the data-plane model at INFO level", "[log]") {
+
+    Log::config = { .level = Log::INFO, .printLabel = true };
+
+    test::MockUDPServer udp;
+    DataPlaneModel dp(&udp);
+
+    unsigned long sent = 0;
+    udp.sentPacketHandler = [&sent](const test::MockUDPServer::Pkt&) { sent++; };
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    for (unsigned short port = 5000; port < 5004; port++) {
+        dp.addStream(DataPlane::Stream{
+            .src  = net::IPv4Port{net::IPv4{"1.1.1.1"}, 10001},
+            .dst  = net::IPv4Port{net::IPv4{"2.2.2.2"}, port},
+            .ssrc = 0x6a70d0e8
+        });
+    }
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+    std::array<unsigned char, sizeof(test::rtp_buf1)> pkt = {};
+
+    BENCHMARK("RTP packet, fan-out 4") {
+        std::memcpy(pkt.data(), test::rtp_buf1, pkt.size());
+        udp.receivePacket(from, (char*) pkt.data(), pkt.size());
+        return sent;
+    };
+
+    CHECK(sent > 0);
+}
+
+TEST_CASE("Log: cost of a disabled statement", "[log]") {
+
+    Log::config = { .level = Log::INFO, .printLabel = true };
+
+    net::IPv4Port addr{net::IPv4{"1.1.1.1"}, 10001};
+
+    BENCHMARK("Log(Log::DEBUG)") {
+        Log(Log::DEBUG) << "from=" << addr << ", ssrc=" << 0x6a70d0e8 << std::endl;
+    };
+
+    BENCHMARK("LOG(DEBUG)") {
+        LOG(DEBUG) << "from=" << addr << ", ssrc=" << 0x6a70d0e8 << std::endl;
+    };
+}
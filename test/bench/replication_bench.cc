@@ -0,0 +1,173 @@
+#include <catch.h>
+
+#include <optional>
+
+#include "data_plane_model.h"
+#include "log.h"
+#include "proto/rtp.h"
+#include "sfu_table.h"
+#include "../rtp_rtcp_packets.h"
+
+using namespace p4sfu;
+using namespace boost;
+
+namespace {
+
+    //! UDP backend that only counts sent datagrams, keeps the socket out of the measurement
+    class CountingUDP : public UDPInterface {
+    public:
+
+        void receive(asio::ip::udp::endpoint& from, char* buf, std::size_t len) {
+            (*_onMessage)(*this, from, buf, len);
+        }
+
+        void sendTo(const asio::ip::udp::endpoint&, const char*, std::size_t) override {
+            sent++;
+        }
+
+        void sendToGather(const asio::ip::udp::endpoint&, const char*, std::size_t, const char*,
+                          std::size_t) override {
+            sent++;
+        }
+
+        unsigned long sent = 0;
+    };
+
+    //! forwards L1T3 AV1 packets (one packet per frame, template IDs 0-4) from one sender to
+    //! receivers spread round-robin over the three decode targets
+    void benchmark(unsigned receivers) {
+
+        Log::config = { .level = Log::WARN, .printLabel = true };
+
+        CountingUDP udp;
+        DataPlaneModel::Config config;
+        config.av1RtpExt = 12;
+        DataPlaneModel dp(&udp, config);
+        dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+        net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001};
+
+        for (unsigned i = 0; i < receivers; i++) {
+            net::IPv4Port to{net::IPv4{0x0a000000 + i}, 20000};
+            dp.addStream(DataPlane::Stream{.src = sender, .dst = to, .ssrc = 0x773939ae});
+            dp.adjustDecodeTarget(sender, to, 0x773939ae, i % 3);
+        }
+
+        std::array<unsigned char, sizeof(test::full_rtp_av1)> pkt = {};
+        std::memcpy(pkt.data(), test::full_rtp_av1, pkt.size());
+
+        auto* hdr = (rtp::hdr*) pkt.data();
+        auto* dd = (unsigned char*) hdr->extension_ptr(12) + 1;
+        asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+        std::uint16_t frame = 100, seq = 1000;
+
+        BENCHMARK("AV1 packet, " + std::to_string(receivers) + " receivers, 3 decode targets") {
+            dd[0] = 0xc0 | (frame % 5);  // start and end of frame, template ID
+            dd[1] = frame >> 8;
+            dd[2] = frame & 0xff;
+            hdr->seq = htons(seq++);
+            frame++;
+            udp.receive(from, (char*) pkt.data(), pkt.size());
+            return udp.sent;
+        };
+    }
+
+    //! the drop test before per-decode-target bitmasks, for comparison: a switch on each
+    //! action's L1T3 decode target and modulo operations
+    bool dropByTemplateModulo(const std::optional<unsigned>& decodeTarget, unsigned templateId) {
+
+        if (!decodeTarget) {
+            return false;
+        }
+
+        switch (*decodeTarget) {
+            case 2: // hi
+                return false;
+            case 1: // mid
+                return templateId % 5 == 3 || templateId % 5 == 4;
+            case 0: // lo
+                return templateId % 5 == 2 || templateId % 5 == 3 || templateId % 5 == 4;
+        }
+
+        return false;
+    }
+
+    //! the drop decisions of _handleRTP for one packet per iteration, without the sending
+    void benchmarkDropTest(unsigned receivers) {
+
+        SFUTable t;
+        auto& e = t.addMatch(SFUTable::Match{net::IPv4Port{net::IPv4{"1.1.1.1"}, 10001}, 1});
+
+        for (unsigned i = 0; i < receivers; i++) {
+            SFUTable::Action a{net::IPv4Port{net::IPv4{0x0a000000 + i}, 20000}};
+            a.decodeTarget = i % 4 % 3;
+            e.addAction(a);
+        }
+
+        auto suffix = ", " + std::to_string(receivers) + " receivers";
+        unsigned templateId = 0;
+
+        BENCHMARK("drop test: switch and modulo per action" + suffix) {
+            unsigned dropped = 0;
+            for (const auto& a: e.actions()) {
+                dropped += dropByTemplateModulo(a.decodeTarget, templateId);
+            }
+            templateId = (templateId + 1) % 5;
+            return dropped;
+        };
+
+        // the node of each action, so that the bitmask is tested at the same granularity as the
+        // switch above
+        std::vector<const SFUTable::Entry::Node*> nodeOf(e.actions().size());
+
+        for (const auto& n: e.nodes()) {
+            for (auto r: n.replicas) {
+                nodeOf[r] = &n;
+            }
+        }
+
+        BENCHMARK("drop test: exclusion bitmask per action" + suffix) {
+            unsigned dropped = 0;
+            for (const auto* n: nodeOf) {
+                dropped += e.prunes(*n, templateId);
+            }
+            templateId = (templateId + 1) % 5;
+            return dropped;
+        };
+
+        // additionally groups the actions by decode target
+        BENCHMARK("drop test: exclusion bitmask per node" + suffix) {
+            unsigned dropped = 0;
+            for (const auto& n: e.nodes()) {
+                dropped += e.prunes(n, templateId) * (unsigned) n.replicas.size();
+            }
+            templateId = (templateId + 1) % 5;
+            return dropped;
+        };
+    }
+}
+
+TEST_CASE("Replication: AV1 fan-out, 8 receivers", "[replication]") {
+
+    benchmark(8);
+}
+
+TEST_CASE("Replication: AV1 fan-out, 64 receivers", "[replication]") {
+
+    benchmark(64);
+}
+
+TEST_CASE("Replication: AV1 fan-out, 512 receivers", "[replication]") {
+
+    benchmark(512);
+}
+
+TEST_CASE("Replication: drop test, 64 receivers", "[replication]") {
+
+    benchmarkDropTest(64);
+}
+
+TEST_CASE("Replication: drop test, 512 receivers", "[replication]") {
+
+    benchmarkDropTest(512);
+}
@@ -0,0 +1,125 @@
+#include <catch.h>
+
+#include <list>
+#include <random>
+#include <unordered_map>
+
+#include "sfu_table.h"
+
+using namespace p4sfu;
+
+namespace {
+
+    constexpr unsigned LOOKUPS = 4096;
+    constexpr unsigned FAN_OUT = 4;
+
+    net::IPv4Port sender(unsigned i) {
+        return net::IPv4Port{net::IPv4{0x0a000000 + i / 4}, (unsigned short) (10000 + i % 4)};
+    }
+
+    //! the previous table layout for comparison: node-based map, node-based action list
+    struct NodeTable {
+
+        struct Hash {
+            std::size_t operator()(const SFUTable::Match& m) const noexcept {
+                std::size_t h = 0;
+                h ^= std::hash<net::IPv4Port>{}(m.ipPort()) + 0x9e3779b9 + (h << 6) + (h >> 2);
+                h ^= m.ssrc() + 0x9e3779b9 + (h << 6) + (h >> 2);
+                return h;
+            }
+        };
+
+        std::unordered_map<SFUTable::Match, std::list<SFUTable::Action>, Hash,
+                           SFUTable::Match::Equal> table;
+    };
+
+    //! random lookup order over all n matches, fixed seed
+    std::vector<SFUTable::Match> lookupOrder(unsigned n) {
+
+        std::mt19937 rng{42};
+        std::uniform_int_distribution<unsigned> dist{0, n - 1};
+        std::vector<SFUTable::Match> matches;
+
+        for (unsigned i = 0; i < LOOKUPS; i++) {
+            auto j = dist(rng);
+            matches.emplace_back(sender(j), 0x10000000 + j);
+        }
+
+        return matches;
+    }
+
+    void benchmark(unsigned n) {
+
+        SFUTable flat;
+        NodeTable node;
+
+        for (unsigned i = 0; i < n; i++) {
+
+            SFUTable::Match m{sender(i), 0x10000000 + i};
+            auto& e = flat.addMatch(m);
+            auto& l = node.table[m];
+
+            for (unsigned short r = 0; r < FAN_OUT; r++) {
+                SFUTable::Action a{net::IPv4Port{net::IPv4{0x0b000000 + i},
+                                                 (unsigned short) (20000 + r)}};
+                e.addAction(a);
+                l.push_back(a);
+            }
+        }
+
+        auto matches = lookupOrder(n);
+        auto suffix = " (" + std::to_string(n) + " entries, " + std::to_string(LOOKUPS)
+                      + " lookups)";
+
+        BENCHMARK("unordered_map + list: lookup" + suffix) {
+            std::size_t found = 0;
+            for (const auto& m: matches) {
+                found += node.table.find(m) != node.table.end();
+            }
+            return found;
+        };
+
+        BENCHMARK("SFUTable: lookup" + suffix) {
+            std::size_t found = 0;
+            for (const auto& m: matches) {
+                found += flat.find(m) != nullptr;
+            }
+            return found;
+        };
+
+        BENCHMARK("unordered_map + list: lookup, fan-out 4" + suffix) {
+            std::uint64_t sum = 0;
+            for (const auto& m: matches) {
+                for (auto& a: node.table.find(m)->second) {
+                    sum += a.to().port() + a.decodeTarget.has_value();
+                }
+            }
+            return sum;
+        };
+
+        BENCHMARK("SFUTable: lookup, fan-out 4" + suffix) {
+            std::uint64_t sum = 0;
+            for (const auto& m: matches) {
+                for (auto& a: flat.find(m)->actions()) {
+                    sum += a.to().port() + a.decodeTarget.has_value();
+                }
+            }
+            return sum;
+        };
+    }
+}
+
+TEST_CASE("SFUTable: lookup and fan-out, 10k entries", "[sfu_table]") {
+
+    benchmark(10000);
+}
+
+TEST_CASE("SFUTable: lookup and fan-out, 100k entries", "[sfu_table]") {
+
+    benchmark(100000);
+}
+
+TEST_CASE("SFUTable: lookup and fan-out, 1M entries", "[sfu_table]") {
+
+    benchmark(1000000);
+}
@@ -0,0 +1,202 @@
+#include <catch.h>
+
+#include <chrono>
+#include <iomanip>
+
+#include "data_plane_model.h"
+#include "net/batch_udp_server.h"
+#include "net/udp_server.h"
+#include "net/uring_udp_server.h"
+#include "../rtp_rtcp_packets.h"
+
+using namespace p4sfu;
+using namespace boost;
+
+namespace {
+
+    struct ForwardingResult {
+        unsigned long pkts = 0;
+        double seconds     = 0;
+
+        [[nodiscard]] double pps() const {
+            return seconds > 0 ? (double) pkts / seconds : 0;
+        }
+    };
+
+    //! preloads the server's receive buffer with RTP packets from a single sender, then measures
+    //! how fast the data-plane model drains and forwards them to fanOut receivers
+    template <typename Server, typename... Args>
+    ForwardingResult forward(unsigned fanOut, unsigned rounds, unsigned pktsPerRound,
+                             Args&&... args) {
+
+        asio::io_context io;
+        Server udp(io, 0, std::forward<Args>(args)...);
+        udp.socket().set_option(asio::socket_base::receive_buffer_size{32 * 1024 * 1024});
+
+        DataPlaneModel dp(&udp);
+        dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+        asio::ip::udp::socket sender{io, asio::ip::udp::endpoint{
+            asio::ip::make_address_v4("127.0.0.1"), 0}};
+        asio::ip::udp::endpoint serverEp{asio::ip::make_address_v4("127.0.0.1"),
+                                         udp.socket().local_endpoint().port()};
+
+        std::vector<std::unique_ptr<asio::ip::udp::socket>> receivers;
+
+        for (unsigned i = 0; i < fanOut; i++) {
+
+            receivers.push_back(std::make_unique<asio::ip::udp::socket>(io,
+                asio::ip::udp::endpoint{asio::ip::make_address_v4("127.0.0.1"), 0}));
+
+            dp.addStream(DataPlane::Stream{
+                .src  = net::IPv4Port{net::IPv4{"127.0.0.1"}, sender.local_endpoint().port()},
+                .dst  = net::IPv4Port{net::IPv4{"127.0.0.1"},
+                                      receivers.back()->local_endpoint().port()},
+                .ssrc = 0x6a70d0e8
+            });
+        }
+
+        std::array<unsigned char, 1200> pkt = {};
+        std::memcpy(pkt.data(), test::rtp_buf1, sizeof(test::rtp_buf1));
+
+        ForwardingResult res;
+
+        for (unsigned round = 0; round < rounds; round++) {
+
+            auto before = dp.totalStatistics().rtpPkts;
+
+            for (unsigned i = 0; i < pktsPerRound; i++) {
+                sender.send_to(asio::buffer(pkt), serverEp);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            while (dp.totalStatistics().rtpPkts - before < pktsPerRound) {
+                if (io.run_one_for(std::chrono::milliseconds(100)) == 0) {
+                    break; // packets were dropped by the kernel
+                }
+            }
+
+            res.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                .count();
+            res.pkts += dp.totalStatistics().rtpPkts - before;
+        }
+
+        return res;
+    }
+}
+
+TEST_CASE("UDP backends: raw fan-out rate", "[udp]") {
+
+    const unsigned rounds = 20, pktsPerRound = 2000;
+
+    auto fanOutRate = [&]<typename Server, typename... Args>(unsigned fanOut, Args&&... args) {
+
+        asio::io_context io;
+        Server udp(io, 0, std::forward<Args>(args)...);
+        udp.socket().set_option(asio::socket_base::receive_buffer_size{32 * 1024 * 1024});
+
+        asio::ip::udp::socket sender{io, asio::ip::udp::endpoint{
+            asio::ip::make_address_v4("127.0.0.1"), 0}};
+        asio::ip::udp::socket receiver{io, asio::ip::udp::endpoint{
+            asio::ip::make_address_v4("127.0.0.1"), 0}};
+        asio::ip::udp::endpoint serverEp{asio::ip::make_address_v4("127.0.0.1"),
+                                         udp.socket().local_endpoint().port()};
+        asio::ip::udp::endpoint receiverEp = receiver.local_endpoint();
+
+        unsigned long handled = 0;
+
+        udp.onMessage([&](UDPInterface& c, asio::ip::udp::endpoint&, const char* buf,
+                          std::size_t len) {
+            handled++;
+            for (unsigned i = 0; i < fanOut; i++) {
+                c.sendTo(receiverEp, buf, len);
+            }
+        });
+
+        std::array<char, 1200> pkt = {};
+        ForwardingResult res;
+
+        for (unsigned round = 0; round < rounds; round++) {
+
+            auto before = handled;
+
+            for (unsigned i = 0; i < pktsPerRound; i++) {
+                sender.send_to(asio::buffer(pkt), serverEp);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            while (handled - before < pktsPerRound) {
+                if (io.run_one_for(std::chrono::milliseconds(100)) == 0) {
+                    break;
+                }
+            }
+
+            res.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                .count();
+            res.pkts += handled - before;
+        }
+
+        return res;
+    };
+
+    for (unsigned fanOut: {1, 8, 32}) {
+
+        auto single = fanOutRate.operator()<UDPServer>(fanOut);
+        auto batched = fanOutRate.operator()<BatchUDPServer>(fanOut, 32);
+        auto gso = fanOutRate.operator()<BatchUDPServer>(fanOut, 32, false, true);
+        auto uring = fanOutRate.operator()<UringUDPServer>(fanOut, 256);
+        auto uringZc = fanOutRate.operator()<UringUDPServer>(fanOut, 256, false, true);
+
+        std::cout << "fan-out=" << fanOut
+                  << ": UDPServer=" << (unsigned long) single.pps() << " pps"
+                  << ", BatchUDPServer(32)=" << (unsigned long) batched.pps() << " pps"
+                  << " (x" << std::setprecision(3) << batched.pps() / single.pps() << ")"
+                  << ", BatchUDPServer(32, GSO/GRO)=" << (unsigned long) gso.pps() << " pps"
+                  << " (x" << std::setprecision(3) << gso.pps() / single.pps() << ")"
+                  << ", UringUDPServer=" << (unsigned long) uring.pps() << " pps"
+                  << " (x" << std::setprecision(3) << uring.pps() / single.pps() << ")"
+                  << ", UringUDPServer(SEND_ZC)=" << (unsigned long) uringZc.pps() << " pps"
+                  << " (x" << std::setprecision(3) << uringZc.pps() / single.pps() << ")"
+                  << std::endl;
+
+        CHECK(single.pkts > 0);
+        CHECK(batched.pkts > 0);
+        CHECK(gso.pkts > 0);
+        CHECK(uring.pkts > 0);
+        CHECK(uringZc.pkts > 0);
+    }
+}
+
+TEST_CASE("UDP backends: data-plane model forwarding rate", "[udp]") {
+
+    const unsigned rounds = 20, pktsPerRound = 2000;
+
+    for (unsigned fanOut: {1, 8, 32}) {
+
+        auto single = forward<UDPServer>(fanOut, rounds, pktsPerRound);
+        auto batched = forward<BatchUDPServer>(fanOut, rounds, pktsPerRound, 32);
+        auto gso = forward<BatchUDPServer>(fanOut, rounds, pktsPerRound, 32, false, true);
+        auto uring = forward<UringUDPServer>(fanOut, rounds, pktsPerRound, 256);
+        auto uringZc = forward<UringUDPServer>(fanOut, rounds, pktsPerRound, 256, false, true);
+
+        std::cout << "fan-out=" << fanOut
+                  << ": UDPServer=" << (unsigned long) single.pps() << " pps"
+                  << ", BatchUDPServer(32)=" << (unsigned long) batched.pps() << " pps"
+                  << " (x" << std::setprecision(3) << batched.pps() / single.pps() << ")"
+                  << ", BatchUDPServer(32, GSO/GRO)=" << (unsigned long) gso.pps() << " pps"
+                  << " (x" << std::setprecision(3) << gso.pps() / single.pps() << ")"
+                  << ", UringUDPServer=" << (unsigned long) uring.pps() << " pps"
+                  << " (x" << std::setprecision(3) << uring.pps() / single.pps() << ")"
+                  << ", UringUDPServer(SEND_ZC)=" << (unsigned long) uringZc.pps() << " pps"
+                  << " (x" << std::setprecision(3) << uringZc.pps() / single.pps() << ")"
+                  << std::endl;
+
+        CHECK(single.pkts > 0);
+        CHECK(batched.pkts > 0);
+        CHECK(gso.pkts > 0);
+        CHECK(uring.pkts > 0);
+        CHECK(uringZc.pkts > 0);
+    }
+}
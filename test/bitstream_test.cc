@@ -1,5 +1,8 @@
 
 #include <catch.h>
+
+#include <stdexcept>
+
 #include <bitstream.h>
 
 const unsigned char bits[] = {0x35, 0xca, 0x06, 0x3f};
@@ -46,3 +49,49 @@ TEST_CASE("Bitstream: extract", "[bitstream]") {
     CHECK(bs.extract(16, 8) == 0x06);
     CHECK(bs.extract(24, 8) == 0x3f);
 }
+
+TEST_CASE("Bitstream: read", "[bitstream]") {
+
+    Bitstream r(bits, 4);
+
+    CHECK(r.read(0) == 0);
+    CHECK(r.read(3) == 0b001);
+    CHECK(r.read(10) == 0b1010111001);
+    CHECK(r.position() == 13);
+    CHECK(r.remaining() == 19);
+
+    r.skip(11);
+    CHECK(r.read(8) == 0x3f);
+    CHECK(r.remaining() == 0);
+    CHECK_THROWS_AS(r.read(1), std::invalid_argument);
+    CHECK_THROWS_AS(r.skip(1), std::invalid_argument);
+}
+
+TEST_CASE("Bitstream: readNonSymmetric", "[bitstream]") {
+
+    // ns(5): values below 3 take 2 bits, 3 and 4 take 3 bits
+    const unsigned char ns[] = {0b00011011, 0b01110000};
+    Bitstream r(ns, 2);
+
+    CHECK(r.readNonSymmetric(5) == 0);
+    CHECK(r.readNonSymmetric(5) == 1);
+    CHECK(r.readNonSymmetric(5) == 2);
+    CHECK(r.readNonSymmetric(5) == 3);
+    CHECK(r.readNonSymmetric(5) == 4);
+    CHECK(r.position() == 12);
+
+    // ns(1) takes no bits
+    CHECK(r.readNonSymmetric(1) == 0);
+    CHECK(r.position() == 12);
+}
+
+TEST_CASE("Bitstream: extract across words", "[bitstream]") {
+
+    const unsigned char buf[] = {0, 0, 0, 0, 0, 0, 0, 0x01, 0xff, 0x80};
+    const Bitstream b(buf, sizeof(buf));
+
+    CHECK(b.extract(63, 10) == 0b1111111111);
+    CHECK(b.extract(56, 17) == 0b00000001111111111);
+    CHECK(b.extract(72, 8) == 0x80);
+    CHECK_THROWS_AS(b.extract(73, 8), std::invalid_argument);
+}
@@ -1,5 +1,8 @@
 #include <catch.h>
 
+#include <map>
+
+#include "proto/rtcp.h"
 #include "proto/rtp.h"
 #include "stun_packets.h"
 #include "rtp_rtcp_packets.h"
@@ -59,3 +62,1149 @@ TEST_CASE("DataPlaneModel: forwards packets along a forwarding association", "[d
     CHECK(pktsSent[0].to.address() == asio::ip::make_address_v4("2.2.2.2"));
     CHECK(pktsSent[0].to.port() == 10002);
 }
+
+TEST_CASE("DataPlaneModel: sends each receiver its own header and leaves the packet untouched",
+          "[data_plane_model]") {
+
+    std::vector<test::MockUDPServer::Pkt> pktsSent;
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    DataPlaneModel dp(&udp, config);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    udp.sentPacketHandler = [&pktsSent](const test::MockUDPServer::Pkt& pkt) {
+        pktsSent.push_back(pkt);
+    };
+
+    for (unsigned short port = 10002; port < 10004; port++) {
+        dp.addStream(DataPlane::Stream{
+            .src  = net::IPv4Port{net::IPv4{"1.1.1.1"}, 10001},
+            .dst  = net::IPv4Port{net::IPv4{"2.2.2.2"}, port},
+            .ssrc = 0x773939ae
+        });
+    }
+
+    std::vector<unsigned char> pkt(test::full_rtp_av1, test::full_rtp_av1 + sizeof(test::full_rtp_av1));
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+    udp.receivePacket(from, (char*) pkt.data(), pkt.size());
+
+    CHECK(std::equal(pkt.begin(), pkt.end(), test::full_rtp_av1));
+    REQUIRE(pktsSent.size() == 2);
+
+    for (auto& p: pktsSent) {
+        REQUIRE(p.len == pkt.size());
+        CHECK(std::memcmp(p.buf.data(), pkt.data(), 2) == 0);
+        CHECK(std::memcmp(p.buf.data() + 4, pkt.data() + 4, pkt.size() - 4) == 0);
+    }
+
+    CHECK(pktsSent[0].to.port() != pktsSent[1].to.port());
+}
+
+TEST_CASE("DataPlaneModel: removeStream() reverses addStream()", "[data_plane_model]") {
+
+    std::vector<test::MockUDPServer::Pkt> pktsSent;
+
+    test::MockUDPServer udp;
+    DataPlaneModel dp(&udp);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    udp.sentPacketHandler = [&pktsSent](const test::MockUDPServer::Pkt& pkt) {
+        pktsSent.push_back(pkt);
+    };
+
+    auto stream = [](unsigned short port) {
+        return DataPlane::Stream{
+            .src         = net::IPv4Port{net::IPv4{"1.1.1.1"}, 10001},
+            .dst         = net::IPv4Port{net::IPv4{"2.2.2.2"}, port},
+            .ssrc        = 0x6a70d0e8,
+            .rtxSsrc     = 0x6a70d0e9,
+            .rtcpSsrc    = port,
+            .rtcpRtxSsrc = port + 1u
+        };
+    };
+
+    dp.addStream(stream(10002));
+    dp.addStream(stream(10004));
+
+    // main, RTX and one reverse RTCP match pair per receiver
+    CHECK(dp.sfuTable()->size() == 6);
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+
+    dp.removeStream(stream(10002));
+    CHECK(dp.sfuTable()->size() == 4);
+
+    udp.receivePacket(from, (char*) test::rtp_buf1, sizeof(test::rtp_buf1));
+    REQUIRE(pktsSent.size() == 1);
+    CHECK(pktsSent[0].to.port() == 10004);
+
+    dp.removeStream(stream(10004));
+    CHECK(dp.sfuTable()->size() == 0);
+
+    udp.receivePacket(from, (char*) test::rtp_buf1, sizeof(test::rtp_buf1));
+    CHECK(pktsSent.size() == 1);
+
+    // removing again only logs
+    CHECK_NOTHROW(dp.removeStream(stream(10004)));
+}
+
+TEST_CASE("DataPlaneModel: removeParticipant() removes all streams of an address",
+          "[data_plane_model]") {
+
+    std::vector<test::MockUDPServer::Pkt> pktsSent;
+
+    test::MockUDPServer udp;
+    DataPlaneModel dp(&udp);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    udp.sentPacketHandler = [&pktsSent](const test::MockUDPServer::Pkt& pkt) {
+        pktsSent.push_back(pkt);
+    };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001};
+
+    // send stream as installed by the switch agent
+    dp.addStream(DataPlane::Stream{
+        .src  = net::IPv4Port{0, 0},
+        .dst  = sender,
+        .ssrc = 0x6a70d0e8
+    });
+
+    for (unsigned short port = 10002; port < 10004; port++) {
+        dp.addStream(DataPlane::Stream{
+            .src      = sender,
+            .dst      = net::IPv4Port{net::IPv4{"2.2.2.2"}, port},
+            .ssrc     = 0x6a70d0e8,
+            .rtcpSsrc = port
+        });
+    }
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+
+    dp.removeParticipant(net::IPv4Port{net::IPv4{"2.2.2.2"}, 10002});
+
+    udp.receivePacket(from, (char*) test::rtp_buf1, sizeof(test::rtp_buf1));
+    REQUIRE(pktsSent.size() == 1);
+    CHECK(pktsSent[0].to.port() == 10003);
+
+    dp.removeParticipant(sender);
+    CHECK(dp.sfuTable()->size() == 0);
+}
+
+TEST_CASE("DataPlaneModel: keeps an action shared by streams until the last one is removed",
+          "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel dp(&udp);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001}, receiver{net::IPv4{"2.2.2.2"}, 10002};
+
+    // audio and video of one sender, the receiver reports on both with the same SSRC
+    auto stream = [&](SSRC ssrc) {
+        return DataPlane::Stream{
+            .src      = sender,
+            .dst      = receiver,
+            .ssrc     = ssrc,
+            .rtcpSsrc = 0x0000abcd
+        };
+    };
+
+    SFUTable::Match retMatch{receiver, 0x0000abcd};
+    SFUTable::Action retAction{sender};
+
+    auto forwardsRTCP = [&]() {
+        const auto* e = dp.sfuTable()->find(retMatch);
+        return e && e->hasAction(retAction);
+    };
+
+    SECTION("removeStream()") {
+
+        dp.addStream(stream(0x6a70d0e8));
+        dp.addStream(stream(0x6a70d0e9));
+
+        dp.removeStream(stream(0x6a70d0e8));
+        CHECK(forwardsRTCP());
+
+        dp.removeStream(stream(0x6a70d0e9));
+        CHECK_FALSE(forwardsRTCP());
+        CHECK(dp.sfuTable()->size() == 0);
+    }
+
+    SECTION("removeParticipant()") {
+
+        dp.addStream(stream(0x6a70d0e8));
+        dp.addStream(stream(0x6a70d0e9));
+
+        // the receiver's reverse match goes with the last action of the sender's streams
+        dp.removeParticipant(sender);
+        CHECK_FALSE(forwardsRTCP());
+        CHECK(dp.sfuTable()->size() == 0);
+    }
+}
+
+TEST_CASE("DataPlaneModel: releases the receiver's RTX match when a sender reporting with SSRC 1 "
+          "leaves", "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel dp(&udp);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001}, receiver{net::IPv4{"2.2.2.2"}, 10002};
+
+    // the receiver's RTX match gets no action, see addStream()
+    auto stream = [&](SSRC ssrc) {
+        return DataPlane::Stream{
+            .src         = sender,
+            .dst         = receiver,
+            .ssrc        = ssrc,
+            .rtcpSsrc    = 1,
+            .rtcpRtxSsrc = 0x0000abce
+        };
+    };
+
+    SFUTable::Match retRtxMatch{receiver, 0x0000abce};
+
+    dp.addStream(stream(0x6a70d0e8));
+    dp.addStream(stream(0x6a70d0e9));
+    REQUIRE(dp.sfuTable()->hasMatch(retRtxMatch));
+
+    SECTION("removeStream()") {
+
+        dp.removeStream(stream(0x6a70d0e8));
+        CHECK(dp.sfuTable()->hasMatch(retRtxMatch));
+
+        dp.removeStream(stream(0x6a70d0e9));
+        CHECK_FALSE(dp.sfuTable()->hasMatch(retRtxMatch));
+        CHECK(dp.sfuTable()->size() == 0);
+    }
+
+    SECTION("removeParticipant() of the sender") {
+
+        dp.removeParticipant(sender);
+        CHECK_FALSE(dp.sfuTable()->hasMatch(retRtxMatch));
+        CHECK(dp.sfuTable()->size() == 0);
+    }
+
+    SECTION("removeParticipant() of the receiver, then the sender") {
+
+        dp.removeParticipant(receiver);
+        CHECK_FALSE(dp.sfuTable()->hasMatch(retRtxMatch));
+
+        dp.removeParticipant(sender);
+        CHECK(dp.sfuTable()->size() == 0);
+
+        // a later stream to the same receiver starts from a fresh reference count
+        dp.addStream(stream(0x6a70d0e8));
+        dp.removeStream(stream(0x6a70d0e8));
+        CHECK(dp.sfuTable()->size() == 0);
+    }
+}
+
+TEST_CASE("DataPlaneModel: counts packets per stream and receiver", "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    DataPlaneModel dp(&udp, config);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+    udp.sentPacketHandler = [](const test::MockUDPServer::Pkt&) { };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001};
+    net::IPv4Port lo{net::IPv4{"2.2.2.2"}, 10002}, hi{net::IPv4{"2.2.2.2"}, 10003};
+
+    for (const auto& r: {lo, hi}) {
+        dp.addStream(DataPlane::Stream{.src = sender, .dst = r, .ssrc = 0x773939ae});
+    }
+
+    dp.adjustDecodeTarget(sender, lo, 0x773939ae, 0);
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+    udp.receivePacket(from, (char*) test::full_rtp_av1, sizeof(test::full_rtp_av1));
+    udp.receivePacket(from, (char*) test::full_rtp_av1, sizeof(test::full_rtp_av1));
+
+    auto stats = dp.streamStatistics();
+    auto st = std::find_if(stats.begin(), stats.end(), [&](const StreamStatistics& s) {
+        return s.from == sender && s.ssrc == 0x773939ae;
+    });
+
+    REQUIRE(st != stats.end());
+    CHECK(st->pkts == 2);
+    CHECK(st->bytes == 2 * sizeof(test::full_rtp_av1));
+    REQUIRE(st->receivers.size() == 2);
+
+    for (const auto& r: st->receivers) {
+        CHECK(r.pkts + r.svcDropped == 2);
+        CHECK(r.bytes == r.pkts * sizeof(test::full_rtp_av1));
+        CHECK(r.rewritten <= r.pkts);
+    }
+
+    auto& hiStats = st->receivers[0].to == hi ? st->receivers[0] : st->receivers[1];
+    CHECK(hiStats.pkts == 2);
+    CHECK(hiStats.svcDropped == 0);
+}
+
+TEST_CASE("DataPlaneModel: receivers keep consecutive sequence numbers across decode targets",
+          "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    DataPlaneModel dp(&udp, config);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    std::map<unsigned short, std::vector<std::uint16_t>> received;
+    udp.sentPacketHandler = [&received](const test::MockUDPServer::Pkt& p) {
+        received[p.to.port()].push_back(ntohs(((const rtp::hdr*) p.buf.data())->seq));
+    };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001};
+    net::IPv4Port r1{net::IPv4{"2.2.2.2"}, 10002}, r2{net::IPv4{"2.2.2.2"}, 10003};
+    net::IPv4Port r3{net::IPv4{"2.2.2.2"}, 10004};
+
+    for (const auto& r: {r1, r2, r3}) {
+        dp.addStream(DataPlane::Stream{.src = sender, .dst = r, .ssrc = 0x773939ae});
+    }
+
+    dp.adjustDecodeTarget(sender, r1, 0x773939ae, 0);
+    dp.adjustDecodeTarget(sender, r2, 0x773939ae, 0);
+
+    std::array<unsigned char, sizeof(test::full_rtp_av1)> pkt = {};
+    std::memcpy(pkt.data(), test::full_rtp_av1, pkt.size());
+
+    auto* hdr = (rtp::hdr*) pkt.data();
+    auto* dd = (unsigned char*) hdr->extension_ptr(12) + 1;
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+    std::uint16_t frame = 100, seq = 1000;
+
+    // keyframe with the L1T3 template dependency structure: templates 0 and 1 in all decode
+    // targets, 2 from mid, 3 and 4 in hi only
+    std::vector<unsigned char> keyframe(pkt.begin(), pkt.begin() + sizeof(rtp::hdr));
+    keyframe[0] |= 0x10;
+    keyframe[2] = (seq - 1) >> 8;
+    keyframe[3] = (seq - 1) & 0xff;
+    keyframe.insert(keyframe.end(), {
+        0xbe, 0xde, 0x00, 0x05,
+        0xcf, 0xc0, 0x00, (unsigned char) (frame - 1), 0x80, 0x02, 0x14, 0xea, 0xa8, 0x60, 0x41,
+        0x4d, 0x14, 0x10, 0x20, 0x84, 0x26,
+        0x00, 0x00, 0x00,
+        0x01, 0x02, 0x03, 0x04
+    });
+    udp.receivePacket(from, (char*) keyframe.data(), keyframe.size());
+
+    auto send = [&](unsigned n) {
+        for (unsigned i = 0; i < n; i++, frame++, seq++) {
+            dd[0] = 0xc0 | (frame % 5); // start and end of frame, template ID
+            dd[1] = frame >> 8;
+            dd[2] = frame & 0xff;
+            hdr->seq = htons(seq);
+            udp.receivePacket(from, (char*) pkt.data(), pkt.size());
+        }
+    };
+
+    send(20);
+    CHECK(received[r1.port()] == received[r2.port()]);
+    CHECK(received[r1.port()].size() < received[r3.port()].size());
+
+    // r2 moves to the node of r3, then back to a node of its own
+    dp.adjustDecodeTarget(sender, r2, 0x773939ae, 2);
+    send(20);
+    dp.adjustDecodeTarget(sender, r2, 0x773939ae, 1);
+    send(20);
+
+    for (const auto& r: {r1, r2, r3}) {
+        const auto& s = received[r.port()];
+        REQUIRE(s.size() > 1);
+        for (std::size_t i = 1; i < s.size(); i++) {
+            CHECK(s[i] == (std::uint16_t) (s[i - 1] + 1));
+        }
+    }
+}
+
+TEST_CASE("DataPlaneModel: selects decode targets of the stream's template dependency structure",
+          "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    DataPlaneModel dp(&udp, config);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    std::map<unsigned short, std::size_t> received;
+    udp.sentPacketHandler = [&received](const test::MockUDPServer::Pkt& p) {
+        received[p.to.port()]++;
+    };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001};
+    net::IPv4Port s0{net::IPv4{"2.2.2.2"}, 10002}, s1{net::IPv4{"2.2.2.2"}, 10003};
+    SFUTable::Match match{sender, 0x773939ae};
+
+    for (const auto& r: {s0, s1}) {
+        dp.addStream(DataPlane::Stream{.src = sender, .dst = r, .ssrc = 0x773939ae});
+    }
+
+    auto decodeTarget = [&](const net::IPv4Port& to) {
+        for (const auto& a: dp.sfuTable()->find(match)->actions()) {
+            if (a.to() == to) {
+                return a.decodeTarget;
+            }
+        }
+        return std::optional<unsigned>{};
+    };
+
+    // L1T3's decode targets until the first structure
+    dp.adjustDecodeTarget(sender, s1, 0x773939ae, 3);
+    CHECK(decodeTarget(s1) == std::nullopt);
+
+    // L2T2 keyframe, the structure needs the two-byte header: decode targets S0T0, S0T1, S1T0,
+    // S1T1
+    const unsigned char l2t2[] = {
+        0xc0, 0x00, 0x01, 0x80, 0x03, 0x18, 0x7a, 0xaa, 0xf1, 0x30, 0xa0, 0xa0, 0x14, 0xd1, 0x41,
+        0x38, 0x23, 0x04, 0x60, 0x08, 0x64, 0x22, 0x22, 0x26, 0x50, 0x09, 0xf0, 0x07, 0x70, 0x13,
+        0xf0, 0x0e, 0xf0
+    };
+
+    std::vector<unsigned char> keyframe(test::full_rtp_av1, test::full_rtp_av1 + sizeof(rtp::hdr));
+    keyframe.insert(keyframe.end(), {0x10, 0x00, 0x00, 0x09, 12, sizeof(l2t2)});
+    keyframe.insert(keyframe.end(), std::begin(l2t2), std::end(l2t2));
+    keyframe.insert(keyframe.end(), {0x00, 0x01, 0x02, 0x03, 0x04});
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+    udp.receivePacket(from, (char*) keyframe.data(), keyframe.size());
+
+    dp.adjustDecodeTarget(sender, s0, 0x773939ae, 1);
+    dp.adjustDecodeTarget(sender, s1, 0x773939ae, 3);
+    dp.adjustDecodeTarget(sender, s1, 0x773939ae, 4); // not in the structure
+    CHECK(decodeTarget(s0) == 1u);
+    CHECK(decodeTarget(s1) == 3u);
+
+    // a frame of the S1 layer reaches only the receiver of S1T1
+    av1::DependencyDescriptor dd{l2t2, sizeof(l2t2)};
+    av1::DropTable dropTable{dd};
+    auto spatial = std::find_if(dd.templates().begin(), dd.templates().end(),
+                                [](const auto& t) { return t.spatial_layer_id == 1; });
+    REQUIRE(spatial != dd.templates().end());
+    REQUIRE(dropTable.drop(spatial->id, 1));
+    REQUIRE_FALSE(dropTable.drop(spatial->id, 3));
+
+    std::array<unsigned char, sizeof(test::full_rtp_av1)> pkt = {};
+    std::memcpy(pkt.data(), test::full_rtp_av1, pkt.size());
+    auto* hdr = (rtp::hdr*) pkt.data();
+    auto* ext = (unsigned char*) hdr->extension_ptr(12) + 1;
+    ext[0] = 0xc0 | spatial->id;
+    ext[1] = 0x00;
+    ext[2] = 0x02;
+    hdr->seq = htons(ntohs(hdr->seq) + 1);
+
+    received.clear();
+    udp.receivePacket(from, (char*) pkt.data(), pkt.size());
+    CHECK(received[s0.port()] == 0);
+    CHECK(received[s1.port()] == 1);
+}
+
+TEST_CASE("DataPlaneModel: paces RTP to a receiver at the rate of its REMB", "[data_plane_model]") {
+
+    asio::io_context io;
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    config.pacing = EgressPacer::Config{.pacingFactor = 10, .burst = 2 * sizeof(test::rtp_buf1)};
+    DataPlaneModel dp(&udp, config, &io);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    std::size_t sent = 0;
+    udp.sentPacketHandler = [&sent](const test::MockUDPServer::Pkt&) { sent++; };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001}, receiver{net::IPv4{"2.2.2.2"}, 10002};
+    dp.addStream(DataPlane::Stream{.src = sender, .dst = receiver, .ssrc = 0x6a70d0e8});
+
+    // compound RR + REMB (229389 bit/s) from the receiver
+    std::vector<unsigned char> rtcp(std::begin(test::rtcp_rr_buf), std::end(test::rtcp_rr_buf));
+    rtcp.insert(rtcp.end(), std::begin(test::rtcp_remb_buf), std::end(test::rtcp_remb_buf));
+
+    asio::ip::udp::endpoint fromReceiver{asio::ip::make_address_v4("2.2.2.2"), 10002};
+    udp.receivePacket(fromReceiver, (char*) rtcp.data(), rtcp.size());
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+
+    for (int i = 0; i < 6; i++) {
+        udp.receivePacket(from, (char*) test::rtp_buf1, sizeof(test::rtp_buf1));
+    }
+
+    CHECK(sent == 2); // the bucket's burst, the rest is released by the pacing timer
+
+    for (int i = 0; i < 100 && sent < 6; i++) {
+        io.run_for(std::chrono::milliseconds(10));
+    }
+
+    CHECK(sent == 6);
+
+    auto stats = dp.streamStatistics();
+    auto st = std::find_if(stats.begin(), stats.end(), [&](const StreamStatistics& s) {
+        return s.from == sender;
+    });
+
+    REQUIRE(st != stats.end());
+    REQUIRE(st->receivers.size() == 1);
+    REQUIRE(st->receivers[0].pacing);
+    CHECK(st->receivers[0].pacing->rate == 2293890);
+    CHECK(st->receivers[0].pacing->delayed == 4);
+    CHECK(st->receivers[0].pacing->maxQueueingDelayUs > 0);
+}
+
+TEST_CASE("DataPlaneModel: answers NACKs from the retransmission cache", "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    config.nackCache = RetransmissionCache::Config{.packets = 16};
+    DataPlaneModel dp(&udp, config);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    std::vector<test::MockUDPServer::Pkt> toSender, toReceiver;
+    udp.sentPacketHandler = [&](const test::MockUDPServer::Pkt& p) {
+        (p.to.port() == 10001 ? toSender : toReceiver).push_back(p);
+    };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001}, receiver{net::IPv4{"2.2.2.2"}, 10002};
+    dp.addStream(DataPlane::Stream{
+        .src      = sender,
+        .dst      = receiver,
+        .ssrc     = 0x6a70d0e8,
+        .rtcpSsrc = 0x0000abcd
+    });
+
+    std::vector<unsigned char> rtp(std::begin(test::rtp_buf1), std::end(test::rtp_buf1));
+    auto* hdr = (rtp::hdr*) rtp.data();
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+
+    for (std::uint16_t seq = 100; seq < 102; seq++) {
+        hdr->seq = htons(seq);
+        udp.receivePacket(from, (char*) rtp.data(), rtp.size());
+    }
+
+    toReceiver.clear();
+
+    // generic NACK from the receiver for media SSRC 0x6a70d0e8
+    auto nack = [](std::uint16_t pid, std::uint16_t blp) {
+        return std::vector<unsigned char>{
+            0x81, 205, 0x00, 0x03,
+            0x00, 0x00, 0xab, 0xcd,
+            0x6a, 0x70, 0xd0, 0xe8,
+            (unsigned char) (pid >> 8), (unsigned char) pid,
+            (unsigned char) (blp >> 8), (unsigned char) blp
+        };
+    };
+
+    asio::ip::udp::endpoint fromReceiver{asio::ip::make_address_v4("2.2.2.2"), 10002};
+
+    SECTION("cached packets are resent, only the others are requested from the sender") {
+
+        auto buf = nack(100, 0x0002); // 100 and 102
+        udp.receivePacket(fromReceiver, (char*) buf.data(), buf.size());
+
+        REQUIRE(toReceiver.size() == 1);
+        REQUIRE(toReceiver[0].len == rtp.size());
+        CHECK(ntohs(((const rtp::hdr*) toReceiver[0].buf.data())->seq) == 100);
+        CHECK(std::memcmp(toReceiver[0].buf.data() + 4, rtp.data() + 4, rtp.size() - 4) == 0);
+
+        REQUIRE(toSender.size() == 1);
+        CHECK(toSender[0].len == buf.size());
+        CHECK(toSender[0].buf[12] == 0);
+        CHECK(toSender[0].buf[13] == 102);
+        CHECK(toSender[0].buf[14] == 0);
+        CHECK(toSender[0].buf[15] == 0);
+
+        auto stats = dp.streamStatistics();
+        auto st = std::find_if(stats.begin(), stats.end(), [&](const StreamStatistics& s) {
+            return s.from == sender;
+        });
+
+        REQUIRE(st != stats.end());
+        REQUIRE(st->nackCache);
+        CHECK(st->nackCache->hits == 1);
+        CHECK(st->nackCache->misses == 1);
+        REQUIRE(st->receivers.size() == 1);
+        CHECK(st->receivers[0].retransmitted == 1);
+    }
+
+    SECTION("NACKs answered completely are not forwarded") {
+
+        auto buf = nack(100, 0x0001); // 100 and 101
+        udp.receivePacket(fromReceiver, (char*) buf.data(), buf.size());
+
+        CHECK(toReceiver.size() == 2);
+        CHECK(toSender.empty());
+    }
+
+    SECTION("NACKs following a receiver report are forwarded on their own") {
+
+        std::vector<unsigned char> buf = {0x80, 201, 0x00, 0x01, 0x00, 0x00, 0xab, 0xcd};
+        auto n = nack(102, 0);
+        buf.insert(buf.end(), n.begin(), n.end());
+        udp.receivePacket(fromReceiver, (char*) buf.data(), buf.size());
+
+        CHECK(toReceiver.empty());
+        REQUIRE(toSender.size() == 1);
+        REQUIRE(toSender[0].len == n.size());
+        CHECK(std::memcmp(toSender[0].buf.data(), n.data(), n.size()) == 0);
+    }
+}
+
+TEST_CASE("DataPlaneModel: coalesces PLIs of all receivers until the next keyframe",
+          "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    config.pliWindow = std::chrono::seconds(10);
+    DataPlaneModel dp(&udp, config);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    std::size_t plis = 0;
+    udp.sentPacketHandler = [&plis](const test::MockUDPServer::Pkt& p) {
+        plis += p.to.port() == 10001;
+    };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001};
+
+    for (unsigned short port = 10002; port < 10005; port++) {
+        dp.addStream(DataPlane::Stream{
+            .src      = sender,
+            .dst      = net::IPv4Port{net::IPv4{"2.2.2.2"}, port},
+            .ssrc     = 0x773939ae,
+            .rtcpSsrc = port
+        });
+    }
+
+    auto pliFrom = [&udp](unsigned short port) {
+        std::array<unsigned char, 12> pli = {
+            0x81, 206, 0x00, 0x02,
+            0x00, 0x00, (unsigned char) (port >> 8), (unsigned char) port,
+            0x77, 0x39, 0x39, 0xae
+        };
+        asio::ip::udp::endpoint from{asio::ip::make_address_v4("2.2.2.2"), port};
+        udp.receivePacket(from, (char*) pli.data(), pli.size());
+    };
+
+    // start of frame with template dependency structure (extended descriptor)
+    std::array<unsigned char, 36> keyframe = {
+        0x90, 0x2d, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x77, 0x39, 0x39, 0xae,
+        0xbe, 0xde, 0x00, 0x04, 0xce, 0x80, 0x00, 0x01, 0x80, 0x01, 0x1e, 0xa8,
+        0x51, 0x41, 0x01, 0x0c, 0x04, 0xfc, 0x03, 0xbc, 0x12, 0x34, 0x56, 0x78
+    };
+
+    asio::ip::udp::endpoint fromSender{asio::ip::make_address_v4("1.1.1.1"), 10001};
+
+    for (unsigned short port = 10002; port < 10005; port++) {
+        pliFrom(port);
+    }
+
+    CHECK(plis == 1);
+
+    // a delta frame doesn't answer the request
+    udp.receivePacket(fromSender, (char*) test::full_rtp_av1, sizeof(test::full_rtp_av1));
+    pliFrom(10002);
+    CHECK(plis == 1);
+
+    udp.receivePacket(fromSender, (char*) keyframe.data(), keyframe.size());
+    pliFrom(10003);
+    pliFrom(10004);
+    CHECK(plis == 2);
+
+    // FIRs are keyframe requests as well
+    std::array<unsigned char, 20> fir = {
+        0x84, 206, 0x00, 0x04,
+        0x00, 0x00, 0x27, 0x12,
+        0x00, 0x00, 0x00, 0x00,
+        0x77, 0x39, 0x39, 0xae,
+        0x01, 0x00, 0x00, 0x00
+    };
+
+    asio::ip::udp::endpoint fromReceiver{asio::ip::make_address_v4("2.2.2.2"), 10002};
+    udp.receivePacket(fromReceiver, (char*) fir.data(), fir.size());
+    CHECK(plis == 2);
+
+    udp.receivePacket(fromSender, (char*) keyframe.data(), keyframe.size());
+    udp.receivePacket(fromReceiver, (char*) fir.data(), fir.size());
+    CHECK(plis == 3);
+
+    auto stats = dp.streamStatistics();
+    auto st = std::find_if(stats.begin(), stats.end(), [&](const StreamStatistics& s) {
+        return s.from == sender;
+    });
+
+    REQUIRE(st != stats.end());
+    REQUIRE(st->keyframeRequests);
+    CHECK(st->keyframeRequests->forwarded == 3);
+    CHECK(st->keyframeRequests->suppressed == 5);
+    CHECK(st->keyframeRequests->keyframes == 2);
+}
+
+TEST_CASE("DataPlaneModel: forwards a sender report without the feedback of its compound packet",
+          "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel dp(&udp);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    std::vector<test::MockUDPServer::Pkt> pktsSent;
+    udp.sentPacketHandler = [&pktsSent](const test::MockUDPServer::Pkt& pkt) {
+        pktsSent.push_back(pkt);
+    };
+
+    net::IPv4Port a{net::IPv4{"1.1.1.1"}, 10001}, b{net::IPv4{"2.2.2.2"}, 10002};
+
+    // a reports on b's stream with the SSRC of its own stream, as in the SR below
+    dp.addStream(DataPlane::Stream{.src = a, .dst = b, .ssrc = 0x01000401, .rtcpSsrc = 0xabcd});
+    dp.addStream(DataPlane::Stream{.src = b, .dst = a, .ssrc = 0x6a70d0e8, .rtcpSsrc = 0x01000401});
+
+    const std::array<unsigned char, 12> pli = {
+        0x81, 206, 0x00, 0x02,
+        0x01, 0x00, 0x04, 0x01,
+        0x6a, 0x70, 0xd0, 0xe8
+    };
+
+    std::vector<unsigned char> sr(std::begin(test::rtp_sr_buf), std::end(test::rtp_sr_buf));
+    unsigned plis = 1;
+
+    SECTION("within MAX_RTCP_LEN") { }
+
+    SECTION("longer than MAX_RTCP_LEN") {
+
+        // an SDES chunk padding the SR, the PLIs push the compound packet past the limit
+        std::vector<unsigned char> sdes(1960, 0x00);
+        sdes[0] = 0x81;
+        sdes[1] = 202;
+        sdes[2] = ((sdes.size() / 4 - 1) >> 8) & 0xff;
+        sdes[3] = (sdes.size() / 4 - 1) & 0xff;
+        std::copy(sr.begin() + 4, sr.begin() + 8, sdes.begin() + 4);
+
+        sr.insert(sr.end(), sdes.begin(), sdes.end());
+        plis = 6;
+    }
+
+    std::vector<unsigned char> compound = sr;
+
+    for (unsigned i = 0; i < plis; i++) {
+        compound.insert(compound.end(), pli.begin(), pli.end());
+    }
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+    udp.receivePacket(from, (char*) compound.data(), compound.size());
+
+    // the SR goes to a's receiver, each PLI to the sender of the stream, once
+    REQUIRE(pktsSent.size() == 1 + plis);
+
+    for (const auto& p: pktsSent) {
+
+        CHECK(p.to.port() == 10002);
+
+        if ((unsigned char) p.buf[1] == 200) {
+            REQUIRE(p.len == sr.size());
+            CHECK(std::memcmp(p.buf.data(), sr.data(), p.len) == 0);
+        } else {
+            REQUIRE(p.len == pli.size());
+            CHECK(std::memcmp(p.buf.data(), pli.data(), p.len) == 0);
+        }
+    }
+}
+
+TEST_CASE("DataPlaneModel: drops frames a receiver can't decode until the next keyframe",
+          "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    config.dropUndecodable = true;
+    config.undecodablePLI = true;
+
+    SECTION("PLIs coalesced") {
+        config.pliWindow = std::chrono::seconds(10);
+    }
+
+    // the chains of the receivers break on different frames, still a single PLI is sent
+    SECTION("PLIs not coalesced") { }
+
+    DataPlaneModel dp(&udp, config);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    std::map<unsigned short, std::vector<std::uint16_t>> received;
+    std::size_t plis = 0;
+    udp.sentPacketHandler = [&](const test::MockUDPServer::Pkt& p) {
+        if (p.to.port() == 10001) {
+            const auto* rtcp = (const rtcp::hdr*) p.buf.data();
+            CHECK(rtcp->fb_fmt() == 1);
+            CHECK(ntohl(rtcp->data.pli.ssrc) == 0x773939ae);
+            plis++;
+        } else {
+            received[p.to.port()].push_back(ntohs(((const rtp::hdr*) p.buf.data())->seq));
+        }
+    };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001};
+    net::IPv4Port hi{net::IPv4{"2.2.2.2"}, 10002}, lo{net::IPv4{"2.2.2.2"}, 10003};
+
+    for (const auto& r: {hi, lo}) {
+        dp.addStream(DataPlane::Stream{.src = sender, .dst = r, .ssrc = 0x773939ae});
+    }
+
+    dp.adjustDecodeTarget(sender, lo, 0x773939ae, 0);
+
+    std::array<unsigned char, sizeof(test::full_rtp_av1)> pkt = {};
+    std::memcpy(pkt.data(), test::full_rtp_av1, pkt.size());
+
+    auto* hdr = (rtp::hdr*) pkt.data();
+    auto* dd = (unsigned char*) hdr->extension_ptr(12) + 1;
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+    std::uint16_t seq = 1000;
+
+    // keyframe with the L1T3 template dependency structure, its single chain holds the T0
+    // frames
+    auto keyframe = [&](std::uint16_t frame) {
+        std::vector<unsigned char> k(pkt.begin(), pkt.begin() + sizeof(rtp::hdr));
+        k[0] |= 0x10;
+        k[2] = seq >> 8;
+        k[3] = seq++ & 0xff;
+        k.insert(k.end(), {
+            0xbe, 0xde, 0x00, 0x05,
+            0xcf, 0xc0, (unsigned char) (frame >> 8), (unsigned char) frame, 0x80, 0x02, 0x14,
+            0xea, 0xa8, 0x60, 0x41, 0x4d, 0x14, 0x10, 0x20, 0x84, 0x26,
+            0x00, 0x00, 0x00,
+            0x01, 0x02, 0x03, 0x04
+        });
+        udp.receivePacket(from, (char*) k.data(), k.size());
+    };
+
+    // single-packet frames of templates T0, T2, T1, T2, T0, ...
+    auto send = [&](std::uint16_t first, std::uint16_t last, std::uint16_t lost = 0) {
+        for (auto frame = first; frame <= last; frame++, seq++) {
+            const unsigned char templates[] = {1, 3, 2, 4};
+            dd[0] = 0xc0 | templates[frame % 4];
+            dd[1] = frame >> 8;
+            dd[2] = frame & 0xff;
+            hdr->seq = htons(seq);
+
+            if (frame != lost) {
+                udp.receivePacket(from, (char*) pkt.data(), pkt.size());
+            }
+        }
+    };
+
+    keyframe(100);
+    send(101, 107);
+    CHECK(received[hi.port()].size() == 8);
+    CHECK(received[lo.port()].size() == 2);
+    CHECK(plis == 0);
+
+    // T0 frame 108 is lost upstream: the following frames can't be decoded, a single PLI is
+    // sent for both receivers
+    send(108, 115, 108);
+    CHECK(received[hi.port()].size() == 8);
+    CHECK(received[lo.port()].size() == 2);
+    CHECK(plis == 1);
+
+    keyframe(116);
+    send(117, 120);
+    CHECK(received[hi.port()].size() == 13);
+    CHECK(received[lo.port()].size() == 4);
+    CHECK(plis == 1);
+
+    // the receivers don't see a gap in the sequence numbers of the frames they get
+    for (const auto& r: {hi, lo}) {
+        const auto& s = received[r.port()];
+        for (std::size_t i = 1; i < s.size(); i++) {
+            CHECK(s[i] == (std::uint16_t) (s[i - 1] + 1));
+        }
+    }
+
+    auto stats = dp.streamStatistics();
+    auto st = std::find_if(stats.begin(), stats.end(), [&](const StreamStatistics& s) {
+        return s.from == sender;
+    });
+
+    REQUIRE(st != stats.end());
+    REQUIRE(st->receivers.size() == 2);
+
+    for (const auto& r: st->receivers) {
+        CHECK(r.undecodableDropped == (r.to == hi ? 7 : 1));
+    }
+
+    REQUIRE(st->keyframeRequests);
+    CHECK(st->keyframeRequests->forwarded == (config.pliWindow ? 1 : 0));
+    CHECK(st->keyframeRequests->keyframes == 2);
+}
+
+TEST_CASE("DataPlaneModel: punts only changed receiver reports with the punt filter",
+          "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    config.rtcpPuntFilter = RTCPPuntFilter::Config{};
+    DataPlaneModel dp(&udp, config);
+
+    std::size_t punted = 0;
+    dp.onPacketToController([&punted](DataPlane&, DataPlane::PktIn) { punted++; });
+
+    std::vector<unsigned char> rtcp(std::begin(test::rtcp_rr_buf), std::end(test::rtcp_rr_buf));
+    rtcp.insert(rtcp.end(), std::begin(test::rtcp_remb_buf), std::end(test::rtcp_remb_buf));
+
+    asio::ip::udp::endpoint fromReceiver{asio::ip::make_address_v4("2.2.2.2"), 10002};
+
+    for (int i = 0; i < 3; i++) {
+        udp.receivePacket(fromReceiver, (char*) rtcp.data(), rtcp.size());
+    }
+
+    CHECK(punted == 1);
+    CHECK(dp.totalStatistics().rtcpPkts == 3);
+    CHECK(dp.totalStatistics().rtcpPuntsSuppressed == 2);
+
+    // the filter's state goes with the participant
+    dp.removeParticipant(net::IPv4Port{net::IPv4{"2.2.2.2"}, 10002});
+    udp.receivePacket(fromReceiver, (char*) rtcp.data(), rtcp.size());
+    CHECK(punted == 2);
+}
+
+TEST_CASE("DataPlaneModel: punts AV1 descriptors only when the template dependency structure "
+          "changes", "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    DataPlaneModel dp(&udp, config);
+
+    std::size_t punted = 0;
+    dp.onPacketToController([&punted](DataPlane&, DataPlane::PktIn) { punted++; });
+    udp.sentPacketHandler = [](const test::MockUDPServer::Pkt&) { };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001};
+    net::IPv4Port receiver{net::IPv4{"2.2.2.2"}, 10002};
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+    dp.addStream(DataPlane::Stream{.src = sender, .dst = receiver, .ssrc = 0x773939ae});
+
+    // RTP packet of the stream with a dependency descriptor of up to 16 bytes
+    auto send = [&](std::vector<unsigned char> dd) {
+        std::vector<unsigned char> pkt(test::full_rtp_av1, test::full_rtp_av1 + sizeof(rtp::hdr));
+        auto words = (unsigned char) ((dd.size() + 4) / 4);
+        pkt.insert(pkt.end(), {0xbe, 0xde, 0x00, words, (unsigned char) (0xc0 | (dd.size() - 1))});
+        pkt.insert(pkt.end(), dd.begin(), dd.end());
+        pkt.resize(sizeof(rtp::hdr) + 4 + 4 * words);
+        pkt.insert(pkt.end(), {0x01, 0x02, 0x03, 0x04});
+        udp.receivePacket(from, (char*) pkt.data(), pkt.size());
+    };
+
+    const std::vector<unsigned char> l1t3 = {
+        0xc0, 0x00, 0x64, 0x80, 0x02, 0x14, 0xea, 0xa8, 0x60, 0x41, 0x4d, 0x14, 0x10, 0x20, 0x84,
+        0x26
+    };
+
+    const std::vector<unsigned char> l1t2 = {
+        0x80, 0x00, 0x01, 0x80, 0x01, 0x1e, 0xa8, 0x51, 0x41, 0x01, 0x0c, 0x04, 0xfc, 0x03, 0xbc
+    };
+
+    send(l1t3);
+    CHECK(punted == 1);
+
+    // the structure repeated on the next keyframe
+    auto again = l1t3;
+    again[2] = 0x70;
+    send(again);
+    CHECK(punted == 1);
+    CHECK(dp.totalStatistics().av1PuntsSuppressed == 1);
+
+    // extended descriptors without a structure are punted, the agent resolves them against
+    // its copy
+    send({0x02, 0x00, 0x71, 0x40, 0x03});
+    CHECK(punted == 2);
+    CHECK(dp.totalStatistics().av1PuntsSuppressed == 1);
+
+    send(l1t2);
+    CHECK(punted == 3);
+    CHECK(dp.totalStatistics().av1ExtendedDescriptors == 4);
+    CHECK(dp.totalStatistics().av1PuntsSuppressed == 1);
+
+    // streams without a match are always punted, the agent may not know them yet
+    dp.removeParticipant(sender);
+    send(l1t2);
+    send(l1t2);
+    CHECK(punted == 5);
+
+    dp.addStream(DataPlane::Stream{.src = sender, .dst = receiver, .ssrc = 0x773939ae});
+    send(l1t2);
+    send(l1t2);
+    CHECK(punted == 6);
+}
+
+TEST_CASE("DataPlaneModel: sends transport-cc feedback and estimates the bandwidth to receivers",
+          "[data_plane_model]") {
+
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    config.transportFeedback = TransportFeedback::Config{
+        .rtpExt   = 3,
+        .interval = std::chrono::milliseconds(0)
+    };
+    config.delayBasedEstimate = DelayBasedEstimator::Config{};
+    DataPlaneModel dp(&udp, config);
+
+    std::size_t punted = 0;
+    dp.onPacketToController([&punted](DataPlane&, DataPlane::PktIn) { punted++; });
+
+    std::vector<test::MockUDPServer::Pkt> toSender, toReceiver;
+    udp.sentPacketHandler = [&](const test::MockUDPServer::Pkt& p) {
+        (p.to.port() == 10001 ? toSender : toReceiver).push_back(p);
+    };
+
+    net::IPv4Port sender{net::IPv4{"1.1.1.1"}, 10001}, receiver{net::IPv4{"2.2.2.2"}, 10002};
+    dp.addStream(DataPlane::Stream{.src = sender, .dst = receiver, .ssrc = 0x11223344});
+
+    // RTP with a one-byte header extension carrying the transport-wide sequence number
+    std::vector<unsigned char> rtp = {
+        0x90, 96, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00,
+        0x11, 0x22, 0x33, 0x44,
+        0xbe, 0xde, 0x00, 0x01,
+        0x31, 0x00, 0x00, 0x00,
+        0x01, 0x02, 0x03, 0x04
+    };
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+
+    for (std::uint16_t seq = 1000; seq < 1003; seq++) {
+        rtp[17] = (unsigned char) (seq >> 8);
+        rtp[18] = (unsigned char) seq;
+        udp.receivePacket(from, (char*) rtp.data(), rtp.size());
+    }
+
+    // feedback to the sender on the arrivals of its sequence numbers
+    REQUIRE(toSender.size() == 3);
+
+    for (std::uint16_t i = 0; i < 3; i++) {
+        const auto* fb = (const rtcp::hdr*) toSender[i].buf.data();
+        CHECK(fb->pt == 205);
+        CHECK(fb->fb_fmt() == 15);
+        CHECK(ntohl(fb->data.twcc.ssrc) == 0x11223344);
+
+        std::vector<std::uint16_t> seqs;
+        CHECK(TransportFeedback::parse((const unsigned char*) toSender[i].buf.data(),
+                                       toSender[i].len,
+                                       [&](std::uint16_t seq, auto) { seqs.push_back(seq); }));
+        CHECK(seqs == std::vector<std::uint16_t>{(std::uint16_t) (1000 + i)});
+    }
+
+    // the receiver's packets are stamped with its own sequence numbers, the rest is untouched
+    REQUIRE(toReceiver.size() == 3);
+
+    for (std::uint16_t i = 0; i < 3; i++) {
+        REQUIRE(toReceiver[i].len == rtp.size());
+        CHECK(toReceiver[i].buf[17] == 0);
+        CHECK(toReceiver[i].buf[18] == i);
+        CHECK(std::memcmp(toReceiver[i].buf.data(), rtp.data(), 17) == 0);
+        CHECK(std::memcmp(toReceiver[i].buf.data() + 19, rtp.data() + 19, rtp.size() - 19) == 0);
+    }
+
+    // the receiver's feedback stays in the data plane and yields its estimate
+    TransportFeedback receiverFeedback{TransportFeedback::Config{}};
+    auto now = TransportFeedback::Clock::now();
+
+    for (std::uint16_t seq = 0; seq < 3; seq++) {
+        receiverFeedback.record(seq, now + seq * std::chrono::milliseconds(1));
+    }
+
+    std::vector<unsigned char> buf(1200);
+    auto len = receiverFeedback.write(buf.data(), buf.size(), 0x11223344, now);
+    REQUIRE(len > 0);
+
+    asio::ip::udp::endpoint fromReceiver{asio::ip::make_address_v4("2.2.2.2"), 10002};
+    udp.receivePacket(fromReceiver, (char*) buf.data(), len);
+
+    CHECK(punted == 0);
+
+    auto stats = dp.streamStatistics();
+    auto st = std::find_if(stats.begin(), stats.end(), [&](const StreamStatistics& s) {
+        return s.from == sender;
+    });
+
+    REQUIRE(st != stats.end());
+    REQUIRE(st->receivers.size() == 1);
+    REQUIRE(st->receivers[0].delayBasedEstimate);
+    CHECK(*st->receivers[0].delayBasedEstimate >= 1'000'000);
+    CHECK(*st->receivers[0].delayBasedEstimate < 1'010'000);
+
+    // the state goes with the participants
+    dp.removeParticipant(receiver);
+    for (const auto& s: dp.streamStatistics()) {
+        CHECK(s.receivers.empty());
+    }
+}
+
+TEST_CASE("DataPlaneModel: sends the last transport-cc feedback to a sender that went quiet",
+          "[data_plane_model]") {
+
+    asio::io_context io;
+    test::MockUDPServer udp;
+    DataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    config.transportFeedback = TransportFeedback::Config{
+        .rtpExt   = 3,
+        .interval = std::chrono::milliseconds(20)
+    };
+    DataPlaneModel dp(&udp, config, &io);
+
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    std::vector<std::uint16_t> reported;
+    udp.sentPacketHandler = [&](const test::MockUDPServer::Pkt& p) {
+        if (p.to.port() == 10001) {
+            CHECK(TransportFeedback::parse((const unsigned char*) p.buf.data(), p.len,
+                                           [&](std::uint16_t seq, auto) {
+                                               reported.push_back(seq);
+                                           }));
+        }
+    };
+
+    dp.addStream(DataPlane::Stream{
+        .src  = net::IPv4Port{net::IPv4{"1.1.1.1"}, 10001},
+        .dst  = net::IPv4Port{net::IPv4{"2.2.2.2"}, 10002},
+        .ssrc = 0x11223344
+    });
+
+    std::vector<unsigned char> rtp = {
+        0x90, 96, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00,
+        0x11, 0x22, 0x33, 0x44,
+        0xbe, 0xde, 0x00, 0x01,
+        0x31, 0x03, 0xe8, 0x00,
+        0x01, 0x02, 0x03, 0x04
+    };
+
+    asio::ip::udp::endpoint from{asio::ip::make_address_v4("1.1.1.1"), 10001};
+    udp.receivePacket(from, (char*) rtp.data(), rtp.size());
+
+    // not due on arrival, no further packet makes it due
+    CHECK(reported.empty());
+
+    // the timer stops once nothing is left to report
+    io.run_for(std::chrono::seconds(2));
+
+    CHECK(reported == std::vector<std::uint16_t>{1000});
+    CHECK(io.stopped());
+}
@@ -0,0 +1,95 @@
+#include <catch.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <delay_based_estimator.h>
+#include <transport_feedback.h>
+
+using namespace p4sfu;
+using namespace std::chrono_literals;
+
+namespace {
+
+    using Clock = DelayBasedEstimator::Clock;
+
+    //! sends packets of 1000 bytes every 10 ms (800 kbps) over a path with a bottleneck of
+    //! rate bits per second for duration, the receiver sends feedback every 100 ms
+    void simulate(DelayBasedEstimator& e, unsigned long rate, Clock::duration duration,
+                  Clock::time_point t0) {
+
+        TransportFeedback receiver{TransportFeedback::Config{}};
+        std::vector<unsigned char> buf(1200);
+
+        const std::size_t len = 1000;
+        const auto propagation = 20ms;
+        const auto serialization = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>((double) len * 8 / (double) rate));
+
+        auto arrival = t0;
+
+        for (auto sent = t0; sent < t0 + duration; sent += 10ms) {
+
+            auto seq = e.onSent(len, sent);
+            arrival = std::max(sent + propagation, arrival + serialization);
+            receiver.record(seq, arrival);
+
+            if (receiver.due(sent)) {
+                while (auto n = receiver.write(buf.data(), buf.size(), 1, sent)) {
+                    REQUIRE(e.onFeedback(buf.data(), n, sent));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("DelayBasedEstimator: estimates the bandwidth of a path from transport-cc feedback",
+          "[delay_based_estimator]") {
+
+    auto t0 = DelayBasedEstimator::Clock::time_point{} + 1000s;
+    DelayBasedEstimator e{DelayBasedEstimator::Config{.initialRate = 1'000'000}, t0};
+
+    CHECK(e.estimate() == 1'000'000);
+
+    SECTION("the estimate grows while the delay is constant") {
+
+        simulate(e, 10'000'000, 5s, t0);
+
+        CHECK(e.usage() == DelayBasedEstimator::Usage::normal);
+        CHECK(e.acknowledgedRate() == Approx(800'000).epsilon(0.05));
+        CHECK(e.estimate() > 1'200'000);
+        CHECK(e.estimate() <= 2'000'000); // 2.5 times the acknowledged rate
+    }
+
+    SECTION("the estimate drops below the bottleneck rate when a queue builds up") {
+
+        simulate(e, 500'000, 5s, t0);
+
+        CHECK(e.usage() == DelayBasedEstimator::Usage::overusing);
+        CHECK(e.acknowledgedRate() == Approx(500'000).epsilon(0.05));
+        CHECK(e.estimate() < 500'000);
+    }
+
+    SECTION("feedback on unknown packets doesn't change the estimate") {
+
+        TransportFeedback receiver{TransportFeedback::Config{}};
+        std::vector<unsigned char> buf(1200);
+
+        for (std::uint16_t seq = 100; seq < 200; seq++) {
+            receiver.record(seq, t0 + seq * 1ms);
+        }
+
+        auto n = receiver.write(buf.data(), buf.size(), 1, t0 + 200ms);
+        REQUIRE(e.onFeedback(buf.data(), n, t0 + 200ms));
+        CHECK(e.estimate() == 1'000'000);
+        CHECK_FALSE(e.onFeedback(buf.data(), 8, t0 + 200ms));
+    }
+
+    SECTION("invalid configuration") {
+
+        CHECK_THROWS_AS(DelayBasedEstimator{DelayBasedEstimator::Config{.window = 1}},
+                        std::invalid_argument);
+        CHECK_THROWS_AS(DelayBasedEstimator{DelayBasedEstimator::Config{.history = 0}},
+                        std::invalid_argument);
+    }
+}
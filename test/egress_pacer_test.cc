@@ -0,0 +1,149 @@
+#include <catch.h>
+
+#include <vector>
+
+#include <egress_pacer.h>
+
+using namespace p4sfu;
+using namespace std::chrono_literals;
+
+namespace {
+
+    struct Sent {
+        net::IPv4Port to;
+        std::size_t len;
+        EgressPacer::Clock::time_point at;
+        EgressPacer::Clock::time_point departure;
+    };
+}
+
+TEST_CASE("EgressPacer: paces a burst at the receiver's rate", "[egress_pacer]") {
+
+    auto t0 = EgressPacer::Clock::now();
+    auto now = t0;
+    std::vector<Sent> sent;
+
+    EgressPacer::Config c;
+    c.pacingFactor = 1;
+    c.burst = 2000;
+    c.tick = 100us;
+
+    EgressPacer p{c, [&](const net::IPv4Port& to, const char*, std::size_t hdrLen, const char*,
+                         std::size_t payloadLen, EgressPacer::Clock::time_point departure) {
+        sent.push_back(Sent{to, hdrLen + payloadLen, now, departure});
+    }, t0};
+
+    net::IPv4Port paced{net::IPv4{"2.2.2.2"}, 10002}, unpaced{net::IPv4{"2.2.2.3"}, 10002};
+    char hdr[12] = {}, payload[988] = {};
+
+    // 8 Mbit/s: 1000 bytes per ms
+    p.setBandwidthEstimate(paced, 8'000'000, t0);
+
+    for (int i = 0; i < 10; i++) {
+        p.send(paced, hdr, sizeof(hdr), payload, sizeof(payload), now);
+        p.send(unpaced, hdr, sizeof(hdr), payload, sizeof(payload), now);
+    }
+
+    auto to = [&sent](const net::IPv4Port& a) {
+        return std::count_if(sent.begin(), sent.end(), [&a](const Sent& s) { return s.to == a; });
+    };
+
+    // the bucket lets 2 packets pass, the rest waits, unpaced receivers are not affected
+    CHECK(to(paced) == 2);
+    CHECK(to(unpaced) == 10);
+    CHECK_FALSE(p.idle());
+
+    while (!p.idle() && now < t0 + 100ms) {
+        now += 100us;
+        p.poll(now);
+    }
+
+    REQUIRE(to(paced) == 10);
+
+    std::vector<Sent> s;
+    std::copy_if(sent.begin(), sent.end(), std::back_inserter(s), [&](const Sent& x) {
+        return x.to == paced;
+    });
+
+    // one packet per ms after the burst
+    for (std::size_t i = 3; i < s.size(); i++) {
+        auto gap = s[i].at - s[i - 1].at;
+        CHECK(gap >= 900us);
+        CHECK(gap <= 1100us);
+    }
+
+    auto st = p.statistics(paced);
+    REQUIRE(st);
+    CHECK(st->rate == 8'000'000);
+    CHECK(st->pkts == 10);
+    CHECK(st->delayed == 8);
+    CHECK(st->dropped == 0);
+    CHECK(st->maxQueueingDelayUs >= 7000);
+    CHECK_FALSE(p.statistics(net::IPv4Port{net::IPv4{"9.9.9.9"}, 1}));
+}
+
+TEST_CASE("EgressPacer: drops packets that would wait too long", "[egress_pacer]") {
+
+    auto t0 = EgressPacer::Clock::now();
+    std::size_t sent = 0;
+
+    EgressPacer::Config c;
+    c.pacingFactor = 1;
+    c.burst = 1000;
+    c.maxQueueingDelay = 5ms;
+
+    EgressPacer p{c, [&](auto&&...) { sent++; }, t0};
+
+    net::IPv4Port to{net::IPv4{"2.2.2.2"}, 10002};
+    char payload[1000] = {};
+
+    p.setBandwidthEstimate(to, 8'000'000, t0);
+
+    for (int i = 0; i < 20; i++) {
+        p.send(to, nullptr, 0, payload, sizeof(payload), t0);
+    }
+
+    auto st = p.statistics(to);
+    REQUIRE(st);
+    CHECK(sent == 1);
+    CHECK(st->dropped == 14); // 5 packets fit into 5 ms
+
+    p.removeReceiver(to);
+    CHECK_FALSE(p.statistics(to));
+    p.poll(t0 + 10ms); // scheduled release of the removed receiver is ignored
+    CHECK(sent == 1);
+}
+
+TEST_CASE("EgressPacer: txTime hands packets over with their departure time", "[egress_pacer]") {
+
+    auto t0 = EgressPacer::Clock::now();
+    std::vector<Sent> sent;
+
+    EgressPacer::Config c;
+    c.pacingFactor = 1;
+    c.burst = 1000;
+    c.txTime = true;
+
+    EgressPacer p{c, [&](const net::IPv4Port& to, const char*, std::size_t hdrLen, const char*,
+                         std::size_t payloadLen, EgressPacer::Clock::time_point departure) {
+        sent.push_back(Sent{to, hdrLen + payloadLen, t0, departure});
+    }, t0};
+
+    net::IPv4Port to{net::IPv4{"2.2.2.2"}, 10002};
+    char payload[1000] = {};
+
+    p.setBandwidthEstimate(to, 8'000'000, t0);
+
+    for (int i = 0; i < 4; i++) {
+        p.send(to, nullptr, 0, payload, sizeof(payload), t0);
+    }
+
+    REQUIRE(sent.size() == 4);
+    CHECK(p.idle());
+
+    for (int i = 0; i < (int) sent.size(); i++) {
+        auto d = sent[i].departure - t0;
+        CHECK(d >= i * 1ms - 10us);
+        CHECK(d <= i * 1ms + 10us);
+    }
+}
@@ -0,0 +1,60 @@
+#include <catch.h>
+
+#include <net/packet_buffer_pool.h>
+
+#include <cstring>
+
+TEST_CASE("PacketBufferPool: reuses buffers after the last reference is dropped",
+          "[packet_buffer_pool]") {
+
+    PacketBufferPool pool{128, 4};
+    CHECK(pool.statistics().slabs == 0);
+
+    char* first;
+
+    {
+        auto a = pool.get();
+        first = a.data();
+        CHECK(a.capacity() == 128);
+        CHECK(a.useCount() == 1);
+
+        auto b = a;
+        CHECK(a.useCount() == 2);
+        CHECK(b.data() == first);
+        CHECK(b.contains(first + 127));
+        CHECK(!b.contains(first + 128));
+
+        CHECK(pool.statistics().slabs == 1);
+        CHECK(pool.statistics().inUse == 1);
+    }
+
+    CHECK(pool.statistics().inUse == 0);
+    CHECK(pool.get().data() == first);
+
+    std::vector<PacketBufferPool::Ref> refs;
+
+    for (int i = 0; i < 5; i++) {
+        refs.push_back(pool.get());
+    }
+
+    CHECK(pool.statistics().slabs == 2);
+    CHECK(pool.statistics().inUse == 5);
+
+    refs.clear();
+    CHECK(pool.statistics().inUse == 0);
+}
+
+TEST_CASE("PacketBufferPool: buffers outlive the pool", "[packet_buffer_pool]") {
+
+    PacketBufferPool::Ref ref;
+
+    {
+        PacketBufferPool pool{64};
+        ref = pool.get();
+        std::memset(ref.data(), 0xab, ref.capacity());
+    }
+
+    CHECK((unsigned char) ref.data()[63] == 0xab);
+    ref = {};
+    CHECK(!ref);
+}
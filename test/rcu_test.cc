@@ -0,0 +1,100 @@
+#include <catch.h>
+
+#include <thread>
+
+#include <rcu.h>
+
+using namespace p4sfu;
+
+namespace {
+
+    //! counts live instances to observe reclamation
+    struct Counted {
+        Counted() { live++; }
+        Counted(const Counted& o) : value(o.value) { live++; }
+        ~Counted() { live--; }
+        static inline int live = 0;
+        int value = 0;
+    };
+}
+
+TEST_CASE("RCU: read() and update()", "[rcu]") {
+
+    RCU<std::vector<int>> r{{1, 2}};
+    CHECK(r.read()->size() == 2);
+
+    r.update([](auto& v) { v.push_back(3); });
+    CHECK(r.read()->size() == 3);
+    CHECK((*r.read())[2] == 3);
+}
+
+TEST_CASE("RCU: a pinned version survives updates", "[rcu]") {
+
+    {
+        RCU<Counted> r;
+
+        auto pinned = r.read();
+        r.update([](auto& c) { c.value = 1; });
+        r.update([](auto& c) { c.value = 2; });
+        r.reclaim();
+
+        CHECK(pinned->value == 0);
+        CHECK(r.read()->value == 2);
+        CHECK(r.retired() > 0);
+    }
+
+    CHECK(Counted::live == 0);
+}
+
+TEST_CASE("RCU: retired versions are reclaimed once readers leave", "[rcu]") {
+
+    RCU<Counted> r;
+
+    {
+        auto pinned = r.read();
+        r.update([](auto& c) { c.value = 1; });
+        CHECK(Counted::live == 2);
+    }
+
+    r.reclaim();
+    r.reclaim();
+    CHECK(r.retired() == 0);
+    CHECK(Counted::live == 1);
+}
+
+TEST_CASE("RCU: concurrent reader and writer", "[rcu]") {
+
+    RCU<std::vector<int>> r{std::vector<int>(64, 0)};
+    std::atomic<bool> done = false;
+    std::atomic<unsigned long> reads = 0, torn = 0;
+
+    std::thread reader{[&]() {
+        while (!done) {
+            auto v = r.read();
+            // every version holds 64 equal values, a reclaimed or half-written one would not
+            for (auto x: *v) {
+                torn += x != v->front();
+            }
+            reads++;
+        }
+    }};
+
+    while (reads == 0) {
+        std::this_thread::yield();
+    }
+
+    for (int i = 1; i <= 2000; i++) {
+        r.update([i](auto& v) { std::fill(v.begin(), v.end(), i); });
+        std::this_thread::yield();
+    }
+
+    done = true;
+    reader.join();
+    r.reclaim();
+    r.reclaim();
+
+    CHECK(r.read()->front() == 2000);
+    CHECK(torn == 0);
+    CHECK(reads > 0);
+    CHECK(r.retired() == 0);
+}
@@ -0,0 +1,71 @@
+#include <catch.h>
+
+#include <vector>
+
+#include <retransmission_cache.h>
+
+using namespace p4sfu;
+
+TEST_CASE("RetransmissionCache: finds recently inserted packets", "[retransmission_cache]") {
+
+    RetransmissionCache c{RetransmissionCache::Config{.packets = 6}};
+    auto now = RetransmissionCache::Clock::now();
+    std::vector<unsigned char> pkt(100, 0x42);
+
+    CHECK(c.capacity() == 8);
+
+    for (std::uint16_t seq = 65530; seq != 4; seq++) { // across the wrap-around
+        pkt[0] = (unsigned char) seq;
+        c.insert(seq, pkt.data(), pkt.size(), now);
+    }
+
+    SECTION("only the last packets are kept") {
+
+        for (std::uint16_t seq = 65532; seq != 4; seq++) {
+            auto p = c.find(seq, now);
+            REQUIRE(p);
+            CHECK(p->len == pkt.size());
+            CHECK(p->buf[0] == (unsigned char) seq);
+        }
+
+        CHECK_FALSE(c.find(65530, now));
+        CHECK_FALSE(c.find(65531, now));
+        CHECK_FALSE(c.find(4, now));
+    }
+
+    SECTION("packets expire") {
+
+        CHECK(c.find(3, now + std::chrono::milliseconds(1000)));
+        CHECK_FALSE(c.find(3, now + std::chrono::milliseconds(1001)));
+    }
+
+    SECTION("oversized packets aren't cached and clear their slot") {
+
+        std::vector<unsigned char> large(RetransmissionCache::MAX_PACKET_LEN + 1);
+        c.insert(11, large.data(), large.size(), now);
+        CHECK_FALSE(c.find(11, now));
+        CHECK_FALSE(c.find(3, now));
+    }
+
+    SECTION("invalid configuration") {
+
+        CHECK_THROWS_AS(RetransmissionCache{RetransmissionCache::Config{.packets = 0}},
+                        std::invalid_argument);
+    }
+}
+
+TEST_CASE("SequenceHistory: maps sent to original sequence numbers", "[retransmission_cache]") {
+
+    SequenceHistory h;
+    CHECK_FALSE(h.original(10));
+
+    h.record(10, 20);
+    h.record(11, 22);
+    CHECK(h.original(10) == 20);
+    CHECK(h.original(11) == 22);
+    CHECK_FALSE(h.original(12));
+
+    h.record(10 + SequenceHistory::SIZE, 30); // evicts 10
+    CHECK_FALSE(h.original(10));
+    CHECK(h.original(10 + SequenceHistory::SIZE) == 30);
+}
@@ -0,0 +1,77 @@
+#include <catch.h>
+
+#include <vector>
+
+#include "proto/rtcp.h"
+#include "rtp_rtcp_packets.h"
+#include "rtcp_punt_filter.h"
+
+using namespace p4sfu;
+
+TEST_CASE("RTCPPuntFilter: punts receiver reports on meaningful changes", "[rtcp_punt_filter]") {
+
+    RTCPPuntFilter f{RTCPPuntFilter::Config{
+        .rembRelative = 0.1,
+        .rembAbsolute = 50000,
+        .fractionLost = 5,
+        .maxStaleness = std::chrono::seconds(1)
+    }};
+
+    net::IPv4Port receiver{net::IPv4{"2.2.2.2"}, 10002};
+    auto now = RTCPPuntFilter::Clock::now();
+
+    // compound RR + REMB
+    auto report = [](unsigned bitRate, std::uint8_t fractionLost = 0) {
+        std::vector<unsigned char> buf(std::begin(test::rtcp_rr_buf), std::end(test::rtcp_rr_buf));
+        buf[12] = fractionLost; // of the first report block
+        buf.resize(buf.size() + rtcp::REMB_LEN);
+        rtcp::write_remb(buf.data() + sizeof(test::rtcp_rr_buf), 1, 2, bitRate);
+        return buf;
+    };
+
+    auto admit = [&](const std::vector<unsigned char>& buf, RTCPPuntFilter::Clock::duration t) {
+        return f.admit(receiver, buf.data(), buf.size(), now + t);
+    };
+
+    auto ms = [](int n) { return std::chrono::milliseconds(n); };
+
+    CHECK(admit(report(1000000), ms(0)));
+    CHECK_FALSE(admit(report(1000000), ms(10)));
+
+    SECTION("bit rate changes must exceed both thresholds") {
+        CHECK_FALSE(admit(report(1090000), ms(20))); // 9 %
+        CHECK_FALSE(admit(report(900001), ms(30)));
+        CHECK(admit(report(1200000), ms(40)));
+        CHECK_FALSE(admit(report(1200000), ms(50)));
+
+        // small rates: 10 % is below the absolute threshold
+        CHECK(admit(report(100000), ms(60)));
+        CHECK_FALSE(admit(report(140000), ms(70)));
+    }
+
+    SECTION("fraction lost changes") {
+        CHECK_FALSE(admit(report(1000000, 5), ms(20)));
+        CHECK(admit(report(1000000, 6), ms(30)));
+        CHECK_FALSE(admit(report(1000000, 2), ms(40)));
+    }
+
+    SECTION("reports are punted when the last punt is stale") {
+        CHECK_FALSE(admit(report(1000000), ms(999)));
+        CHECK(admit(report(1000000), ms(1000)));
+        CHECK_FALSE(admit(report(1000000), ms(1999)));
+    }
+
+    SECTION("reports of other receivers and removed receivers are punted") {
+        auto buf = report(1000000);
+        CHECK(f.admit(net::IPv4Port{net::IPv4{"2.2.2.2"}, 10003}, buf.data(), buf.size(), now));
+        f.removeReceiver(receiver);
+        CHECK(admit(buf, ms(20)));
+    }
+
+    SECTION("packets with other feedback are always punted") {
+        auto buf = report(1000000);
+        buf.insert(buf.end(), std::begin(test::rtcp_nack_buf), std::end(test::rtcp_nack_buf));
+        CHECK(admit(buf, ms(20)));
+        CHECK(admit(buf, ms(30)));
+    }
+}
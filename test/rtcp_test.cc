@@ -6,6 +6,8 @@
 #include "rtp_rtcp_packets.h"
 
 #include <iostream>
+#include <iterator>
+#include <vector>
 
 TEST_CASE("rtcp: can be parsed from a packet buffer", "[rtcp]") {
 
@@ -70,6 +72,21 @@ TEST_CASE("rtcp: parses receiver-estimated bandwidth reports", "[rtcp]") {
     CHECK(rtcp->data.remb.ssrcs[0] == ntohl(1926291140));
 }
 
+TEST_CASE("rtcp: writes receiver-estimated bandwidth reports", "[rtcp]") {
+
+    unsigned char buf[rtcp::REMB_LEN];
+
+    rtcp::write_remb(buf, 3128394281, 1926291140, 229389);
+    CHECK(std::memcmp(buf, test::rtcp_remb_buf, sizeof(buf)) == 0);
+
+    // bit rates beyond the 18-bit mantissa lose their low bits
+    rtcp::write_remb(buf, 1, 2, 5000001);
+    const auto* rtcp = reinterpret_cast<const rtcp::hdr*>(buf);
+    CHECK(rtcp->byte_len() == rtcp::REMB_LEN);
+    CHECK(rtcp->data.remb.num_ssrcs() == 1);
+    CHECK(rtcp->data.remb.bit_rate() == 5000000 - 5000000 % 32);
+}
+
 TEST_CASE("rtcp: parses negative acknowledgements", "[rtcp]") {
 
     const auto* rtcp = reinterpret_cast<const rtcp::hdr*>(test::rtcp_nack_buf);
@@ -85,4 +102,64 @@ TEST_CASE("rtcp: parses negative acknowledgements", "[rtcp]") {
     CHECK(ntohl(rtcp->data.nack.ssrc) == 0x1c5ef618);
     CHECK(ntohs(rtcp->data.nack.pid) == 11564);
     CHECK(ntohs(rtcp->data.nack.blp) == 0);
-}
\ No newline at end of file
+}
+TEST_CASE("rtcp: iterates over the packets of a compound packet", "[rtcp]") {
+
+    std::vector<unsigned char> buf(std::begin(test::rtcp_rr_buf), std::end(test::rtcp_rr_buf));
+    buf.insert(buf.end(), std::begin(test::rtcp_remb_buf), std::end(test::rtcp_remb_buf));
+
+    SECTION("all packets of a well-formed compound packet") {
+
+        rtcp::compound packets{buf.data(), buf.size()};
+        CHECK(!packets.truncated());
+
+        auto it = packets.begin();
+        REQUIRE(it != packets.end());
+        CHECK(it.offset() == 0);
+        CHECK(it->pt == 201);
+        CHECK(it->complete());
+        CHECK(!it->is_remb());
+
+        ++it;
+        REQUIRE(it != packets.end());
+        CHECK(it.offset() == sizeof(test::rtcp_rr_buf));
+        CHECK(it->is_remb());
+        CHECK(it->complete());
+        CHECK(it->data.remb.bit_rate() == 229389);
+
+        CHECK(++it == packets.end());
+        CHECK(std::distance(packets.begin(), packets.end()) == 2);
+    }
+
+    SECTION("stops before a packet that extends beyond the buffer") {
+
+        rtcp::compound packets{buf.data(), buf.size() - 4};
+        CHECK(packets.truncated());
+        CHECK(std::distance(packets.begin(), packets.end()) == 1);
+    }
+
+    SECTION("stops at a packet shorter than the common header") {
+
+        buf[sizeof(test::rtcp_rr_buf) + 2] = 0;
+        buf[sizeof(test::rtcp_rr_buf) + 3] = 0; // length of 4 bytes
+
+        rtcp::compound packets{buf.data(), buf.size()};
+        CHECK(packets.truncated());
+        CHECK(std::distance(packets.begin(), packets.end()) == 1);
+    }
+
+    SECTION("empty and short buffers have no packets") {
+
+        CHECK(rtcp::compound{buf.data(), 0}.begin() == rtcp::compound{buf.data(), 0}.end());
+        CHECK(!rtcp::compound{buf.data(), 0}.truncated());
+        CHECK(rtcp::compound{buf.data(), 4}.truncated());
+    }
+
+    SECTION("reports the fields a packet's length doesn't cover as incomplete") {
+
+        buf[0] = 0x83; // three report blocks in a packet long enough for two
+
+        rtcp::compound packets{buf.data(), buf.size()};
+        CHECK(!packets.begin()->complete());
+    }
+}
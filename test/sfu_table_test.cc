@@ -1,5 +1,8 @@
 #include <catch.h>
 
+#include <algorithm>
+#include <utility>
+
 #include <sfu_table.h>
 
 using namespace p4sfu;
@@ -98,7 +101,7 @@ TEST_CASE("SFUTable: Entry: addAction()", "[sfu_table]") {
 
         auto& a = m.actions().front();
         CHECK(a.to() == action.to());
-        CHECK(a.svcConfig == std::nullopt);
+        CHECK(a.decodeTarget == std::nullopt);
     }
 
     SECTION("throws when adding an action that already exists") {
@@ -106,7 +109,7 @@ TEST_CASE("SFUTable: Entry: addAction()", "[sfu_table]") {
     }
 }
 
-TEST_CASE("SFUTable: Action: set svcConfig", "[sfu_table]") {
+TEST_CASE("SFUTable: Action: set decodeTarget", "[sfu_table]") {
 
     SFUTable::Match match{net::IPv4Port{"1.2.2.4", 23823}, 783927459};
     SFUTable::Action action{net::IPv4Port{"5.6.7.8", 23825}};
@@ -116,7 +119,293 @@ TEST_CASE("SFUTable: Action: set svcConfig", "[sfu_table]") {
     CHECK_NOTHROW(m.addAction(action));
 
     auto& a = m.actions().front();
-    a.svcConfig = av1::svc::L1T3{};
-    CHECK(a.svcConfig);
-    CHECK(a.svcConfig->decodeTarget == av1::svc::L1T3::DecodeTarget::hi);
+    a.decodeTarget = 5;
+    m.updateTreatment(a);
+    REQUIRE(m.nodes().size() == 1);
+    CHECK(m.nodes().front().decodeTarget == 5u);
+}
+
+TEST_CASE("SFUTable: grows and keeps all matches", "[sfu_table]") {
+
+    SFUTable t;
+
+    for (unsigned i = 0; i < 10000; i++) {
+        auto& e = t.addMatch(SFUTable::Match{net::IPv4Port{net::IPv4{0x0a000000 + i / 8},
+                                                           (unsigned short) (5000 + i % 8)}, i});
+        e.addAction(SFUTable::Action{net::IPv4Port{net::IPv4{0x0b000000 + i}, 6000}});
+    }
+
+    CHECK(t.size() == 10000);
+
+    for (unsigned i = 0; i < 10000; i++) {
+        SFUTable::Match m{net::IPv4Port{net::IPv4{0x0a000000 + i / 8},
+                                        (unsigned short) (5000 + i % 8)}, i};
+        auto* e = t.find(m);
+        REQUIRE(e);
+        REQUIRE(e->actions().size() == 1);
+        CHECK(e->actions().front().to() == net::IPv4Port{net::IPv4{0x0b000000 + i}, 6000});
+    }
+
+    CHECK_FALSE(t.find(SFUTable::Match{net::IPv4Port{net::IPv4{0x0a000000}, 5000}, 1}));
+}
+
+TEST_CASE("SFUTable: keys differing only in address, port or SSRC", "[sfu_table]") {
+
+    SFUTable t;
+
+    SFUTable::Match m1{net::IPv4Port{"1.2.3.4", 5000}, 1};
+    SFUTable::Match m2{net::IPv4Port{"1.2.3.4", 5001}, 1};
+    SFUTable::Match m3{net::IPv4Port{"1.2.3.5", 5000}, 1};
+    SFUTable::Match m4{net::IPv4Port{"1.2.3.4", 5000}, 2};
+
+    for (const auto& m: {m1, m2, m3, m4}) {
+        t.addMatch(m).addAction(SFUTable::Action{m.ipPort()});
+    }
+
+    CHECK(t.size() == 4);
+
+    for (const auto& m: {m1, m2, m3, m4}) {
+        CHECK(m.ipPort() == t[m].actions().front().to());
+        CHECK(t[m].actions().size() == 1);
+    }
+
+    CHECK(m1.ipPort() == net::IPv4Port{"1.2.3.4", 5000});
+    CHECK(m4.ssrc() == 2);
+}
+
+TEST_CASE("SFUTable: actions are stored contiguously and cache-line aligned", "[sfu_table]") {
+
+    SFUTable t;
+    auto& e = t.addMatch(SFUTable::Match{net::IPv4Port{"1.2.3.4", 5000}, 1});
+
+    for (unsigned short p = 0; p < 8; p++) {
+        e.addAction(SFUTable::Action{net::IPv4Port{"5.6.7.8", (unsigned short) (6000 + p)}});
+    }
+
+    auto& actions = t[SFUTable::Match{net::IPv4Port{"1.2.3.4", 5000}, 1}].actions();
+    CHECK(actions.size() == 8);
+    CHECK(reinterpret_cast<std::uintptr_t>(actions.data()) % 64 == 0);
+    CHECK(&actions[7] - &actions[0] == 7);
+}
+
+TEST_CASE("SFUTable: copies share the per-packet state of actions and entries", "[sfu_table]") {
+
+    SFUTable::Match match{net::IPv4Port{"1.2.2.4", 23823}, 783927459};
+
+    SFUTable t;
+    t.addMatch(match).addAction(SFUTable::Action{net::IPv4Port{"5.6.7.8", 23825}});
+
+    auto copy = t;
+    copy[match].actions().front().decodeTarget = 0;
+
+    CHECK(t[match].actions().front().decodeTarget == std::nullopt);
+    CHECK(t[match].actions().front().state == copy[match].actions().front().state);
+
+    copy[match].counters().pkts.add();
+    CHECK(t[match].counters().pkts.get() == 1);
+}
+
+TEST_CASE("SFUTable: removeMatch()", "[sfu_table]") {
+
+    SFUTable t;
+
+    SECTION("throws when match does not exist") {
+        CHECK_THROWS(t.removeMatch(SFUTable::Match{net::IPv4Port{"1.2.2.4", 23823}, 1}));
+    }
+
+    SECTION("keeps the remaining matches reachable and shrinks") {
+
+        auto match = [](unsigned i) {
+            return SFUTable::Match{net::IPv4Port{net::IPv4{0x0a000000 + i / 4},
+                                                 (unsigned short) (5000 + i % 4)}, i};
+        };
+
+        for (unsigned i = 0; i < 4096; i++) {
+            t.addMatch(match(i)).addAction(SFUTable::Action{match(i).ipPort()});
+        }
+
+        for (unsigned i = 0; i < 4096; i += 2) {
+            t.removeMatch(match(i));
+        }
+
+        CHECK(t.size() == 2048);
+
+        for (unsigned i = 0; i < 4096; i++) {
+            REQUIRE(t.hasMatch(match(i)) == (i % 2 == 1));
+        }
+
+        for (unsigned i = 1; i < 4096; i += 2) {
+            REQUIRE(t[match(i)].actions().front().to() == match(i).ipPort());
+            t.removeMatch(match(i));
+        }
+
+        CHECK(t.size() == 0);
+        CHECK_FALSE(t.hasMatch(match(1)));
+
+        // the table is usable again after shrinking
+        t.addMatch(match(7));
+        CHECK(t.hasMatch(match(7)));
+    }
+}
+
+TEST_CASE("SFUTable: Entry: removeAction()", "[sfu_table]") {
+
+    SFUTable::Action a1{net::IPv4Port{"5.6.7.8", 23825}}, a2{net::IPv4Port{"5.6.7.9", 23825}};
+
+    SFUTable t;
+    auto& e = t.addMatch(SFUTable::Match{net::IPv4Port{"1.2.2.4", 23823}, 783927459});
+    e.addAction(a1);
+    e.addAction(a2);
+
+    e.removeAction(a1);
+    CHECK(e.actions().size() == 1);
+    CHECK(e.actions().front() == a2);
+    CHECK_THROWS(e.removeAction(a1));
+}
+
+TEST_CASE("SFUTable: Entry: groups replicas with the same treatment into nodes", "[sfu_table]") {
+
+    // L1T3's decode targets
+    enum DT : unsigned { lo, mid, hi };
+
+    auto action = [](unsigned i, std::optional<unsigned> dt) {
+        SFUTable::Action a{net::IPv4Port{net::IPv4{0x05060700 + i}, 23825}};
+        a.decodeTarget = dt;
+        return a;
+    };
+
+    // replicas of the node holding action a
+    auto replicas = [](const SFUTable::Entry& e, const SFUTable::Action& a) {
+        std::vector<net::IPv4Port> to;
+        for (const auto& n: e.nodes()) {
+            for (auto r: n.replicas) {
+                if (e.actions()[r] == a) {
+                    for (auto o: n.replicas) {
+                        to.push_back(e.actions()[o].to());
+                    }
+                    std::sort(to.begin(), to.end(), [](const auto& x, const auto& y) {
+                        return x.ip().num() < y.ip().num();
+                    });
+                }
+            }
+        }
+        return to;
+    };
+
+    SFUTable t;
+    auto& e = t.addMatch(SFUTable::Match{net::IPv4Port{"1.2.2.4", 23823}, 783927459});
+
+    auto a1 = action(1, DT::lo), a2 = action(2, DT::hi), a3 = action(3, DT::lo);
+    auto a4 = action(4, std::nullopt);
+    e.addAction(a1);
+    e.addAction(a2);
+    e.addAction(a3);
+    e.addAction(a4);
+
+    SECTION("same decode target shares a node, no svc has a node of its own") {
+
+        CHECK(e.nodes().size() == 3);
+        CHECK(replicas(e, a1) == std::vector{a1.to(), a3.to()});
+        CHECK(replicas(e, a2) == std::vector{a2.to()});
+        CHECK(replicas(e, a4) == std::vector{a4.to()});
+        CHECK(e.nodes()[0].decodeTarget == 0u);
+        CHECK(e.nodes()[1].decodeTarget == 2u);
+        CHECK(e.nodes()[2].decodeTarget == std::nullopt);
+    }
+
+    SECTION("updateTreatment() moves a replica to its new node") {
+
+        e.actions()[2].decodeTarget = DT::mid;
+        e.updateTreatment(e.actions()[2]);
+        CHECK(e.nodes().size() == 4);
+        CHECK(replicas(e, a1) == std::vector{a1.to()});
+        CHECK(replicas(e, a3) == std::vector{a3.to()});
+
+        e.actions()[0].decodeTarget = DT::mid;
+        e.updateTreatment(e.actions()[0]);
+        CHECK(e.nodes().size() == 3);
+        CHECK(replicas(e, a1) == std::vector{a1.to(), a3.to()});
+    }
+
+    SECTION("removeAction() keeps replica indices valid") {
+
+        e.removeAction(a1);
+        CHECK(e.nodes().size() == 3);
+        CHECK(replicas(e, a3) == std::vector{a3.to()});
+        CHECK(replicas(e, a4) == std::vector{a4.to()});
+
+        e.removeAction(a3);
+        CHECK(e.nodes().size() == 2);
+        CHECK(replicas(e, a2) == std::vector{a2.to()});
+    }
+}
+
+TEST_CASE("SFUTable: Entry: prunes the template IDs of the latest structure per node",
+          "[sfu_table]") {
+
+    // L1T3's decode targets, L2T3's S1T2
+    enum DT : unsigned { lo, mid, hi, s1t2 = 5 };
+
+    SFUTable t;
+    auto& e = t.addMatch(SFUTable::Match{net::IPv4Port{"1.2.2.4", 23823}, 783927459});
+
+    for (unsigned i = 0; i < 5; i++) {
+        SFUTable::Action a{net::IPv4Port{net::IPv4{0x05060700 + i}, 23825}};
+        if (i < 3) {
+            a.decodeTarget = i;
+        } else if (i == 4) {
+            a.decodeTarget = DT::s1t2;
+        }
+        e.addAction(a);
+    }
+
+    auto node = [&e](std::optional<unsigned> dt) {
+        return *std::find_if(e.nodes().begin(), e.nodes().end(), [&](const auto& n) {
+            return n.decodeTarget == dt;
+        });
+    };
+
+    // L1T3 until the first structure: templates 0 and 1 in all decode targets, 2 from mid, 3
+    // and 4 in hi only
+    CHECK_FALSE(e.prunes(node(DT::lo), 1));
+    CHECK(e.prunes(node(DT::lo), 2));
+    CHECK(e.prunes(node(DT::mid), 3));
+    CHECK_FALSE(e.prunes(node(DT::hi), 4));
+    CHECK(e.decodeTargets() == 3);
+
+    // L2T3: S0T2 prunes all of S1 (templates 5-9), S1T2 none
+    e.updateExclusions(av1::svc::L2T3Structure::dropTable());
+    CHECK(e.decodeTargets() == 6);
+    CHECK_FALSE(e.prunes(node(DT::hi), 4));
+    CHECK(e.prunes(node(DT::hi), 5));
+    CHECK(e.prunes(node(DT::hi), 9));
+    CHECK_FALSE(e.prunes(node(DT::s1t2), 5));
+    CHECK_FALSE(e.prunes(node(DT::s1t2), 9));
+
+    // L1T2 with template IDs 6-8: 8 is T1
+    e.updateExclusions(av1::svc::L1T2Structure::dropTable(6));
+    CHECK(e.decodeTargets() == 2);
+    CHECK_FALSE(e.prunes(node(DT::lo), 2));
+    CHECK(e.prunes(node(DT::lo), 8));
+    CHECK_FALSE(e.prunes(node(DT::mid), 8));
+
+    // L1T3 as parsed from a descriptor
+    const unsigned char l1t3[] = {0xc0, 0x00, 0x64, 0x80, 0x02, 0x14, 0xea, 0xa8, 0x60, 0x41,
+                                  0x4d, 0x14, 0x10, 0x20, 0x84, 0x26};
+    e.updateExclusions(av1::DropTable{av1::DependencyDescriptor{l1t3, sizeof(l1t3)}});
+
+    // copies of the entry share the exclusions
+    auto copy = t;
+    const auto& c = copy[SFUTable::Match{net::IPv4Port{"1.2.2.4", 23823}, 783927459}];
+
+    for (const auto* x: {&std::as_const(e), &c}) {
+        CHECK_FALSE(x->prunes(node(DT::lo), 1));
+        CHECK(x->prunes(node(DT::lo), 2));
+        CHECK(x->prunes(node(DT::lo), 4));
+        CHECK_FALSE(x->prunes(node(DT::lo), 8));
+        CHECK_FALSE(x->prunes(node(DT::mid), 2));
+        CHECK(x->prunes(node(DT::mid), 3));
+        CHECK_FALSE(x->prunes(node(DT::hi), 4));
+        CHECK_FALSE(x->prunes(node(std::nullopt), 4));
+    }
 }
@@ -0,0 +1,288 @@
+#include <catch.h>
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "proto/rtp.h"
+#include "rtp_rtcp_packets.h"
+#include "sharded_data_plane_model.h"
+
+using namespace p4sfu;
+using namespace boost;
+
+namespace {
+
+    const auto localhost = asio::ip::make_address_v4("127.0.0.1");
+
+    net::IPv4Port ipPort(const asio::ip::udp::socket& s) {
+        return net::IPv4Port{net::IPv4{"127.0.0.1"}, s.local_endpoint().port()};
+    }
+
+    //! binds sockets to ephemeral ports until one is steered to shard
+    std::unique_ptr<asio::ip::udp::socket> socketOnShard(asio::io_context& io, unsigned shard,
+                                                         unsigned shards) {
+        for (;;) {
+            auto s = std::make_unique<asio::ip::udp::socket>(
+                io, asio::ip::udp::endpoint{localhost, 0});
+
+            if (ShardedDataPlaneModel::shardOf(ipPort(*s), shards) == shard) {
+                return s;
+            }
+        }
+    }
+
+    //! receives n datagrams on each of the sockets, the timeout only bounds a failing test
+    std::vector<std::vector<std::vector<unsigned char>>> receive(
+        asio::io_context& io, const std::vector<std::pair<asio::ip::udp::socket*, unsigned>>& n) {
+
+        std::vector<std::vector<std::vector<unsigned char>>> received(n.size());
+        std::vector<std::array<unsigned char, 2048>> bufs(n.size());
+        std::vector<std::function<void (const system::error_code&, std::size_t)>> handlers;
+
+        for (std::size_t i = 0; i < n.size(); i++) {
+            handlers.emplace_back([&, i](const system::error_code& ec, std::size_t len) {
+
+                if (ec) {
+                    return;
+                }
+
+                received[i].emplace_back(bufs[i].begin(), bufs[i].begin() + len);
+
+                if (received[i].size() < n[i].second) {
+                    n[i].first->async_receive(asio::buffer(bufs[i]), handlers[i]);
+                }
+            });
+        }
+
+        for (std::size_t i = 0; i < n.size(); i++) {
+            if (n[i].second > 0) {
+                n[i].first->async_receive(asio::buffer(bufs[i]), handlers[i]);
+            }
+        }
+
+        io.restart();
+        io.run_for(std::chrono::seconds(2));
+        return received;
+    }
+}
+
+TEST_CASE("ShardedDataPlaneModel: steers senders to the shard owning their matches",
+          "[sharded_data_plane_model]") {
+
+    const unsigned shards = 2;
+
+    asio::io_context io;
+    ShardedDataPlaneModel::Config config;
+    config.port = 0;
+    config.shards = shards;
+
+    ShardedDataPlaneModel dp(&io, &config);
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    auto localhost = asio::ip::make_address_v4("127.0.0.1");
+    asio::ip::udp::endpoint sfuEp{localhost, dp.port()};
+
+    // one sender per shard:
+    std::vector<std::unique_ptr<asio::ip::udp::socket>> senders(shards);
+
+    for (unsigned found = 0; found < shards;) {
+
+        auto s = std::make_unique<asio::ip::udp::socket>(io, asio::ip::udp::endpoint{localhost, 0});
+        auto shard = ShardedDataPlaneModel::shardOf(
+            net::IPv4Port{net::IPv4{"127.0.0.1"}, s->local_endpoint().port()}, shards);
+
+        if (!senders[shard]) {
+            senders[shard] = std::move(s);
+            found++;
+        }
+    }
+
+    asio::ip::udp::socket receiver{io, asio::ip::udp::endpoint{localhost, 0}};
+
+    // the shards' SFU tables are updated before addStream() returns
+    for (auto& s: senders) {
+        dp.addStream(DataPlane::Stream{
+            .src  = net::IPv4Port{net::IPv4{"127.0.0.1"}, s->local_endpoint().port()},
+            .dst  = net::IPv4Port{net::IPv4{"127.0.0.1"}, receiver.local_endpoint().port()},
+            .ssrc = 0x6a70d0e8
+        });
+    }
+
+    for (auto& s: senders) {
+        s->send_to(asio::buffer(test::rtp_buf1, sizeof(test::rtp_buf1)), sfuEp);
+    }
+
+    // runs until all forwarded packets arrived, the timeout only bounds a failing test
+    unsigned received = 0;
+    std::array<char, 2048> buf = {};
+
+    std::function<void (const system::error_code&, std::size_t)> onReceive =
+        [&](const system::error_code& ec, std::size_t len) {
+
+            if (ec) {
+                return;
+            }
+
+            received += (len == sizeof(test::rtp_buf1));
+
+            if (received < shards) {
+                receiver.async_receive(asio::buffer(buf), onReceive);
+            }
+        };
+
+    receiver.async_receive(asio::buffer(buf), onReceive);
+    io.run_for(std::chrono::seconds(2));
+
+    CHECK(received == shards);
+    CHECK(dp.totalStatistics().rtpPkts == shards);
+}
+
+TEST_CASE("ShardedDataPlaneModel: answers NACKs from the cache of the sender's shard",
+          "[sharded_data_plane_model]") {
+
+    const unsigned shards = 2;
+
+    asio::io_context io;
+    ShardedDataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    config.port = 0;
+    config.shards = shards;
+    config.nackCache = RetransmissionCache::Config{.packets = 16};
+
+    ShardedDataPlaneModel dp(&io, &config);
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    asio::ip::udp::endpoint sfuEp{localhost, dp.port()};
+
+    // the NACK arrives at the receiver's shard, the stream and its cache are in the sender's
+    auto sender = socketOnShard(io, 0, shards);
+    auto receiver = socketOnShard(io, 1, shards);
+
+    dp.addStream(DataPlane::Stream{
+        .src      = ipPort(*sender),
+        .dst      = ipPort(*receiver),
+        .ssrc     = 0x6a70d0e8,
+        .rtcpSsrc = 0x0000abcd
+    });
+
+    std::vector<unsigned char> rtp(std::begin(test::rtp_buf1), std::end(test::rtp_buf1));
+
+    for (std::uint16_t seq = 100; seq < 102; seq++) {
+        ((rtp::hdr*) rtp.data())->seq = htons(seq);
+        sender->send_to(asio::buffer(rtp), sfuEp);
+    }
+
+    REQUIRE(receive(io, {{receiver.get(), 2}})[0].size() == 2);
+
+    // generic NACK for 100 and 102, 100 is resent from the cache, 102 requested from the sender
+    const std::vector<unsigned char> nack = {
+        0x81, 205, 0x00, 0x03,
+        0x00, 0x00, 0xab, 0xcd,
+        0x6a, 0x70, 0xd0, 0xe8,
+        0x00, 100,  0x00, 0x02
+    };
+
+    receiver->send_to(asio::buffer(nack), sfuEp);
+
+    auto received = receive(io, {{receiver.get(), 1}, {sender.get(), 1}});
+
+    REQUIRE(received[0].size() == 1);
+    REQUIRE(received[0][0].size() == rtp.size());
+    CHECK(ntohs(((const rtp::hdr*) received[0][0].data())->seq) == 100);
+
+    REQUIRE(received[1].size() == 1);
+    REQUIRE(received[1][0].size() == nack.size());
+    CHECK(received[1][0][13] == 102);
+    CHECK(received[1][0][15] == 0);
+
+    SECTION("NACKs without FCIs are forwarded unchanged") {
+
+        std::vector<unsigned char> empty(nack.begin(), nack.begin() + 12);
+        empty[3] = 0x02;
+        receiver->send_to(asio::buffer(empty), sfuEp);
+
+        received = receive(io, {{sender.get(), 1}});
+
+        REQUIRE(received[0].size() == 1);
+        CHECK(received[0][0] == empty);
+    }
+}
+
+TEST_CASE("ShardedDataPlaneModel: coalesces PLIs in the sender's shard",
+          "[sharded_data_plane_model]") {
+
+    const unsigned shards = 2;
+
+    asio::io_context io;
+    ShardedDataPlaneModel::Config config;
+    config.av1RtpExt = 12;
+    config.port = 0;
+    config.shards = shards;
+    config.pliWindow = std::chrono::seconds(10);
+
+    ShardedDataPlaneModel dp(&io, &config);
+    dp.onPacketToController([](DataPlane&, DataPlane::PktIn) { });
+
+    asio::ip::udp::endpoint sfuEp{localhost, dp.port()};
+
+    // one receiver's PLIs are handled in the sender's shard, the other's are handed to it
+    auto sender = socketOnShard(io, 0, shards);
+    std::unique_ptr<asio::ip::udp::socket> receivers[] = {
+        socketOnShard(io, 0, shards),
+        socketOnShard(io, 1, shards)
+    };
+
+    for (std::uint8_t i = 0; i < 2; i++) {
+        dp.addStream(DataPlane::Stream{
+            .src      = ipPort(*sender),
+            .dst      = ipPort(*receivers[i]),
+            .ssrc     = 0x773939ae,
+            .rtcpSsrc = 0x0000ab00u + i
+        });
+    }
+
+    auto pliFrom = [&](std::uint8_t i) {
+        const std::array<unsigned char, 12> pli = {
+            0x81, 206, 0x00, 0x02,
+            0x00, 0x00, 0xab, i,
+            0x77, 0x39, 0x39, 0xae
+        };
+        receivers[i]->send_to(asio::buffer(pli), sfuEp);
+    };
+
+    auto keyframeRequests = [&dp]() {
+        for (const auto& st: dp.streamStatistics()) {
+            if (st.keyframeRequests) {
+                return *st.keyframeRequests;
+            }
+        }
+        return StreamStatistics::KeyframeRequests{};
+    };
+
+    SECTION("first PLI from the sender's shard") {
+        pliFrom(0);
+    }
+
+    SECTION("first PLI handed to the sender's shard") {
+        pliFrom(1);
+    }
+
+    REQUIRE(receive(io, {{sender.get(), 1}})[0].size() == 1);
+
+    pliFrom(0);
+    pliFrom(1);
+
+    // suppressed PLIs leave nothing to wait for, the timeout only bounds a failing test
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+
+    while (keyframeRequests().suppressed < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+
+    CHECK(keyframeRequests().forwarded == 1);
+    CHECK(keyframeRequests().suppressed == 2);
+    CHECK(sender->available() == 0);
+}
@@ -58,6 +58,14 @@ TEST_CASE("SwitchAgentState: getSendStream", "[switch_agent_state]") {
         CHECK(it != s.sendStreams().end());
         CHECK(it->second.type == MediaType::video);
         CHECK(it->second.receiveStreamIds.empty());
+        CHECK_FALSE(it->second.av1Structure);
+    }
+
+    SECTION("by sender address") {
+        auto it = s.getSendStream(net::IPv4Port{"1.1.1.0", 49290}, 1102);
+        REQUIRE(it != s.sendStreams().end());
+        CHECK(it->second.rtx);
+        CHECK(s.getSendStream(net::IPv4Port{"1.1.1.0", 49291}, 1102) == s.sendStreams().end());
     }
 }
 
@@ -79,7 +87,7 @@ TEST_CASE("SwitchAgentState: getReceiveStream", "[switch_agent_state]") {
         CHECK(it->second.type == MediaType::video);
         CHECK(it->second.sendStreamId == 0);
         CHECK(it->second.sendingParticipant == 1);
-        CHECK(it->second.decodeTarget == av1::svc::L1T3::DecodeTarget::hi);
+        CHECK(it->second.decodeTarget == std::nullopt);
     }
 
     SECTION("by ip end point and ssrc, returns std::end if stream does not exist") {
@@ -94,6 +102,69 @@ TEST_CASE("SwitchAgentState: getReceiveStream", "[switch_agent_state]") {
         CHECK(it->second.type == MediaType::video);
         CHECK(it->second.sendStreamId == 0);
         CHECK(it->second.sendingParticipant == 1);
-        CHECK(it->second.decodeTarget == av1::svc::L1T3::DecodeTarget::hi);
+        CHECK(it->second.decodeTarget == std::nullopt);
+    }
+}
+
+TEST_CASE("SwitchAgentState: aggregateEstimate", "[switch_agent_state]") {
+
+    SwitchAgentState s;
+    s.addSendStream(1, 1, net::IPv4Port{"1.1.1.0", 49290}, MediaType::video, 1101, 1102);
+    s.addReceiveStream(1, 1, 2, net::IPv4Port{"1.2.1.0", 23292}, 1101, 1102, 2001);
+    s.addReceiveStream(1, 1, 3, net::IPv4Port{"1.3.1.0", 12022}, 1101, 1102, 3001);
+    s.addReceiveStream(1, 1, 4, net::IPv4Port{"1.4.1.0", 32101}, 1101, 1102, 4001);
+
+    auto sendStreamId = s.getSendStream(1, 1101)->first;
+    auto receiver = [&s](unsigned participantId) -> SwitchAgentState::ReceiveStream& {
+        return s.getReceiveStream(1, 1101, participantId)->second;
+    };
+
+    SECTION("no estimate without REMBs") {
+        CHECK_FALSE(s.aggregateEstimate(sendStreamId));
+        CHECK_FALSE(s.aggregateEstimate(39403));
     }
+
+    SECTION("minimum of the latest estimates of the receivers on the top decode target") {
+
+        receiver(2).bandwidthEstimates = {100000, 2000000};
+        receiver(3).bandwidthEstimates = {1500000};
+        receiver(4).bandwidthEstimates = {300000};
+        receiver(4).decodeTarget = 0;
+
+        auto e = s.aggregateEstimate(sendStreamId);
+        REQUIRE(e);
+        CHECK(e->bitRate == 1500000);
+        CHECK(e->rtcpSsrc == 3001);
+
+        // no receiver on the top layer: the highest layer demanded decides
+        receiver(2).decodeTarget = 1;
+        receiver(3).decodeTarget = 0;
+
+        e = s.aggregateEstimate(sendStreamId);
+        REQUIRE(e);
+        CHECK(e->bitRate == 2000000);
+        CHECK(e->rtcpSsrc == 2001);
+    }
+}
+
+TEST_CASE("SwitchAgentState: decode targets of a send stream", "[switch_agent_state]") {
+
+    SwitchAgentState s;
+    s.addSendStream(1, 1, net::IPv4Port{"1.1.1.0", 49290}, MediaType::video, 1101, 1102);
+    auto& stream = s.getSendStream(1, 1101)->second;
+
+    // L1T3's until the first structure, like the data plane
+    CHECK(stream.decodeTargets() == 3);
+
+    // L2T2 keyframe: S0T0, S0T1, S1T0, S1T1
+    const unsigned char l2t2[] = {
+        0xc0, 0x00, 0x01, 0x80, 0x03, 0x18, 0x7a, 0xaa, 0xf1, 0x30, 0xa0, 0xa0, 0x14, 0xd1, 0x41,
+        0x38, 0x23, 0x04, 0x60, 0x08, 0x64, 0x22, 0x22, 0x26, 0x50, 0x09, 0xf0, 0x07, 0x70, 0x13,
+        0xf0, 0x0e, 0xf0
+    };
+
+    av1::DependencyDescriptor dd{l2t2, sizeof(l2t2)};
+    REQUIRE(dd.structure());
+    stream.av1Structure = *dd.structure();
+    CHECK(stream.decodeTargets() == 4);
 }
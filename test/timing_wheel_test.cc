@@ -0,0 +1,71 @@
+#include <catch.h>
+
+#include <vector>
+
+#include <timing_wheel.h>
+
+using namespace p4sfu;
+
+TEST_CASE("TimingWheel: fires items at their deadline", "[timing_wheel]") {
+
+    TimingWheel<int> w{100};
+    std::vector<std::pair<std::uint64_t, int>> fired;
+
+    auto advance = [&](std::uint64_t now) {
+        w.advance(now, [&](int&& i) { fired.emplace_back(w.now(), i); });
+    };
+
+    SECTION("within the first level") {
+
+        w.schedule(1, 105);
+        w.schedule(2, 103);
+        CHECK(w.size() == 2);
+
+        advance(104);
+        REQUIRE(fired.size() == 1);
+        CHECK(fired[0] == std::pair<std::uint64_t, int>{103, 2});
+
+        advance(110);
+        REQUIRE(fired.size() == 2);
+        CHECK(fired[1] == std::pair<std::uint64_t, int>{105, 1});
+        CHECK(w.empty());
+    }
+
+    SECTION("past deadlines fire on the next tick") {
+
+        w.schedule(1, 50);
+        advance(100);
+        CHECK(fired.empty());
+        advance(101);
+        CHECK(fired.size() == 1);
+    }
+
+    SECTION("cascaded from higher levels") {
+
+        std::vector<std::uint64_t> deadlines = {355, 356, 611, 70000, 65636, 1 << 20};
+
+        for (std::size_t i = 0; i < deadlines.size(); i++) {
+            w.schedule((int) i, deadlines[i]);
+        }
+
+        advance(2 << 20);
+        REQUIRE(fired.size() == deadlines.size());
+
+        for (const auto& [tick, i]: fired) {
+            CHECK(tick == deadlines[i]);
+        }
+
+        for (std::size_t i = 1; i < fired.size(); i++) {
+            CHECK(fired[i - 1].first < fired[i].first);
+        }
+    }
+
+    SECTION("skips idle ticks") {
+
+        advance(1ull << 40);
+        CHECK(w.now() == 1ull << 40);
+        w.schedule(1, (1ull << 40) + 300);
+        advance((1ull << 40) + 300);
+        CHECK(fired.size() == 1);
+    }
+}
@@ -0,0 +1,195 @@
+#include <catch.h>
+
+#include <map>
+#include <optional>
+#include <vector>
+
+#include <proto/rtcp.h>
+#include <transport_feedback.h>
+
+using namespace p4sfu;
+using namespace std::chrono_literals;
+
+namespace {
+
+    using Reports = std::map<std::uint16_t, std::optional<TransportFeedback::Clock::duration>>;
+
+    //! parses a feedback packet into arrival times by sequence number
+    bool parse(const unsigned char* buf, std::size_t len, Reports& reports,
+               std::vector<std::uint16_t>* order = nullptr) {
+
+        return TransportFeedback::parse(buf, len, [&](std::uint16_t seq, auto arrival) {
+            reports[seq] = arrival;
+            if (order) {
+                order->push_back(seq);
+            }
+        });
+    }
+}
+
+TEST_CASE("TransportFeedback: reports arrival times and losses", "[transport_feedback]") {
+
+    TransportFeedback fb{TransportFeedback::Config{.rtpExt = 3, .ssrc = 7}};
+    auto t0 = TransportFeedback::Clock::time_point{} + 1000s;
+    std::vector<unsigned char> buf(1200);
+
+    // across the wrap-around, 0 is lost and 2 arrives before 1
+    fb.record(65534, t0);
+    fb.record(65535, t0 + 1ms);
+    fb.record(2, t0 + 2ms);
+    fb.record(1, t0 + 3ms);
+
+    CHECK_FALSE(fb.due(t0 + 99ms));
+    CHECK(fb.due(t0 + 100ms));
+
+    auto len = fb.write(buf.data(), buf.size(), 0x1234, t0 + 100ms);
+    REQUIRE(len > 0);
+    CHECK(len % 4 == 0);
+
+    const auto* rtcp = reinterpret_cast<const rtcp::hdr*>(buf.data());
+    CHECK(rtcp->pt == 205);
+    CHECK(rtcp->fb_fmt() == 15);
+    CHECK(rtcp->byte_len() == len);
+    CHECK(rtcp->complete());
+    CHECK(ntohl(rtcp->sender_ssrc) == 7);
+    CHECK(ntohl(rtcp->data.twcc.ssrc) == 0x1234);
+    CHECK(ntohs(rtcp->data.twcc.base_seq) == 65534);
+    CHECK(ntohs(rtcp->data.twcc.status_count) == 5);
+    CHECK(rtcp->data.twcc.fb_pkt_count == 0);
+
+    Reports r;
+    std::vector<std::uint16_t> order;
+    REQUIRE(parse(buf.data(), len, r, &order));
+
+    CHECK(order == std::vector<std::uint16_t>{65534, 65535, 0, 1, 2});
+    REQUIRE(r[65534]);
+    REQUIRE(r[65535]);
+    REQUIRE(r[1]);
+    REQUIRE(r[2]);
+    CHECK_FALSE(r[0]);
+    CHECK(*r[65535] - *r[65534] == 1ms);
+    CHECK(*r[1] - *r[65534] == 3ms);
+    CHECK(*r[2] - *r[1] == -1ms);
+
+    SECTION("reported packets aren't reported again") {
+
+        CHECK_FALSE(fb.due(t0 + 300ms));
+        CHECK(fb.write(buf.data(), buf.size(), 0x1234, t0 + 300ms) == 0);
+
+        fb.record(0, t0 + 150ms); // too late
+        CHECK(fb.write(buf.data(), buf.size(), 0x1234, t0 + 300ms) == 0);
+
+        fb.record(3, t0 + 200ms);
+        len = fb.write(buf.data(), buf.size(), 0x1234, t0 + 300ms);
+        REQUIRE(len > 0);
+        CHECK(ntohs(rtcp->data.twcc.base_seq) == 3);
+        CHECK(ntohs(rtcp->data.twcc.status_count) == 1);
+        CHECK(rtcp->data.twcc.fb_pkt_count == 1);
+    }
+}
+
+TEST_CASE("TransportFeedback: encodes runs and large gaps", "[transport_feedback]") {
+
+    TransportFeedback fb{TransportFeedback::Config{.maxPackets = 100}};
+    auto t0 = TransportFeedback::Clock::time_point{} + 1000s;
+    std::vector<unsigned char> buf(1200);
+    Reports r;
+
+    SECTION("a run of received packets takes a single chunk") {
+
+        for (std::uint16_t seq = 0; seq < 100; seq++) {
+            CHECK_FALSE(fb.due(t0));
+            fb.record(seq, t0 + seq * 1ms);
+        }
+
+        CHECK(fb.due(t0 + 99ms));
+
+        // header, one run-length chunk, 100 small deltas, padding
+        auto len = fb.write(buf.data(), buf.size(), 1, t0 + 99ms);
+        CHECK(len == 124);
+        CHECK(buf[0] & 0x20); // padding
+        REQUIRE(parse(buf.data(), len, r));
+        CHECK(r.size() == 100);
+        CHECK(*r[99] - *r[0] == 99ms);
+    }
+
+    SECTION("deltas beyond 16 bits continue with a new reference time") {
+
+        fb.record(0, t0);
+        fb.record(1, t0 + 10s);
+
+        auto len = fb.write(buf.data(), buf.size(), 1, t0 + 10s);
+        REQUIRE(parse(buf.data(), len, r));
+        CHECK(r.size() == 1);
+
+        len = fb.write(buf.data(), buf.size(), 1, t0 + 10s);
+        REQUIRE(parse(buf.data(), len, r));
+        REQUIRE(r.size() == 2);
+        CHECK(*r[1] - *r[0] == 10s);
+    }
+
+    SECTION("packets that don't fit are reported in further feedback packets") {
+
+        for (std::uint16_t seq = 0; seq < 300; seq += (seq % 10 == 5 ? 2 : 1)) {
+            fb.record(seq, t0 + seq * 2ms);
+        }
+
+        std::vector<std::uint16_t> order;
+        unsigned packets = 0;
+
+        while (auto len = fb.write(buf.data(), 64, 1, t0 + 1s)) {
+            CHECK(len <= 64);
+            REQUIRE(parse(buf.data(), len, r, &order));
+            packets++;
+        }
+
+        CHECK(packets > 1);
+        REQUIRE(order.size() == 300);
+
+        for (std::uint16_t seq = 0; seq < 300; seq++) {
+            CHECK(order[seq] == seq);
+            CHECK(r[seq].has_value() == (seq % 10 != 6));
+        }
+    }
+}
+
+TEST_CASE("TransportFeedback: rejects malformed feedback", "[transport_feedback]") {
+
+    TransportFeedback fb{TransportFeedback::Config{}};
+    auto t0 = TransportFeedback::Clock::time_point{} + 1000s;
+    std::vector<unsigned char> buf(1200);
+    Reports r;
+
+    fb.record(0, t0);
+    fb.record(1, t0 + 1ms);
+    auto len = fb.write(buf.data(), buf.size(), 1, t0 + 1ms);
+
+    REQUIRE(parse(buf.data(), len, r));
+
+    CHECK_FALSE(parse(buf.data(), len - 4, r)); // truncated
+    CHECK_FALSE(parse(buf.data(), TransportFeedback::BASE_LEN - 1, r));
+
+    SECTION("missing status chunks") {
+        buf[3] = (unsigned char) (TransportFeedback::BASE_LEN / 4 - 1);
+        CHECK_FALSE(parse(buf.data(), TransportFeedback::BASE_LEN, r));
+    }
+
+    SECTION("missing receive deltas") {
+        buf[TransportFeedback::BASE_LEN] = 0x40; // run length chunk of two large deltas
+        buf[TransportFeedback::BASE_LEN + 1] = 0x02;
+        CHECK_FALSE(parse(buf.data(), len, r));
+    }
+
+    SECTION("reserved symbol") {
+        buf[TransportFeedback::BASE_LEN] = 0x7f; // run length chunk of symbol 3
+        CHECK_FALSE(parse(buf.data(), len, r));
+    }
+
+    SECTION("not transport-cc") {
+        buf[0] = 0x81;
+        CHECK_FALSE(parse(buf.data(), len, r));
+    }
+
+    CHECK_THROWS_AS(TransportFeedback{TransportFeedback::Config{.maxPackets = 0}},
+                    std::invalid_argument);
+}
@@ -0,0 +1,102 @@
+#include <catch.h>
+
+#include <net/udp_server.h>
+
+using namespace boost;
+
+TEST_CASE("UDPServer: sends gathered headers and payloads from the receive buffer",
+          "[udp_server]") {
+
+    asio::io_context io;
+    UDPServer server{io, 0};
+    asio::ip::udp::endpoint serverEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     server.socket().local_endpoint().port()};
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+
+    unsigned received = 0;
+
+    server.onMessage([&received](UDPInterface& c, asio::ip::udp::endpoint& from, const char* buf,
+                                 std::size_t len) {
+
+        received++;
+
+        // two copies with individual headers, the payload stays in the receive buffer
+        for (char i = 0; i < 2; i++) {
+            char hdr[4] = {buf[0], i, 0, 0};
+            c.sendToGather(from, hdr, sizeof(hdr), buf + 4, len - 4);
+        }
+    });
+
+    for (char i = 0; i < 3; i++) {
+        char buf[100];
+        std::memset(buf, i, sizeof(buf));
+        client.send_to(asio::buffer(buf, sizeof(buf)), serverEp);
+    }
+
+    // handle all datagrams before any send completes, the receive buffer is reused meanwhile
+    while (received < 3) {
+        io.run_one();
+    }
+
+    io.poll();
+
+    for (char i = 0; i < 3; i++) {
+        for (char j = 0; j < 2; j++) {
+
+            std::array<char, 2048> rxBuf = {};
+            REQUIRE(client.receive(asio::buffer(rxBuf)) == 100);
+
+            CHECK(rxBuf[0] == i);
+            CHECK(rxBuf[1] == j);
+            CHECK(rxBuf[4] == i);
+            CHECK(rxBuf[99] == i);
+        }
+    }
+}
+
+TEST_CASE("UDPServer: copies buffers that are not the receive buffer", "[udp_server]") {
+
+    asio::io_context io;
+    UDPServer server{io, 0};
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+    asio::ip::udp::endpoint clientEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     client.local_endpoint().port()};
+
+    {
+        char buf[10] = {1, 2, 3};
+        server.sendTo(clientEp, buf, sizeof(buf));
+        std::memset(buf, 0, sizeof(buf)); // must not affect the pending send
+    }
+
+    io.poll();
+
+    std::array<char, 2048> rxBuf = {};
+    CHECK(client.receive(asio::buffer(rxBuf)) == 10);
+    CHECK(rxBuf[2] == 3);
+}
+
+TEST_CASE("UDPServer: sends the copy of a buffer overwritten before the send is performed",
+          "[udp_server]") {
+
+    asio::io_context io;
+    UDPServer server{io, 0};
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+    asio::ip::udp::endpoint clientEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     client.local_endpoint().port()};
+
+    // a pending wait queues the send instead of sending it right away
+    server.socket().async_wait(asio::ip::udp::socket::wait_write, [](system::error_code) { });
+
+    char buf[10] = {1, 2, 3};
+    server.sendTo(clientEp, buf, sizeof(buf));
+    std::memset(buf, 0, sizeof(buf));
+
+    io.poll();
+
+    std::array<char, 2048> rxBuf = {};
+    CHECK(client.receive(asio::buffer(rxBuf)) == 10);
+    CHECK(rxBuf[2] == 3);
+}
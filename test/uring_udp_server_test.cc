@@ -0,0 +1,84 @@
+#include <catch.h>
+
+#include <net/uring_udp_server.h>
+
+using namespace boost;
+
+TEST_CASE("UringUDPServer: receives and sends datagrams in batches", "[uring_udp_server]") {
+
+    asio::io_context io;
+    UringUDPServer server{io, 0, 8};
+    asio::ip::udp::endpoint serverEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     server.socket().local_endpoint().port()};
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+
+    std::vector<std::size_t> batchSizes;
+
+    server.onBatch([&batchSizes](UDPInterface& c, UDPInterface::Datagram* d, std::size_t n) {
+
+        batchSizes.push_back(n);
+
+        for (std::size_t i = 0; i < n; i++) { // echo every datagram twice
+            CHECK(d[i].len == 100);
+            c.sendTo(d[i].from, d[i].buf, d[i].len);
+            c.sendTo(d[i].from, d[i].buf, d[i].len);
+        }
+    });
+
+    // more datagrams than receive buffers, so buffers have to be recycled
+    const unsigned n = 20;
+
+    for (unsigned i = 0; i < n; i++) {
+        char buf[100] = {(char) i};
+        client.send_to(asio::buffer(buf, sizeof(buf)), serverEp);
+        io.poll();
+    }
+
+    while (server.statistics().rxPkts < n) {
+        io.run_one();
+    }
+
+    std::size_t received = 0;
+    std::array<char, 2048> rxBuf = {};
+
+    while (received < 2 * n && client.receive(asio::buffer(rxBuf)) == 100) {
+        received++;
+    }
+
+    std::size_t total = 0;
+    for (auto s: batchSizes) {
+        total += s;
+    }
+
+    CHECK(total == n);
+    CHECK(received == 2 * n);
+}
+
+TEST_CASE("UringUDPServer: sends immediately outside a batch", "[uring_udp_server]") {
+
+    bool zeroCopy = false;
+
+    SECTION("SEND") { }
+    SECTION("SEND_ZC") { zeroCopy = true; }
+
+    asio::io_context io;
+    UringUDPServer server{io, 0, 4, false, zeroCopy};
+
+    asio::ip::udp::socket client{io, asio::ip::udp::endpoint{asio::ip::udp::v4(), 0}};
+    asio::ip::udp::endpoint clientEp{asio::ip::make_address_v4("127.0.0.1"),
+                                     client.local_endpoint().port()};
+
+    char buf[10] = {1, 2, 3};
+
+    for (int i = 0; i < 10; i++) { // exceeds the number of transmit buffers
+        server.sendTo(clientEp, buf, sizeof(buf));
+    }
+
+    std::array<char, 2048> rxBuf = {};
+
+    for (int i = 0; i < 10; i++) {
+        CHECK(client.receive(asio::buffer(rxBuf)) == 10);
+        CHECK(rxBuf[2] == 3);
+    }
+}
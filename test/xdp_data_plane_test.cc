@@ -0,0 +1,160 @@
+#include <catch.h>
+
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <chrono>
+#include <cstdlib>
+
+#include "rtp_rtcp_packets.h"
+#include "stun_packets.h"
+#include "xdp_data_plane.h"
+
+using namespace p4sfu;
+using namespace boost;
+
+namespace {
+
+    //! veth pair for the duration of a test, the data plane is attached to the first interface,
+    //! test frames are injected and captured on the second one using a packet socket
+    struct VethPair {
+
+        const std::string dp = "p4sfu-xdp0", peer = "p4sfu-xdp1";
+
+        VethPair() {
+            std::system(("ip link del " + dp + " 2>/dev/null").c_str());
+            ok = std::system(("ip link add " + dp + " type veth peer name " + peer
+                + " && ip link set " + dp + " up && ip link set " + peer + " up").c_str()) == 0;
+        }
+
+        ~VethPair() {
+            std::system(("ip link del " + dp + " 2>/dev/null").c_str());
+        }
+
+        bool ok = false;
+    };
+
+    std::vector<unsigned char> frame(const net::IPv4Port& from, const net::IPv4Port& to,
+                                     const unsigned char* payload, std::size_t len) {
+
+        std::vector<unsigned char> f(net::eth::HDR_LEN + net::ipv4::HDR_LEN + net::udp::HDR_LEN
+                                     + len);
+
+        auto* eth = (net::eth::hdr*) f.data();
+        eth->init_default();
+        eth->src_addr.bytes[0] = 0x02;
+        eth->src_addr.bytes[5] = 0x01;
+        std::fill(eth->dst_addr.bytes, eth->dst_addr.bytes + net::eth::ADDR_LEN, 0xff);
+        eth->ether_type = htons(static_cast<std::uint16_t>(net::eth::type::ipv4));
+
+        auto* ip = (net::ipv4::hdr*) (f.data() + net::eth::HDR_LEN);
+        ip->init_default();
+        ip->total_length = htons(len + net::ipv4::HDR_LEN + net::udp::HDR_LEN);
+        ip->next_proto_id = static_cast<std::uint8_t>(net::ipv4::proto::udp);
+        ip->src_addr = htonl(from.ip().num());
+        ip->dst_addr = htonl(to.ip().num());
+        ip->compute_checksum();
+
+        auto* udp = (net::udp::hdr*) (f.data() + net::eth::HDR_LEN + net::ipv4::HDR_LEN);
+        udp->src_port = htons(from.port());
+        udp->dst_port = htons(to.port());
+        udp->dgram_len = htons(len + net::udp::HDR_LEN);
+
+        std::memcpy(f.data() + net::eth::HDR_LEN + net::ipv4::HDR_LEN + net::udp::HDR_LEN,
+                    payload, len);
+
+        return f;
+    }
+}
+
+TEST_CASE("XDPDataPlane: forwards and punts packets on a veth pair", "[.][xdp_data_plane]") {
+
+    // requires CAP_NET_ADMIN, run explicitly with: unit "[xdp_data_plane]"
+
+    VethPair veth;
+    REQUIRE(veth.ok);
+
+    net::IPv4Port sfu{net::IPv4{"10.211.0.1"}, 3000};
+    net::IPv4Port sender{net::IPv4{"10.211.0.2"}, 5002};
+    net::IPv4Port receiver{net::IPv4{"10.211.0.3"}, 5003};
+
+    asio::io_context io;
+    XDPDataPlane::Config config;
+    config.av1RtpExt = 12;
+    config.port = sfu.port();
+    config.ipv4 = "10.211.0.1";
+    config.dataPlaneIface = veth.dp;
+
+    XDPDataPlane dp(&io, &config);
+
+    std::vector<DataPlane::PktIn> punted;
+    dp.onPacketToController([&punted](DataPlane&, DataPlane::PktIn pkt) {
+        punted.push_back(pkt);
+    });
+
+    dp.addStream(DataPlane::Stream{.src = sender, .dst = receiver, .ssrc = 0x6a70d0e8});
+
+    int s = ::socket(AF_PACKET, SOCK_RAW, htons(ETH_P_IP));
+    REQUIRE(s >= 0);
+
+    sockaddr_ll sll = {};
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex = (int) if_nametoindex(veth.peer.c_str());
+    REQUIRE(::bind(s, (sockaddr*) &sll, sizeof(sll)) == 0);
+
+    auto inject = [&](const std::vector<unsigned char>& f) {
+        REQUIRE(::send(s, f.data(), f.size(), 0) == (ssize_t) f.size());
+    };
+
+    // captures the next frame sent by the data plane towards the peer
+    auto capture = [&]() -> std::vector<unsigned char> {
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        std::vector<unsigned char> buf(2048);
+
+        while (std::chrono::steady_clock::now() < deadline) {
+
+            io.poll();
+
+            sockaddr_ll from = {};
+            socklen_t fromLen = sizeof(from);
+            auto n = ::recvfrom(s, buf.data(), buf.size(), MSG_DONTWAIT, (sockaddr*) &from,
+                                &fromLen);
+
+            if (n > 0 && from.sll_pkttype != PACKET_OUTGOING) {
+                buf.resize(n);
+                return buf;
+            }
+        }
+
+        return {};
+    };
+
+    inject(frame(sender, sfu, test::rtp_buf1, sizeof(test::rtp_buf1)));
+    auto out = capture();
+
+    REQUIRE(out.size() == net::eth::HDR_LEN + net::ipv4::HDR_LEN + net::udp::HDR_LEN
+                          + sizeof(test::rtp_buf1));
+
+    const auto* ip = (const net::ipv4::hdr*) (out.data() + net::eth::HDR_LEN);
+    const auto* udp = (const net::udp::hdr*) (out.data() + net::eth::HDR_LEN + net::ipv4::HDR_LEN);
+
+    CHECK(ntohl(ip->src_addr) == sfu.ip().num());
+    CHECK(ntohl(ip->dst_addr) == receiver.ip().num());
+    CHECK(ntohs(udp->src_port) == sfu.port());
+    CHECK(ntohs(udp->dst_port) == receiver.port());
+    CHECK(dp.totalStatistics().rtpPkts == 1);
+    CHECK(punted.empty());
+
+    inject(frame(sender, sfu, test::stun_bind_req, test::stun_bind_req_len));
+
+    for (int i = 0; i < 100 && punted.empty(); i++) {
+        io.run_one_for(std::chrono::milliseconds(10));
+    }
+
+    REQUIRE(punted.size() == 1);
+    CHECK(punted[0].reason == DataPlane::PktIn::Reason::stun);
+    CHECK(punted[0].from == sender);
+
+    ::close(s);
+}
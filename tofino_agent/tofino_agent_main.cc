@@ -23,7 +23,12 @@ cxxopts::Options setOptions() {
         ("u,ice-ufrag", "ICE user-name fragment", cxxopts::value<std::string>(), "UFRAG")
         ("p,ice-pwd", "ICE password", cxxopts::value<std::string>(), "PWD")
         ("x,api-listen-port", "API listen port", cxxopts::value<std::uint16_t>(), "PORT")
+        ("remb-interval", "send each sender one REMB aggregated from its receivers every MS "
+            "(0: no REMB)", cxxopts::value<unsigned>(), "MS")
         ("v,verbose", "log debug messages")
+        ("async-log", "write log messages from a background thread")
+        ("log-file", "write log messages to this file (implies --async-log)",
+            cxxopts::value<std::string>(), "FILE")
         ("h,help", "print this help message");
 
     return opts;
@@ -71,10 +76,22 @@ typename p4sfu::SwitchAgent<DataPlaneType>::Config parseOptions(cxxopts::Options
         config.apiListenPort = parsed["x"].as<std::uint16_t>();
     }
 
+    if (parsed.count("remb-interval")) {
+        config.rembInterval = parsed["remb-interval"].as<unsigned>();
+    }
+
     if (parsed.count("v")) {
         config.verbose = true;
     }
 
+    if (parsed.count("async-log")) {
+        config.asyncLog = true;
+    }
+
+    if (parsed.count("log-file")) {
+        config.logFile = parsed["log-file"].as<std::string>();
+    }
+
     if (parsed.count("h")) {
         printHelp(opts);
     }